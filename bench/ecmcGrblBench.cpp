@@ -0,0 +1,923 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblBench.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+// Standalone benchmark of the grbl core (no ecmc, EtherCAT or IOC needed, see README.md).
+// Runs a corpus of generated programs (or the files given on the command line) through:
+//   load   ecmcGrblProgram::loadFile() (read and line index)
+//   parse  ecmc_filter_line() + gc_parse_line()
+//   plan   gc_execute_line() + mc_line()/mc_arc() + plan_buffer_line()/plan_buffer_arc(), blocks are discarded
+//          instead of executed
+//   run    full simulation: planner, st_prep_buffer() and the ecmc rt execute at the sample time.
+//          Each rt execute is timed (rt cycle time distribution) and the path is integrated
+//          (simulated feed during motion).
+//   plugin (-e) the program is executed by the plugin (ecmcGrbl) with the stubbed ecmc api and
+//          emulated axes of ecmcGrblBenchEcmc.cpp: writer thread, line queue and grbl main thread to
+//          the planner, while the bench thread calls grblRTexecute() back to back as ecmc rt thread.
+//          Each grblRTexecute() is timed.
+// The grbl waits are replaced with the simulation hook of the grbl context
+// (grbl_context_t::simulation_wait), same as in ecmcGrblSimulator.
+
+#include "ecmcGrbl.h"
+#include "ecmcGrblBenchEcmc.h"
+#include "ecmcGrblProgram.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" {
+#include "grbl.h"
+}
+
+#define BENCH_MAX_RATE_MM_MIN 5000.0   // Machine settings used for the corpus
+#define BENCH_ACCELERATION_MM_S2 200.0
+#define BENCH_STEPS_PER_MM 1000.0       // Resolution 0.001mm (short segments keep their direction)
+#define BENCH_CIRCLE_RADIUS_MM 50.0     // segmented_circle (README planner buffer size table)
+#define BENCH_CIRCLE_SEGMENT_MM 0.05
+#define BENCH_CORPUS_DIR "/tmp"
+#define BENCH_RT_HIST_NS 100000             // Rt cycle time histogram range (1ns bins)
+#define BENCH_ACCEL_WINDOW_MS 20.0          // Window for the axis acceleration (two stepper segments)
+#define BENCH_PLUGIN_PORT "GRBL.BENCH"
+#define BENCH_PLUGIN_AXES "X_AXIS=1;Y_AXIS=2;Z_AXIS=3;SPINDLE_AXIS=4;"
+#define BENCH_PLUGIN_AXIS_ID(grblAxis) ((grblAxis) + 1)  // ecmc axis of grbl axis (BENCH_PLUGIN_AXES)
+#define BENCH_PLUGIN_TIMEOUT_S 600.0        // Max wall time of one program in plugin mode
+#define BENCH_AXES_CYCLES 200000            // Timed cycles per axis state (-a)
+#define BENCH_AXES_WARMUP_CYCLES 1000
+#define BENCH_AXES_FEED_MM_MIN 3000.0       // Feed of the move (-a)
+#define BENCH_CHECK_TIMEOUT_S 10.0          // Max wall time of one check program (-t)
+#define BENCH_CHECK_IDLE_S 0.2              // Not busy time for done (-t)
+#define BENCH_CHECK_IDLE_SLEEP_US 1000
+#define BENCH_CHECK_POSITION_TOL_MM 0.001
+#define BENCH_CHECK_VALIDATE_LINES 500
+#define BENCH_CHECK_ACCELERATION_TOL 0.05   // Relative, window averaging and quantization
+#define BENCH_CHECK_VALIDATE_S 1.0          // Max validation time (5s with a 10ms wait per line)
+
+typedef struct {
+  const char *name;
+  size_t      lines;     // Lines at scale 1
+} benchCorpusProgram;
+
+static const benchCorpusProgram benchCorpus[] = {
+  {"short_lines", 100000},   // short G1 segments (0.1..0.5mm)
+  {"dense_arcs",   20000},   // small G2/G3 arcs (radius 0.5..5mm)
+  {"rapids",       30000},   // drilling pattern, G0 between short plunges
+  {"long_file",   500000},   // mixed lines and arcs
+  {"segmented_circle", 20000},  // 0.05mm G1 segments on a circle (needs a deep planner buffer)
+};
+
+typedef struct {
+  bool                  execute;     // Execute stepper (run), else discard blocks (plan)
+  bool                  continuous;  // INTERP_MODE=CONTINUOUS
+  uint16_t              plannerBlocks;  // plan_init_buffer() (PLANNER_BUFFER_SIZE)
+  double                sampleTimeMs;
+  double                timeToNextExeMs;
+  size_t                blocks;      // Blocks discarded (plan)
+  size_t                samples;
+  size_t                motionSamples;
+  double                pathMm;
+  double                lastPosition[N_AXIS];
+  size_t                accelWindowSamples;            // Samples of BENCH_ACCEL_WINDOW_MS
+  size_t                accelWindows;
+  double                accelPosition[2][N_AXIS];      // Positions one and two windows back
+  double                maxAcceleration[N_AXIS];       // Peak per axis [mm/s^2]
+  size_t                rtCycles;
+  uint32_t              rtMinNs;
+  uint32_t              rtMaxNs;
+  std::vector<uint32_t> rtHistNs;    // Cycles per ns (last bin all longer)
+} benchState;
+
+static double benchNow() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1E-9;
+}
+
+// Deterministic pseudo random number in [min, max)
+static double benchRandom(uint64_t *seed, double min, double max) {
+  *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return min + (max - min) * (double)(*seed >> 11) / (double)(1ULL << 53);
+}
+
+// Generate corpus program. Returns 0 or errno.
+static int benchWriteProgram(const char *name, size_t lines, const char *fileName) {
+  FILE *file = fopen(fileName, "w");
+  if(!file) {
+    return errno;
+  }
+
+  uint64_t seed = 1;
+  double x = 0, y = 0;
+  bool lineMode = !strcmp(name, "short_lines");
+  bool arcMode  = !strcmp(name, "dense_arcs");
+  bool drill    = !strcmp(name, "rapids");
+  bool circle   = !strcmp(name, "segmented_circle");
+  fprintf(file, "G21 G90 G17\nG0 X0 Y0 Z1\nM3 S1000\nG1 Z-1 F1000\n");
+  for(size_t i = 0; i < lines; i++) {
+    if(circle) {
+      // Programmed feed above max rate, the achieved feed is limited by the planner look-ahead
+      double angle = i * BENCH_CIRCLE_SEGMENT_MM / BENCH_CIRCLE_RADIUS_MM;
+      fprintf(file, "G1 X%.4f Y%.4f F6000\n", BENCH_CIRCLE_RADIUS_MM * cos(angle),
+              BENCH_CIRCLE_RADIUS_MM * sin(angle));
+    } else if(drill) {
+      x = benchRandom(&seed, -50, 50);
+      y = benchRandom(&seed, -50, 50);
+      fprintf(file, "G0 X%.3f Y%.3f\nG1 Z-1 F1000\nG0 Z1\n", x, y);
+      i += 2;
+    } else if(arcMode || (!lineMode && i % 20 == 0)) {
+      // Arc with center towards origin, end point on the circle
+      double radius = benchRandom(&seed, 0.5, 5);
+      double start  = atan2(y, x) + benchRandom(&seed, -0.5, 0.5);
+      double sweep  = benchRandom(&seed, 0.5, 3);
+      bool   cw     = benchRandom(&seed, 0, 1) < 0.5;
+      double i0     = -radius * cos(start);
+      double j0     = -radius * sin(start);
+      double end    = start + (cw ? -sweep : sweep);
+      x += i0 + radius * cos(end);
+      y += j0 + radius * sin(end);
+      fprintf(file, "%s X%.4f Y%.4f I%.4f J%.4f F1500\n", cw ? "G2" : "G3", x, y, i0, j0);
+    } else {
+      // Short segment, turn back towards origin when far out
+      double angle  = benchRandom(&seed, 0, 2 * M_PI);
+      double length = benchRandom(&seed, 0.1, 0.5);
+      if(fabs(x) > 50 || fabs(y) > 50) {
+        angle = atan2(-y, -x);
+      }
+      x += length * cos(angle);
+      y += length * sin(angle);
+      fprintf(file, "G1 X%.3f Y%.3f F3000\n", x, y);
+    }
+  }
+  fprintf(file, "G0 Z1\nM5\nM2\n");
+  return fclose(file) ? errno : 0;
+}
+
+static void benchAddRtCycle(benchState *state, struct timespec *start, struct timespec *end) {
+  uint32_t timeNs = (end->tv_sec - start->tv_sec) * 1000000000 + (end->tv_nsec - start->tv_nsec);
+  state->rtHistNs[std::min(timeNs, (uint32_t)BENCH_RT_HIST_NS - 1)]++;
+  state->rtMinNs = state->rtCycles == 0 ? timeNs : std::min(state->rtMinNs, timeNs);
+  state->rtMaxNs = std::max(state->rtMaxNs, timeNs);
+  state->rtCycles++;
+  state->samples++;
+}
+
+// Integrate path (position of one sample [mm])
+static void benchAddPosition(benchState *state, double *position) {
+  double distance = 0;
+  for(int j = 0; j < N_AXIS; j++) {
+    distance += (position[j] - state->lastPosition[j]) * (position[j] - state->lastPosition[j]);
+  }
+  memcpy(state->lastPosition, position, sizeof(double) * N_AXIS);
+  if(distance > 0) {
+    state->pathMm += sqrt(distance);
+    state->motionSamples++;
+  }
+
+  // Axis acceleration: Second difference of the positions at the end of each window (averages the
+  // position quantization and the velocity steps between stepper segments)
+  if(state->samples % state->accelWindowSamples == 0) {
+    if(state->accelWindows >= 2) {
+      double windowS = state->accelWindowSamples * state->sampleTimeMs / 1000.0;
+      for(int j = 0; j < N_AXIS; j++) {
+        double acceleration = fabs(position[j] - 2 * state->accelPosition[0][j] + state->accelPosition[1][j]) /
+                              (windowS * windowS);
+        state->maxAcceleration[j] = std::max(state->maxAcceleration[j], acceleration);
+      }
+    }
+    memcpy(state->accelPosition[1], state->accelPosition[0], sizeof(double) * N_AXIS);
+    memcpy(state->accelPosition[0], position, sizeof(double) * N_AXIS);
+    state->accelWindows++;
+  }
+}
+
+static void benchReadReplies() {
+  char discard[TX_BUFFER_SIZE];
+  while(ecmc_read_from_grbl_tx_buffer(discard, sizeof(discard)) > 0) {}
+}
+
+static void benchPosition(benchState *state, double *position) {
+  if(state->continuous) {
+    st_get_continuous_position(position);
+  } else {
+    for(int i = 0; i < N_AXIS; i++) {
+      position[i] = (double)sys_position[i];
+    }
+  }
+  for(int i = 0; i < N_AXIS; i++) {
+    position[i] /= settings.steps_per_mm[i];
+  }
+}
+
+// Grbl waits for the stepper (see ecmcGrblSimulator::doSample())
+static void benchWait(void *arg, double waitS) {
+  benchState *state = (benchState*)arg;
+  benchReadReplies();
+  if(sys.state == STATE_ALARM) {
+    system_set_exec_state_flag(EXEC_RESET);
+    return;
+  }
+
+  if(!state->execute) {
+    // Plan only: drop the oldest block instead of executing it
+    system_clear_exec_state_flag(EXEC_CYCLE_START);
+    if(sys.state == STATE_CYCLE) {
+      st_reset();
+      sys.state = STATE_IDLE;
+    }
+    if(plan_get_current_block()) {
+      plan_discard_current_block();
+      state->blocks++;
+    }
+    return;
+  }
+
+  if(sys.state == STATE_HOLD && bit_istrue(sys.suspend, SUSPEND_HOLD_COMPLETE)) {
+    system_set_exec_state_flag(EXEC_CYCLE_START);
+  }
+
+  size_t samples = waitS > 0 ? (size_t)ceil(waitS * 1000.0 / state->sampleTimeMs) : 1;
+  for(size_t i = 0; i < samples; i++) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(state->continuous) {
+      ecmc_grbl_main_rt_execute_continuous(state->sampleTimeMs);
+    } else {
+      ecmc_grbl_main_rt_execute(&state->timeToNextExeMs, state->sampleTimeMs);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    benchAddRtCycle(state, &start, &end);
+
+    double position[N_AXIS];
+    benchPosition(state, position);
+    benchAddPosition(state, position);
+  }
+}
+
+// Fresh grbl context with default settings and the bench machine limits
+static grbl_context_t *benchCreateContext(benchState *state) {
+  grbl_context_t *ctx = grbl_context_create();
+  if(!ctx) {
+    return NULL;
+  }
+  grbl_context_bind(ctx);
+  settings_restore(SETTINGS_RESTORE_ALL);
+  for(int i = 0; i < N_AXIS; i++) {
+    settings.max_rate[i]     = BENCH_MAX_RATE_MM_MIN;
+    settings.acceleration[i] = BENCH_ACCELERATION_MM_S2 * 60 * 60;
+    settings.steps_per_mm[i] = BENCH_STEPS_PER_MM;
+  }
+  if(!plan_init_buffer(state->plannerBlocks)) {
+    grbl_context_bind(NULL);
+    grbl_context_delete(ctx);
+    return NULL;
+  }
+  memset(&sys, 0, sizeof(system_t));
+  sys.state = STATE_IDLE;
+  sys.f_override = DEFAULT_FEED_OVERRIDE;
+  sys.r_override = DEFAULT_RAPID_OVERRIDE;
+  sys.spindle_speed_ovr = DEFAULT_SPINDLE_SPEED_OVERRIDE;
+  gc_init();
+  plan_reset();
+  st_reset();
+  plan_sync_position();
+  gc_sync_position();
+  ctx->simulation_wait = benchWait;
+  ctx->simulation_arg  = state;
+  return ctx;
+}
+
+// Execute all lines of program on a new context (settings_restore() is not timed). Returns the
+// row of the first error or -1, seconds is the execution time.
+static long benchExecute(ecmcGrblProgram *program, benchState *state, int *error, double *seconds) {
+  grbl_context_t *ctx = benchCreateContext(state);
+  if(!ctx) {
+    *error = STATUS_SETTING_READ_FAIL;
+    return 0;
+  }
+  double start = benchNow();
+  long errorRow = -1;
+  char filtered[LINE_BUFFER_SIZE];
+  for(size_t i = 0; i < program->size() && !sys.abort; i++) {
+    std::string_view line = program->getLine(i);
+    uint8_t status = ecmc_filter_line(filtered, line.data(), line.length()) ? STATUS_OVERFLOW : STATUS_OK;
+    if(status == STATUS_OK && filtered[0] != '$' && filtered[0] != 0) {
+      status = gc_execute_line(filtered);
+    }
+    benchReadReplies();
+    if(status != STATUS_OK) {
+      *error   = status;
+      errorRow = i;
+      break;
+    }
+  }
+  if(errorRow < 0 && !sys.abort) {
+    protocol_buffer_synchronize();
+  }
+  if(sys.abort && errorRow < 0) {
+    *error   = -1;  // alarm
+    errorRow = program->size();
+  }
+  benchReadReplies();
+  *seconds = benchNow() - start;
+  grbl_context_bind(NULL);
+  grbl_context_delete(ctx);
+  return errorRow;
+}
+
+static void benchInitState(benchState *state, double sampleTimeMs, bool continuous) {
+  state->execute         = false;
+  state->continuous      = continuous;
+  state->plannerBlocks   = BLOCK_BUFFER_SIZE;
+  state->sampleTimeMs    = sampleTimeMs;
+  state->timeToNextExeMs = 0;
+  state->blocks          = 0;
+  state->samples         = 0;
+  state->motionSamples   = 0;
+  state->pathMm          = 0;
+  state->accelWindowSamples = std::max((size_t)1, (size_t)lround(BENCH_ACCEL_WINDOW_MS / sampleTimeMs));
+  state->accelWindows    = 0;
+  memset(state->maxAcceleration, 0, sizeof(state->maxAcceleration));
+  state->rtCycles        = 0;
+  state->rtMinNs         = 0;
+  state->rtMaxNs         = 0;
+  state->rtHistNs.assign(BENCH_RT_HIST_NS, 0);
+  memset(state->lastPosition, 0, sizeof(state->lastPosition));
+}
+
+static uint32_t benchPercentile(benchState *state, double percentile) {
+  size_t count = 0;
+  for(uint32_t timeNs = 0; timeNs < BENCH_RT_HIST_NS; timeNs++) {
+    count += state->rtHistNs[timeNs];
+    if(count > percentile / 100.0 * state->rtCycles) {
+      return timeNs;
+    }
+  }
+  return state->rtMaxNs;
+}
+
+static void benchPrintFeedAndRt(benchState *state) {
+  double simS    = state->samples * state->sampleTimeMs / 1000.0;
+  double motionS = state->motionSamples * state->sampleTimeMs / 1000.0;
+  printf("  feed:   %.1f mm path, %.1f mm/min average, %.1f mm/min mean during motion\n",
+         state->pathMm, simS > 0 ? state->pathMm / simS * 60 : 0,
+         motionS > 0 ? state->pathMm / motionS * 60 : 0);
+  printf("  rt:     %zu cycles, min %u ns, p50 %u ns, p99 %u ns, p99.9 %u ns, max %u ns\n",
+         state->rtCycles, state->rtMinNs, benchPercentile(state, 50), benchPercentile(state, 99),
+         benchPercentile(state, 99.9), state->rtMaxNs);
+}
+
+// Plugin mode: ecmcGrbl with the emulated ecmc of ecmcGrblBenchEcmc.cpp (ideal axes). The bench
+// thread is the ecmc rt thread and calls grblRTexecute() back to back (not paced by the sample
+// time), the writer, grbl main and status threads of the plugin run as in the IOC.
+static ecmcGrbl *benchCreatePlugin(double sampleTimeMs, bool continuous, int plannerBlocks) {
+  benchEcmcInit(sampleTimeMs);
+  std::string config = std::string(BENCH_PLUGIN_AXES) + ECMC_PLUGIN_INTERP_MODE_OPTION_CMD +
+                       (continuous ? ECMC_PLUGIN_INTERP_MODE_CONTINUOUS_STR : ECMC_PLUGIN_INTERP_MODE_STEP_STR) +
+                       ";" + ECMC_PLUGIN_PLANNER_BUFFER_SIZE_OPTION_CMD + std::to_string(plannerBlocks) + ";";
+  std::vector<char> configStr(config.begin(), config.end());
+  configStr.push_back(0);
+  char portName[] = BENCH_PLUGIN_PORT;
+  ecmcGrbl *plugin = NULL;
+  try {
+    plugin = new ecmcGrbl(configStr.data(), portName, sampleTimeMs, 0);
+    // Same machine as the corpus ($100..$102 steps/mm, $110..$112 max rate, $120..$122 acceleration)
+    for(int i = 0; i < N_AXIS; i++) {
+      plugin->addConfig("$" + std::to_string(100 + i) + "=" + std::to_string(BENCH_STEPS_PER_MM));
+      plugin->addConfig("$" + std::to_string(110 + i) + "=" + std::to_string(BENCH_MAX_RATE_MM_MIN));
+      plugin->addConfig("$" + std::to_string(120 + i) + "=" + std::to_string(BENCH_ACCELERATION_MM_S2));
+    }
+  }
+  catch(std::exception& e) {
+    printf("plugin: ERROR: %s\n", e.what());
+    return NULL;
+  }
+  benchEcmcSetIOCState(BENCH_ECMC_IOC_STATE_RUN);
+  if(plugin->enterRT()) {
+    printf("plugin: ERROR: enterRT() failed (0x%x)\n", plugin->getError());
+    return NULL;
+  }
+  plugin->setAllAxesEnable(1);
+
+  // Configs applied by the writer thread
+  double start = benchNow();
+  while(plugin->getParserBusy() || !plugin->getAllAxesEnabled()) {
+    plugin->grblRTexecute(0);
+    if(benchNow() - start > BENCH_PLUGIN_TIMEOUT_S) {
+      printf("plugin: ERROR: Timeout waiting for configuration\n");
+      return NULL;
+    }
+  }
+  return plugin;
+}
+
+static int benchPluginReadInt32(ecmcGrbl *plugin, const char *name) {
+  std::string paramName = std::string(ECMC_PLUGIN_ASYN_PREFIX) + "." + name;
+  asynUser user;
+  epicsInt32 value = 0;
+  memset(&user, 0, sizeof(user));
+  if(plugin->findParam(paramName.c_str(), &user.reason) != asynSuccess ||
+     plugin->readInt32(&user, &value) != asynSuccess) {
+    return -1;
+  }
+  return value;
+}
+
+static double benchPluginReadFloat64(ecmcGrbl *plugin, const char *name) {
+  std::string paramName = std::string(ECMC_PLUGIN_ASYN_PREFIX) + "." + name;
+  asynUser user;
+  epicsFloat64 value = 0;
+  memset(&user, 0, sizeof(user));
+  if(plugin->findParam(paramName.c_str(), &user.reason) != asynSuccess ||
+     plugin->readFloat64(&user, &value) != asynSuccess) {
+    return NAN;
+  }
+  return value;
+}
+
+// Program through the plugin: writer thread, line queue, grbl main thread, planner and
+// grblRTexecute() (readEcmcStatus(), preExeAxes(), stepper, postExeAxes(), status, stats)
+static int benchPluginProgram(ecmcGrbl *plugin, const char *fileName, size_t lines,
+                              double sampleTimeMs, bool continuous) {
+  try {
+    plugin->loadGCodeFile(fileName, 0);
+  }
+  catch(std::exception& e) {
+    printf("  ERROR: %s\n", e.what());
+    return -1;
+  }
+
+  benchState state;
+  benchInitState(&state, sampleTimeMs, continuous);
+  for(int i = 0; i < N_AXIS; i++) {
+    state.lastPosition[i] = benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(i));
+  }
+  int underruns = benchPluginReadInt32(plugin, ECMC_PLUGIN_ASYN_RT_SEG_UNDERRUNS);
+  double start = benchNow();
+  bool timeout = false;
+  plugin->setExecute(1);
+  while(plugin->getBusy() && !plugin->getError()) {
+    struct timespec rtStart, rtEnd;
+    clock_gettime(CLOCK_MONOTONIC, &rtStart);
+    plugin->grblRTexecute(0);
+    clock_gettime(CLOCK_MONOTONIC, &rtEnd);
+    benchAddRtCycle(&state, &rtStart, &rtEnd);
+
+    double position[N_AXIS];
+    for(int i = 0; i < N_AXIS; i++) {
+      position[i] = benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(i));
+    }
+    benchAddPosition(&state, position);
+    if(state.rtCycles % 1024 == 0 && benchNow() - start > BENCH_PLUGIN_TIMEOUT_S) {
+      timeout = true;
+      break;
+    }
+  }
+  double runS = benchNow() - start;
+  plugin->setExecute(0);
+  underruns = benchPluginReadInt32(plugin, ECMC_PLUGIN_ASYN_RT_SEG_UNDERRUNS) - underruns;
+
+  double simS = state.samples * sampleTimeMs / 1000.0;
+  printf("  plugin: %zu lines in %.3f s (%.0f lines/s), %.3f s simulated, %.0fx real time, %d underruns\n",
+         lines, runS, lines / runS, simS, runS > 0 ? simS / runS : 0, underruns);
+  benchPrintFeedAndRt(&state);
+  if(plugin->getError() || timeout) {
+    printf("  ERROR: Plugin stopped at code row %d (0x%x%s)\n", plugin->getCodeRowNum(),
+           plugin->getError(), timeout ? ", timeout" : "");
+    return -1;
+  }
+  return 0;
+}
+
+static void benchPrintAxesRt(const char *name, benchState *state, size_t setpointWrites,
+                             size_t apiCalls) {
+  uint64_t sumNs = 0;
+  for(uint32_t timeNs = 0; timeNs < BENCH_RT_HIST_NS; timeNs++) {
+    sumNs += (uint64_t)timeNs * state->rtHistNs[timeNs];
+  }
+  double cycles = state->rtCycles ? (double)state->rtCycles : 1;
+  printf("  %-20s %8zu cycles, mean %4.0f ns, p50 %4u ns, p99 %5u ns, %5.2f api calls, "
+         "%4.2f setpoint writes/cycle\n", name, state->rtCycles, sumNs / cycles,
+         benchPercentile(state, 50), benchPercentile(state, 99), apiCalls / cycles,
+         setpointWrites / cycles);
+}
+
+// One timed cycle of grblRTexecute() with the ecmc api calls of the cycle
+typedef struct {
+  struct timespec start;
+  struct timespec end;
+  size_t          setpointWrites;
+  size_t          apiCalls;
+} benchPluginCycle;
+
+static void benchPluginExecute(ecmcGrbl *plugin, benchPluginCycle *cycle) {
+  size_t setpointWrites = benchEcmcGetSetpointWrites();
+  size_t apiCalls       = benchEcmcGetApiCalls();
+  clock_gettime(CLOCK_MONOTONIC, &cycle->start);
+  plugin->grblRTexecute(0);
+  clock_gettime(CLOCK_MONOTONIC, &cycle->end);
+  cycle->setpointWrites = benchEcmcGetSetpointWrites() - setpointWrites;
+  cycle->apiCalls       = benchEcmcGetApiCalls() - apiCalls;
+}
+
+static void benchPluginStandstill(ecmcGrbl *plugin, const char *name, double sampleTimeMs,
+                                  size_t cycles) {
+  benchState state;
+  benchInitState(&state, sampleTimeMs, false);
+  benchPluginCycle cycle;
+  for(size_t i = 0; i < BENCH_AXES_WARMUP_CYCLES; i++) {
+    benchPluginExecute(plugin, &cycle);
+  }
+  size_t setpointWrites = 0;
+  size_t apiCalls       = 0;
+  for(size_t i = 0; i < cycles; i++) {
+    benchPluginExecute(plugin, &cycle);
+    benchAddRtCycle(&state, &cycle.start, &cycle.end);
+    setpointWrites += cycle.setpointWrites;
+    apiCalls       += cycle.apiCalls;
+  }
+  benchPrintAxesRt(name, &state, setpointWrites, apiCalls);
+}
+
+// Rt cost of grblRTexecute() per axis state (-a): disabled (position sync), enabled at standstill
+// and moving (one long G1 of X, Y and Z, acceleration and deceleration included)
+static int benchPluginAxes(ecmcGrbl *plugin, const std::string &dir, double sampleTimeMs,
+                           size_t cycles) {
+  printf("plugin rt per axis state (grblRTexecute())\n");
+  plugin->setAllAxesEnable(0);
+  benchPluginStandstill(plugin, "axes disabled", sampleTimeMs, cycles);
+  plugin->setAllAxesEnable(1);
+  benchPluginStandstill(plugin, "enabled, standstill", sampleTimeMs, cycles);
+
+  // Move long enough for cycles at BENCH_AXES_FEED_MM_MIN (relative, from any position)
+  std::string fileName = dir + "/ecmc_grbl_bench_axes.nc";
+  FILE *file = fopen(fileName.c_str(), "w");
+  if(!file) {
+    printf("  ERROR: Failed write %s (%s)\n", fileName.c_str(), strerror(errno));
+    return -1;
+  }
+  double distance = BENCH_AXES_FEED_MM_MIN / 60.0 * cycles * sampleTimeMs / 1000.0 / sqrt(3.0);
+  fprintf(file, "G21 G91\nG1 X%.3f Y%.3f Z%.3f F%.1f\nG90\n", distance, distance, distance,
+          BENCH_AXES_FEED_MM_MIN);
+  fclose(file);
+  try {
+    plugin->loadGCodeFile(fileName, 0);
+  }
+  catch(std::exception& e) {
+    printf("  ERROR: %s\n", e.what());
+    unlink(fileName.c_str());
+    return -1;
+  }
+  unlink(fileName.c_str());
+
+  // The rt runs faster than real time so the segment buffer underruns and the axes stand still
+  // until the main thread catches up: Run until the end position is reached and only count the
+  // cycles where the axes moved.
+  benchState state;
+  benchInitState(&state, sampleTimeMs, false);
+  benchPluginCycle cycle;
+  size_t setpointWrites = 0;
+  size_t apiCalls       = 0;
+  double position = benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(X_AXIS));
+  double target   = position + distance;
+  double start    = benchNow();
+  plugin->setExecute(1);
+  while((plugin->getBusy() || position < target - 0.001) && !plugin->getError() &&
+        benchNow() - start < BENCH_PLUGIN_TIMEOUT_S) {
+    benchPluginExecute(plugin, &cycle);
+    double lastPosition = position;
+    position = benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(X_AXIS));
+    if(position != lastPosition) {
+      benchAddRtCycle(&state, &cycle.start, &cycle.end);
+      setpointWrites += cycle.setpointWrites;
+      apiCalls       += cycle.apiCalls;
+    }
+  }
+  plugin->setExecute(0);
+  benchPrintAxesRt("moving", &state, setpointWrites, apiCalls);
+  if(plugin->getError() || plugin->getBusy()) {
+    printf("  ERROR: Move stopped at %.3f mm (0x%x)\n",
+           benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(X_AXIS)), plugin->getError());
+    return -1;
+  }
+  return 0;
+}
+
+// Write text to dir/ecmc_grbl_bench_<name>.nc and load it into the plugin. Returns false on error.
+static bool benchPluginLoad(ecmcGrbl *plugin, const std::string &dir, const char *name,
+                            const char *text) {
+  std::string fileName = dir + "/ecmc_grbl_bench_" + name + ".nc";
+  FILE *file = fopen(fileName.c_str(), "w");
+  if(!file) {
+    printf("  ERROR: Failed write %s (%s)\n", fileName.c_str(), strerror(errno));
+    return false;
+  }
+  bool ok = fputs(text, file) >= 0;
+  ok = fclose(file) == 0 && ok;
+  try {
+    if(ok) {
+      plugin->loadGCodeFile(fileName, 0);
+    }
+  }
+  catch(std::exception& e) {
+    printf("  ERROR: %s\n", e.what());
+    ok = false;
+  }
+  unlink(fileName.c_str());
+  return ok;
+}
+
+// Execute the loaded program until done, error or BENCH_CHECK_TIMEOUT_S. Returns false on timeout.
+// The rt runs faster than real time and segment buffer underruns make the plugin not busy for a
+// moment, so done is not busy for BENCH_CHECK_IDLE_S. While not busy the rt sleeps one sample
+// (other threads get the cpu also on a single core).
+static bool benchPluginExecute(ecmcGrbl *plugin) {
+  double start = benchNow();
+  double idleStart = 0;
+  plugin->setExecute(1);
+  while(!plugin->getError()) {
+    plugin->grblRTexecute(0);
+    double now = benchNow();
+    if(plugin->getBusy()) {
+      idleStart = 0;
+    } else if(idleStart == 0) {
+      idleStart = now;
+    } else if(now - idleStart > BENCH_CHECK_IDLE_S) {
+      break;
+    }
+    if(idleStart) {
+      usleep(BENCH_CHECK_IDLE_SLEEP_US);
+    }
+    if(now - start > BENCH_CHECK_TIMEOUT_S) {
+      plugin->setExecute(0);
+      return false;
+    }
+  }
+  plugin->setExecute(0);
+  return true;
+}
+
+static bool benchCheckPosition(double x, double y) {
+  return fabs(benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(X_AXIS)) - x) < BENCH_CHECK_POSITION_TOL_MM &&
+         fabs(benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(Y_AXIS)) - y) < BENCH_CHECK_POSITION_TOL_MM;
+}
+
+static bool benchCheckResult(const char *name, bool ok, ecmcGrbl *plugin) {
+  printf("  %-28s %s (code row %d, error 0x%x, X %.3f, Y %.3f)\n", name, ok ? "OK" : "FAILED",
+         plugin->getCodeRowNum(), plugin->getError(), benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(X_AXIS)),
+         benchEcmcGetActPos(BENCH_PLUGIN_AXIS_ID(Y_AXIS)));
+  return ok;
+}
+
+// Peak axis acceleration on small radius arcs (grbl only, simulated time). The centripetal and
+// the tangential acceleration share the axis acceleration limit. Continuous execution, the step
+// events of the step mode add velocity steps within a window.
+static bool benchCheckArcAcceleration(const std::string &dir, double sampleTimeMs) {
+  std::string fileName = dir + "/ecmc_grbl_bench_arc_acceleration.nc";
+  FILE *file = fopen(fileName.c_str(), "w");
+  if(!file) {
+    printf("  ERROR: Failed write %s (%s)\n", fileName.c_str(), strerror(errno));
+    return false;
+  }
+  // Full circles, each from and to standstill (reversed tangent at the junctions). No corners,
+  // the junction deviation allows a velocity step at corners.
+  fprintf(file, "G21 G90 G17\nG0 X0 Y0\nG2 X0 Y0 I1 J0 F6000\nG3 X0 Y0 I5 J0\nG2 X0 Y0 I10 J0\n");
+  fclose(file);
+
+  ecmcGrblProgram program;
+  int error = program.loadFile(fileName.c_str());
+  unlink(fileName.c_str());
+  if(error) {
+    printf("  ERROR: Failed load file (%s)\n", strerror(error));
+    return false;
+  }
+  benchState state;
+  benchInitState(&state, sampleTimeMs, true);
+  state.execute = true;
+  double runS = 0;
+  long errorRow = benchExecute(&program, &state, &error, &runS);
+  double peak = std::max(state.maxAcceleration[X_AXIS], state.maxAcceleration[Y_AXIS]);
+  bool ok = errorRow < 0 && peak <= BENCH_ACCELERATION_MM_S2 * (1 + BENCH_CHECK_ACCELERATION_TOL);
+  printf("  %-28s %s (peak X %.1f, Y %.1f mm/s^2, limit %.1f mm/s^2)\n", "arc acceleration",
+         ok ? "OK" : "FAILED", state.maxAcceleration[X_AXIS], state.maxAcceleration[Y_AXIS],
+         BENCH_ACCELERATION_MM_S2);
+  return ok;
+}
+
+// Checks (-t): Arc acceleration and small programs streamed through the plugin (writer thread,
+// line queue, grbl main thread), verified by the end state. Returns the number of failed checks.
+static int benchChecks(ecmcGrbl *plugin, const std::string &dir, double sampleTimeMs) {
+  printf("checks\n");
+  int failed = !benchCheckArcAcceleration(dir, sampleTimeMs);
+
+  // Every line is replied exactly once, also single character lines that grbl does not execute.
+  // A missing reply hangs the writer at program end.
+  const char *singleChar = "%\nG21 G90 G1 X0 Y0 F3000\nM\nG1 X10 Y5\n%\nG1 X20\n%\n";
+  bool ok = benchPluginLoad(plugin, dir, "single_char", singleChar) && benchPluginExecute(plugin);
+  ok = ok && !plugin->getError() && !plugin->getBusy() && plugin->getCodeRowNum() == 7 &&
+       benchCheckPosition(20, 5);
+  failed += !benchCheckResult("single character lines", ok, plugin);
+
+  // The validator (check mode) does not wait for the planner at program flow and work coordinate
+  // system changes. A 10ms wait per line would take BENCH_CHECK_VALIDATE_LINES / 100 s.
+  std::string wcs;
+  for(int i = 0; i < BENCH_CHECK_VALIDATE_LINES / 5; i++) {
+    wcs += "G10 L20 P1 X0\nG55\nG54\nG92 X0\nG92.1\n";
+  }
+  wcs += "M2\n";
+  ok = benchPluginLoad(plugin, dir, "validate_wcs", wcs.c_str());
+  double start = benchNow();
+  try {
+    ok = ok && plugin->validateGCode(true) == 0;
+  }
+  catch(std::exception& e) {
+    printf("  ERROR: %s\n", e.what());
+    ok = false;
+  }
+  double validateS = benchNow() - start;
+  printf("  validated %d lines in %.3f s\n", BENCH_CHECK_VALIDATE_LINES + 1, validateS);
+  failed += !benchCheckResult("validator without waits", ok && validateS < BENCH_CHECK_VALIDATE_S, plugin);
+
+  // Work position of the status from the work coordinate offset published by the grbl main thread
+  // (G92 and tool length offset, cleared by the reset of the error row check below)
+  const char *workOffset = "G21 G90 G1 X10 Y5 Z1 F3000\nG92 X0 Y0\nG43.1 Z2\n";
+  ok = benchPluginLoad(plugin, dir, "work_offset", workOffset) && benchPluginExecute(plugin);
+  ok = ok && !plugin->getError() &&
+       fabs(benchPluginReadFloat64(plugin, ECMC_PLUGIN_ASYN_STATUS_WPOS ".x")) < BENCH_CHECK_POSITION_TOL_MM &&
+       fabs(benchPluginReadFloat64(plugin, ECMC_PLUGIN_ASYN_STATUS_WPOS ".y")) < BENCH_CHECK_POSITION_TOL_MM &&
+       fabs(benchPluginReadFloat64(plugin, ECMC_PLUGIN_ASYN_STATUS_WPOS ".z") + 1) < BENCH_CHECK_POSITION_TOL_MM;
+  failed += !benchCheckResult("work position", ok, plugin);
+
+  // Error is reported for the failing row, not shifted by single character lines before it
+  // (last check, the plugin is reset by the error)
+  const char *errorRow = "%\nG1 X10 Y0\nM\n%\nG1 X20 Q1\nG1 X30\n";
+  ok = benchPluginLoad(plugin, dir, "error_row", errorRow) && benchPluginExecute(plugin);
+  ok = ok && plugin->getError() && plugin->getCodeRowNum() == 4;
+  failed += !benchCheckResult("error row", ok, plugin);
+  return failed;
+}
+
+static int benchProgram(const char *name, const char *fileName, double sampleTimeMs, bool continuous,
+                        int plannerBlocks, ecmcGrbl *plugin) {
+  printf("%s (%s)\n", name, fileName);
+
+  // load
+  ecmcGrblProgram program;
+  double start = benchNow();
+  int error = program.loadFile(fileName);
+  double loadS = benchNow() - start;
+  if(error) {
+    printf("  ERROR: Failed load file (%s)\n", strerror(error));
+    return error;
+  }
+  printf("  load:   %zu lines, %.1f ms\n", program.size(), loadS * 1000);
+
+  // parse
+  char filtered[LINE_BUFFER_SIZE];
+  gc_parsed_line_t parsed;
+  size_t parseErrors = 0;
+  start = benchNow();
+  for(size_t i = 0; i < program.size(); i++) {
+    std::string_view line = program.getLine(i);
+    if(ecmc_filter_line(filtered, line.data(), line.length()) ||
+       (filtered[0] != '$' && filtered[0] != 0 && gc_parse_line(filtered, &parsed) != STATUS_OK)) {
+      parseErrors++;
+    }
+  }
+  double parseS = benchNow() - start;
+  printf("  parse:  %.0f lines/s (%.0f ns/line, %zu errors)\n",
+         program.size() / parseS, parseS / program.size() * 1E9, parseErrors);
+
+  // plan
+  benchState state;
+  benchInitState(&state, sampleTimeMs, continuous);
+  state.plannerBlocks = plannerBlocks;
+  double planS = 0;
+  long errorRow = benchExecute(&program, &state, &error, &planS);
+  if(errorRow >= 0) {
+    printf("  ERROR: Plan stopped at code row %ld (%d)\n", errorRow, error);
+  }
+  printf("  plan:   %zu blocks, %.0f blocks/s (%.0f ns/block)\n",
+         state.blocks, state.blocks / planS, state.blocks ? planS / state.blocks * 1E9 : 0);
+
+  // run
+  state.execute = true;
+  double runS = 0;
+  errorRow = benchExecute(&program, &state, &error, &runS);
+  if(errorRow >= 0) {
+    printf("  ERROR: Run stopped at code row %ld (%d)\n", errorRow, error);
+  }
+  double simS    = state.samples * sampleTimeMs / 1000.0;
+  double motionS = state.motionSamples * sampleTimeMs / 1000.0;
+  printf("  run:    %.3f s simulated (%.3f s motion) in %.3f s, %.0fx real time\n",
+         simS, motionS, runS, runS > 0 ? simS / runS : 0);
+  benchPrintFeedAndRt(&state);
+  if(errorRow >= 0) {
+    return -1;
+  }
+  return plugin ? benchPluginProgram(plugin, fileName, program.size(), sampleTimeMs, continuous) : 0;
+}
+
+static void benchPrintHelp() {
+  printf("Use ecmcGrblBench [-s <sample time ms>] [-c] [-p <blocks>] [-e] [-a] [-t] [-n <scale>] [-d <dir>] [<file.nc>|<corpus program> ...]\n");
+  printf("  -s  ecmc sample time [ms] (default 1)\n");
+  printf("  -c  continuous interpolation (INTERP_MODE=CONTINUOUS), default step\n");
+  printf("  -p  planner buffer size [blocks] (PLANNER_BUFFER_SIZE, default %d)\n", BLOCK_BUFFER_SIZE);
+  printf("  -e  also run the programs through the plugin (ecmcGrbl) with emulated ecmc axes\n");
+  printf("  -a  only time the plugin rt execute per axis state (disabled, standstill, moving)\n");
+  printf("  -t  only run the checks (exit code is the number of failed checks)\n");
+  printf("  -n  corpus size scale (default 1)\n");
+  printf("  -d  directory for the generated corpus (default " BENCH_CORPUS_DIR ")\n");
+  printf("  Benchmarks the given files or corpus programs (by name) instead of the whole corpus if any.\n");
+}
+
+int main(int argc, char **argv) {
+  double sampleTimeMs = 1.0;
+  bool continuous = false;
+  int plannerBlocks = BLOCK_BUFFER_SIZE;
+  double scale = 1.0;
+  std::string dir = BENCH_CORPUS_DIR;
+  int option;
+  bool pluginMode = false;
+  bool axesMode = false;
+  bool checkMode = false;
+  while((option = getopt(argc, argv, "s:cp:eatn:d:h")) != -1) {
+    switch(option) {
+      case 's': sampleTimeMs = atof(optarg); break;
+      case 'c': continuous = true; break;
+      case 'p': plannerBlocks = atoi(optarg); break;
+      case 'e': pluginMode = true; break;
+      case 'a': pluginMode = true; axesMode = true; break;
+      case 't': pluginMode = true; checkMode = true; break;
+      case 'n': scale = atof(optarg); break;
+      case 'd': dir = optarg; break;
+      default:
+        benchPrintHelp();
+        return option == 'h' ? 0 : 1;
+    }
+  }
+  if(sampleTimeMs <= 0 || scale <= 0 || plannerBlocks < BLOCK_BUFFER_SIZE_MIN ||
+     plannerBlocks > BLOCK_BUFFER_SIZE_MAX) {
+    benchPrintHelp();
+    return 1;
+  }
+
+  printf("grbl bench: sample time %.3f ms, %s interpolation, planner %d blocks, %s precision\n",
+         sampleTimeMs, continuous ? "continuous" : "step", plannerBlocks,
+         sizeof(real_t) == sizeof(double) ? "double" : "float");
+
+  ecmcGrbl *plugin = NULL;
+  if(pluginMode && !(plugin = benchCreatePlugin(sampleTimeMs, continuous, plannerBlocks))) {
+    return 1;
+  }
+  if(axesMode) {
+    return benchPluginAxes(plugin, dir, sampleTimeMs, BENCH_AXES_CYCLES) != 0;
+  }
+  if(checkMode) {
+    return benchChecks(plugin, dir, sampleTimeMs);
+  }
+
+  // Files or names of corpus programs, else the whole corpus
+  int failed = 0;
+  for(const benchCorpusProgram &corpus : benchCorpus) {
+    bool selected = optind == argc;
+    for(int i = optind; i < argc; i++) {
+      selected |= !strcmp(argv[i], corpus.name);
+    }
+    if(!selected) {
+      continue;
+    }
+    std::string fileName = dir + "/ecmc_grbl_bench_" + corpus.name + ".nc";
+    int error = benchWriteProgram(corpus.name, (size_t)(corpus.lines * scale), fileName.c_str());
+    if(error) {
+      printf("%s: ERROR: Failed write %s (%s)\n", corpus.name, fileName.c_str(), strerror(error));
+      failed = 1;
+      continue;
+    }
+    failed |= benchProgram(corpus.name, fileName.c_str(), sampleTimeMs, continuous, plannerBlocks, plugin) != 0;
+    unlink(fileName.c_str());
+  }
+  for(int i = optind; i < argc; i++) {
+    bool corpusName = false;
+    for(const benchCorpusProgram &corpus : benchCorpus) {
+      corpusName |= !strcmp(argv[i], corpus.name);
+    }
+    if(!corpusName) {
+      failed |= benchProgram(argv[i], argv[i], sampleTimeMs, continuous, plannerBlocks, plugin) != 0;
+    }
+  }
+  return failed;
+}
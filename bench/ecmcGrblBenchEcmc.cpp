@@ -0,0 +1,269 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblBenchEcmc.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include "ecmcGrblBenchEcmc.h"
+#include "ecmcMotion.h"
+#include "ecmcPluginClient.h"
+#include "asynPortDriver.h"
+#include <string>
+#include <vector>
+#include <string.h>
+
+#define BENCH_ECMC_ERROR_AXIS 0x114   // Invalid axis index
+
+typedef struct {
+  int    enabled;
+  int    trajSource;
+  double actPos;
+  double velocity;   // spindle [rpm]
+} benchEcmcAxis;
+
+static benchEcmcAxis benchAxes[BENCH_ECMC_AXES + 1];  // ecmc axis index starts at 1
+static int           benchIOCState     = 0;
+static double        benchSampleTimeMs = 1.0;
+static size_t        benchSetpointWrites = 0;
+static size_t        benchApiCalls       = 0;
+
+static benchEcmcAxis *benchGetAxis(int axisIndex) {
+  if(axisIndex < 1 || axisIndex > BENCH_ECMC_AXES) {
+    return NULL;
+  }
+  return &benchAxes[axisIndex];
+}
+
+void benchEcmcInit(double sampleTimeMs) {
+  memset(benchAxes, 0, sizeof(benchAxes));
+  for(int i = 0; i <= BENCH_ECMC_AXES; i++) {
+    benchAxes[i].trajSource = ECMC_DATA_SOURCE_EXTERNAL;
+  }
+  benchIOCState       = 0;
+  benchSampleTimeMs   = sampleTimeMs;
+  benchSetpointWrites = 0;
+  benchApiCalls       = 0;
+}
+
+void benchEcmcSetIOCState(int state) {
+  benchIOCState = state;
+}
+
+double benchEcmcGetActPos(int axisIndex) {
+  benchEcmcAxis *axis = benchGetAxis(axisIndex);
+  return axis ? axis->actPos : 0;
+}
+
+size_t benchEcmcGetSetpointWrites() {
+  return benchSetpointWrites;
+}
+
+size_t benchEcmcGetApiCalls() {
+  return benchApiCalls;
+}
+
+// ecmc plugin client api
+
+int getEcmcEpicsIOCState() {
+  return benchIOCState;
+}
+
+double getEcmcSampleTimeMS() {
+  return benchSampleTimeMs;
+}
+
+// ecmc motion api
+
+#define BENCH_GET_AXIS(axisIndex)                       \
+  benchApiCalls++;                                      \
+  benchEcmcAxis *axis = benchGetAxis(axisIndex);        \
+  if(!axis) {                                           \
+    return BENCH_ECMC_ERROR_AXIS;                       \
+  }
+
+int getAxisEnabled(int axisIndex, int *value) {
+  BENCH_GET_AXIS(axisIndex)
+  *value = axis->enabled;
+  return 0;
+}
+
+int setAxisEnable(int axisIndex, int value) {
+  BENCH_GET_AXIS(axisIndex)
+  axis->enabled = value;
+  return 0;
+}
+
+int getAxisTrajSource(int axisIndex, int *value) {
+  BENCH_GET_AXIS(axisIndex)
+  *value = axis->trajSource;
+  return 0;
+}
+
+int setAxisTrajSource(int axisIndex, int value) {
+  BENCH_GET_AXIS(axisIndex)
+  axis->trajSource = value;
+  return 0;
+}
+
+int getAxisLimitSwitchBwd(int axisIndex, int *value) {
+  BENCH_GET_AXIS(axisIndex)
+  *value = 1;
+  return 0;
+}
+
+int getAxisLimitSwitchFwd(int axisIndex, int *value) {
+  BENCH_GET_AXIS(axisIndex)
+  *value = 1;
+  return 0;
+}
+
+int getAxisEncPosAct(int axisIndex, double *value) {
+  BENCH_GET_AXIS(axisIndex)
+  *value = axis->actPos;
+  return 0;
+}
+
+int getAxisAcceleration(int axisIndex, double *value) {
+  BENCH_GET_AXIS(axisIndex)
+  *value = BENCH_ECMC_SPINDLE_ACCELERATION;
+  return 0;
+}
+
+int setAxisExtSetPos(int axisIndex, double value) {
+  BENCH_GET_AXIS(axisIndex)
+  if(axis->enabled && axis->trajSource == ECMC_DATA_SOURCE_EXTERNAL) {
+    axis->actPos = value;
+  }
+  benchSetpointWrites++;
+  return 0;
+}
+
+int setAxisTargetVel(int axisIndex, double value) {
+  BENCH_GET_AXIS(axisIndex)
+  return 0;
+}
+
+int moveVelocity(int axisIndex, double velocitySet, double accelerationSet, double decelerationSet) {
+  BENCH_GET_AXIS(axisIndex)
+  axis->velocity = velocitySet;
+  return 0;
+}
+
+int stopMotion(int axisIndex, int killAmplifier) {
+  BENCH_GET_AXIS(axisIndex)
+  axis->velocity = 0;
+  return 0;
+}
+
+// asyn port driver (parameter table only, no records or callbacks)
+
+typedef struct {
+  std::string   name;
+  asynParamType type;
+  int           intValue;
+  double        doubleValue;
+} benchAsynParam;
+
+static std::vector<benchAsynParam> benchParams;
+
+asynPortDriver::asynPortDriver(const char *portName, int maxAddr, int interfaceMask,
+                               int interruptMask, int asynFlags, int autoConnect,
+                               int priority, int stackSize) {}
+
+asynPortDriver::~asynPortDriver() {}
+
+asynStatus asynPortDriver::lock() {
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::unlock() {
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::createParam(const char *name, asynParamType type, int *index) {
+  benchAsynParam param;
+  param.name        = name;
+  param.type        = type;
+  param.intValue    = 0;
+  param.doubleValue = 0;
+  *index = (int)benchParams.size();
+  benchParams.push_back(param);
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::findParam(const char *name, int *index) {
+  for(size_t i = 0; i < benchParams.size(); i++) {
+    if(benchParams[i].name == name) {
+      *index = (int)i;
+      return asynSuccess;
+    }
+  }
+  return asynError;
+}
+
+asynStatus asynPortDriver::setIntegerParam(int index, int value) {
+  if(index < 0 || index >= (int)benchParams.size()) {
+    return asynError;
+  }
+  benchParams[index].intValue = value;
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::setDoubleParam(int index, double value) {
+  if(index < 0 || index >= (int)benchParams.size()) {
+    return asynError;
+  }
+  benchParams[index].doubleValue = value;
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::setStringParam(int index, const char *value) {
+  return index < 0 || index >= (int)benchParams.size() ? asynError : asynSuccess;
+}
+
+asynStatus asynPortDriver::callParamCallbacks() {
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::doCallbacksFloat64Array(epicsFloat64 *value, size_t nElements,
+                                                   int reason, int addr) {
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::readInt32(asynUser *pasynUser, epicsInt32 *value) {
+  if(pasynUser->reason < 0 || pasynUser->reason >= (int)benchParams.size()) {
+    return asynError;
+  }
+  *value = benchParams[pasynUser->reason].intValue;
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::readFloat64(asynUser *pasynUser, epicsFloat64 *value) {
+  if(pasynUser->reason < 0 || pasynUser->reason >= (int)benchParams.size()) {
+    return asynError;
+  }
+  *value = benchParams[pasynUser->reason].doubleValue;
+  return asynSuccess;
+}
+
+asynStatus asynPortDriver::readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                          size_t nElements, size_t *nIn) {
+  *nIn = 0;
+  return asynError;
+}
+
+asynStatus asynPortDriver::readFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
+                                            size_t nElements, size_t *nIn) {
+  *nIn = 0;
+  return asynError;
+}
+
+asynStatus asynPortDriver::writeInt32(asynUser *pasynUser, epicsInt32 value) {
+  return setIntegerParam(pasynUser->reason, value);
+}
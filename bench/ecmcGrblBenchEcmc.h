@@ -0,0 +1,32 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblBenchEcmc.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_BENCH_ECMC_H_
+#define ECMC_GRBL_BENCH_ECMC_H_
+
+// Emulated ecmc for the plugin mode of the bench (implements the stubs in bench/stubs).
+// Axes 1..BENCH_ECMC_AXES: The actual position follows the external setpoint written by the
+// plugin while the axis is enabled with external trajectory source (ideal drive, no lag).
+// All axes use external trajectory source unless the plugin sets another source.
+
+#include <stddef.h>
+
+#define BENCH_ECMC_AXES 4
+#define BENCH_ECMC_IOC_STATE_RUN 16
+#define BENCH_ECMC_SPINDLE_ACCELERATION 1000.0  // [rpm/s]
+
+void   benchEcmcInit(double sampleTimeMs);
+void   benchEcmcSetIOCState(int state);
+double benchEcmcGetActPos(int axisIndex);
+size_t benchEcmcGetSetpointWrites();     // setAxisExtSetPos() calls since init
+size_t benchEcmcGetApiCalls();           // ecmc motion api calls since init
+
+#endif  /* ECMC_GRBL_BENCH_ECMC_H_ */
@@ -0,0 +1,78 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  asynPortDriver.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef BENCH_ASYN_PORT_DRIVER_H_
+#define BENCH_ASYN_PORT_DRIVER_H_
+
+// Bench stub of the asyn port driver (only the interface used by the plugin and the bench), see
+// ecmcGrblBenchEcmc.cpp. Parameters are kept in a table, no records, callbacks or locking.
+
+#include <stddef.h>
+#include "epicsTypes.h"
+
+typedef enum {
+  asynSuccess, asynTimeout, asynOverflow, asynError, asynDisconnected, asynDisabled
+} asynStatus;
+
+typedef enum {
+  asynParamNotDefined, asynParamInt32, asynParamUInt32Digital, asynParamFloat64, asynParamOctet,
+  asynParamInt8Array, asynParamInt16Array, asynParamInt32Array, asynParamFloat32Array,
+  asynParamFloat64Array, asynParamGenericPointer
+} asynParamType;
+
+typedef struct asynUser {
+  int   reason;
+  void *userPvt;
+} asynUser;
+
+#define asynCommonMask          0x00000001
+#define asynDrvUserMask         0x00000002
+#define asynOptionMask          0x00000004
+#define asynInt32Mask           0x00000008
+#define asynUInt32DigitalMask   0x00000010
+#define asynFloat64Mask         0x00000020
+#define asynOctetMask           0x00000040
+#define asynInt8ArrayMask       0x00000080
+#define asynInt16ArrayMask      0x00000100
+#define asynInt32ArrayMask      0x00000200
+#define asynFloat32ArrayMask    0x00000400
+#define asynFloat64ArrayMask    0x00000800
+#define asynGenericPointerMask  0x00001000
+#define asynEnumMask            0x00002000
+
+#define ASYN_CANBLOCK           0x0002
+
+class asynPortDriver {
+ public:
+  asynPortDriver(const char *portName, int maxAddr, int interfaceMask, int interruptMask,
+                 int asynFlags, int autoConnect, int priority, int stackSize);
+  virtual ~asynPortDriver();
+
+  virtual asynStatus lock();
+  virtual asynStatus unlock();
+  virtual asynStatus createParam(const char *name, asynParamType type, int *index);
+  virtual asynStatus findParam(const char *name, int *index);
+  virtual asynStatus setIntegerParam(int index, int value);
+  virtual asynStatus setDoubleParam(int index, double value);
+  virtual asynStatus setStringParam(int index, const char *value);
+  virtual asynStatus callParamCallbacks();
+  virtual asynStatus doCallbacksFloat64Array(epicsFloat64 *value, size_t nElements, int reason, int addr);
+
+  virtual asynStatus readInt32(asynUser *pasynUser, epicsInt32 *value);
+  virtual asynStatus readFloat64(asynUser *pasynUser, epicsFloat64 *value);
+  virtual asynStatus readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                    size_t nElements, size_t *nIn);
+  virtual asynStatus readFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
+                                      size_t nElements, size_t *nIn);
+  virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+};
+
+#endif  /* BENCH_ASYN_PORT_DRIVER_H_ */
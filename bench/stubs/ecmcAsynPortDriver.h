@@ -0,0 +1,18 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcAsynPortDriver.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef BENCH_ECMC_ASYN_PORT_DRIVER_H_
+#define BENCH_ECMC_ASYN_PORT_DRIVER_H_
+
+// Bench stub, the plugin does not use the ecmc asyn port directly.
+#include "asynPortDriver.h"
+
+#endif  /* BENCH_ECMC_ASYN_PORT_DRIVER_H_ */
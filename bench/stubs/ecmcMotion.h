@@ -0,0 +1,34 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcMotion.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef BENCH_ECMC_MOTION_H_
+#define BENCH_ECMC_MOTION_H_
+
+// Bench stub of the ecmc motion api (only the functions used by the plugin), implemented by the
+// emulated axes in ecmcGrblBenchEcmc.cpp. Returns 0 or an error code (invalid axis).
+
+#define ECMC_DATA_SOURCE_INTERNAL 0
+#define ECMC_DATA_SOURCE_EXTERNAL 1
+
+int getAxisEnabled(int axisIndex, int *value);
+int setAxisEnable(int axisIndex, int value);
+int getAxisTrajSource(int axisIndex, int *value);
+int setAxisTrajSource(int axisIndex, int value);
+int getAxisLimitSwitchBwd(int axisIndex, int *value);
+int getAxisLimitSwitchFwd(int axisIndex, int *value);
+int getAxisEncPosAct(int axisIndex, double *value);
+int getAxisAcceleration(int axisIndex, double *value);
+int setAxisExtSetPos(int axisIndex, double value);
+int setAxisTargetVel(int axisIndex, double value);
+int moveVelocity(int axisIndex, double velocitySet, double accelerationSet, double decelerationSet);
+int stopMotion(int axisIndex, int killAmplifier);
+
+#endif  /* BENCH_ECMC_MOTION_H_ */
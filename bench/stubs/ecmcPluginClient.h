@@ -0,0 +1,20 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcPluginClient.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef BENCH_ECMC_PLUGIN_CLIENT_H_
+#define BENCH_ECMC_PLUGIN_CLIENT_H_
+
+// Bench stub of the ecmc plugin client api (see ecmcGrblBenchEcmc.cpp)
+
+int    getEcmcEpicsIOCState();   // 16 when the IOC is running
+double getEcmcSampleTimeMS();
+
+#endif  /* BENCH_ECMC_PLUGIN_CLIENT_H_ */
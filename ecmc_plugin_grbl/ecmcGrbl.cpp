@@ -16,6 +16,7 @@
 
 #include <sstream>
 #include "ecmcGrbl.h"
+#include "ecmcGrblProgram.h"
 #include "ecmcPluginClient.h"
 #include "ecmcAsynPortDriver.h"
 #include "ecmcAsynPortDriverUtils.h"
@@ -23,27 +24,19 @@
 #include "ecmcMotion.h"
 #include <iostream>
 #include <fstream>
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
 
 extern "C" {
 #include "grbl.h"
 }
-
-// Global grbl vars
-int enableDebugPrintouts = 0;
-int stepperInterruptEnable = 0;
-
-system_t sys;
-int32_t sys_position[N_AXIS];         // Real-time machine (aka home) position vector in steps.
-int32_t sys_probe_position[N_AXIS];   // Last probe position in machine coordinates and steps.
-volatile uint8_t sys_probe_state;     // Probing state value.  Used to coordinate the probing cycle with stepper ISR.
-volatile uint8_t sys_rt_exec_state;   // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
-volatile uint8_t sys_rt_exec_alarm;   // Global realtime executor bitflag variable for setting various alarms.
-volatile uint8_t sys_rt_exec_motion_override; // Global realtime executor bitflag variable for motion-based overrides.
-volatile uint8_t sys_rt_exec_accessory_override; // Global realtime executor bitflag variable for spindle/coolant overrides.
-
-#ifdef DEBUG
-  volatile uint8_t sys_rt_exec_debug;
-#endif
+#include "ecmcGrblBlockCache.h"
+#include "ecmcGrblValidator.h"
+#include "ecmcGrblSimulator.h"
+#include "ecmcGrblPreview.h"
+#include "ecmcGrblTrace.h"
 
 // Thread that writes commands to grbl
 void f_worker_write(void *obj) {
@@ -67,12 +60,32 @@ void f_worker_main(void *obj) {
   grblObj->doMainWorker();
 }
 
+// Thread that publishes the realtime status
+void f_worker_status(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: GRBL: ERROR: Worker status thread ecmcGrbl object NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+  ecmcGrbl * grblObj = (ecmcGrbl*)obj;
+  grblObj->doStatusWorker();
+}
+
+// Axis slots X, Y and Z are indexed with the grbl axis index
+static_assert(X_AXIS == 0 && Y_AXIS == 1 && Z_AXIS == 2 && ECMC_PLUGIN_AXIS_SLOT_SPINDLE == N_AXIS,
+              "Axis slots must match grbl axis index");
+
+// Names of ECMC_PLUGIN_GRBL_STATE_* (same as in '?' report)
+static const char *grblStateNames[] = {"Idle", "Run", "Hold", "Jog", "Home",
+                                       "Alarm", "Check", "Door", "Sleep"};
+
 /** ecmc ecmcGrbl class
  * This object can throw: 
 */
 ecmcGrbl::ecmcGrbl(char* configStr,
                    char* portName,
-                   double exeSampleTimeMs)
+                   double exeSampleTimeMs,
+                   int index)
          : asynPortDriver(portName,
                    1, /* maxAddr */
                    asynInt32Mask | asynFloat64Mask | asynFloat32ArrayMask |
@@ -91,8 +104,17 @@ ecmcGrbl::ecmcGrbl(char* configStr,
                    {
 
   // Init  
+  index_                = index;
   cfgDbgMode_           = 0;
   cfgAutoStart_         = 0;
+  cfgInterpMode_        = ECMC_GRBL_INTERP_STEP;
+  cfgPlannerBufferSize_ = BLOCK_BUFFER_SIZE;
+  cfgStatusDecimation_  = ECMC_PLUGIN_STATUS_DECIMATION_DEFAULT;
+  cfgPreviewPoints_     = ECMC_PLUGIN_PREVIEW_POINTS_DEFAULT;
+  grblPreview_          = NULL;
+  cfgTracePre_          = ECMC_PLUGIN_TRACE_PRE_DEFAULT;
+  cfgTracePost_         = ECMC_PLUGIN_TRACE_POST_DEFAULT;
+  grblTrace_            = NULL;
   destructs_            = 0;
   executeCmd_           = 0;
   resetCmd_             = 0;
@@ -114,26 +136,72 @@ ecmcGrbl::ecmcGrbl(char* configStr,
   unrecoverableError_   = 0;
   cfgAutoEnableTimeOutSecs_ = ECMC_PLUGIN_AUTO_ENABLE_TIME_OUT_SEC;
   grblCommandBufferIndex_ = 0;
-  grblCommandBuffer_.clear();
+  grblCodeRowNum_         = 0;
+  grblReplyDataPos_       = 0;
+  grblReplyDataLen_       = 0;
+  grblReplyLineLen_       = 0;
   grblConfigBuffer_.clear();
   memset(&ecmcData_,0,sizeof(ecmcStatusData));
+  rtAxesCount_          = 0;
+  rtStatsResetCmd_      = 0;
+  statusCycles_         = 0;
+  statusSeq_            = 0;
+  memset(&status_,0,sizeof(ecmcGrblStatus));
+  traceCycles_          = 0;
+  traceErrorOld_        = false;
+  traceTriggerCmd_      = 0;
+
+  // All grbl state of this object (bound to each thread calling grbl)
+  if(!(grblCtx_ = grbl_context_create())) {
+    throw std::runtime_error("GRBL: ERROR: Failed allocate grbl context.");
+  }
+  grbl_context_bind(grblCtx_);
+  resetRTStats();
   
   if(!(grblConfigBufferMutex_ = epicsMutexCreate())) {
     throw std::runtime_error("GRBL: ERROR: Failed create mutex config buffer.");
   }
-  
-  if(!(grblCommandBufferMutex_ = epicsMutexCreate())) {
-    throw std::runtime_error("GRBL: ERROR: Failed create mutex for command buffer.");
+
+  if(!(statusEvent_ = epicsEventCreate(epicsEventEmpty))) {
+    throw std::runtime_error("GRBL: ERROR: Failed create event for status.");
   }
   
+  grblProgram_ = new ecmcGrblProgram();
+  grblBlockCache_ = new ecmcGrblBlockCache();
+  grblValidator_ = new ecmcGrblValidator(grblCtx_, index_ > 0 ? std::to_string(index_) : "");
+
   parseConfigStr(configStr); // Assigns all configs
+  initAsyn();
+
+  // Allocate grbl planner buffer (look-ahead)
+  if(cfgPlannerBufferSize_ < BLOCK_BUFFER_SIZE_MIN || cfgPlannerBufferSize_ > BLOCK_BUFFER_SIZE_MAX ||
+     !plan_init_buffer(cfgPlannerBufferSize_)) {
+    throw std::out_of_range("GRBL: ERROR: Failed allocate planner buffer (valid size " +
+                            std::to_string(BLOCK_BUFFER_SIZE_MIN) + ".." +
+                            std::to_string(BLOCK_BUFFER_SIZE_MAX) + ").");
+  }
+  grblSimulator_ = new ecmcGrblSimulator(grblCtx_, index_ > 0 ? std::to_string(index_) : "",
+                                         cfgPlannerBufferSize_,
+                                         cfgInterpMode_ == ECMC_GRBL_INTERP_CONTINUOUS,
+                                         exeSampleTimeMs_);
+
+  // Preview is published by the status thread
+  if(cfgPreviewPoints_ > 0 && cfgStatusDecimation_ > 0) {
+    grblPreview_ = new ecmcGrblPreview(grblCtx_, cfgPreviewPoints_);
+  }
+
+  // Rt trace written by ecmc rt thread, drained to file by trace thread
+  if(!cfgTraceFile_.empty()) {
+    grblTrace_ = new ecmcGrblTrace(cfgTraceFile_, index_ > 0 ? std::to_string(index_) : "",
+                                   index_, exeSampleTimeMs_, cfgTracePre_, cfgTracePost_);
+  }
   
-  ecmcData_.xAxis.axisId       = cfgXAxisId_;
-  ecmcData_.yAxis.axisId       = cfgYAxisId_;
-  ecmcData_.zAxis.axisId       = cfgZAxisId_;
-  ecmcData_.spindleAxis.axisId = cfgSpindleAxisId_;
+  ecmcData_.axes[X_AXIS].axisId                        = cfgXAxisId_;
+  ecmcData_.axes[Y_AXIS].axisId                        = cfgYAxisId_;
+  ecmcData_.axes[Z_AXIS].axisId                        = cfgZAxisId_;
+  ecmcData_.axes[ECMC_PLUGIN_AXIS_SLOT_SPINDLE].axisId = cfgSpindleAxisId_;
 
-  // global varaible in grbl  
+  // grbl context varaible
   enableDebugPrintouts = cfgDbgMode_;
 
   //Check atleast one valid axis
@@ -141,18 +209,29 @@ ecmcGrbl::ecmcGrbl(char* configStr,
     throw std::out_of_range("GRBL: ERROR: No valid axis choosen.");
   }
 
+  // Thread names are suffixed with the object index for all but the first object
+  std::string threadSuffix = index_ > 0 ? std::to_string(index_) : "";
+
     // Create worker thread for main grbl loop
-  std::string threadname = "ecmc.grbl.main";
+  std::string threadname = "ecmc.grbl.main" + threadSuffix;
   if(epicsThreadCreate(threadname.c_str(), 0, 32768, f_worker_main, this) == NULL) {
     throw std::runtime_error("GRBL: ERROR: Failed create worker thread for main().");
   }
 
   // Create worker thread for write socket
-  threadname = "ecmc.grbl.write";
+  threadname = "ecmc.grbl.write" + threadSuffix;
   if(epicsThreadCreate(threadname.c_str(), 0, 32768, f_worker_write, this) == NULL) {
     throw std::runtime_error("GRBL: ERROR: Failed create worker thread for write().");
   }
 
+  // Create worker thread for status (asyn callbacks outside ecmc rt thread)
+  if(cfgStatusDecimation_ > 0) {
+    threadname = "ecmc.grbl.status" + threadSuffix;
+    if(epicsThreadCreate(threadname.c_str(), 0, 32768, f_worker_status, this) == NULL) {
+      throw std::runtime_error("GRBL: ERROR: Failed create worker thread for status.");
+    }
+  }
+
   // wait for grblInitDone_!
   if(cfgDbgMode_) {
     printf("GRBL: INFO: Waiting for grbl init..");
@@ -170,6 +249,7 @@ ecmcGrbl::ecmcGrbl(char* configStr,
 ecmcGrbl::~ecmcGrbl() {
   // kill worker
   destructs_ = 1;  // maybe need todo in other way..
+  epicsEventSignal(statusEvent_);
 }
 
 void ecmcGrbl::parseConfigStr(char *configStr) {
@@ -229,14 +309,155 @@ void ecmcGrbl::parseConfigStr(char *configStr) {
         cfgAutoStart_ = atoi(pThisOption);
       }
 
+      // ECMC_PLUGIN_INTERP_MODE_OPTION_CMD (STEP/CONTINUOUS)
+      if (!strncmp(pThisOption, ECMC_PLUGIN_INTERP_MODE_OPTION_CMD, strlen(ECMC_PLUGIN_INTERP_MODE_OPTION_CMD))) {
+        pThisOption += strlen(ECMC_PLUGIN_INTERP_MODE_OPTION_CMD);
+        if(!strcmp(pThisOption, ECMC_PLUGIN_INTERP_MODE_CONTINUOUS_STR)) {
+          cfgInterpMode_ = ECMC_GRBL_INTERP_CONTINUOUS;
+        } else if(!strcmp(pThisOption, ECMC_PLUGIN_INTERP_MODE_STEP_STR)) {
+          cfgInterpMode_ = ECMC_GRBL_INTERP_STEP;
+        } else {
+          throw std::invalid_argument("GRBL: ERROR: Invalid interpolation mode (STEP/CONTINUOUS).");
+        }
+      }
+
+      // ECMC_PLUGIN_PLANNER_BUFFER_SIZE_OPTION_CMD
+      if (!strncmp(pThisOption, ECMC_PLUGIN_PLANNER_BUFFER_SIZE_OPTION_CMD, strlen(ECMC_PLUGIN_PLANNER_BUFFER_SIZE_OPTION_CMD))) {
+        pThisOption += strlen(ECMC_PLUGIN_PLANNER_BUFFER_SIZE_OPTION_CMD);
+        cfgPlannerBufferSize_ = atoi(pThisOption);
+      }
+
+      // ECMC_PLUGIN_STATUS_DECIMATION_OPTION_CMD (ecmc cycles, 0 disables)
+      if (!strncmp(pThisOption, ECMC_PLUGIN_STATUS_DECIMATION_OPTION_CMD, strlen(ECMC_PLUGIN_STATUS_DECIMATION_OPTION_CMD))) {
+        pThisOption += strlen(ECMC_PLUGIN_STATUS_DECIMATION_OPTION_CMD);
+        cfgStatusDecimation_ = atoi(pThisOption);
+        if(cfgStatusDecimation_ < 0) {
+          throw std::out_of_range("GRBL: ERROR: Invalid status decimation (must be >= 0).");
+        }
+      }
+
+      // ECMC_PLUGIN_PREVIEW_POINTS_OPTION_CMD (0 disables)
+      if (!strncmp(pThisOption, ECMC_PLUGIN_PREVIEW_POINTS_OPTION_CMD, strlen(ECMC_PLUGIN_PREVIEW_POINTS_OPTION_CMD))) {
+        pThisOption += strlen(ECMC_PLUGIN_PREVIEW_POINTS_OPTION_CMD);
+        cfgPreviewPoints_ = atoi(pThisOption);
+        if(cfgPreviewPoints_ < 0) {
+          throw std::out_of_range("GRBL: ERROR: Invalid number of preview points (must be >= 0).");
+        }
+      }
+
+      // ECMC_PLUGIN_TRACE_FILE_OPTION_CMD (empty disables)
+      if (!strncmp(pThisOption, ECMC_PLUGIN_TRACE_FILE_OPTION_CMD, strlen(ECMC_PLUGIN_TRACE_FILE_OPTION_CMD))) {
+        pThisOption += strlen(ECMC_PLUGIN_TRACE_FILE_OPTION_CMD);
+        cfgTraceFile_ = pThisOption;
+      }
+
+      // ECMC_PLUGIN_TRACE_PRE_OPTION_CMD (ecmc cycles before trigger)
+      if (!strncmp(pThisOption, ECMC_PLUGIN_TRACE_PRE_OPTION_CMD, strlen(ECMC_PLUGIN_TRACE_PRE_OPTION_CMD))) {
+        pThisOption += strlen(ECMC_PLUGIN_TRACE_PRE_OPTION_CMD);
+        cfgTracePre_ = atoi(pThisOption);
+      }
+
+      // ECMC_PLUGIN_TRACE_POST_OPTION_CMD (ecmc cycles after trigger)
+      if (!strncmp(pThisOption, ECMC_PLUGIN_TRACE_POST_OPTION_CMD, strlen(ECMC_PLUGIN_TRACE_POST_OPTION_CMD))) {
+        pThisOption += strlen(ECMC_PLUGIN_TRACE_POST_OPTION_CMD);
+        cfgTracePost_ = atoi(pThisOption);
+      }
+
       pThisOption = pNextOption;
     }    
     free(pOptions);
   }
 }
 
+int ecmcGrbl::createAsynParam(const char *name, asynParamType type) {
+  std::string paramName = std::string(ECMC_PLUGIN_ASYN_PREFIX) + "." + name;
+  int index = -1;
+  if(createParam(paramName.c_str(), type, &index) != asynSuccess) {
+    throw std::runtime_error("GRBL: ERROR: Failed create asyn parameter " + paramName + ".");
+  }
+  return index;
+}
+
+void ecmcGrbl::initAsyn() {
+  // Rt statistics (values fetched from rtStats_ on read, see readInt32(), readFloat64())
+  asynRTExeTimeMinId_   = createAsynParam(ECMC_PLUGIN_ASYN_RT_EXE_TIME_MIN,   asynParamFloat64);
+  asynRTExeTimeMaxId_   = createAsynParam(ECMC_PLUGIN_ASYN_RT_EXE_TIME_MAX,   asynParamFloat64);
+  asynRTExeTimeMeanId_  = createAsynParam(ECMC_PLUGIN_ASYN_RT_EXE_TIME_MEAN,  asynParamFloat64);
+  asynRTExeTimeHistId_  = createAsynParam(ECMC_PLUGIN_ASYN_RT_EXE_TIME_HIST,  asynParamInt32Array);
+  asynRTCyclesId_       = createAsynParam(ECMC_PLUGIN_ASYN_RT_CYCLES,         asynParamInt32);
+  asynRTStepsLastId_    = createAsynParam(ECMC_PLUGIN_ASYN_RT_STEPS_LAST,     asynParamInt32);
+  asynRTStepsMaxId_     = createAsynParam(ECMC_PLUGIN_ASYN_RT_STEPS_MAX,      asynParamInt32);
+  asynRTStepsMeanId_    = createAsynParam(ECMC_PLUGIN_ASYN_RT_STEPS_MEAN,     asynParamFloat64);
+  asynRTSegUnderrunsId_ = createAsynParam(ECMC_PLUGIN_ASYN_RT_SEG_UNDERRUNS,  asynParamInt32);
+  asynRTSegHighWaterId_ = createAsynParam(ECMC_PLUGIN_ASYN_RT_SEG_HIGH_WATER, asynParamInt32);
+  asynRTSegLowWaterId_  = createAsynParam(ECMC_PLUGIN_ASYN_RT_SEG_LOW_WATER,  asynParamInt32);
+  asynRTStatsResetId_   = createAsynParam(ECMC_PLUGIN_ASYN_RT_STATS_RESET,    asynParamInt32);
+  setIntegerParam(asynRTStatsResetId_, 0);
+
+  // Program validation (results fetched from grblValidator_ on read)
+  asynValidateId_       = createAsynParam(ECMC_PLUGIN_ASYN_VALIDATE,          asynParamInt32);
+  asynValidateBusyId_   = createAsynParam(ECMC_PLUGIN_ASYN_VALIDATE_BUSY,     asynParamInt32);
+  asynValidateErrorsId_ = createAsynParam(ECMC_PLUGIN_ASYN_VALIDATE_ERRORS,   asynParamInt32);
+  asynValidateRowsId_   = createAsynParam(ECMC_PLUGIN_ASYN_VALIDATE_ROWS,     asynParamInt32Array);
+  asynValidateCodesId_  = createAsynParam(ECMC_PLUGIN_ASYN_VALIDATE_CODES,    asynParamInt32Array);
+  setIntegerParam(asynValidateId_, 0);
+
+  // Simulation (results fetched from grblSimulator_ on read)
+  asynSimulateId_       = createAsynParam(ECMC_PLUGIN_ASYN_SIMULATE,          asynParamInt32);
+  asynSimulateBusyId_   = createAsynParam(ECMC_PLUGIN_ASYN_SIMULATE_BUSY,     asynParamInt32);
+  asynSimulateTimeId_   = createAsynParam(ECMC_PLUGIN_ASYN_SIMULATE_TIME,     asynParamFloat64);
+  setIntegerParam(asynSimulateId_, 0);
+
+  // Realtime status (values set and callbacks made by status thread, see doStatusWorker())
+  const char *axisNames[ECMC_PLUGIN_STATUS_AXES] = {"x", "y", "z"};
+  asynStatusStateId_     = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_STATE,       asynParamInt32);
+  asynStatusStateNameId_ = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_STATE_NAME,  asynParamOctet);
+  asynStatusSubStateId_  = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_SUBSTATE,    asynParamInt32);
+  for(int i = 0; i < ECMC_PLUGIN_STATUS_AXES; i++) {
+    std::string mposName = std::string(ECMC_PLUGIN_ASYN_STATUS_MPOS) + "." + axisNames[i];
+    std::string wposName = std::string(ECMC_PLUGIN_ASYN_STATUS_WPOS) + "." + axisNames[i];
+    asynStatusMPosId_[i] = createAsynParam(mposName.c_str(),                    asynParamFloat64);
+    asynStatusWPosId_[i] = createAsynParam(wposName.c_str(),                    asynParamFloat64);
+  }
+  asynStatusFeedId_       = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_FEED,       asynParamFloat64);
+  asynStatusSpindleId_    = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_SPINDLE,    asynParamFloat64);
+  asynStatusOvrFeedId_    = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_OVR_FEED,   asynParamInt32);
+  asynStatusOvrRapidId_   = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_OVR_RAPID,  asynParamInt32);
+  asynStatusOvrSpindleId_ = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_OVR_SPINDLE, asynParamInt32);
+  asynStatusPlannerId_    = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_PLANNER,    asynParamInt32);
+  asynStatusRxId_         = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_RX,         asynParamInt32);
+  asynStatusLineQueueId_  = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_LINE_QUEUE, asynParamInt32);
+  asynStatusLineId_       = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_LINE,       asynParamInt32);
+  asynStatusRowId_        = createAsynParam(ECMC_PLUGIN_ASYN_STATUS_ROW,        asynParamInt32);
+  ecmcGrblStatus status;
+  memset(&status,0,sizeof(ecmcGrblStatus));
+  status.feedOverride    = DEFAULT_FEED_OVERRIDE;
+  status.rapidOverride   = DEFAULT_RAPID_OVERRIDE;
+  status.spindleOverride = DEFAULT_SPINDLE_SPEED_OVERRIDE;
+  setStatusParams(&status);
+
+  // Toolpath preview (arrays fetched from grblPreview_ on read, callbacks made by status thread)
+  asynPreviewXId_       = createAsynParam(ECMC_PLUGIN_ASYN_PREVIEW_X,         asynParamFloat64Array);
+  asynPreviewYId_       = createAsynParam(ECMC_PLUGIN_ASYN_PREVIEW_Y,         asynParamFloat64Array);
+  asynPreviewZId_       = createAsynParam(ECMC_PLUGIN_ASYN_PREVIEW_Z,         asynParamFloat64Array);
+  asynPreviewSpeedId_   = createAsynParam(ECMC_PLUGIN_ASYN_PREVIEW_SPEED,     asynParamFloat64Array);
+  asynPreviewLineId_    = createAsynParam(ECMC_PLUGIN_ASYN_PREVIEW_LINE,      asynParamFloat64Array);
+  asynPreviewCountId_   = createAsynParam(ECMC_PLUGIN_ASYN_PREVIEW_COUNT,     asynParamInt32);
+  asynPreviewPlannedId_ = createAsynParam(ECMC_PLUGIN_ASYN_PREVIEW_PLANNED,   asynParamInt32);
+  setIntegerParam(asynPreviewCountId_, 0);
+  setIntegerParam(asynPreviewPlannedId_, 0);
+
+  // Rt trace (counters fetched from grblTrace_ on read, trigger executed by ecmc rt thread)
+  asynTraceTriggerId_   = createAsynParam(ECMC_PLUGIN_ASYN_TRACE_TRIGGER,     asynParamInt32);
+  asynTraceCapturesId_  = createAsynParam(ECMC_PLUGIN_ASYN_TRACE_CAPTURES,    asynParamInt32);
+  asynTraceLostId_      = createAsynParam(ECMC_PLUGIN_ASYN_TRACE_LOST,        asynParamInt32);
+  setIntegerParam(asynTraceTriggerId_, 0);
+  callParamCallbacks();
+}
+
 // Main program for grbl client (interaction with grbl, configs and g-code)
 void ecmcGrbl::doWriteWorker() {
+  grbl_context_bind(grblCtx_);
   // simulate serial connection here (need mutex)
   std::string reply = "";
   if(cfgDbgMode_){
@@ -365,44 +586,85 @@ bool ecmcGrbl::autoEnableAxesSuccess() {
   return ecmcData_.allEnabled;
 }
 
+// Stream g-code to grbl (character counting streaming, see doc/script/stream.py).
+// Lines are written as long as there is space in the grbl line queue without waiting
+// for the ok of the previous line. The command index of each line written but not yet
+// acknowledged is kept in grblOutstandingLines_ so that replies can be matched to
+// code rows in order (grbl replies exactly once per line).
 bool ecmcGrbl::WriteGCodeSuccess() {
   //printf("START WRITE G_CODE!\n");
+  grblOutstandingLines_.clear();
+  if(grblPreview_) {
+    grblPreview_->start(grblProgram_);
+  }
   for(;;) {
-    //printf("grblCommandBuffer_.size() %d grblCommandBufferIndex_ %d executeCmd_  %d ecmcData_.allEnabled %d\n",grblCommandBuffer_.size(), grblCommandBufferIndex_,executeCmd_ ,ecmcData_.allEnabled);
-    if( (grblCommandBuffer_.size() > grblCommandBufferIndex_) 
-         && executeCmd_ && ecmcData_.allEnabled) {      
-      epicsMutexLock(grblCommandBufferMutex_);
-      std::string commandRaw = grblCommandBuffer_[grblCommandBufferIndex_];
-      epicsMutexUnlock(grblCommandBufferMutex_);
-      std::string command = commandRaw.substr(0, commandRaw.find(ECMC_CONFIG_FILE_COMMENT_CHAR));
-      //printf("commandRaw");
-      if(command.length() == 0) {
-        continue;
+    //printf("grblProgram_->size() %d grblCommandBufferIndex_ %d executeCmd_  %d ecmcData_.allEnabled %d\n",grblProgram_->size(), grblCommandBufferIndex_,executeCmd_ ,ecmcData_.allEnabled);
+    bool moreCommands = grblProgram_->hasLine(grblCommandBufferIndex_)
+                        && executeCmd_ && ecmcData_.allEnabled;
+
+    // Keep the grbl line queue as full as possible
+    while(moreCommands && serial_get_line_queue_available() > 0) {
+      // Program lines are stored without comments and are never empty
+      grblProgram_->lock();
+      std::string_view command = grblProgram_->getLine(grblCommandBufferIndex_);
+      if(command.length() > 0) {
+        //Write pre-compiled block if available, else command (space in queue so will not block)
+        grblBlockCache_->lock();
+        const gc_parsed_line_t *block = grblBlockCache_->getBlock(grblCommandBufferIndex_);
+        if(block) {
+          while(!ecmc_write_parsed_line(block)) {
+            delay_ms(1);
+          }
+        }
+        grblBlockCache_->unlock();
+        if(!block) {
+          grblWriteCommand(command);
+        }
+        grblOutstandingLines_.push_back(grblCommandBufferIndex_);
       }
+      grblProgram_->unlock();
+      grblCommandBufferIndex_++;
+      moreCommands = grblProgram_->hasLine(grblCommandBufferIndex_)
+                     && executeCmd_ && ecmcData_.allEnabled;
+    }
+
+    // Match replies with outstanding lines. Block for reply if nothing else to do.
+    if(!grblOutstandingLines_.empty() &&
+       (grblReplyAvailable() || !moreCommands ||
+        serial_get_line_queue_available() == 0)) {
 
-      //Write command (will block untill written)
-      grblWriteCommand(command);
-      
-      // will block untill answer
       grblReplyType replyStat = grblReadReply();
 
+      if(replyStat == ECMC_GRBL_REPLY_NON_PROTOCOL) {
+        continue;
+      }
+
       if(replyStat != ECMC_GRBL_REPLY_OK) {
+        // Error belongs to the oldest outstanding line
+        grblCodeRowNum_ = grblOutstandingLines_.front();
+        grblOutstandingLines_.clear();
         errorCode_ = ECMC_PLUGIN_GRBL_COMMAND_ERROR_CODE;
         // stop motion
         setExecute(0);
         setReset(0);
         setReset(1);
         setReset(0);
-        printf("GRBL: ERROR: Grbl reply not OK (motion stopped)\n");
+        printf("GRBL: ERROR: Grbl reply not OK for code row %u (motion stopped)\n",
+               grblCodeRowNum_);
         grblCommandBufferIndex_ = 0;
         return false;  // for loop
       }
-      
-      grblCommandBufferIndex_++;
+
+      grblOutstandingLines_.pop_front();
+      grblCodeRowNum_ = grblOutstandingLines_.empty() ?
+                        grblCommandBufferIndex_ : grblOutstandingLines_.front();
+      continue;
     }
-    else {
+
+    if(!moreCommands) {
       //printf("GRBL: INFO: No more commands in buffer!!!\n");
-      if( ( (grblCommandBufferIndex_ >= grblCommandBuffer_.size()) || !executeCmd_) && grblInitDone_) {
+      if( grblOutstandingLines_.empty() &&
+          ( !grblProgram_->hasLine(grblCommandBufferIndex_) || !executeCmd_) && grblInitDone_) {
         writerBusy_ = 0;        
         return true;  // code executed once
       }
@@ -414,51 +676,59 @@ bool ecmcGrbl::WriteGCodeSuccess() {
   return true;
 }
 
-void ecmcGrbl::grblWriteCommand(std::string command) {
-  // wait for grbl
-  printf("WAIT FOR SPACE IN BUFFER\n");
-  while(serial_get_rx_buffer_available() <= strlen(command.c_str()+1)) {
-    //printf("WAITING for free in buffer %d %d\n",serial_get_rx_buffer_available(),strlen(command.c_str()+1));
-    delay_ms(10);
+void ecmcGrbl::grblWriteCommand(std::string_view command) {
+  // Hand the complete line to grbl through the line queue (will block untill space in queue)
+  while(!ecmc_write_command_line(command.data(), command.length())) {
+    delay_ms(1);
   }
-  ecmc_write_command_serial(strdup(command.c_str()));
   if(cfgDbgMode_){
-    printf("GRBL: INFO: Write command (command[%d] = %s)\n",
+    printf("GRBL: INFO: Write command (command[%d] = %.*s)\n",
            grblCommandBufferIndex_,
-           command.c_str());
+           (int)command.length(),
+           command.data());
   }
 }
 
  grblReplyType ecmcGrbl::grblReadReply() {
-  std::string reply = "";
-
-  // Wait for reply!
+  // Wait for reply! (bulk reads into preallocated buffers, no locking per char)
   for(;;) {
-    while(serial_get_tx_buffer_count()==0) {
-      delay_ms(1);      
+    if(grblReplyDataPos_ >= grblReplyDataLen_) {
+      grblReplyDataPos_ = 0;
+      grblReplyDataLen_ = ecmc_read_from_grbl_tx_buffer(grblReplyData_,
+                                                        ECMC_PLUGIN_GRBL_REPLY_BUFFER_SIZE);
+      if(grblReplyDataLen_ == 0) {
+        ecmc_wait_for_grbl_tx_data(ECMC_PLUGIN_GRBL_REPLY_WAIT_TIMEOUT_S);
+        continue;
+      }
     }
-    char c = ecmc_get_char_from_grbl_tx_buffer();
-    reply += c;
-    if(c == '\n'&& reply.length() > 1) {
-      if(reply.find(ECMC_PLUGIN_GRBL_GRBL_OK_STRING) != std::string::npos) {            
+
+    char c = grblReplyData_[grblReplyDataPos_++];
+    if(grblReplyLineLen_ < ECMC_PLUGIN_GRBL_REPLY_BUFFER_SIZE - 1) {
+      grblReplyLine_[grblReplyLineLen_++] = c;
+    }
+    if(c == '\n'&& grblReplyLineLen_ > 1) {
+      grblReplyLine_[grblReplyLineLen_] = 0;
+      grblReplyLineLen_ = 0;
+      const char *reply = grblReplyLine_;
+      if(strstr(reply, ECMC_PLUGIN_GRBL_GRBL_OK_STRING)) {            
         if(cfgDbgMode_){
-          printf("GRBL: INFO: Reply OK (%s)\n",reply.c_str());
+          printf("GRBL: INFO: Reply OK (%s)\n",reply);
         }
         return ECMC_GRBL_REPLY_OK;        
-      } else if(reply.find(ECMC_PLUGIN_GRBL_GRBL_ERR_STRING) != std::string::npos) {
+      } else if(strstr(reply, ECMC_PLUGIN_GRBL_GRBL_ERR_STRING)) {
         if(cfgDbgMode_){
-          printf("GRBL: ERROR: Reply ERROR, (%s)\n", reply.c_str());
+          printf("GRBL: ERROR: Reply ERROR, (%s)\n", reply);
         }
         return ECMC_GRBL_REPLY_ERROR;
-      } else if(reply.find(ECMC_PLUGIN_GRBL_GRBL_STARTUP_STRING) != std::string::npos ) {
+      } else if(strstr(reply, ECMC_PLUGIN_GRBL_GRBL_STARTUP_STRING)) {
         if(cfgDbgMode_){
-          printf("GRBL: INFO: Ready for commands: %s\n",reply.c_str());
+          printf("GRBL: INFO: Ready for commands: %s\n",reply);
         }
         return ECMC_GRBL_REPLY_START;
       } else {
         // keep waiting (no break)            
         if(cfgDbgMode_){
-          printf("GRBL: INFO: Reply non protocol related: %s\n",reply.c_str());
+          printf("GRBL: INFO: Reply non protocol related: %s\n",reply);
         }
         return ECMC_GRBL_REPLY_NON_PROTOCOL;
       }
@@ -467,8 +737,14 @@ void ecmcGrbl::grblWriteCommand(std::string command) {
   return ECMC_GRBL_REPLY_NON_PROTOCOL;
 }
 
+// Reply data read from grbl but not yet handled by grblReadReply()
+bool ecmcGrbl::grblReplyAvailable() {
+  return grblReplyDataPos_ < grblReplyDataLen_ || serial_get_tx_buffer_count() > 0;
+}
+
 // Main grbl worker (copied from grbl main.c)
 void ecmcGrbl::doMainWorker() {
+  grbl_context_bind(grblCtx_);
   if(cfgDbgMode_){
     printf("%s:%s:%d\n",__FILE__,__FUNCTION__,__LINE__);
   }
@@ -519,6 +795,7 @@ void ecmcGrbl::doMainWorker() {
     sys_rt_exec_alarm = 0;
     sys_rt_exec_motion_override = 0;
     sys_rt_exec_accessory_override = 0;
+    sys_rt_exec_sync_position = 0;
 
     // Reset Grbl primary systems.
     serial_reset_read_buffer(); // Clear serial read buffer
@@ -552,17 +829,10 @@ void ecmcGrbl::doMainWorker() {
 
 int ecmcGrbl::setAllAxesEnable(int enable) {
 
-  if(ecmcData_.xAxis.axisId >= 0) {
-     setAxisEnable(ecmcData_.xAxis.axisId, enable);
-  }
-  if(ecmcData_.yAxis.axisId >= 0 ) {
-    setAxisEnable(ecmcData_.yAxis.axisId, enable);
-  }
-  if(ecmcData_.zAxis.axisId >= 0 ) {
-    setAxisEnable(ecmcData_.zAxis.axisId, enable);
-  }
-  if(ecmcData_.spindleAxis.axisId >= 0) {
-    setAxisEnable(ecmcData_.spindleAxis.axisId, enable);
+  for(int slot = 0; slot < ECMC_PLUGIN_AXIS_SLOTS; slot++) {
+    if(ecmcData_.axes[slot].axisId >= 0) {
+      setAxisEnable(ecmcData_.axes[slot].axisId, enable);
+    }
   }
   return 0;
 }
@@ -604,9 +874,19 @@ double  ecmcGrbl::getEcmcAxisActPos(int axis) {
 
 void ecmcGrbl::preExeAxes() {
 
-  preExeAxis(ecmcData_.xAxis,X_AXIS);
-  preExeAxis(ecmcData_.yAxis,Y_AXIS);
-  preExeAxis(ecmcData_.zAxis,Z_AXIS);
+  // One batched resync of stepper and planner, only if any quantized position changed
+  bool changed = false;
+  for(int i = 0; i < rtAxesCount_; i++) {
+    int slot = rtAxes_[i];
+    if(slot != ECMC_PLUGIN_AXIS_SLOT_SPINDLE) {
+      changed = syncAxisPosition(&ecmcData_.axes[slot], slot) || changed;
+    }
+  }
+  if(changed) {
+    st_sync_continuous_position();
+    plan_sync_position();
+    system_set_exec_sync_position();  // g-code parser synced by the grbl main thread
+  }
 
   // Kill everything if limit switch violation
   if(executeCmd_) {
@@ -614,47 +894,25 @@ void ecmcGrbl::preExeAxes() {
   }
 }
 
-void ecmcGrbl::preExeAxis(ecmcAxisStatusData ecmcAxisData, int grblAxisId) {
-  if(ecmcAxisData.axisId < 0) {
-    return;
-  }
-  
-  syncAxisPosition(ecmcAxisData, grblAxisId);  
-}
-
 void ecmcGrbl::giveControlToEcmcIfNeeded() {
 
   // Give total control to ecmc at negative edge of any limit switch
   if( (!ecmcData_.allLimitsOK && ecmcData_.allLimitsOKOld) ||
      (!ecmcData_.errorOld && ecmcData_.error) ) {
 
-    if(ecmcData_.xAxis.axisId >= 0) {
-      if(ecmcData_.xAxis.trajSource == ECMC_DATA_SOURCE_EXTERNAL) {
-        setAxisTrajSource(ecmcData_.xAxis.axisId,ECMC_DATA_SOURCE_INTERNAL);
-        stopMotion(ecmcData_.xAxis.axisId,0);
-      }
-    }
-
-    if(ecmcData_.yAxis.axisId >= 0) {
-      if(ecmcData_.yAxis.trajSource == ECMC_DATA_SOURCE_EXTERNAL) {
-        setAxisTrajSource(ecmcData_.yAxis.axisId,ECMC_DATA_SOURCE_INTERNAL);
-        stopMotion(ecmcData_.yAxis.axisId,0);
+    for(int i = 0; i < rtAxesCount_; i++) {
+      ecmcAxisStatusData *axis = &ecmcData_.axes[rtAxes_[i]];
+      if(rtAxes_[i] == ECMC_PLUGIN_AXIS_SLOT_SPINDLE) {
+        // Stop spindle
+        setAxisTargetVel(axis->axisId, 0);
+        stopMotion(axis->axisId,0);
+        axis->setpoint = NAN;
+      } else if(axis->trajSource == ECMC_DATA_SOURCE_EXTERNAL) {
+        setAxisTrajSource(axis->axisId,ECMC_DATA_SOURCE_INTERNAL);
+        stopMotion(axis->axisId,0);
       }
     }
 
-    if(ecmcData_.zAxis.axisId >= 0) {
-      if(ecmcData_.zAxis.trajSource == ECMC_DATA_SOURCE_EXTERNAL) {
-        setAxisTrajSource(ecmcData_.zAxis.axisId,ECMC_DATA_SOURCE_INTERNAL);
-        stopMotion(ecmcData_.zAxis.axisId,0);
-      }
-    }
-
-    // Stop spindle
-    if(ecmcData_.spindleAxis.axisId >= 0) {
-      setAxisTargetVel(ecmcData_.spindleAxis.axisId, 0);
-      stopMotion(ecmcData_.spindleAxis.axisId,0);
-    }
-
     // Halt grbl and stop motion (even though should be handled by ecmc)
     setExecute(0);
     setHalt(0);
@@ -667,18 +925,45 @@ void ecmcGrbl::giveControlToEcmcIfNeeded() {
   }
 }
 
-void ecmcGrbl::syncAxisPosition(ecmcAxisStatusData ecmcAxisData, int grblAxisId) {
+// Returns true if sys_position changed or the axis just entered sync (planner needs resync)
+bool ecmcGrbl::syncAxisPosition(ecmcAxisStatusData *ecmcAxisData, int grblAxisId) {
   
   // sync positions when not enabled
-  if(!ecmcAxisData.enabled || ecmcAxisData.trajSource == ECMC_DATA_SOURCE_INTERNAL) {
-    sys_position[grblAxisId] = (int32_t)(double(settings.steps_per_mm[grblAxisId])*ecmcAxisData.actpos);
-    plan_sync_position();
-    gc_sync_position();
+  bool sync = !ecmcAxisData->enabled || ecmcAxisData->trajSource == ECMC_DATA_SOURCE_INTERNAL;
+  bool enteredSync = sync && !ecmcAxisData->sync;
+  ecmcAxisData->sync = sync;
+  if(!sync) {
+    return false;
   }
+  int32_t steps = (int32_t)(double(settings.steps_per_mm[grblAxisId])*ecmcAxisData->actpos);
+  if(steps == sys_position[grblAxisId] && !enteredSync) {
+    return false;
+  }
+  sys_position[grblAxisId] = steps;
+  return true;
 }
 
 // prepare for rt here  
 int ecmcGrbl::enterRT() {
+  // Resolve configured axes once, the rt thread only iterates rtAxes_
+  rtAxesCount_ = 0;
+  for(int slot = 0; slot < ECMC_PLUGIN_AXIS_SLOTS; slot++) {
+    ecmcAxisStatusData *axis = &ecmcData_.axes[slot];
+    if(axis->axisId < 0) {
+      continue;
+    }
+    int enabled = 0;
+    if(getAxisEnabled(axis->axisId, &enabled)) {
+      printf("GRBL: ERROR: Invalid ecmc axis %d.\n", axis->axisId);
+      errorCode_ = ECMC_PLUGIN_CONFIG_ERROR_CODE;
+      return errorCode_;
+    }
+    axis->enabled  = enabled;
+    axis->setpoint = NAN;
+    axis->sync     = false;  // first sync always resyncs planner
+    rtAxes_[rtAxesCount_++] = slot;
+  }
+
   // readback spindleAcceleration_
   if(cfgSpindleAxisId_ >= 0) {
     double acc = 0;
@@ -694,7 +979,7 @@ int ecmcGrbl::enterRT() {
       return errorCode_;
     }
 
-    ecmcData_.spindleAxis.acceleration = acc;                 
+    ecmcData_.axes[ECMC_PLUGIN_AXIS_SLOT_SPINDLE].acceleration = acc;
   }
   return 0;
 }
@@ -708,70 +993,77 @@ void   ecmcGrbl::readEcmcStatus(int ecmcError) {
   ecmcData_.allEnabled     = true;
   ecmcData_.allLimitsOK    = true;
 
-  if(ecmcData_.xAxis.axisId >= 0) {
-     ecmcData_.xAxis.enabled    = getEcmcAxisEnabled(cfgXAxisId_);
-     ecmcData_.xAxis.limitBwd   = getEcmcAxisLimitBwd(cfgXAxisId_);
-     ecmcData_.xAxis.limitFwd   = getEcmcAxisLimitFwd(cfgXAxisId_);
-     ecmcData_.xAxis.error      = getAxisError(cfgXAxisId_);
-     ecmcData_.xAxis.actpos     = getEcmcAxisActPos(cfgXAxisId_);
-     ecmcData_.xAxis.trajSource = getEcmcAxisTrajSource(cfgXAxisId_);
-     ecmcData_.allEnabled       = ecmcData_.allEnabled &&
-                                  ecmcData_.xAxis.enabled;
-     ecmcData_.allLimitsOK      = ecmcData_.allLimitsOK &&
-                                  ecmcData_.xAxis.limitBwd && 
-                                  ecmcData_.xAxis.limitFwd;
-  }
-
-  if(ecmcData_.yAxis.axisId >= 0) {
-     ecmcData_.yAxis.enabled    = getEcmcAxisEnabled(cfgYAxisId_);
-     ecmcData_.yAxis.limitBwd   = getEcmcAxisLimitBwd(cfgYAxisId_);
-     ecmcData_.yAxis.limitFwd   = getEcmcAxisLimitFwd(cfgYAxisId_);
-     ecmcData_.yAxis.error      = getAxisError(cfgYAxisId_);
-     ecmcData_.yAxis.actpos     = getEcmcAxisActPos(cfgYAxisId_);
-     ecmcData_.yAxis.trajSource = getEcmcAxisTrajSource(cfgYAxisId_);
-     ecmcData_.allEnabled       = ecmcData_.allEnabled &&
-                                  ecmcData_.yAxis.enabled;
-     ecmcData_.allLimitsOK      = ecmcData_.allLimitsOK &&
-                                  ecmcData_.yAxis.limitBwd && 
-                                  ecmcData_.yAxis.limitFwd;
-  }
-
-  if(ecmcData_.zAxis.axisId >= 0) {
-     ecmcData_.zAxis.enabled    = getEcmcAxisEnabled(cfgZAxisId_);
-     ecmcData_.zAxis.limitBwd   = getEcmcAxisLimitBwd(cfgZAxisId_);
-     ecmcData_.zAxis.limitFwd   = getEcmcAxisLimitFwd(cfgZAxisId_);
-     ecmcData_.zAxis.error      = getAxisError(cfgZAxisId_);
-     ecmcData_.zAxis.actpos     = getEcmcAxisActPos(cfgZAxisId_);
-     ecmcData_.zAxis.trajSource = getEcmcAxisTrajSource(cfgZAxisId_);
-     ecmcData_.allEnabled       = ecmcData_.allEnabled &&
-                                  ecmcData_.zAxis.enabled;
-     ecmcData_.allLimitsOK      = ecmcData_.allLimitsOK &&
-                                  ecmcData_.zAxis.limitBwd && 
-                                  ecmcData_.zAxis.limitFwd;
-  }
-
-  if(ecmcData_.spindleAxis.axisId >= 0) {
-     ecmcData_.spindleAxis.enabled    = getEcmcAxisEnabled(cfgSpindleAxisId_);
-     ecmcData_.spindleAxis.limitBwd   = getEcmcAxisLimitBwd(cfgSpindleAxisId_);
-     ecmcData_.spindleAxis.limitFwd   = getEcmcAxisLimitFwd(cfgSpindleAxisId_);
-     ecmcData_.spindleAxis.error      = getAxisError(cfgSpindleAxisId_);
-     ecmcData_.spindleAxis.actpos     = getEcmcAxisActPos(cfgSpindleAxisId_);
-     ecmcData_.spindleAxis.trajSource = getEcmcAxisTrajSource(cfgSpindleAxisId_);    
-     ecmcData_.allEnabled             = ecmcData_.allEnabled &&
-                                        ecmcData_.spindleAxis.enabled;
-     ecmcData_.allLimitsOK            = ecmcData_.allLimitsOK &&
-                                        ecmcData_.spindleAxis.limitBwd && 
-                                        ecmcData_.spindleAxis.limitFwd;
+  for(int i = 0; i < rtAxesCount_; i++) {
+    int slot = rtAxes_[i];
+    ecmcAxisStatusData *axis = &ecmcData_.axes[slot];
+    bool enabled           = getEcmcAxisEnabled(axis->axisId);
+    axis->limitBwd         = getEcmcAxisLimitBwd(axis->axisId);
+    axis->limitFwd         = getEcmcAxisLimitFwd(axis->axisId);
+    ecmcData_.allEnabled   = ecmcData_.allEnabled && enabled;
+    ecmcData_.allLimitsOK  = ecmcData_.allLimitsOK && axis->limitBwd && axis->limitFwd;
+
+    // Write setpoint again after enable or source change
+    if(enabled != axis->enabled) {
+      axis->setpoint = NAN;
+    }
+    axis->enabled = enabled;
+
+    // Spindle is velocity controlled
+    if(slot == ECMC_PLUGIN_AXIS_SLOT_SPINDLE) {
+      continue;
+    }
+    int trajSource = getEcmcAxisTrajSource(axis->axisId);
+    if(trajSource != axis->trajSource) {
+      axis->setpoint = NAN;
+    }
+    axis->trajSource = trajSource;
+
+    // Actual position only needed for sync (see syncAxisPosition()) and trace
+    if(!enabled || trajSource == ECMC_DATA_SOURCE_INTERNAL || grblTrace_) {
+      axis->actpos = getEcmcAxisActPos(axis->axisId);
+    }
   }
 }
 
 // grb realtime thread!!!  
 int  ecmcGrbl::grblRTexecute(int ecmcError) {
 
+  // The ecmc rt thread executes all grbl objects
+  grbl_context_bind(grblCtx_);
+
   if((getEcmcEpicsIOCState()!=16 && getEcmcEpicsIOCState()!=29) || !grblInitDone_ || unrecoverableError_) {
     return 0;
   }
-  
+
+  // Reset of statistics requested over asyn
+  if(rtStatsResetCmd_) {
+    resetRTStats();
+    rtStatsResetCmd_ = 0;
+  }
+
+  struct timespec start, end;
+  uint32_t steps = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int errorCode = grblRTexecuteCycle(ecmcError, &steps);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  updateRTStats((end.tv_sec - start.tv_sec)*1E6 + (end.tv_nsec - start.tv_nsec)*1E-3, steps);
+
+  // Status snapshot, published by status thread
+  if(cfgStatusDecimation_ > 0 && ++statusCycles_ >= cfgStatusDecimation_) {
+    statusCycles_ = 0;
+    updateStatus();
+    epicsEventSignal(statusEvent_);
+  }
+
+  if(grblTrace_) {
+    updateTrace(ecmcError);
+  }
+  return errorCode;
+}
+
+int  ecmcGrbl::grblRTexecuteCycle(int ecmcError, uint32_t *steps) {
+
   // Read all ecmc data
   readEcmcStatus(ecmcError);
   
@@ -782,9 +1074,11 @@ int  ecmcGrbl::grblRTexecute(int ecmcError) {
     setHalt(1);
 
     // Stop spindle
-    if(ecmcData_.spindleAxis.axisId >= 0) {
-      setAxisTargetVel(ecmcData_.spindleAxis.axisId, 0);
-      stopMotion(ecmcData_.spindleAxis.axisId,0);
+    ecmcAxisStatusData *spindle = &ecmcData_.axes[ECMC_PLUGIN_AXIS_SLOT_SPINDLE];
+    if(spindle->axisId >= 0) {
+      setAxisTargetVel(spindle->axisId, 0);
+      stopMotion(spindle->axisId,0);
+      spindle->setpoint = NAN;
     }
 
     setExecute(0);
@@ -806,18 +1100,13 @@ int  ecmcGrbl::grblRTexecute(int ecmcError) {
   
   preExeAxes();
 
-  double sampleRateMs = 0.0;
   if(grblInitDone_ && ecmcData_.allEnabled) {
-    while(timeToNextExeMs_ < exeSampleTimeMs_ && sampleRateMs >= 0) {      
-      sampleRateMs = ecmc_grbl_main_rt_thread();
-      if(sampleRateMs > 0){
-        timeToNextExeMs_ += sampleRateMs;
-      } else {
-        timeToNextExeMs_ = 0;  // reset since no more steps..
-      }
-    }
-    if(sampleRateMs >= 0){
-      timeToNextExeMs_-= exeSampleTimeMs_;
+    if(cfgInterpMode_ == ECMC_GRBL_INTERP_CONTINUOUS) {
+      // Sample segment velocity profile at ecmc rate (no step emulation)
+      *steps = ecmc_grbl_main_rt_execute_continuous(exeSampleTimeMs_);
+    } else {
+      // Execute all steps of this ecmc cycle at once (O(segments) instead of O(steps))
+      *steps = ecmc_grbl_main_rt_execute(&timeToNextExeMs_, exeSampleTimeMs_);
     }
   }
   //update setpoints
@@ -825,26 +1114,276 @@ int  ecmcGrbl::grblRTexecute(int ecmcError) {
   return errorCode_;
 }
 
-void ecmcGrbl::postExeAxis(ecmcAxisStatusData ecmcAxisData, int grblAxisId) {
-  if(ecmcAxisData.axisId >= 0) {
-    setAxisExtSetPos(ecmcAxisData.axisId,double(sys_position[grblAxisId])/double(settings.steps_per_mm[grblAxisId]));
+void ecmcGrbl::updateRTStats(double exeTimeUs, uint32_t steps) {
+  if(rtStats_.cycles == 0 || exeTimeUs < rtStats_.exeTimeMinUs) {
+    rtStats_.exeTimeMinUs = exeTimeUs;
+  }
+  if(exeTimeUs > rtStats_.exeTimeMaxUs) {
+    rtStats_.exeTimeMaxUs = exeTimeUs;
+  }
+  rtStats_.exeTimeSumUs += exeTimeUs;
+
+  // log2 histogram bucket
+  int bucket = 0;
+  uint32_t timeUs = (uint32_t)exeTimeUs;
+  while(timeUs > 0 && bucket < ECMC_PLUGIN_RT_HIST_BUCKETS - 1) {
+    timeUs >>= 1;
+    bucket++;
+  }
+  rtStats_.exeTimeHist[bucket]++;
+
+  rtStats_.stepsLast = steps;
+  if(steps > rtStats_.stepsMax) {
+    rtStats_.stepsMax = steps;
+  }
+  rtStats_.stepsSum += steps;
+  rtStats_.cycles++;
+}
+
+void ecmcGrbl::resetRTStats() {
+  memset(&rtStats_,0,sizeof(ecmcGrblRTStats));
+  st_reset_segment_buffer_stats();
+}
+
+// Same content as the '?' realtime report of grbl (report_realtime_status()) without text formatting
+void ecmcGrbl::updateStatus() {
+  uint32_t seq = statusSeq_.load(std::memory_order_relaxed);
+  statusSeq_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  status_.subState = 0;
+  switch (sys.state) {
+    case STATE_IDLE:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_IDLE;
+      break;
+    case STATE_CYCLE:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_RUN;
+      break;
+    case STATE_HOLD:
+      if (!(sys.suspend & SUSPEND_JOG_CANCEL)) {
+        status_.state = ECMC_PLUGIN_GRBL_STATE_HOLD;
+        status_.subState = (sys.suspend & SUSPEND_HOLD_COMPLETE) ? 0 : 1;
+      } else {
+        status_.state = ECMC_PLUGIN_GRBL_STATE_JOG;
+      }
+      break;
+    case STATE_JOG:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_JOG;
+      break;
+    case STATE_HOMING:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_HOME;
+      break;
+    case STATE_ALARM:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_ALARM;
+      break;
+    case STATE_CHECK_MODE:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_CHECK;
+      break;
+    case STATE_SAFETY_DOOR:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_DOOR;
+      if (sys.suspend & SUSPEND_INITIATE_RESTORE) {
+        status_.subState = 3;  // Restoring
+      } else if (sys.suspend & SUSPEND_RETRACT_COMPLETE) {
+        status_.subState = (sys.suspend & SUSPEND_SAFETY_DOOR_AJAR) ? 1 : 0;
+      } else {
+        status_.subState = 2;  // Retracting
+      }
+      break;
+    case STATE_SLEEP:
+      status_.state = ECMC_PLUGIN_GRBL_STATE_SLEEP;
+      break;
+  }
+
+  // Same setpoints as sent to ecmc (see postExeAxis())
+  double position[N_AXIS];
+  if(cfgInterpMode_ == ECMC_GRBL_INTERP_CONTINUOUS) {
+    st_get_continuous_position(position);
+  } else {
+    for(int i = 0; i < N_AXIS; i++) {
+      position[i] = (double)sys_position[i];
+    }
+  }
+  // Work coordinate offset as published by the grbl main thread (parser state written meanwhile)
+  real_t wco[N_AXIS];
+  grbl_context_get_wco(grblCtx_, wco);
+  for(int i = 0; i < ECMC_PLUGIN_STATUS_AXES; i++) {
+    status_.mpos[i] = position[i] / double(settings.steps_per_mm[i]);
+    status_.wpos[i] = status_.mpos[i] - (double)wco[i];
+  }
+
+  status_.feed            = st_get_realtime_rate();
+  status_.spindleSpeed    = sys.spindle_speed;
+  status_.feedOverride    = sys.f_override;
+  status_.rapidOverride   = sys.r_override;
+  status_.spindleOverride = sys.spindle_speed_ovr;
+  status_.plannerFill     = plan_get_block_buffer_count();
+  status_.rxFill          = serial_get_rx_buffer_count();
+  status_.lineQueueFill   = LINE_QUEUE_SIZE - 1 - serial_get_line_queue_available();
+  status_.lineNumber      = 0;
+  #ifdef USE_LINE_NUMBERS
+    plan_block_t *block = plan_get_current_block();
+    if(block) {
+      status_.lineNumber = block->line_number;
+    }
+  #endif
+  status_.codeRow         = grblCodeRowNum_;
+
+  statusSeq_.store(seq + 2, std::memory_order_release);
+}
+
+// Consistent copy of last snapshot (retry if written meanwhile)
+void ecmcGrbl::readStatus(ecmcGrblStatus *status) {
+  uint32_t seq;
+  do {
+    seq = statusSeq_.load(std::memory_order_acquire);
+    memcpy(status, &status_, sizeof(ecmcGrblStatus));
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while((seq & 1) || seq != statusSeq_.load(std::memory_order_relaxed));
+}
+
+void ecmcGrbl::setStatusParams(ecmcGrblStatus *status) {
+  setIntegerParam(asynStatusStateId_, status->state);
+  setStringParam(asynStatusStateNameId_, grblStateNames[status->state]);
+  setIntegerParam(asynStatusSubStateId_, status->subState);
+  for(int i = 0; i < ECMC_PLUGIN_STATUS_AXES; i++) {
+    setDoubleParam(asynStatusMPosId_[i], status->mpos[i]);
+    setDoubleParam(asynStatusWPosId_[i], status->wpos[i]);
   }
+  setDoubleParam(asynStatusFeedId_, status->feed);
+  setDoubleParam(asynStatusSpindleId_, status->spindleSpeed);
+  setIntegerParam(asynStatusOvrFeedId_, status->feedOverride);
+  setIntegerParam(asynStatusOvrRapidId_, status->rapidOverride);
+  setIntegerParam(asynStatusOvrSpindleId_, status->spindleOverride);
+  setIntegerParam(asynStatusPlannerId_, status->plannerFill);
+  setIntegerParam(asynStatusRxId_, status->rxFill);
+  setIntegerParam(asynStatusLineQueueId_, status->lineQueueFill);
+  setIntegerParam(asynStatusLineId_, status->lineNumber);
+  setIntegerParam(asynStatusRowId_, status->codeRow);
 }
 
+// One trace record per cycle. Triggers on new ecmc or plugin error and on request over asyn.
+void ecmcGrbl::updateTrace(int ecmcError) {
+  ecmcGrblTraceRecord record;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  bool error = ecmcError || errorCode_;
+  record.flags = 0;
+  if(error) {
+    record.flags |= ECMC_GRBL_TRACE_FLAG_ERROR;
+  }
+  if(((error && !traceErrorOld_) || traceTriggerCmd_) && grblTrace_->trigger()) {
+    record.flags |= ECMC_GRBL_TRACE_FLAG_TRIGGER;
+  }
+  if(grblInitDone_ && ecmcData_.allEnabled) {
+    record.flags |= ECMC_GRBL_TRACE_FLAG_EXECUTE;
+  }
+  traceErrorOld_   = error;
+  traceTriggerCmd_ = 0;
+
+  // Same setpoints as sent to ecmc (see postExeAxis())
+  double position[N_AXIS];
+  if(cfgInterpMode_ == ECMC_GRBL_INTERP_CONTINUOUS) {
+    st_get_continuous_position(position);
+  } else {
+    for(int i = 0; i < N_AXIS; i++) {
+      position[i] = (double)sys_position[i];
+    }
+  }
+  for(int i = 0; i < ECMC_GRBL_TRACE_AXES; i++) {
+    record.setpoint[i] = position[i] / double(settings.steps_per_mm[i]);
+  }
+  for(int i = 0; i < ECMC_GRBL_TRACE_AXES; i++) {
+    record.actual[i] = ecmcData_.axes[i].actpos;
+  }
+
+  record.cycle        = traceCycles_++;
+  record.timeNs       = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  record.spindleSpeed = sys.spindle_speed;
+  record.segment      = st_get_segment_count();
+  record.line         = st_get_line_number();
+  record.state        = sys.state;
+  record.reserved     = 0;
+  grblTrace_->write(&record);
+}
+
+void ecmcGrbl::publishPreview() {
+  grblPreview_->lock();
+  size_t count = grblPreview_->getCount();
+  setIntegerParam(asynPreviewCountId_, (epicsInt32)count);
+  setIntegerParam(asynPreviewPlannedId_, (epicsInt32)grblPreview_->getPlannedCount());
+  doCallbacksFloat64Array((epicsFloat64*)grblPreview_->getX(), count, asynPreviewXId_, 0);
+  doCallbacksFloat64Array((epicsFloat64*)grblPreview_->getY(), count, asynPreviewYId_, 0);
+  doCallbacksFloat64Array((epicsFloat64*)grblPreview_->getZ(), count, asynPreviewZId_, 0);
+  doCallbacksFloat64Array((epicsFloat64*)grblPreview_->getSpeed(), count, asynPreviewSpeedId_, 0);
+  doCallbacksFloat64Array((epicsFloat64*)grblPreview_->getLine(), count, asynPreviewLineId_, 0);
+  grblPreview_->unlock();
+}
+
+// Publish status snapshots of ecmc rt thread (asyn locking and callbacks kept out of rt thread).
+// Parameters only changed since last snapshot trigger callbacks.
+void ecmcGrbl::doStatusWorker() {
+  ecmcGrblStatus status;
+  for(;;) {
+    epicsEventWait(statusEvent_);
+    if(destructs_) {
+      return;
+    }
+    readStatus(&status);
+    bool previewChanged = grblPreview_ && grblPreview_->update(status.codeRow);
+    lock();
+    setStatusParams(&status);
+    if(previewChanged) {
+      publishPreview();
+    }
+    callParamCallbacks();
+    unlock();
+  }
+}
+
+// Setpoints and feed-forward of all axes. Setpoints (and spindle speed) are only written to ecmc when changed.
 void ecmcGrbl::postExeAxes() {
-  postExeAxis(ecmcData_.xAxis,X_AXIS);
-  postExeAxis(ecmcData_.yAxis,Y_AXIS);
-  postExeAxis(ecmcData_.zAxis,Z_AXIS);
+  double position[N_AXIS];
+  double velocity[N_AXIS];
+  double acceleration[N_AXIS];
+  if(cfgInterpMode_ == ECMC_GRBL_INTERP_CONTINUOUS) {
+    st_get_continuous_position(position);
+  } else {
+    for(int i = 0; i < N_AXIS; i++) {
+      position[i] = (double)sys_position[i];
+    }
+  }
 
-  
-  if(ecmcData_.spindleAxis.axisId >= 0) {
-    setAxisTargetVel(ecmcData_.spindleAxis.axisId,(double)sys.spindle_speed);
-    if(sys.spindle_speed!=0) {
-      moveVelocity(cfgSpindleAxisId_,
-                   (double)sys.spindle_speed,
-                   ecmcData_.spindleAxis.acceleration,
-                   ecmcData_.spindleAxis.acceleration);      
+  // Velocity and acceleration feed-forward of current segment
+  st_get_feed_forward(velocity, acceleration);
+
+  for(int i = 0; i < rtAxesCount_; i++) {
+    int slot = rtAxes_[i];
+    if(slot == ECMC_PLUGIN_AXIS_SLOT_SPINDLE) {
+      continue;
+    }
+    ecmcAxisStatusData *axis = &ecmcData_.axes[slot];
+    double stepsPerMM = double(settings.steps_per_mm[slot]);
+    double setpoint   = position[slot] / stepsPerMM;
+    if(setpoint != axis->setpoint) {
+      setAxisExtSetPos(axis->axisId, setpoint);
+      axis->setpoint = setpoint;
     }
+    axis->ffVelocity     = velocity[slot] / stepsPerMM;
+    axis->ffAcceleration = acceleration[slot] / stepsPerMM;
+  }
+
+  ecmcAxisStatusData *spindle = &ecmcData_.axes[ECMC_PLUGIN_AXIS_SLOT_SPINDLE];
+  double speed = (double)sys.spindle_speed;
+  if(spindle->axisId >= 0 && speed != spindle->setpoint) {
+    setAxisTargetVel(spindle->axisId, speed);
+    if(speed != 0) {
+      moveVelocity(spindle->axisId,
+                   speed,
+                   spindle->acceleration,
+                   spindle->acceleration);
+    }
+    spindle->setpoint = speed;
   }
 }
 
@@ -856,6 +1395,7 @@ int ecmcGrbl::setExecute(int exe) {
 
   if(!executeCmd_ && exe) {
     grblCommandBufferIndex_ = 0;
+    grblCodeRowNum_         = 0;
     writerBusy_ = 1;
   }
 
@@ -864,6 +1404,7 @@ int ecmcGrbl::setExecute(int exe) {
 }
 
 int ecmcGrbl::setHalt(int halt) {
+  grbl_context_bind(grblCtx_);
   if(!haltCmd_ && halt) {
     system_set_exec_state_flag(EXEC_FEED_HOLD);
   }
@@ -872,6 +1413,7 @@ int ecmcGrbl::setHalt(int halt) {
 }
 
 int ecmcGrbl::setResume(int resume) {
+  grbl_context_bind(grblCtx_);
   if(!resumeCmd_ && resume) {
    system_set_exec_state_flag(EXEC_CYCLE_START);
   }
@@ -880,6 +1422,7 @@ int ecmcGrbl::setResume(int resume) {
 }
 
 int ecmcGrbl::setReset(int reset) {
+  grbl_context_bind(grblCtx_);
   if(!resetCmd_ && reset) {
     mc_reset();
   }
@@ -889,6 +1432,7 @@ int ecmcGrbl::setReset(int reset) {
 }
 
 int ecmcGrbl::getBusy() {
+  grbl_context_bind(grblCtx_);
   return (getEcmcEpicsIOCState()!=16 && getEcmcEpicsIOCState()!=29) || writerBusy_ || stepperInterruptEnable || !grblInitDone_;
 }
 
@@ -898,7 +1442,21 @@ int ecmcGrbl::getParserBusy() {
 }
 
 int ecmcGrbl::getCodeRowNum() {
-  return grblCommandBufferIndex_;
+  return grblCodeRowNum_;
+}
+
+double ecmcGrbl::getAxisFFVelocity(int grblAxisId) {
+  if(grblAxisId < 0 || grblAxisId >= ECMC_PLUGIN_AXIS_SLOT_SPINDLE) {
+    return 0;
+  }
+  return ecmcData_.axes[grblAxisId].ffVelocity;
+}
+
+double ecmcGrbl::getAxisFFAcceleration(int grblAxisId) {
+  if(grblAxisId < 0 || grblAxisId >= ECMC_PLUGIN_AXIS_SLOT_SPINDLE) {
+    return 0;
+  }
+  return ecmcData_.axes[grblAxisId].ffAcceleration;
 }
 
 int ecmcGrbl::getError() {
@@ -913,23 +1471,173 @@ void ecmcGrbl::resetError() {
   errorCodeOld_ = 0;
 }
 
+asynStatus ecmcGrbl::readInt32(asynUser *pasynUser, epicsInt32 *value) {
+  int function = pasynUser->reason;
+  st_segment_buffer_stats_t segStats;
+
+  if(function == asynRTCyclesId_) {
+    *value = (epicsInt32)rtStats_.cycles;
+  } else if(function == asynRTStepsLastId_) {
+    *value = (epicsInt32)rtStats_.stepsLast;
+  } else if(function == asynRTStepsMaxId_) {
+    *value = (epicsInt32)rtStats_.stepsMax;
+  } else if(function == asynRTSegUnderrunsId_ ||
+            function == asynRTSegHighWaterId_ ||
+            function == asynRTSegLowWaterId_) {
+    grbl_context_bind(grblCtx_);
+    st_get_segment_buffer_stats(&segStats);
+    if(function == asynRTSegUnderrunsId_) {
+      *value = (epicsInt32)segStats.underruns;
+    } else if(function == asynRTSegHighWaterId_) {
+      *value = (epicsInt32)segStats.high_water;
+    } else {
+      *value = (epicsInt32)segStats.low_water;
+    }
+  } else if(function == asynValidateBusyId_) {
+    *value = grblValidator_->busy();
+  } else if(function == asynValidateErrorsId_) {
+    *value = (epicsInt32)grblValidator_->getErrorCount();
+  } else if(function == asynSimulateBusyId_) {
+    *value = grblSimulator_->busy();
+  } else if(function == asynTraceCapturesId_) {
+    *value = grblTrace_ ? (epicsInt32)grblTrace_->getCaptures() : 0;
+  } else if(function == asynTraceLostId_) {
+    *value = grblTrace_ ? (epicsInt32)grblTrace_->getLost() : 0;
+  } else {
+    return asynPortDriver::readInt32(pasynUser, value);
+  }
+  return asynSuccess;
+}
+
+asynStatus ecmcGrbl::readFloat64(asynUser *pasynUser, epicsFloat64 *value) {
+  int function = pasynUser->reason;
+  uint64_t cycles = rtStats_.cycles;
+
+  if(function == asynRTExeTimeMinId_) {
+    *value = rtStats_.exeTimeMinUs;
+  } else if(function == asynRTExeTimeMaxId_) {
+    *value = rtStats_.exeTimeMaxUs;
+  } else if(function == asynRTExeTimeMeanId_) {
+    *value = cycles > 0 ? rtStats_.exeTimeSumUs / cycles : 0;
+  } else if(function == asynRTStepsMeanId_) {
+    *value = cycles > 0 ? (double)rtStats_.stepsSum / cycles : 0;
+  } else if(function == asynSimulateTimeId_) {
+    *value = grblSimulator_->getTime();
+  } else {
+    return asynPortDriver::readFloat64(pasynUser, value);
+  }
+  return asynSuccess;
+}
+
+asynStatus ecmcGrbl::readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                    size_t nElements, size_t *nIn) {
+  int function = pasynUser->reason;
+
+  if(function == asynRTExeTimeHistId_) {
+    size_t count = nElements < ECMC_PLUGIN_RT_HIST_BUCKETS ? nElements : ECMC_PLUGIN_RT_HIST_BUCKETS;
+    memcpy(value, rtStats_.exeTimeHist, count*sizeof(epicsInt32));
+    *nIn = count;
+    return asynSuccess;
+  }
+  if(function == asynValidateRowsId_ || function == asynValidateCodesId_) {
+    std::vector<ecmcGrblValidationError> errors = grblValidator_->getErrors();
+    size_t count = std::min(nElements, errors.size());
+    for(size_t i = 0; i < count; i++) {
+      value[i] = function == asynValidateRowsId_ ? (epicsInt32)errors[i].row : errors[i].code;
+    }
+    *nIn = count;
+    return asynSuccess;
+  }
+  return asynPortDriver::readInt32Array(pasynUser, value, nElements, nIn);
+}
+
+asynStatus ecmcGrbl::readFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
+                                      size_t nElements, size_t *nIn) {
+  int function = pasynUser->reason;
+  const double *data = NULL;
+
+  if(!grblPreview_) {
+    return asynPortDriver::readFloat64Array(pasynUser, value, nElements, nIn);
+  }
+  grblPreview_->lock();
+  if(function == asynPreviewXId_) {
+    data = grblPreview_->getX();
+  } else if(function == asynPreviewYId_) {
+    data = grblPreview_->getY();
+  } else if(function == asynPreviewZId_) {
+    data = grblPreview_->getZ();
+  } else if(function == asynPreviewSpeedId_) {
+    data = grblPreview_->getSpeed();
+  } else if(function == asynPreviewLineId_) {
+    data = grblPreview_->getLine();
+  }
+  if(data) {
+    size_t count = std::min(nElements, grblPreview_->getCount());
+    memcpy(value, data, count*sizeof(epicsFloat64));
+    *nIn = count;
+  }
+  grblPreview_->unlock();
+  if(!data) {
+    return asynPortDriver::readFloat64Array(pasynUser, value, nElements, nIn);
+  }
+  return asynSuccess;
+}
+
+asynStatus ecmcGrbl::writeInt32(asynUser *pasynUser, epicsInt32 value) {
+  int function = pasynUser->reason;
+
+  if(function == asynRTStatsResetId_) {
+    // Executed by ecmc rt thread at next cycle
+    if(value) {
+      rtStatsResetCmd_ = 1;
+    }
+  } else if(function == asynValidateId_) {
+    if(value) {
+      try {
+        validateGCode(false);
+      }
+      catch(std::exception& e) {
+        printf("GRBL: ERROR: %s\n", e.what());
+        return asynError;
+      }
+    }
+  } else if(function == asynSimulateId_) {
+    if(value) {
+      try {
+        simulateGCode("", false);
+      }
+      catch(std::exception& e) {
+        printf("GRBL: ERROR: %s\n", e.what());
+        return asynError;
+      }
+    }
+  } else if(function == asynTraceTriggerId_) {
+    // Executed by ecmc rt thread at next cycle
+    if(value) {
+      if(!grblTrace_) {
+        printf("GRBL: ERROR: Trace not enabled (%s).\n", ECMC_PLUGIN_TRACE_FILE_OPTION_CMD);
+        return asynError;
+      }
+      traceTriggerCmd_ = 1;
+    }
+  }
+  return asynPortDriver::writeInt32(pasynUser, value);
+}
+
 void ecmcGrbl::addCommand(std::string command) {
   if(cfgDbgMode_){
     printf("%s:%s:%d:command %s\n",__FILE__,__FUNCTION__,__LINE__,command.c_str());
   }
 
-    // ignore comments
-  std::string commandStrip = command.substr(0, command.find(ECMC_CONFIG_FILE_COMMENT_CHAR));
-  if (commandStrip.length()==0) {
-    return;
+  // ignores comments. Appended rows are not in the block cache (written as text), the cached rows
+  // are unchanged.
+  if(grblProgram_->addLine(command)) {
+    errorCode_ = ECMC_PLUGIN_LOAD_FILE_ERROR_CODE;
+    throw std::runtime_error("Error: Commands can not be added after a streamed file.");
   }
-
-  epicsMutexLock(grblCommandBufferMutex_);  
-  grblCommandBuffer_.push_back(commandStrip.c_str());
-  epicsMutexUnlock(grblCommandBufferMutex_);
   if(cfgDbgMode_){
-    printf("%s:%s:%d: GRBL: INFO: Buffer size %d\n",
-           __FILE__,__FUNCTION__,__LINE__,grblCommandBuffer_.size());
+    printf("%s:%s:%d: GRBL: INFO: Buffer size %zu\n",
+           __FILE__,__FUNCTION__,__LINE__,grblProgram_->size());
   }
 }
 
@@ -938,9 +1646,7 @@ void ecmcGrbl::loadGCodeFile(std::string fileName, int append) {
     printf("%s:%s:%d: file %s, append %d\n",__FILE__,__FUNCTION__,__LINE__,fileName.c_str(),append);
   }
 
-  std::ifstream file;
-  file.open(fileName);
-  if (!file.good()) {
+  if (access(fileName.c_str(), R_OK) != 0) {
     if(cfgDbgMode_){
       printf("%s:%s:%d: GRBL: ERROR: File not found: %s (0x%x)\n",
              __FILE__,__FUNCTION__,__LINE__,fileName.c_str(),ECMC_PLUGIN_LOAD_FILE_ERROR_CODE);
@@ -950,21 +1656,143 @@ void ecmcGrbl::loadGCodeFile(std::string fileName, int append) {
     return;
   }
   
+  // Program changed
+  grblBlockCache_->clear();
+
   // Clear buffer (since not append)
   if(!append) {
     setExecute(0);
-    epicsMutexLock(grblCommandBufferMutex_);  
-    grblCommandBuffer_.clear();
-    epicsMutexUnlock(grblCommandBufferMutex_);
+    grblProgram_->clear();
   }
 
-  std::string line, lineNoComments;
+  // Map file and index lines
+  int error = grblProgram_->loadFile(fileName.c_str());
+  if (error) {
+    printf("%s:%s:%d: GRBL: ERROR: Failed load file: %s (%s) (0x%x)\n",
+           __FILE__,__FUNCTION__,__LINE__,fileName.c_str(),strerror(error),ECMC_PLUGIN_LOAD_FILE_ERROR_CODE);
+    errorCode_ = ECMC_PLUGIN_LOAD_FILE_ERROR_CODE;
+    throw std::runtime_error("Error: Failed load file.");
+  }
 
-  while (std::getline(file, line)) {
-    if(line.length()>0) {
-      addCommand(line);
-    }
+  if(cfgDbgMode_){
+    printf("%s:%s:%d: GRBL: INFO: Buffer size %zu\n",
+           __FILE__,__FUNCTION__,__LINE__,grblProgram_->size());
+  }
+}
+
+void ecmcGrbl::streamGCodeFile(std::string fileName) {
+  if(cfgDbgMode_){
+    printf("%s:%s:%d: file %s\n",__FILE__,__FUNCTION__,__LINE__,fileName.c_str());
+  }
+
+  // Clear buffer (always, nothing can be added after a streamed file)
+  setExecute(0);
+  grblBlockCache_->clear();
+
+  // Map file, lines are indexed while executing
+  int error = grblProgram_->streamFile(fileName.c_str(), ECMC_PLUGIN_GRBL_STREAM_WINDOW_LINES);
+  if (error) {
+    printf("%s:%s:%d: GRBL: ERROR: Failed load file: %s (%s) (0x%x)\n",
+           __FILE__,__FUNCTION__,__LINE__,fileName.c_str(),strerror(error),ECMC_PLUGIN_LOAD_FILE_ERROR_CODE);
+    errorCode_ = ECMC_PLUGIN_LOAD_FILE_ERROR_CODE;
+    throw std::runtime_error("Error: Failed load file.");
+  }
+}
+
+void ecmcGrbl::compileGCode(std::string cacheDir) {
+  if(cfgDbgMode_){
+    printf("%s:%s:%d: cache dir %s\n",__FILE__,__FUNCTION__,__LINE__,cacheDir.c_str());
+  }
+
+  // Parse program once (or map cache of earlier compile of same program)
+  bool hit = false;
+  int error = grblBlockCache_->compile(grblProgram_, cacheDir.c_str(), &hit);
+  if (error == ENOTSUP) {
+    errorCode_ = ECMC_PLUGIN_LOAD_FILE_ERROR_CODE;
+    throw std::runtime_error("Error: Streamed files can not be compiled.");
+  }
+  if (error) {
+    printf("%s:%s:%d: GRBL: ERROR: Failed compile program to %s (%s) (0x%x)\n",
+           __FILE__,__FUNCTION__,__LINE__,grblBlockCache_->getFileName().c_str(),
+           strerror(error),ECMC_PLUGIN_LOAD_FILE_ERROR_CODE);
+    errorCode_ = ECMC_PLUGIN_LOAD_FILE_ERROR_CODE;
+    throw std::runtime_error("Error: Failed compile program.");
+  }
+
+  if(cfgDbgMode_){
+    printf("%s:%s:%d: GRBL: INFO: Block cache %s (%s, %zu lines)\n",
+           __FILE__,__FUNCTION__,__LINE__,grblBlockCache_->getFileName().c_str(),
+           hit ? "existing" : "compiled",grblBlockCache_->size());
+  }
+}
+
+// Check program offline (see ecmcGrblValidator.h). If wait, the result is printed and the number of
+// errors is returned, else validation continues in background (result over asyn).
+size_t ecmcGrbl::validateGCode(bool wait) {
+  if(executeCmd_) {
+    throw std::runtime_error("Error: Program can not be validated while executing.");
+  }
+
+  int error = grblValidator_->start(grblProgram_);
+  if (error == EBUSY) {
+    throw std::runtime_error("Error: Validation already running.");
+  }
+  if (error == ENOTSUP) {
+    throw std::runtime_error("Error: Streamed files can not be validated.");
+  }
+  if (error) {
+    throw std::runtime_error("Error: Failed start validation.");
+  }
+  if(!wait) {
+    return 0;
+  }
+
+  grblValidator_->wait();
+  std::vector<ecmcGrblValidationError> errors = grblValidator_->getErrors();
+  for(ecmcGrblValidationError &validationError : errors) {
+    printf("GRBL: ERROR: Validation failed for code row %u (error:%d)\n",
+           validationError.row, validationError.code);
+  }
+  printf("GRBL: INFO: Validated %zu code rows, %zu errors (%zu '$' commands not validated)\n",
+         grblValidator_->getLines(), errors.size(), grblValidator_->getSkipped());
+  return errors.size();
+}
+
+// Simulate program without ecmc axes (see ecmcGrblSimulator.h). The trajectory is written to
+// dumpFile if not empty. If wait, the result is printed and the simulated time [s] is returned,
+// else simulation continues in background (result over asyn).
+double ecmcGrbl::simulateGCode(std::string dumpFile, bool wait) {
+  if(executeCmd_) {
+    throw std::runtime_error("Error: Program can not be simulated while executing.");
+  }
+
+  int error = grblSimulator_->start(grblProgram_, dumpFile.c_str());
+  if (error == EBUSY) {
+    throw std::runtime_error("Error: Simulation already running.");
   }
+  if (error == ENOTSUP) {
+    throw std::runtime_error("Error: Streamed files can not be simulated.");
+  }
+  if (error) {
+    throw std::runtime_error("Error: Failed start simulation (" + std::string(strerror(error)) + ").");
+  }
+  if(!wait) {
+    return 0;
+  }
+
+  grblSimulator_->wait();
+  if(grblSimulator_->getErrorCode()) {
+    printf("GRBL: ERROR: Simulation stopped at code row %zu (error:%d)\n",
+           grblSimulator_->getErrorRow(), grblSimulator_->getErrorCode());
+  }
+  if(grblSimulator_->getAlarmCode()) {
+    printf("GRBL: ERROR: Simulation stopped at code row %zu (ALARM:%d)\n",
+           grblSimulator_->getErrorRow(), grblSimulator_->getAlarmCode());
+  }
+  printf("GRBL: INFO: Simulated %zu code rows, time %.3fs (%zu samples of %.3fms)\n",
+         grblSimulator_->getLines(), grblSimulator_->getTime(), grblSimulator_->getSamples(),
+         exeSampleTimeMs_);
+  return grblSimulator_->getTime();
 }
 
 void  ecmcGrbl::addConfig(std::string command) {
@@ -1021,7 +1849,7 @@ void ecmcGrbl::loadConfigFile(std::string fileName, int append) {
     throw std::runtime_error("Error: File not found.");
     return;
   }
-  
+
   // Clear buffer (since not append)
   if(!append) {
     setExecute(0);
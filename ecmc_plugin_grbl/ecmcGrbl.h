@@ -18,29 +18,40 @@
 
 #include "inttypes.h"
 #include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <vector>
+#include <deque>
 #include <string.h>
 
+class ecmcGrblProgram;
+class ecmcGrblBlockCache;
+class ecmcGrblValidator;
+class ecmcGrblSimulator;
+class ecmcGrblPreview;
+class ecmcGrblTrace;
+
 typedef struct {
   bool        limitBwd;
   bool        limitFwd;
   bool        enabled;
-  int         error;
   double      acceleration; // only spindle
-  double      actpos;
+  double      actpos;       // read only when needed (sync or trace)
   int         axisId;
   int         trajSource;
+  double      setpoint;       // last written to ecmc [mm] (spindle [rpm]), NAN forces write
+  double      ffVelocity;     // feed-forward from grbl [mm/s]
+  double      ffAcceleration; // feed-forward from grbl [mm/s^2]
+  bool        sync;           // position synced from ecmc last cycle (disabled or internal source)
 } ecmcAxisStatusData;
 
 typedef struct {
-  ecmcAxisStatusData  xAxis;
-  ecmcAxisStatusData  yAxis;
-  ecmcAxisStatusData  zAxis;
-  ecmcAxisStatusData  spindleAxis;
+  ecmcAxisStatusData  axes[ECMC_PLUGIN_AXIS_SLOTS];  // X, Y, Z (grbl axis index) and spindle
   int error;
   int errorOld;
   bool allEnabled;
@@ -48,6 +59,39 @@ typedef struct {
   bool allLimitsOKOld;
 } ecmcStatusData;
 
+// Realtime execution statistics (written by ecmc rt thread only)
+typedef struct {
+  double      exeTimeMinUs;
+  double      exeTimeMaxUs;
+  double      exeTimeSumUs;
+  epicsInt32  exeTimeHist[ECMC_PLUGIN_RT_HIST_BUCKETS];
+  uint64_t    cycles;
+  uint32_t    stepsLast;
+  uint32_t    stepsMax;
+  uint64_t    stepsSum;
+} ecmcGrblRTStats;
+
+// Realtime status snapshot (written by ecmc rt thread, published by status thread)
+typedef struct {
+  int         state;          // ECMC_PLUGIN_GRBL_STATE_*
+  int         subState;       // Hold:<n>/Door:<n> of '?' report, else 0
+  double      mpos[ECMC_PLUGIN_STATUS_AXES];  // machine position [mm]
+  double      wpos[ECMC_PLUGIN_STATUS_AXES];  // work position [mm]
+  double      feed;           // [mm/min]
+  double      spindleSpeed;   // [rpm]
+  int         feedOverride;   // [%]
+  int         rapidOverride;  // [%]
+  int         spindleOverride;// [%]
+  int         plannerFill;    // blocks in planner buffer
+  int         rxFill;         // bytes in serial rx buffer
+  int         lineQueueFill;  // lines in line queue
+  int         lineNumber;     // g-code line number (N) of executing block
+  int         codeRow;        // oldest code row not yet acknowledged by grbl
+} ecmcGrblStatus;
+
+// Per object grbl state (see grbl/grbl_context.h)
+struct grbl_context;
+
 enum grblReplyType {
   ECMC_GRBL_REPLY_START = 0,
   ECMC_GRBL_REPLY_OK = 1,
@@ -55,6 +99,11 @@ enum grblReplyType {
   ECMC_GRBL_REPLY_NON_PROTOCOL = 3
 };
 
+enum grblInterpMode {
+  ECMC_GRBL_INTERP_STEP = 0,        // Setpoints from emulated steps (sys_position)
+  ECMC_GRBL_INTERP_CONTINUOUS = 1   // Setpoints interpolated from segment velocity profile
+};
+
 class ecmcGrbl : public asynPortDriver {
  public:
 
@@ -67,14 +116,20 @@ class ecmcGrbl : public asynPortDriver {
   */
   ecmcGrbl(char*  configStr,
            char*  portName,
-           double exeSampelTimeMs);
+           double exeSampelTimeMs,
+           int    index);
   ~ecmcGrbl();
 
   void                     doMainWorker();     // Simulated grbl main.c
   void                     doWriteWorker();    // Simulated grbl client
+  void                     doStatusWorker();   // Publish realtime status
   void                     addCommand(std::string command);
   void                     addConfig(std::string command);
   void                     loadGCodeFile(std::string filename, int append);
+  void                     streamGCodeFile(std::string filename);
+  void                     compileGCode(std::string cacheDir);
+  size_t                   validateGCode(bool wait);
+  double                   simulateGCode(std::string dumpFile, bool wait);
   void                     loadConfigFile(std::string fileName, int append);
   int                      enterRT();
   int                      grblRTexecute(int ecmcError);              //ecmc rt thread (main)
@@ -89,23 +144,44 @@ class ecmcGrbl : public asynPortDriver {
   int                      getError();
   void                     resetError();
   int                      getAllAxesEnabled();
+  void                     resetRTStats();
+  double                   getAxisFFVelocity(int grblAxisId);
+  double                   getAxisFFAcceleration(int grblAxisId);
+  virtual asynStatus       readInt32(asynUser *pasynUser, epicsInt32 *value);
+  virtual asynStatus       readFloat64(asynUser *pasynUser, epicsFloat64 *value);
+  virtual asynStatus       readInt32Array(asynUser *pasynUser, epicsInt32 *value,
+                                          size_t nElements, size_t *nIn);
+  virtual asynStatus       readFloat64Array(asynUser *pasynUser, epicsFloat64 *value,
+                                            size_t nElements, size_t *nIn);
+  virtual asynStatus       writeInt32(asynUser *pasynUser, epicsInt32 value);
 
  private:
   void                     parseConfigStr(char *configStr);           // constructor (iocsh thread)
+  void                     initAsyn();                                // constructor (iocsh thread)
+  int                      createAsynParam(const char *name,
+                                           asynParamType type);       // constructor (iocsh thread)
+  int                      grblRTexecuteCycle(int ecmcError,
+                                              uint32_t *steps);       // ecmc rt thread
+  void                     updateRTStats(double exeTimeUs,
+                                         uint32_t steps);             // ecmc rt thread
   void                     readEcmcStatus(int ecmcError);             // ecmc rt thread
+  void                     updateStatus();                            // ecmc rt thread
+  void                     readStatus(ecmcGrblStatus *status);        // status thread
+  void                     setStatusParams(ecmcGrblStatus *status);   // status thread (port locked)
+  void                     publishPreview();                          // status thread (port locked)
+  void                     updateTrace(int ecmcError);                // ecmc rt thread
   void                     preExeAxes();                              // ecmc rt thread
   void                     postExeAxes();                             // ecmc rt thread
-  void                     preExeAxis(ecmcAxisStatusData ecmcAxisData, int grblAxisId); //ecmc rt thread
-  void                     postExeAxis(ecmcAxisStatusData ecmcAxisData, int grblAxisId); //ecmc rt thread
   void                     giveControlToEcmcIfNeeded();                //ecmc rt thread
-  void                     syncAxisPosition(ecmcAxisStatusData ecmcAxisData, int grblAxisId); //ecmc rt thread
+  bool                     syncAxisPosition(ecmcAxisStatusData *ecmcAxisData, int grblAxisId); //ecmc rt thread
   bool                     getEcmcAxisEnabled(int ecmcAxisId);        //ecmc rt thread
   double                   getEcmcAxisActPos(int axis);               //ecmc rt thread
   int                      getEcmcAxisTrajSource(int ecmcAxisId);     //ecmc rt thread
   bool                     getEcmcAxisLimitBwd(int ecmcAxisId);       //ecmc rt thread
   bool                     getEcmcAxisLimitFwd(int ecmcAxisId);       //ecmc rt thread
   grblReplyType            grblReadReply();                           // doWriteWorker thread
-  void                     grblWriteCommand(std::string command);     // doWriteWorker thread
+  bool                     grblReplyAvailable();                      // doWriteWorker thread
+  void                     grblWriteCommand(std::string_view command); // doWriteWorker thread
   bool                     applyConfigsSuccess();                     // doWriteWorker thread
   bool                     WriteGCodeSuccess();                       // doWriteWorker thread
   bool                     autoEnableAxesSuccess();                   // doWriteWorker thread
@@ -117,7 +193,16 @@ class ecmcGrbl : public asynPortDriver {
   int                      cfgSpindleAxisId_;
   int                      cfgAutoEnable_;
   int                      cfgAutoStart_;
+  grblInterpMode           cfgInterpMode_;
+  int                      cfgPlannerBufferSize_;
+  int                      cfgStatusDecimation_;
+  int                      cfgPreviewPoints_;
+  std::string              cfgTraceFile_;
+  int                      cfgTracePre_;
+  int                      cfgTracePost_;
   int                      destructs_;
+  int                      index_;          // Object index (0 for first object)
+  struct grbl_context*     grblCtx_;
   int                      executeCmd_;
   int                      resetCmd_;
   int                      haltCmd_;
@@ -128,9 +213,20 @@ class ecmcGrbl : public asynPortDriver {
   int                      grblInitDone_;
   std::vector<std::string> grblConfigBuffer_;
   epicsMutexId             grblConfigBufferMutex_;
-  std::vector<std::string> grblCommandBuffer_;
+  ecmcGrblProgram*         grblProgram_;    // g-code program
+  ecmcGrblBlockCache*      grblBlockCache_; // pre-compiled blocks of grblProgram_
+  ecmcGrblValidator*       grblValidator_;  // offline check of grblProgram_
+  ecmcGrblSimulator*       grblSimulator_;  // machining time estimate of grblProgram_
+  ecmcGrblPreview*         grblPreview_;    // toolpath look-ahead (NULL if disabled)
+  ecmcGrblTrace*           grblTrace_;      // rt trace (NULL if disabled)
   unsigned int             grblCommandBufferIndex_;
-  epicsMutexId             grblCommandBufferMutex_;
+  unsigned int             grblCodeRowNum_;            // Oldest code row not yet acknowledged by grbl
+  std::deque<unsigned int> grblOutstandingLines_;      // Code rows written to grbl waiting for reply
+  char                     grblReplyData_[ECMC_PLUGIN_GRBL_REPLY_BUFFER_SIZE]; // Bulk read from grbl tx buffer
+  size_t                   grblReplyDataPos_;
+  size_t                   grblReplyDataLen_;
+  char                     grblReplyLine_[ECMC_PLUGIN_GRBL_REPLY_BUFFER_SIZE]; // Reply line being assembled
+  size_t                   grblReplyLineLen_;
   bool                     autoStartDone_;
   int                      grblExeCycles_;  
   double                   timeToNextExeMs_;
@@ -139,6 +235,62 @@ class ecmcGrbl : public asynPortDriver {
   int                      cfgAutoEnableTimeOutSecs_;
   int                      unrecoverableError_;
   ecmcStatusData           ecmcData_;
+  int                      rtAxes_[ECMC_PLUGIN_AXIS_SLOTS];  // Configured axis slots (resolved in enterRT())
+  int                      rtAxesCount_;
+  ecmcGrblRTStats          rtStats_;
+  int                      rtStatsResetCmd_;
+  int                      statusCycles_;   // ecmc cycles since last status snapshot
+  ecmcGrblStatus           status_;         // guarded by statusSeq_ (seqlock, odd while writing)
+  std::atomic<uint32_t>    statusSeq_;
+  epicsEventId             statusEvent_;    // new snapshot available
+  uint64_t                 traceCycles_;
+  bool                     traceErrorOld_;
+  int                      traceTriggerCmd_;
+  int                      asynRTExeTimeMinId_;
+  int                      asynRTExeTimeMaxId_;
+  int                      asynRTExeTimeMeanId_;
+  int                      asynRTExeTimeHistId_;
+  int                      asynRTCyclesId_;
+  int                      asynRTStepsLastId_;
+  int                      asynRTStepsMaxId_;
+  int                      asynRTStepsMeanId_;
+  int                      asynRTSegUnderrunsId_;
+  int                      asynRTSegHighWaterId_;
+  int                      asynRTSegLowWaterId_;
+  int                      asynRTStatsResetId_;
+  int                      asynValidateId_;
+  int                      asynValidateBusyId_;
+  int                      asynValidateErrorsId_;
+  int                      asynValidateRowsId_;
+  int                      asynValidateCodesId_;
+  int                      asynSimulateId_;
+  int                      asynSimulateBusyId_;
+  int                      asynSimulateTimeId_;
+  int                      asynStatusStateId_;
+  int                      asynStatusStateNameId_;
+  int                      asynStatusSubStateId_;
+  int                      asynStatusMPosId_[ECMC_PLUGIN_STATUS_AXES];
+  int                      asynStatusWPosId_[ECMC_PLUGIN_STATUS_AXES];
+  int                      asynStatusFeedId_;
+  int                      asynStatusSpindleId_;
+  int                      asynStatusOvrFeedId_;
+  int                      asynStatusOvrRapidId_;
+  int                      asynStatusOvrSpindleId_;
+  int                      asynStatusPlannerId_;
+  int                      asynStatusRxId_;
+  int                      asynStatusLineQueueId_;
+  int                      asynStatusLineId_;
+  int                      asynStatusRowId_;
+  int                      asynPreviewXId_;
+  int                      asynPreviewYId_;
+  int                      asynPreviewZId_;
+  int                      asynPreviewSpeedId_;
+  int                      asynPreviewLineId_;
+  int                      asynPreviewCountId_;
+  int                      asynPreviewPlannedId_;
+  int                      asynTraceTriggerId_;
+  int                      asynTraceCapturesId_;
+  int                      asynTraceLostId_;
 
 };
 
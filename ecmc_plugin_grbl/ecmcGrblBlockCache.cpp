@@ -0,0 +1,210 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblBlockCache.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include "ecmcGrblBlockCache.h"
+#include "ecmcGrblProgram.h"
+#include "ecmcGrblDefs.h"
+#include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ecmcGrblBlockCache::ecmcGrblBlockCache() {
+  if(!(cacheMutex_ = epicsMutexCreate())) {
+    throw std::runtime_error("GRBL: ERROR: Failed create mutex for block cache.");
+  }
+  data_     = NULL;
+  dataSize_ = 0;
+  records_  = NULL;
+  lines_    = 0;
+}
+
+ecmcGrblBlockCache::~ecmcGrblBlockCache() {
+  clear();
+  epicsMutexDestroy(cacheMutex_);
+}
+
+// FNV-1a hash of all program lines (program locked)
+uint64_t ecmcGrblBlockCache::hashProgram(ecmcGrblProgram *program) {
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i = 0; i < program->size(); i++) {
+    std::string_view line = program->getLine(i);
+    for(char c : line) {
+      hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+    }
+    hash = (hash ^ (uint8_t)'\n') * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Parse all lines and write cache file (program locked). Returns 0 or errno.
+int ecmcGrblBlockCache::writeFile(ecmcGrblProgram *program, uint64_t hash, const char *fileName) {
+  // Write to temporary file and rename, so a cache file is always complete
+  std::string tempFileName = std::string(fileName) + "." + std::to_string(getpid());
+  FILE *file = fopen(tempFileName.c_str(), "wb");
+  if(!file) {
+    return errno;
+  }
+
+  cacheHeader header;
+  memset(&header, 0, sizeof(header));
+  static_assert(sizeof(ECMC_PLUGIN_GRBL_BLOCK_CACHE_MAGIC) == sizeof(header.magic),
+                "Block cache magic must fill the header magic (including terminating zero)");
+  memcpy(header.magic, ECMC_PLUGIN_GRBL_BLOCK_CACHE_MAGIC, sizeof(ECMC_PLUGIN_GRBL_BLOCK_CACHE_MAGIC));
+  header.version    = ECMC_PLUGIN_GRBL_BLOCK_CACHE_VERSION;
+  header.recordSize = sizeof(cacheRecord);
+  header.hash       = hash;
+  header.lines      = program->size();
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  char filtered[LINE_BUFFER_SIZE];
+  cacheRecord record;
+  for(size_t i = 0; ok && i < program->size(); i++) {
+    std::string_view line = program->getLine(i);
+    memset(&record, 0, sizeof(record));
+    record.kind = ECMC_PLUGIN_GRBL_BLOCK_CACHE_TEXT;
+
+    // Same filtering and dispatch as the grbl line queue (see protocol_execute_line())
+    uint8_t overflow = ecmc_filter_line(filtered, line.data(), line.length());
+    if(!overflow && filtered[0] != '$' && filtered[0] != '0' && strlen(filtered) > 1 &&
+       gc_parse_line(filtered, &record.block) == STATUS_OK) {
+      record.kind = ECMC_PLUGIN_GRBL_BLOCK_CACHE_PARSED;
+    }
+    ok = fwrite(&record, sizeof(record), 1, file) == 1;
+  }
+
+  int error = ok ? 0 : errno;
+  if(fclose(file) != 0 && !error) {
+    error = errno;
+  }
+  if(!error && rename(tempFileName.c_str(), fileName) != 0) {
+    error = errno;
+  }
+  if(error) {
+    unlink(tempFileName.c_str());
+  }
+  return error;
+}
+
+// Map cache file (cache locked). Returns 0, errno or EINVAL if the file does not match.
+int ecmcGrblBlockCache::mapFile(const char *fileName, uint64_t hash, size_t lines) {
+  int fd = open(fileName, O_RDONLY);
+  if(fd < 0) {
+    return errno;
+  }
+
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0) {
+    int error = errno;
+    close(fd);
+    return error;
+  }
+
+  size_t expectedSize = sizeof(cacheHeader) + lines * sizeof(cacheRecord);
+  if((size_t)fileStat.st_size != expectedSize) {
+    close(fd);
+    return EINVAL;
+  }
+
+  void *data = mmap(NULL, expectedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  int error = errno;
+  close(fd);  // mapping stays valid
+  if(data == MAP_FAILED) {
+    return error;
+  }
+
+  const cacheHeader *header = (const cacheHeader*)data;
+  if(memcmp(header->magic, ECMC_PLUGIN_GRBL_BLOCK_CACHE_MAGIC, sizeof(header->magic)) ||
+     header->version != ECMC_PLUGIN_GRBL_BLOCK_CACHE_VERSION ||
+     header->recordSize != sizeof(cacheRecord) ||
+     header->hash != hash || header->lines != lines) {
+    munmap(data, expectedSize);
+    return EINVAL;
+  }
+
+  madvise(data, expectedSize, MADV_SEQUENTIAL);
+  data_     = (const char*)data;
+  dataSize_ = expectedSize;
+  records_  = (const cacheRecord*)(data_ + sizeof(cacheHeader));
+  lines_    = lines;
+  return 0;
+}
+
+int ecmcGrblBlockCache::compile(ecmcGrblProgram *program, const char *cacheDir, bool *hit) {
+  *hit = false;
+  clear();
+
+  program->lock();
+  if(program->isStreamed()) {
+    program->unlock();
+    return ENOTSUP;
+  }
+
+  uint64_t hash = hashProgram(program);
+  char hashStr[17];
+  snprintf(hashStr, sizeof(hashStr), "%016llx", (unsigned long long)hash);
+  std::string fileName = std::string(cacheDir) + "/" + hashStr + ECMC_PLUGIN_GRBL_BLOCK_CACHE_FILE_EXT;
+
+  lock();
+  fileName_ = fileName;
+  int error = mapFile(fileName.c_str(), hash, program->size());
+  if(!error) {
+    *hit = true;
+  } else {
+    error = writeFile(program, hash, fileName.c_str());
+    if(!error) {
+      error = mapFile(fileName.c_str(), hash, program->size());
+    }
+  }
+  unlock();
+  program->unlock();
+  return error;
+}
+
+void ecmcGrblBlockCache::clear() {
+  lock();
+  if(data_) {
+    munmap((void*)data_, dataSize_);
+  }
+  data_     = NULL;
+  dataSize_ = 0;
+  records_  = NULL;
+  lines_    = 0;
+  unlock();
+}
+
+size_t ecmcGrblBlockCache::size() {
+  return lines_;
+}
+
+const gc_parsed_line_t* ecmcGrblBlockCache::getBlock(size_t index) {
+  if(index >= lines_ || records_[index].kind != ECMC_PLUGIN_GRBL_BLOCK_CACHE_PARSED) {
+    return NULL;
+  }
+  return &records_[index].block;
+}
+
+void ecmcGrblBlockCache::lock() {
+  epicsMutexLock(cacheMutex_);
+}
+
+void ecmcGrblBlockCache::unlock() {
+  epicsMutexUnlock(cacheMutex_);
+}
+
+std::string ecmcGrblBlockCache::getFileName() {
+  return fileName_;
+}
@@ -0,0 +1,86 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblBlockCache.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_BLOCK_CACHE_H_
+#define ECMC_GRBL_BLOCK_CACHE_H_
+
+#include <epicsMutex.h>
+#include <string>
+#include <stdint.h>
+
+extern "C" {
+#include "grbl.h"
+}
+
+class ecmcGrblProgram;
+
+// Pre-compiled g-code blocks.
+// Each line of a program is parsed once (gc_parse_line()) and the parsed blocks are stored in a
+// binary cache file named by a hash of the program text (<cacheDir>/<hash>.grblblk). Later runs of
+// the same program map the file and hand the parsed blocks directly to grbl, so the text is not
+// parsed again. Error-checking and execution (gc_execute_parsed_line()) depend on the machine
+// state (work offsets, position, modes) and are still done when the block is executed.
+// Lines that are not plain g-code ('$' commands, lines with parse errors, overflow, empty lines)
+// are not cached and are sent as text.
+// The cache file is rebuilt if the program, the record layout (grbl build options) or the cache
+// version differs.
+class ecmcGrblBlockCache {
+ public:
+  ecmcGrblBlockCache();
+  ~ecmcGrblBlockCache();
+
+  // Map the cache of the program in cacheDir, compile and write it if needed.
+  // hit is set to true if an existing cache file was used.
+  // Returns 0, ENOTSUP for a streamed program or errno if the cache file could not be written/mapped.
+  int                     compile(ecmcGrblProgram *program, const char *cacheDir, bool *hit);
+
+  // Unmap cache (must be called when the program changes)
+  void                    clear();
+
+  // Number of lines in cache (0 if no cache)
+  size_t                  size();
+
+  // Parsed block of line at index, NULL if not cached (send text). Cache must be locked while
+  // the block is used.
+  const gc_parsed_line_t* getBlock(size_t index);
+  void                    lock();
+  void                    unlock();
+
+  // Cache file of last compile()
+  std::string             getFileName();
+
+ private:
+  typedef struct {
+    char                  magic[8];
+    uint32_t              version;
+    uint32_t              recordSize;
+    uint64_t              hash;
+    uint64_t              lines;
+  } cacheHeader;
+
+  typedef struct {
+    uint32_t              kind;   // ECMC_GRBL_BLOCK_CACHE_TEXT/PARSED
+    gc_parsed_line_t      block;
+  } cacheRecord;
+
+  static uint64_t         hashProgram(ecmcGrblProgram *program);
+  static int              writeFile(ecmcGrblProgram *program, uint64_t hash, const char *fileName);
+  int                     mapFile(const char *fileName, uint64_t hash, size_t lines);
+
+  epicsMutexId            cacheMutex_;
+  const char             *data_;     // Mapped cache file
+  size_t                  dataSize_;
+  const cacheRecord      *records_;
+  size_t                  lines_;
+  std::string             fileName_;
+};
+
+#endif  /* ECMC_GRBL_BLOCK_CACHE_H_ */
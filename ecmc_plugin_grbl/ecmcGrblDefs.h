@@ -21,8 +21,106 @@
 #define ECMC_PLUGIN_SPINDLE_AXIS_ID_OPTION_CMD "SPINDLE_AXIS="
 #define ECMC_PLUGIN_AUTO_ENABLE_AT_START_OPTION_CMD "AUTO_ENABLE="
 #define ECMC_PLUGIN_AUTO_START_OPTION_CMD "AUTO_START="
+#define ECMC_PLUGIN_INTERP_MODE_OPTION_CMD "INTERP_MODE="
+#define ECMC_PLUGIN_PLANNER_BUFFER_SIZE_OPTION_CMD "PLANNER_BUFFER_SIZE="
+#define ECMC_PLUGIN_STATUS_DECIMATION_OPTION_CMD "STATUS_DECIMATION="
+#define ECMC_PLUGIN_PREVIEW_POINTS_OPTION_CMD "PREVIEW_POINTS="
+#define ECMC_PLUGIN_TRACE_FILE_OPTION_CMD "TRACE_FILE="
+#define ECMC_PLUGIN_TRACE_PRE_OPTION_CMD "TRACE_PRE="
+#define ECMC_PLUGIN_TRACE_POST_OPTION_CMD "TRACE_POST="
+
+// Interpolation modes (ECMC_PLUGIN_INTERP_MODE_OPTION_CMD)
+#define ECMC_PLUGIN_INTERP_MODE_STEP_STR "STEP"
+#define ECMC_PLUGIN_INTERP_MODE_CONTINUOUS_STR "CONTINUOUS"
 
 #define ECMC_PLUGIN_ASYN_PREFIX          "plugin.grbl"
+
+// Asyn parameters (prefixed with ECMC_PLUGIN_ASYN_PREFIX)
+#define ECMC_PLUGIN_ASYN_RT_EXE_TIME_MIN   "rt.exetime.min"     // [us]
+#define ECMC_PLUGIN_ASYN_RT_EXE_TIME_MAX   "rt.exetime.max"     // [us]
+#define ECMC_PLUGIN_ASYN_RT_EXE_TIME_MEAN  "rt.exetime.mean"    // [us]
+#define ECMC_PLUGIN_ASYN_RT_EXE_TIME_HIST  "rt.exetime.hist"    // log2 buckets [us]
+#define ECMC_PLUGIN_ASYN_RT_CYCLES         "rt.cycles"
+#define ECMC_PLUGIN_ASYN_RT_STEPS_LAST     "rt.steps.last"      // step events last cycle
+#define ECMC_PLUGIN_ASYN_RT_STEPS_MAX      "rt.steps.max"       // step events max per cycle
+#define ECMC_PLUGIN_ASYN_RT_STEPS_MEAN     "rt.steps.mean"      // step events mean per cycle
+#define ECMC_PLUGIN_ASYN_RT_SEG_UNDERRUNS  "rt.segbuff.underruns"
+#define ECMC_PLUGIN_ASYN_RT_SEG_HIGH_WATER "rt.segbuff.highwater"
+#define ECMC_PLUGIN_ASYN_RT_SEG_LOW_WATER  "rt.segbuff.lowwater"
+#define ECMC_PLUGIN_ASYN_RT_STATS_RESET    "rt.reset"
+#define ECMC_PLUGIN_ASYN_VALIDATE          "validate"           // write 1 to start validation
+#define ECMC_PLUGIN_ASYN_VALIDATE_BUSY     "validate.busy"
+#define ECMC_PLUGIN_ASYN_VALIDATE_ERRORS   "validate.errors"    // number of errors
+#define ECMC_PLUGIN_ASYN_VALIDATE_ROWS     "validate.error.rows"  // code rows of errors
+#define ECMC_PLUGIN_ASYN_VALIDATE_CODES    "validate.error.codes" // grbl error codes
+#define ECMC_PLUGIN_ASYN_SIMULATE          "simulate"           // write 1 to start simulation
+#define ECMC_PLUGIN_ASYN_SIMULATE_BUSY     "simulate.busy"
+#define ECMC_PLUGIN_ASYN_SIMULATE_TIME     "simulate.time"      // simulated time [s]
+#define ECMC_PLUGIN_ASYN_STATUS_STATE      "status.state"       // ECMC_PLUGIN_GRBL_STATE_*
+#define ECMC_PLUGIN_ASYN_STATUS_STATE_NAME "status.state.name"  // same text as in '?' report
+#define ECMC_PLUGIN_ASYN_STATUS_SUBSTATE   "status.substate"    // Hold:<n>/Door:<n>
+#define ECMC_PLUGIN_ASYN_STATUS_MPOS       "status.mpos"        // .x/.y/.z [mm]
+#define ECMC_PLUGIN_ASYN_STATUS_WPOS       "status.wpos"        // .x/.y/.z [mm]
+#define ECMC_PLUGIN_ASYN_STATUS_FEED       "status.feed"        // [mm/min]
+#define ECMC_PLUGIN_ASYN_STATUS_SPINDLE    "status.spindle"     // [rpm]
+#define ECMC_PLUGIN_ASYN_STATUS_OVR_FEED   "status.ovr.feed"    // [%]
+#define ECMC_PLUGIN_ASYN_STATUS_OVR_RAPID  "status.ovr.rapid"   // [%]
+#define ECMC_PLUGIN_ASYN_STATUS_OVR_SPINDLE "status.ovr.spindle" // [%]
+#define ECMC_PLUGIN_ASYN_STATUS_PLANNER    "status.planner.fill" // blocks
+#define ECMC_PLUGIN_ASYN_STATUS_RX         "status.rx.fill"     // bytes
+#define ECMC_PLUGIN_ASYN_STATUS_LINE_QUEUE "status.linequeue.fill" // lines
+#define ECMC_PLUGIN_ASYN_STATUS_LINE       "status.line"        // g-code line number (N) executing
+#define ECMC_PLUGIN_ASYN_STATUS_ROW        "status.row"         // code row (grbl_get_code_row_num())
+#define ECMC_PLUGIN_ASYN_PREVIEW_X         "preview.x"          // [mm]
+#define ECMC_PLUGIN_ASYN_PREVIEW_Y         "preview.y"          // [mm]
+#define ECMC_PLUGIN_ASYN_PREVIEW_Z         "preview.z"          // [mm]
+#define ECMC_PLUGIN_ASYN_PREVIEW_SPEED     "preview.speed"      // entry speed [mm/min], -1 not planned
+#define ECMC_PLUGIN_ASYN_PREVIEW_LINE      "preview.line"       // g-code line number (N)
+#define ECMC_PLUGIN_ASYN_PREVIEW_COUNT     "preview.count"      // points
+#define ECMC_PLUGIN_ASYN_PREVIEW_PLANNED   "preview.planned"    // points from planner buffer
+#define ECMC_PLUGIN_ASYN_TRACE_TRIGGER     "trace.trigger"      // write 1 to capture trace window
+#define ECMC_PLUGIN_ASYN_TRACE_CAPTURES    "trace.captures"     // trace files written
+#define ECMC_PLUGIN_ASYN_TRACE_LOST        "trace.lost"         // records lost
+
+// Number of buckets in rt execution time histogram. Bucket 0 counts times below 1us,
+// bucket n times in [2^(n-1), 2^n) us and the last bucket all longer times.
+#define ECMC_PLUGIN_RT_HIST_BUCKETS 16
+
+// Realtime status published as asyn parameters every ECMC_PLUGIN_STATUS_DECIMATION_OPTION_CMD ecmc cycles
+// (0 disables). Default 20 cycles, 50Hz at 1kHz ecmc rate.
+#define ECMC_PLUGIN_STATUS_DECIMATION_DEFAULT 20
+#define ECMC_PLUGIN_STATUS_AXES 3                       // X, Y, Z
+
+// Axis slots of ecmc data (X, Y and Z at grbl axis index followed by spindle)
+#define ECMC_PLUGIN_AXIS_SLOTS 4
+#define ECMC_PLUGIN_AXIS_SLOT_SPINDLE 3
+
+// Toolpath preview (published with the status, ECMC_PLUGIN_PREVIEW_POINTS_OPTION_CMD points, 0 disables)
+#define ECMC_PLUGIN_PREVIEW_POINTS_DEFAULT 0
+#define ECMC_PLUGIN_GRBL_PREVIEW_LINES 2000               // Program lines parsed ahead of code row
+#define ECMC_PLUGIN_GRBL_PREVIEW_MIN_DIST_MM 0.1          // Closer points are skipped (decimation)
+#define ECMC_PLUGIN_GRBL_PREVIEW_ARC_POINTS 36            // Points per turn of planned arc blocks
+
+// Rt trace (ECMC_PLUGIN_TRACE_FILE_OPTION_CMD, disabled if no file). Window of
+// ECMC_PLUGIN_TRACE_PRE_OPTION_CMD cycles before and ECMC_PLUGIN_TRACE_POST_OPTION_CMD cycles after an error
+// or trigger, both 0 traces all cycles (continuous).
+#define ECMC_PLUGIN_TRACE_PRE_DEFAULT 2000
+#define ECMC_PLUGIN_TRACE_POST_DEFAULT 500
+#define ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS 65536       // Ring buffer (power of 2, 80 bytes per record)
+#define ECMC_PLUGIN_GRBL_TRACE_POLL_S 0.05                // Trace thread period
+#define ECMC_PLUGIN_GRBL_TRACE_NO_TRIGGER UINT64_MAX
+
+// Machine states (ECMC_PLUGIN_ASYN_STATUS_STATE), order of the '?' report
+#define ECMC_PLUGIN_GRBL_STATE_IDLE 0
+#define ECMC_PLUGIN_GRBL_STATE_RUN 1
+#define ECMC_PLUGIN_GRBL_STATE_HOLD 2
+#define ECMC_PLUGIN_GRBL_STATE_JOG 3
+#define ECMC_PLUGIN_GRBL_STATE_HOME 4
+#define ECMC_PLUGIN_GRBL_STATE_ALARM 5
+#define ECMC_PLUGIN_GRBL_STATE_CHECK 6
+#define ECMC_PLUGIN_GRBL_STATE_DOOR 7
+#define ECMC_PLUGIN_GRBL_STATE_SLEEP 8
+
 #define ECMC_CONFIG_FILE_COMMENT_CHAR    "#"
 #define ECMC_CONFIG_GRBL_CONFIG_CHAR     "$"
 
@@ -43,4 +141,23 @@
 #define ECMC_PLUGIN_GRBL_GRBL_OK_STRING "ok"
 #define ECMC_PLUGIN_GRBL_GRBL_ERR_STRING "error"
 
+#define ECMC_PLUGIN_GRBL_REPLY_BUFFER_SIZE 256      // Reply read and line buffer size
+#define ECMC_PLUGIN_GRBL_REPLY_WAIT_TIMEOUT_S 0.01  // Fallback timeout when waiting for reply
+
+#define ECMC_PLUGIN_GRBL_STREAM_WINDOW_LINES 4096        // Lines indexed ahead when streaming a file
+#define ECMC_PLUGIN_GRBL_STREAM_READ_AHEAD_BYTES 1048576 // File read ahead when streaming a file
+
+#define ECMC_PLUGIN_GRBL_BLOCK_CACHE_MAGIC "GRBLBLK"      // Block cache file header (8 bytes with terminating zero)
+#define ECMC_PLUGIN_GRBL_BLOCK_CACHE_VERSION 1            // Increase if cache file format changes
+#define ECMC_PLUGIN_GRBL_BLOCK_CACHE_FILE_EXT ".grblblk"
+#define ECMC_PLUGIN_GRBL_BLOCK_CACHE_TEXT 0               // Line sent as text
+#define ECMC_PLUGIN_GRBL_BLOCK_CACHE_PARSED 1             // Line sent as parsed block
+
+#define ECMC_PLUGIN_GRBL_VALIDATE_BATCH_LINES 16384       // Lines parsed ahead in parallel when validating
+#define ECMC_PLUGIN_GRBL_VALIDATE_MAX_WORKERS 8           // Max parallel parse threads when validating
+#define ECMC_PLUGIN_GRBL_VALIDATE_LINE_EMPTY 0            // Nothing to validate
+#define ECMC_PLUGIN_GRBL_VALIDATE_LINE_PARSED 1           // Parsed, check in order
+#define ECMC_PLUGIN_GRBL_VALIDATE_LINE_ERROR 2            // Parse error
+#define ECMC_PLUGIN_GRBL_VALIDATE_LINE_SYSTEM 3           // '$' command (skipped)
+
 #endif  /* ECMC_GRBL_DEFS_H_ */
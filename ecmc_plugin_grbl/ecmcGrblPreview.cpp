@@ -0,0 +1,318 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblPreview.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include "ecmcGrblPreview.h"
+#include "ecmcGrblProgram.h"
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+
+ecmcGrblPreview::ecmcGrblPreview(struct grbl_context *grblCtx, size_t maxPoints) {
+  grblCtx_       = grblCtx;
+  previewCtx_    = NULL;
+  maxPoints_     = maxPoints;
+  program_       = NULL;
+  lastHead_      = 0;
+  nextRow_       = 0;
+  programEnd_    = true;
+  count_         = 0;
+  plannedCount_  = 0;
+
+  if(maxPoints_ == 0) {
+    throw std::out_of_range("GRBL: ERROR: Invalid number of preview points.");
+  }
+  if(!(previewMutex_ = epicsMutexCreate())) {
+    throw std::runtime_error("GRBL: ERROR: Failed create mutex for preview.");
+  }
+  if(!(previewCtx_ = grbl_context_create())) {
+    throw std::runtime_error("GRBL: ERROR: Failed allocate grbl context for preview.");
+  }
+  x_.resize(maxPoints_);
+  y_.resize(maxPoints_);
+  z_.resize(maxPoints_);
+  speed_.resize(maxPoints_);
+  line_.resize(maxPoints_);
+}
+
+ecmcGrblPreview::~ecmcGrblPreview() {
+  grbl_context_delete(previewCtx_);
+  epicsMutexDestroy(previewMutex_);
+}
+
+void ecmcGrblPreview::lock() {
+  epicsMutexLock(previewMutex_);
+}
+
+void ecmcGrblPreview::unlock() {
+  epicsMutexUnlock(previewMutex_);
+}
+
+// Called by the thread writing the program (instance context bound)
+void ecmcGrblPreview::start(ecmcGrblProgram *program) {
+  lock();
+  program_ = program;
+  program_->lock();
+  programEnd_ = program_->isStreamed();
+  program_->unlock();
+  programPoints_.clear();
+  nextRow_ = 0;
+
+  // Same state as the instance (idle, nothing parsed yet). Locked against the grbl main thread.
+  grbl_context_lock_state(grblCtx_);
+  settings_t     instanceSettings = settings;
+  parser_state_t instanceState    = gc_state;
+  memcpy(previewCtx_->eeprom_buffer, grblCtx_->eeprom_buffer, EEPROM_MEM_SIZE);  // coordinate systems
+  grbl_context_unlock_state(grblCtx_);
+  grbl_context_bind(previewCtx_);
+  settings = instanceSettings;
+  gc_state = instanceState;
+
+  // limits_soft_check() waits for reset, the preview just ends at the first error instead
+  bit_false(settings.flags, BITFLAG_SOFT_LIMIT_ENABLE);
+  plan_reset();
+  sys.state = STATE_CHECK_MODE;
+  previewCtx_->simulation_wait = grbl_context_no_wait;  // Planner waits would block the status thread
+  previewCtx_->simulation_arg  = NULL;
+  grbl_context_bind(grblCtx_);
+  unlock();
+}
+
+bool ecmcGrblPreview::update(size_t codeRow) {
+  lock();
+  grbl_context_bind(grblCtx_);
+  bool changed = updatePlanner();
+  changed = updateProgram(codeRow) || changed;
+  grbl_context_bind(grblCtx_);
+  if(changed) {
+    publish();
+  }
+  unlock();
+  return changed;
+}
+
+// Mirror of the planner blocks (instance context bound). The blocks up to head are complete (see
+// plan_get_buffer_indices()), entry speeds read while replanned are refreshed on the next update.
+bool ecmcGrblPreview::updatePlanner() {
+  uint16_t tail, head, planned;
+  plan_get_buffer_indices(&tail, &head, &planned);
+  uint16_t size = plan_get_block_buffer_size();
+  auto distance = [size](uint16_t from, uint16_t to) -> size_t {
+    return to >= from ? to - from : size - (from - to);
+  };
+  bool changed = false;
+
+  // Restart mirror if the planner was reset
+  size_t valid = distance(tail, lastHead_);
+  if(valid > distance(tail, head)) {
+    changed = !plannerPoints_.empty();
+    plannerPoints_.clear();
+    lastHead_ = tail;
+    valid = 0;
+  }
+  // Drop points of executed blocks (arc blocks have several points)
+  while(!plannerPoints_.empty() && distance(tail, plannerPoints_.front().index) >= valid) {
+    plannerPoints_.pop_front();
+    changed = true;
+  }
+  if((plannerPoints_.empty() && valid > 0) ||
+     (!plannerPoints_.empty() && plannerPoints_.front().index != tail)) {
+    plannerPoints_.clear();
+    lastHead_ = tail;
+    changed = true;
+  }
+
+  // Copy new blocks only
+  while(lastHead_ != head) {
+    plan_block_t *block = plan_get_block(lastHead_);
+    previewPoint point;
+    for(int i = 0; i < ECMC_PLUGIN_STATUS_AXES; i++) {
+      point.position[i] = block->target_steps[i] / double(settings.steps_per_mm[i]);
+    }
+    point.speed = sqrt(block->entry_speed_sqr);
+    #ifdef USE_LINE_NUMBERS
+      point.line = block->line_number;
+    #else
+      point.line = 0;
+    #endif
+    point.index = lastHead_;
+    if(block->is_arc) {
+      addArcPoints(block, point);
+    }
+    plannerPoints_.push_back(point);
+    lastHead_ = plan_next_block_index(lastHead_);
+    changed = true;
+  }
+
+  // Refresh entry speeds of blocks that can still be replanned
+  size_t first = distance(tail, planned);
+  for(previewPoint &point : plannerPoints_) {
+    if(distance(tail, point.index) < first) {
+      continue;
+    }
+    double speed = sqrt(plan_get_block(point.index)->entry_speed_sqr);
+    if(speed != point.speed) {
+      point.speed = speed;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// Points on the circle before the target of an arc block, ECMC_PLUGIN_GRBL_PREVIEW_ARC_POINTS per
+// turn (same geometry as the stepper interpolation, see plan_arc_t). target is the end point.
+void ecmcGrblPreview::addArcPoints(plan_block_t *block, const previewPoint &target) {
+  const plan_arc_t *arc = &block->arc;
+  if(arc->axis_0 >= ECMC_PLUGIN_STATUS_AXES || arc->axis_1 >= ECMC_PLUGIN_STATUS_AXES) {
+    return;
+  }
+  double travel   = arc->angular_travel;
+  double r0       = arc->r_axis0;
+  double r1       = arc->r_axis1;
+  double center0  = target.position[arc->axis_0] - (r0*cos(travel) - r1*sin(travel));
+  double center1  = target.position[arc->axis_1] - (r0*sin(travel) + r1*cos(travel));
+  double linear   = 0;  // Helical travel
+  if(arc->axis_linear < ECMC_PLUGIN_STATUS_AXES) {
+    linear = block->steps[arc->axis_linear] / double(settings.steps_per_mm[arc->axis_linear]);
+    if(block->direction_bits & get_direction_pin_mask(arc->axis_linear)) {
+      linear = -linear;
+    }
+  }
+  int points = (int)ceil(fabs(travel) * ECMC_PLUGIN_GRBL_PREVIEW_ARC_POINTS / (2 * M_PI));
+  for(int i = 1; i < points; i++) {
+    double fraction = double(i) / points;
+    double angle    = travel * fraction;
+    previewPoint point = target;
+    point.position[arc->axis_0] = center0 + r0*cos(angle) - r1*sin(angle);
+    point.position[arc->axis_1] = center1 + r0*sin(angle) + r1*cos(angle);
+    if(arc->axis_linear < ECMC_PLUGIN_STATUS_AXES) {
+      point.position[arc->axis_linear] -= (1 - fraction) * linear;
+    }
+    plannerPoints_.push_back(point);
+  }
+}
+
+// Parse program lines ahead of the code row being executed (each line once)
+bool ecmcGrblPreview::updateProgram(size_t codeRow) {
+  bool changed = false;
+  while(!programPoints_.empty() && programPoints_.front().index < codeRow) {
+    programPoints_.pop_front();
+    changed = true;
+  }
+
+  size_t lastRow = codeRow + ECMC_PLUGIN_GRBL_PREVIEW_LINES;
+  if(programEnd_ || nextRow_ >= lastRow || nextRow_ >= program_->size()) {
+    return changed;
+  }
+
+  program_->lock();
+  grbl_context_bind(previewCtx_);
+  size_t lines = program_->size();
+  char filtered[LINE_BUFFER_SIZE];
+  for(; nextRow_ < lines && nextRow_ < lastRow; nextRow_++) {
+    std::string_view line = program_->getLine(nextRow_);
+    if(ecmc_filter_line(filtered, line.data(), line.length())) {
+      programEnd_ = true;
+      break;
+    }
+    if(filtered[0] == '$' || filtered[0] == 0 || filtered[1] == 0) {
+      continue;  // Not executed by grbl (see protocol_execute_line())
+    }
+    real_t position[N_AXIS];
+    memcpy(position, gc_state.position, sizeof(position));
+    if(gc_execute_line(filtered) != STATUS_OK) {
+      programEnd_ = true;
+      break;
+    }
+    // Rows already executed are parsed for the modal state only
+    if(nextRow_ < codeRow || !memcmp(position, gc_state.position, sizeof(position))) {
+      continue;
+    }
+    previewPoint point;
+    for(int i = 0; i < ECMC_PLUGIN_STATUS_AXES; i++) {
+      point.position[i] = gc_state.position[i];
+    }
+    point.speed = -1;
+    point.line  = gc_state.line_number;
+    point.index = nextRow_;
+    programPoints_.push_back(point);
+    changed = true;
+  }
+  program_->unlock();
+  return changed;
+}
+
+// Decimated points: planner blocks followed by program lines
+void ecmcGrblPreview::publish() {
+  count_        = 0;
+  plannedCount_ = 0;
+  double minDistSqr = ECMC_PLUGIN_GRBL_PREVIEW_MIN_DIST_MM * ECMC_PLUGIN_GRBL_PREVIEW_MIN_DIST_MM;
+  auto add = [&](const previewPoint &point) -> bool {
+    if(count_ >= maxPoints_) {
+      return false;
+    }
+    if(count_ > 0) {
+      double dx = point.position[X_AXIS] - x_[count_ - 1];
+      double dy = point.position[Y_AXIS] - y_[count_ - 1];
+      double dz = point.position[Z_AXIS] - z_[count_ - 1];
+      if(dx*dx + dy*dy + dz*dz < minDistSqr) {
+        return true;
+      }
+    }
+    x_[count_]     = point.position[X_AXIS];
+    y_[count_]     = point.position[Y_AXIS];
+    z_[count_]     = point.position[Z_AXIS];
+    speed_[count_] = point.speed;
+    line_[count_]  = point.line;
+    count_++;
+    return true;
+  };
+
+  for(const previewPoint &point : plannerPoints_) {
+    if(!add(point)) {
+      break;
+    }
+  }
+  plannedCount_ = count_;
+  for(const previewPoint &point : programPoints_) {
+    if(!add(point)) {
+      break;
+    }
+  }
+}
+
+size_t ecmcGrblPreview::getCount() {
+  return count_;
+}
+
+size_t ecmcGrblPreview::getPlannedCount() {
+  return plannedCount_;
+}
+
+const double *ecmcGrblPreview::getX() {
+  return x_.data();
+}
+
+const double *ecmcGrblPreview::getY() {
+  return y_.data();
+}
+
+const double *ecmcGrblPreview::getZ() {
+  return z_.data();
+}
+
+const double *ecmcGrblPreview::getSpeed() {
+  return speed_.data();
+}
+
+const double *ecmcGrblPreview::getLine() {
+  return line_.data();
+}
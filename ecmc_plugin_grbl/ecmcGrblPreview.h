@@ -0,0 +1,95 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblPreview.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_PREVIEW_H_
+#define ECMC_GRBL_PREVIEW_H_
+
+#include "ecmcGrblDefs.h"
+#include <epicsMutex.h>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+extern "C" {
+#include "grbl.h"
+}
+
+class ecmcGrblProgram;
+
+// Toolpath look-ahead preview.
+// The upcoming path is the blocks in the grbl planner buffer followed by the program lines not yet
+// parsed by grbl. Both are mirrored and updated incrementally by update():
+//  - Planner: Only blocks added since last update are copied (target, entry speed, line number),
+//    arc blocks with points on the circle. Entry speeds are refreshed only for blocks that can still
+//    be replanned (from the optimally planned block to the head), executed blocks are dropped.
+//  - Program: The lines ahead of the code row being executed are parsed in check mode on a private
+//    grbl context (copy of the settings, coordinate systems and parser state of the grbl instance at
+//    start of execution, see start()), each line only once. Lines without motion are skipped, arcs
+//    are represented by the end point until planned.
+// The preview is then decimated (points closer than ECMC_PLUGIN_GRBL_PREVIEW_MIN_DIST_MM skipped) into
+// at most maxPoints points. Streamed files are not previewed (only the planner buffer).
+// start() and update() lock the preview, lock it while reading the points (lock()/unlock()).
+class ecmcGrblPreview {
+ public:
+  ecmcGrblPreview(struct grbl_context *grblCtx, size_t maxPoints);
+  ~ecmcGrblPreview();
+
+  // Start preview of program from code row 0 (grbl idle, called before the first line is written)
+  void                    start(ecmcGrblProgram *program);
+
+  // Update with new planner blocks and program lines. codeRow is the oldest code row not yet
+  // acknowledged by grbl (grbl_get_code_row_num()). Returns true if the preview changed.
+  bool                    update(size_t codeRow);
+
+  // Preview points (valid until next update())
+  size_t                  getCount();
+  size_t                  getPlannedCount();   // First points are from the planner buffer
+  const double           *getX();              // [mm]
+  const double           *getY();              // [mm]
+  const double           *getZ();              // [mm]
+  const double           *getSpeed();          // Entry speed [mm/min], -1 for lines not yet planned
+  const double           *getLine();           // g-code line number (N)
+  void                    lock();
+  void                    unlock();
+
+ private:
+  typedef struct {
+    double                position[ECMC_PLUGIN_STATUS_AXES];
+    double                speed;
+    int32_t               line;
+    size_t                index;    // Planner block index or code row
+  } previewPoint;
+
+  bool                    updatePlanner();
+  void                    addArcPoints(plan_block_t *block, const previewPoint &target);
+  bool                    updateProgram(size_t codeRow);
+  void                    publish();
+
+  struct grbl_context    *grblCtx_;          // Instance (planner and source of state)
+  struct grbl_context    *previewCtx_;       // Private context (check mode)
+  size_t                  maxPoints_;
+  epicsMutexId            previewMutex_;
+  ecmcGrblProgram        *program_;
+  std::deque<previewPoint> plannerPoints_;   // Blocks tail..lastHead_
+  uint16_t                lastHead_;
+  std::deque<previewPoint> programPoints_;   // Lines parsed ahead
+  size_t                  nextRow_;          // Next code row to parse
+  bool                    programEnd_;       // Parse error or streamed program
+  size_t                  count_;
+  size_t                  plannedCount_;
+  std::vector<double>     x_;
+  std::vector<double>     y_;
+  std::vector<double>     z_;
+  std::vector<double>     speed_;
+  std::vector<double>     line_;
+};
+
+#endif  /* ECMC_GRBL_PREVIEW_H_ */
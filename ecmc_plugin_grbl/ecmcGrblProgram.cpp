@@ -0,0 +1,348 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblProgram.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include "ecmcGrblProgram.h"
+#include "ecmcGrblDefs.h"
+#include <stdexcept>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ecmcGrblProgram::ecmcGrblProgram() {
+  if(!(programMutex_ = epicsMutexCreate())) {
+    throw std::runtime_error("GRBL: ERROR: Failed create mutex for program.");
+  }
+  segments_.push_back({NULL, 0, false});
+  firstLine_       = 0;
+  size_            = 0;
+  streamSegment_   = 0;
+  streamOffset_    = 0;
+  streamReleased_  = 0;
+  streamWindow_    = 0;
+}
+
+ecmcGrblProgram::~ecmcGrblProgram() {
+  clear();
+  epicsMutexDestroy(programMutex_);
+}
+
+// Length of line without comment
+size_t ecmcGrblProgram::commandLength(const char *line, size_t length) {
+  const char *comment = (const char*)memchr(line, ECMC_CONFIG_FILE_COMMENT_CHAR[0], length);
+  return comment ? comment - line : length;
+}
+
+int ecmcGrblProgram::addLine(std::string_view line) {
+  size_t length = commandLength(line.data(), line.length());
+  if(length == 0) {
+    return 0;
+  }
+
+  epicsMutexLock(programMutex_);
+  if(streamSegment_) {
+    epicsMutexUnlock(programMutex_);
+    return EBUSY;
+  }
+  lines_.push_back({addedLines_.size(), (uint32_t)length, 0});
+  addedLines_.append(line.data(), length);
+  size_ = lines_.size();
+  epicsMutexUnlock(programMutex_);
+  return 0;
+}
+
+// Read file into an owned buffer (segment data is NULL for empty file)
+int ecmcGrblProgram::readFile(const char *fileName, programSegment *segment) {
+  segment->data   = NULL;
+  segment->size   = 0;
+  segment->mapped = false;
+
+  int fd = open(fileName, O_RDONLY);
+  if(fd < 0) {
+    return errno;
+  }
+
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0) {
+    int error = errno;
+    close(fd);
+    return error;
+  }
+
+  if(fileStat.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+
+  char *data = (char*)malloc(fileStat.st_size);
+  if(!data) {
+    close(fd);
+    return ENOMEM;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  // The file can shrink while read (only the bytes read are used)
+  size_t size = 0;
+  while(size < (size_t)fileStat.st_size) {
+    ssize_t bytes = read(fd, data + size, fileStat.st_size - size);
+    if(bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if(bytes < 0) {
+      int error = errno;
+      close(fd);
+      free(data);
+      return error;
+    }
+    if(bytes == 0) {
+      break;
+    }
+    size += bytes;
+  }
+  close(fd);
+  if(size == 0) {
+    free(data);
+    return 0;
+  }
+  segment->data = data;
+  segment->size = size;
+  return 0;
+}
+
+// Map file read only (segment data is NULL for empty file)
+int ecmcGrblProgram::mapFile(const char *fileName, programSegment *segment) {
+  segment->data   = NULL;
+  segment->size   = 0;
+  segment->mapped = true;
+
+  int fd = open(fileName, O_RDONLY);
+  if(fd < 0) {
+    return errno;
+  }
+
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0) {
+    int error = errno;
+    close(fd);
+    return error;
+  }
+
+  if(fileStat.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+
+  void *data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int error = errno;
+  close(fd);  // mapping stays valid
+  if(data == MAP_FAILED) {
+    return error;
+  }
+  madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+  segment->data = (const char*)data;
+  segment->size = fileStat.st_size;
+  return 0;
+}
+
+// Unmap or free segment data
+void ecmcGrblProgram::freeSegment(programSegment *segment) {
+  if(segment->mapped) {
+    munmap((void*)segment->data, segment->size);
+  } else {
+    free((void*)segment->data);
+  }
+  segment->data = NULL;
+  segment->size = 0;
+}
+
+int ecmcGrblProgram::loadFile(const char *fileName) {
+  programSegment file;
+  int error = readFile(fileName, &file);
+  if(error || !file.data) {
+    return error;
+  }
+
+  // Build index outside lock (one pass over file)
+  std::vector<programLine> fileLines;
+  const char *end   = file.data + file.size;
+  const char *line  = file.data;
+  while(line < end) {
+    const char *lineEnd = (const char*)memchr(line, '\n', end - line);
+    if(!lineEnd) {
+      lineEnd = end;
+    }
+    size_t length = commandLength(line, lineEnd - line);
+    if(length > 0) {
+      fileLines.push_back({(uint64_t)(line - file.data), (uint32_t)length, 0});
+    }
+    line = lineEnd + 1;
+  }
+
+  epicsMutexLock(programMutex_);
+  if(streamSegment_) {
+    epicsMutexUnlock(programMutex_);
+    freeSegment(&file);
+    return EBUSY;
+  }
+  uint32_t segment = segments_.size();
+  segments_.push_back(file);
+  for(programLine &fileLine : fileLines) {
+    fileLine.segment = segment;
+  }
+  lines_.insert(lines_.end(), fileLines.begin(), fileLines.end());
+  size_ = firstLine_ + lines_.size();
+  epicsMutexUnlock(programMutex_);
+  return 0;
+}
+
+int ecmcGrblProgram::streamFile(const char *fileName, size_t windowLines) {
+  programSegment file;
+  int error = mapFile(fileName, &file);
+  if(error) {
+    return error;
+  }
+
+  clear();
+  if(!file.data) {
+    return 0;  // empty file
+  }
+
+  epicsMutexLock(programMutex_);
+  streamSegment_  = segments_.size();
+  segments_.push_back(file);
+  streamWindow_   = windowLines > 0 ? windowLines : 1;
+  streamIndex(streamWindow_);
+  epicsMutexUnlock(programMutex_);
+  return 0;
+}
+
+// Index up to lines more lines of streamed file (called with lock)
+void ecmcGrblProgram::streamIndex(size_t lines) {
+  const programSegment &file = segments_[streamSegment_];
+  const char *end   = file.data + file.size;
+  const char *line  = file.data + streamOffset_;
+  size_t added = 0;
+  while(line < end && added < lines) {
+    const char *lineEnd = (const char*)memchr(line, '\n', end - line);
+    if(!lineEnd) {
+      lineEnd = end;
+    }
+    size_t length = commandLength(line, lineEnd - line);
+    if(length > 0) {
+      lines_.push_back({(uint64_t)(line - file.data), (uint32_t)length, streamSegment_});
+      added++;
+    }
+    line = lineEnd + 1;
+  }
+  streamOffset_ = line < end ? line - file.data : file.size;
+  size_ = firstLine_ + lines_.size();
+
+  // Let the kernel read ahead the next part of the file
+  long pageSize = sysconf(_SC_PAGESIZE);
+  uint64_t readAheadStart = streamOffset_ & ~(uint64_t)(pageSize - 1);
+  if(readAheadStart < file.size) {
+    madvise((void*)(file.data + readAheadStart),
+            std::min((uint64_t)ECMC_PLUGIN_GRBL_STREAM_READ_AHEAD_BYTES, file.size - readAheadStart),
+            MADV_WILLNEED);
+  }
+}
+
+// Release lines before index and the file pages they used (called with lock)
+void ecmcGrblProgram::streamRelease(size_t index) {
+  while(firstLine_ < index && !lines_.empty()) {
+    lines_.pop_front();
+    firstLine_++;
+  }
+
+  const programSegment &file = segments_[streamSegment_];
+  uint64_t inUse = lines_.empty() ? streamOffset_ : lines_.front().offset;
+  long pageSize = sysconf(_SC_PAGESIZE);
+  uint64_t release = inUse & ~(uint64_t)(pageSize - 1);
+  if(release > streamReleased_) {
+    madvise((void*)(file.data + streamReleased_), release - streamReleased_, MADV_DONTNEED);
+    streamReleased_ = release;
+  }
+}
+
+bool ecmcGrblProgram::hasLine(size_t index) {
+  epicsMutexLock(programMutex_);
+  if(!streamSegment_) {
+    epicsMutexUnlock(programMutex_);
+    return index < size_;
+  }
+
+  if(index < firstLine_) {
+    // Restart from beginning of file
+    lines_.clear();
+    firstLine_      = 0;
+    streamOffset_   = 0;
+    streamReleased_ = 0;
+    streamIndex(streamWindow_);
+  }
+  streamRelease(index);
+  size_t end   = firstLine_ + lines_.size();
+  size_t ahead = end > index ? end - index : 0;
+  if(ahead < streamWindow_ / 2 + 1) {
+    streamIndex(streamWindow_ - ahead);
+  }
+  bool exists = index < firstLine_ + lines_.size();
+  epicsMutexUnlock(programMutex_);
+  return exists;
+}
+
+void ecmcGrblProgram::clear() {
+  epicsMutexLock(programMutex_);
+  for(size_t i = 1; i < segments_.size(); i++) {
+    freeSegment(&segments_[i]);
+  }
+  segments_.resize(1);
+  lines_.clear();
+  lines_.shrink_to_fit();
+  addedLines_.clear();
+  addedLines_.shrink_to_fit();
+  firstLine_       = 0;
+  size_            = 0;
+  streamSegment_   = 0;
+  streamOffset_    = 0;
+  streamReleased_  = 0;
+  streamWindow_    = 0;
+  epicsMutexUnlock(programMutex_);
+}
+
+size_t ecmcGrblProgram::size() {
+  return size_;
+}
+
+bool ecmcGrblProgram::isStreamed() {
+  return streamSegment_ != 0;
+}
+
+std::string_view ecmcGrblProgram::getLine(size_t index) {
+  if(index < firstLine_ || index >= firstLine_ + lines_.size()) {
+    return std::string_view();
+  }
+  const programLine &line = lines_[index - firstLine_];
+  const char *data = line.segment ? segments_[line.segment].data : addedLines_.data();
+  return std::string_view(data + line.offset, line.length);
+}
+
+void ecmcGrblProgram::lock() {
+  epicsMutexLock(programMutex_);
+}
+
+void ecmcGrblProgram::unlock() {
+  epicsMutexUnlock(programMutex_);
+}
@@ -0,0 +1,100 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblProgram.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_PROGRAM_H_
+#define ECMC_GRBL_PROGRAM_H_
+
+#include <epicsMutex.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+
+// G-code program store.
+// Loaded files are read once into an owned buffer and indexed in one pass (offset and length of each
+// non empty line, comments after '#' removed), so loading is limited by file io and memory use is about
+// the size of the file plus 16 bytes per line. Commands added one by one are copied to an internal buffer.
+// Lines are served as string views into the buffers. A view is only valid while the program is locked
+// (lock()/unlock()), since clear() frees the buffers.
+// A streamed file (streamFile()) is memory mapped and indexed on demand in a bounded window ahead of the
+// line being executed, lines and file pages behind it are released. Memory use is then independent of the
+// file size and execution can start directly after the file is mapped. A streamed file must not be
+// truncated or rewritten while it is streamed (access to a page beyond the new end of the file raises
+// SIGBUS), loaded files have no such restriction.
+class ecmcGrblProgram {
+ public:
+  ecmcGrblProgram();
+  ~ecmcGrblProgram();
+
+  // Append one line (ignored if empty after comment removal).
+  // Returns 0 or EBUSY if a file is streamed (nothing can be added after a streamed file).
+  int              addLine(std::string_view line);
+
+  // Append all lines of a file. Returns 0 or errno if the file could not be read.
+  int              loadFile(const char *fileName);
+
+  // Clear program and stream file (must not be modified while streamed).
+  // Returns 0 or errno if the file could not be mapped.
+  int              streamFile(const char *fileName, size_t windowLines);
+
+  // True if line at index exists. For a streamed file the window is moved to index (lines before
+  // index are released). Index lower than the window restarts the stream from the beginning.
+  bool             hasLine(size_t index);
+
+  // Remove all lines and unmap files
+  void             clear();
+
+  // Number of lines indexed (can be called without lock)
+  size_t           size();
+
+  // True if a file is streamed (only a window of the lines is available). Program must be locked.
+  bool             isStreamed();
+
+  // Line at index. Program must be locked while the view is used.
+  std::string_view getLine(size_t index);
+  void             lock();
+  void             unlock();
+
+ private:
+  typedef struct {
+    uint64_t       offset;
+    uint32_t       length;
+    uint32_t       segment;  // 0: added lines buffer, >0: file
+  } programLine;
+
+  typedef struct {
+    const char    *data;
+    size_t         size;
+    bool           mapped;   // Mapped (streamed) file, otherwise buffer owned by the program
+  } programSegment;
+
+  static size_t    commandLength(const char *line, size_t length);
+  int              readFile(const char *fileName, programSegment *segment);
+  int              mapFile(const char *fileName, programSegment *segment);
+  static void      freeSegment(programSegment *segment);
+  void             streamIndex(size_t lines);
+  void             streamRelease(size_t index);
+
+  epicsMutexId                programMutex_;
+  std::deque<programLine>     lines_;
+  size_t                      firstLine_;    // Index of lines_.front() (>0 if streamed lines released)
+  std::vector<programSegment> segments_;     // segments_[0] refers to addedLines_
+  std::string                 addedLines_;
+  std::atomic<size_t>         size_;
+  uint32_t                    streamSegment_; // Segment streamed (0: no stream)
+  uint64_t                    streamOffset_;  // Next byte to index in streamed file
+  uint64_t                    streamReleased_; // Bytes released (page aligned) in streamed file
+  size_t                      streamWindow_;  // Lines indexed ahead
+};
+
+#endif  /* ECMC_GRBL_PROGRAM_H_ */
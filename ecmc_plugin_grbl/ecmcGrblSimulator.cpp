@@ -0,0 +1,325 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblSimulator.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include "ecmcGrblSimulator.h"
+#include "ecmcGrblProgram.h"
+#include "epicsThread.h"
+#include <stdexcept>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+// Simulation thread
+void f_worker_simulate(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: GRBL: ERROR: Worker simulate thread ecmcGrblSimulator object NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+  ecmcGrblSimulator * simulatorObj = (ecmcGrblSimulator*)obj;
+  simulatorObj->doWorker();
+}
+
+// Called by grbl instead of waiting (grbl_context_t::simulation_wait)
+void f_simulation_wait(void *obj, double waitS) {
+  ecmcGrblSimulator * simulatorObj = (ecmcGrblSimulator*)obj;
+  simulatorObj->doSample(waitS);
+}
+
+ecmcGrblSimulator::ecmcGrblSimulator(struct grbl_context *grblCtx,
+                                     std::string threadSuffix,
+                                     int plannerBufferSize,
+                                     bool continuous,
+                                     double sampleTimeMs) {
+  grblCtx_           = grblCtx;
+  simulatorCtx_      = NULL;
+  threadSuffix_      = threadSuffix;
+  plannerBufferSize_ = plannerBufferSize;
+  continuous_        = continuous;
+  sampleTimeMs_      = sampleTimeMs;
+  timeToNextExeMs_   = 0;
+  program_           = NULL;
+  dumpFile_          = NULL;
+  busy_              = false;
+  abort_             = false;
+  samples_           = 0;
+  lines_             = 0;
+  row_               = 0;
+  errorCode_         = 0;
+  alarmCode_         = 0;
+  errorRow_          = 0;
+
+  if(sampleTimeMs_ <= 0) {
+    throw std::out_of_range("GRBL: ERROR: Invalid sample time for simulation.");
+  }
+  if(!(doneEvent_ = epicsEventCreate(epicsEventEmpty))) {
+    throw std::runtime_error("GRBL: ERROR: Failed create event for simulation.");
+  }
+}
+
+ecmcGrblSimulator::~ecmcGrblSimulator() {
+  abort_ = true;
+  wait();
+  epicsEventDestroy(doneEvent_);
+}
+
+int ecmcGrblSimulator::start(ecmcGrblProgram *program, const char *dumpFile) {
+  bool idle = false;
+  if(!busy_.compare_exchange_strong(idle, true)) {
+    return EBUSY;
+  }
+
+  program->lock();
+  bool streamed = program->isStreamed();
+  program->unlock();
+  if(streamed) {
+    busy_ = false;
+    return ENOTSUP;
+  }
+
+  dumpFile_ = NULL;
+  if(dumpFile && strlen(dumpFile) > 0) {
+    if(!(dumpFile_ = fopen(dumpFile, "w"))) {
+      int error = errno;
+      busy_ = false;
+      return error;
+    }
+    fprintf(dumpFile_, "# time[s] x y z [mm] vx vy vz [mm/s] row\n");
+  }
+
+  program_         = program;
+  abort_           = false;
+  timeToNextExeMs_ = 0;
+  samples_         = 0;
+  lines_           = 0;
+  row_             = 0;
+  errorCode_       = 0;
+  alarmCode_       = 0;
+  errorRow_        = 0;
+
+  std::string threadname = "ecmc.grbl.simulate" + threadSuffix_;
+  if(epicsThreadCreate(threadname.c_str(), 0, 32768, f_worker_simulate, this) == NULL) {
+    if(dumpFile_) {
+      fclose(dumpFile_);
+      dumpFile_ = NULL;
+    }
+    busy_ = false;
+    return EAGAIN;
+  }
+  return 0;
+}
+
+void ecmcGrblSimulator::wait() {
+  while(busy_) {
+    epicsEventWaitWithTimeout(doneEvent_, 0.1);
+  }
+}
+
+bool ecmcGrblSimulator::busy() {
+  return busy_;
+}
+
+double ecmcGrblSimulator::getTime() {
+  return samples_ * sampleTimeMs_ / 1000.0;
+}
+
+size_t ecmcGrblSimulator::getSamples() {
+  return samples_;
+}
+
+size_t ecmcGrblSimulator::getLines() {
+  return lines_;
+}
+
+int ecmcGrblSimulator::getErrorCode() {
+  return errorCode_;
+}
+
+int ecmcGrblSimulator::getAlarmCode() {
+  return alarmCode_;
+}
+
+size_t ecmcGrblSimulator::getErrorRow() {
+  return errorRow_;
+}
+
+// Private grbl context with a copy of the state of the instance (idle, same planner size)
+bool ecmcGrblSimulator::initContext() {
+  if(!(simulatorCtx_ = grbl_context_create())) {
+    return false;
+  }
+  grbl_context_bind(grblCtx_);
+  grbl_context_lock_state(grblCtx_);  // Consistent with the grbl main thread
+  settings_t     instanceSettings = settings;
+  parser_state_t instanceState    = gc_state;
+  int32_t        instancePosition[N_AXIS];
+  memcpy(instancePosition, sys_position, sizeof(instancePosition));
+  memcpy(simulatorCtx_->eeprom_buffer, grblCtx_->eeprom_buffer, EEPROM_MEM_SIZE);  // coordinate systems
+  grbl_context_unlock_state(grblCtx_);
+
+  grbl_context_bind(simulatorCtx_);
+  settings = instanceSettings;
+  if(!plan_init_buffer(plannerBufferSize_)) {
+    return false;
+  }
+
+  // Same reset as the grbl main thread (see ecmcGrbl::doMainWorker())
+  memset(&sys, 0, sizeof(system_t));
+  sys.state = STATE_IDLE;
+  sys.f_override = DEFAULT_FEED_OVERRIDE;
+  sys.r_override = DEFAULT_RAPID_OVERRIDE;
+  sys.spindle_speed_ovr = DEFAULT_SPINDLE_SPEED_OVERRIDE;
+  memcpy(sys_position, instancePosition, sizeof(instancePosition));
+  gc_state = instanceState;
+  plan_reset();
+  st_reset();
+  plan_sync_position();
+  gc_sync_position();
+  st_sync_continuous_position();
+
+  simulatorCtx_->simulation_wait = f_simulation_wait;
+  simulatorCtx_->simulation_arg  = this;
+  return true;
+}
+
+// Discard messages, keep the first alarm (simulator context bound)
+void ecmcGrblSimulator::readReplies() {
+  char buffer[TX_BUFFER_SIZE];
+  uint16_t bytes = 0;
+  while((bytes = ecmc_read_from_grbl_tx_buffer(buffer, sizeof(buffer))) > 0) {
+    for(uint16_t i = 0; i < bytes; i++) {
+      if(buffer[i] != '\n' && buffer[i] != '\r') {
+        reply_ += buffer[i];
+        continue;
+      }
+      int alarm = 0;
+      if(!alarmCode_ && sscanf(reply_.c_str(), "ALARM:%d", &alarm) == 1) {
+        alarmCode_ = alarm;
+        errorRow_  = row_;
+      }
+      reply_.clear();
+    }
+  }
+}
+
+// Execute one ecmc sample (same as ecmcGrbl::grblRTexecute() without ecmc axes)
+void ecmcGrblSimulator::executeSample() {
+  if(continuous_) {
+    ecmc_grbl_main_rt_execute_continuous(sampleTimeMs_);
+  } else {
+    ecmc_grbl_main_rt_execute(&timeToNextExeMs_, sampleTimeMs_);
+  }
+  samples_++;
+
+  if(!dumpFile_) {
+    return;
+  }
+  double position[N_AXIS];
+  double velocity[N_AXIS];
+  double acceleration[N_AXIS];
+  if(continuous_) {
+    st_get_continuous_position(position);
+  } else {
+    for(int i = 0; i < N_AXIS; i++) {
+      position[i] = (double)sys_position[i];
+    }
+  }
+  st_get_feed_forward(velocity, acceleration);
+  fprintf(dumpFile_, "%.6f", getTime());
+  for(int i = 0; i < N_AXIS; i++) {
+    fprintf(dumpFile_, " %.6f", position[i] / settings.steps_per_mm[i]);
+  }
+  for(int i = 0; i < N_AXIS; i++) {
+    fprintf(dumpFile_, " %.6f", velocity[i] / settings.steps_per_mm[i]);
+  }
+  fprintf(dumpFile_, " %zu\n", row_);
+}
+
+// Grbl waits for the stepper: advance simulated time (simulation thread)
+void ecmcGrblSimulator::doSample(double waitS) {
+  readReplies();
+
+  // Stop at alarm (grbl waits for reset) or if aborted
+  if(sys.state == STATE_ALARM || alarmCode_ || abort_) {
+    system_set_exec_state_flag(EXEC_RESET);
+    return;
+  }
+
+  // Resume program pause (M0)
+  if(sys.state == STATE_HOLD && bit_istrue(sys.suspend, SUSPEND_HOLD_COMPLETE)) {
+    system_set_exec_state_flag(EXEC_CYCLE_START);
+  }
+
+  size_t samples = 1;
+  if(waitS > 0) {
+    samples = (size_t)ceil(waitS * 1000.0 / sampleTimeMs_);
+  }
+  for(size_t i = 0; i < samples; i++) {
+    executeSample();
+  }
+}
+
+// Filter and execute one line (same dispatch as protocol_execute_line(), '$' skipped)
+uint8_t ecmcGrblSimulator::executeLine(std::string_view line) {
+  char filtered[LINE_BUFFER_SIZE];
+  if(ecmc_filter_line(filtered, line.data(), line.length())) {
+    return STATUS_OVERFLOW;
+  }
+  if(filtered[0] == '$' || filtered[0] == 0 || filtered[1] == 0) {
+    return STATUS_OK;
+  }
+  return gc_execute_line(filtered);
+}
+
+void ecmcGrblSimulator::doWorker() {
+  program_->lock();
+  size_t lines = program_->isStreamed() ? 0 : program_->size();
+  if(!initContext()) {
+    printf("%s/%s:%d: GRBL: ERROR: Failed allocate grbl context for simulation.\n",
+           __FILE__, __FUNCTION__, __LINE__);
+    errorCode_ = STATUS_SETTING_READ_FAIL;
+    lines = 0;
+  }
+  reply_.clear();
+
+  for(size_t i = 0; i < lines; i++) {
+    row_ = i;
+    uint8_t status = executeLine(program_->getLine(i));
+    readReplies();
+    if(sys.abort || alarmCode_ || abort_) {
+      break;
+    }
+    if(status != STATUS_OK) {
+      errorCode_ = status;
+      errorRow_  = i;
+      break;
+    }
+    lines_ = i + 1;
+  }
+
+  // Execute remaining motion
+  if(lines > 0 && !sys.abort && !alarmCode_ && !errorCode_) {
+    protocol_buffer_synchronize();
+    readReplies();
+  }
+
+  grbl_context_bind(NULL);
+  grbl_context_delete(simulatorCtx_);
+  simulatorCtx_ = NULL;
+  if(dumpFile_) {
+    fclose(dumpFile_);
+    dumpFile_ = NULL;
+  }
+  program_->unlock();
+  busy_ = false;
+  epicsEventSignal(doneEvent_);
+}
@@ -0,0 +1,98 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblSimulator.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_SIMULATOR_H_
+#define ECMC_GRBL_SIMULATOR_H_
+
+#include "ecmcGrblDefs.h"
+#include <epicsEvent.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <stdio.h>
+#include <stdint.h>
+
+extern "C" {
+#include "grbl.h"
+}
+
+class ecmcGrblProgram;
+
+// Headless simulation of a program (machining time estimate).
+// Runs the program through the real grbl parser, planner (plan_buffer_line(), look-ahead) and
+// segment generator (st_prep_buffer()) and executes the stepper at the ecmc sample time, all on a
+// private grbl context (copy of the settings, coordinate systems, parser state and position of the
+// grbl instance) without ecmc axes. The simulation runs in a worker thread as fast as possible:
+// each time grbl would wait for the stepper (full planner, buffer sync, dwell) the stepper is
+// executed one sample (or the dwell time) instead (see grbl_context_t::simulation_wait).
+// Optionally the trajectory is written to a file, one line per sample:
+//   <time[s]> <x> <y> <z> [mm] <vx> <vy> <vz> [mm/s] <code row>
+// where code row is the row last handed to grbl (same as grbl_get_code_row_num()).
+// The simulation stops at the first error or alarm. Program pauses (M0) are resumed immediately
+// (operator time not included). '$' system commands are skipped. Streamed files are not supported.
+class ecmcGrblSimulator {
+ public:
+  ecmcGrblSimulator(struct grbl_context *grblCtx,
+                    std::string threadSuffix,
+                    int plannerBufferSize,
+                    bool continuous,            // ECMC_GRBL_INTERP_CONTINUOUS
+                    double sampleTimeMs);
+  ~ecmcGrblSimulator();
+
+  // Start simulation of program. dumpFile is the trajectory file (NULL or "" for none).
+  // Returns 0, EBUSY if a simulation is running, ENOTSUP for a streamed program or errno if the
+  // dump file could not be opened or the worker could not be started. The program is locked while
+  // simulating.
+  int                     start(ecmcGrblProgram *program, const char *dumpFile);
+
+  // Wait for simulation to finish
+  void                    wait();
+  bool                    busy();
+
+  // Result of last simulation
+  double                  getTime();        // Simulated time [s] (machining time estimate)
+  size_t                  getSamples();     // Simulated samples
+  size_t                  getLines();       // Code rows simulated
+  int                     getErrorCode();   // Grbl status code of first error (0 if none)
+  int                     getAlarmCode();   // Grbl alarm code (0 if none)
+  size_t                  getErrorRow();    // Code row of error or alarm
+
+  void                    doWorker();                                  // simulation thread
+  void                    doSample(double waitS);                      // simulation_wait()
+
+ private:
+  bool                    initContext();
+  void                    executeSample();
+  void                    readReplies();
+  uint8_t                 executeLine(std::string_view line);
+
+  struct grbl_context    *grblCtx_;          // Instance (source of settings and state)
+  struct grbl_context    *simulatorCtx_;     // Private context
+  std::string             threadSuffix_;
+  int                     plannerBufferSize_;
+  bool                    continuous_;
+  double                  sampleTimeMs_;
+  double                  timeToNextExeMs_;  // Carried tick time (step mode)
+  ecmcGrblProgram        *program_;
+  FILE                   *dumpFile_;
+  std::atomic<bool>       busy_;
+  std::atomic<bool>       abort_;
+  epicsEventId            doneEvent_;
+  size_t                  samples_;
+  size_t                  lines_;
+  size_t                  row_;
+  int                     errorCode_;
+  int                     alarmCode_;
+  size_t                  errorRow_;
+  std::string             reply_;            // Partial reply line from grbl
+};
+
+#endif  /* ECMC_GRBL_SIMULATOR_H_ */
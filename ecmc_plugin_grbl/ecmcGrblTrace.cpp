@@ -0,0 +1,240 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblTrace.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include "ecmcGrblTrace.h"
+#include "epicsThread.h"
+#include <stdexcept>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#define TRACE_MASK (ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS - 1)
+
+static_assert((ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS & TRACE_MASK) == 0,
+              "ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS must be a power of 2");
+static_assert(sizeof(ecmcGrblTraceRecord) == 80, "Trace record layout changed, update ECMC_GRBL_TRACE_VERSION");
+
+// Trace thread (drains ring buffer to file)
+void f_worker_trace(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: GRBL: ERROR: Worker trace thread ecmcGrblTrace object NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+  ecmcGrblTrace * traceObj = (ecmcGrblTrace*)obj;
+  traceObj->doWorker();
+}
+
+ecmcGrblTrace::ecmcGrblTrace(std::string fileName,
+                             std::string threadSuffix,
+                             int index,
+                             double sampleTimeMs,
+                             int preCycles,
+                             int postCycles) {
+  fileName_     = fileName;
+  index_        = index;
+  sampleTimeMs_ = sampleTimeMs;
+  head_         = 0;
+  tail_         = 0;
+  triggerAt_    = ECMC_PLUGIN_GRBL_TRACE_NO_TRIGGER;
+  lost_         = 0;
+  captures_     = 0;
+  file_         = NULL;
+  stop_         = false;
+
+  if(fileName_.empty()) {
+    throw std::invalid_argument("GRBL: ERROR: Invalid trace file name.");
+  }
+  if(preCycles < 0 || postCycles < 0 ||
+     preCycles + postCycles > ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS / 2) {
+    throw std::out_of_range("GRBL: ERROR: Invalid trace window (pre + post must be 0.." +
+                            std::to_string(ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS / 2) + " cycles).");
+  }
+  preCycles_  = preCycles;
+  postCycles_ = postCycles;
+  continuous_ = preCycles_ == 0 && postCycles_ == 0;
+
+  if(continuous_) {
+    if(!(file_ = openFile(fileName_)) || !writeHeader(file_, 0, 0)) {
+      throw std::runtime_error("GRBL: ERROR: Failed open trace file " + fileName_ + ".");
+    }
+  }
+  buffer_.resize(ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS);
+
+  if(!(doneEvent_ = epicsEventCreate(epicsEventEmpty))) {
+    throw std::runtime_error("GRBL: ERROR: Failed create event for trace.");
+  }
+  std::string threadname = "ecmc.grbl.trace" + threadSuffix;
+  if(epicsThreadCreate(threadname.c_str(), 0, 32768, f_worker_trace, this) == NULL) {
+    throw std::runtime_error("GRBL: ERROR: Failed create worker thread for trace.");
+  }
+}
+
+ecmcGrblTrace::~ecmcGrblTrace() {
+  stop_ = true;
+  epicsEventWait(doneEvent_);
+  epicsEventDestroy(doneEvent_);
+}
+
+// Never blocks. In continuous mode the record is dropped if the ring buffer is full.
+void ecmcGrblTrace::write(const ecmcGrblTraceRecord *record) {
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  if(continuous_ &&
+     head - tail_.load(std::memory_order_acquire) >= ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS) {
+    lost_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer_[head & TRACE_MASK] = *record;
+  head_.store(head + 1, std::memory_order_release);
+}
+
+// Returns true if accepted (not continuous mode and no capture in progress)
+bool ecmcGrblTrace::trigger() {
+  if(continuous_) {
+    return false;
+  }
+  uint64_t none = ECMC_PLUGIN_GRBL_TRACE_NO_TRIGGER;
+  return triggerAt_.compare_exchange_strong(none, head_.load(std::memory_order_relaxed),
+                                            std::memory_order_release);
+}
+
+size_t ecmcGrblTrace::getCaptures() {
+  return captures_;
+}
+
+uint64_t ecmcGrblTrace::getLost() {
+  return lost_;
+}
+
+void ecmcGrblTrace::doWorker() {
+  while(!stop_) {
+    epicsThreadSleep(ECMC_PLUGIN_GRBL_TRACE_POLL_S);
+    if(continuous_) {
+      drain();
+      continue;
+    }
+    uint64_t triggerAt = triggerAt_.load(std::memory_order_acquire);
+    if(triggerAt != ECMC_PLUGIN_GRBL_TRACE_NO_TRIGGER &&
+       head_.load(std::memory_order_acquire) >= triggerAt + postCycles_) {
+      capture(triggerAt);
+      triggerAt_.store(ECMC_PLUGIN_GRBL_TRACE_NO_TRIGGER, std::memory_order_release);
+    }
+  }
+  if(file_) {
+    drain();
+    fclose(file_);
+    file_ = NULL;
+  }
+  epicsEventSignal(doneEvent_);
+}
+
+FILE *ecmcGrblTrace::openFile(const std::string &fileName) {
+  FILE *file = fopen(fileName.c_str(), "wb");
+  if(!file) {
+    printf("GRBL: ERROR: Failed open trace file %s (%s).\n", fileName.c_str(), strerror(errno));
+  }
+  return file;
+}
+
+// Header at start of file (rewritten when lost records are updated)
+bool ecmcGrblTrace::writeHeader(FILE *file, uint64_t triggerRecord, uint64_t lostRecords) {
+  ecmcGrblTraceHeader header;
+  memset(&header, 0, sizeof(header));
+  strncpy(header.magic, ECMC_GRBL_TRACE_MAGIC, sizeof(header.magic));
+  header.version       = ECMC_GRBL_TRACE_VERSION;
+  header.recordSize    = sizeof(ecmcGrblTraceRecord);
+  header.mode          = continuous_ ? ECMC_GRBL_TRACE_MODE_CONTINUOUS : ECMC_GRBL_TRACE_MODE_TRIGGERED;
+  header.index         = index_;
+  header.sampleTimeMs  = sampleTimeMs_;
+  header.triggerRecord = triggerRecord;
+  header.lostRecords   = lostRecords;
+
+  long pos = ftell(file);
+  if(fseek(file, 0, SEEK_SET) || fwrite(&header, sizeof(header), 1, file) != 1) {
+    return false;
+  }
+  return pos <= 0 || !fseek(file, pos, SEEK_SET);
+}
+
+// Records [first, end) of ring buffer (at most two writes)
+bool ecmcGrblTrace::writeRecords(FILE *file, uint64_t first, uint64_t end) {
+  while(first < end) {
+    size_t index = first & TRACE_MASK;
+    size_t count = end - first;
+    if(count > ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS - index) {
+      count = ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS - index;
+    }
+    if(fwrite(&buffer_[index], sizeof(ecmcGrblTraceRecord), count, file) != count) {
+      return false;
+    }
+    first += count;
+  }
+  return true;
+}
+
+// Continuous mode: Append all new records
+void ecmcGrblTrace::drain() {
+  uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  if(head == tail) {
+    return;
+  }
+  bool ok = writeRecords(file_, tail, head);
+  tail_.store(head, std::memory_order_release);
+  if(!ok || !writeHeader(file_, 0, lost_) || fflush(file_)) {
+    printf("GRBL: ERROR: Failed write trace file %s (%s). Trace stopped.\n",
+           fileName_.c_str(), strerror(errno));
+    fclose(file_);
+    file_ = NULL;
+    stop_ = true;
+  }
+}
+
+// Triggered mode: Write window around trigger to new file
+void ecmcGrblTrace::capture(uint64_t triggerAt) {
+  uint64_t first  = triggerAt > preCycles_ ? triggerAt - preCycles_ : 0;
+  uint64_t end    = triggerAt + postCycles_;
+  uint64_t oldest = 0;
+  uint64_t lost   = 0;
+
+  // Start of window already overwritten (trace thread starved)
+  uint64_t head = head_.load(std::memory_order_acquire);
+  if(head > ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS) {
+    oldest = head - ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS;
+  }
+  if(first < oldest) {
+    lost  = oldest - first;
+    first = oldest;
+  }
+
+  std::string fileName = fileName_ + "." + std::to_string(captures_);
+  FILE *file = openFile(fileName);
+  if(!file) {
+    return;
+  }
+  bool ok = writeHeader(file, triggerAt - first, lost) && writeRecords(file, first, end);
+
+  // Records overwritten by the rt thread while copying
+  head = head_.load(std::memory_order_acquire);
+  if(head > ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS && head - ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS > first) {
+    oldest = head - ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS;
+    lost  += (oldest < end ? oldest : end) - first;
+    ok     = ok && writeHeader(file, triggerAt - first, lost);
+  }
+  if(fclose(file) || !ok) {
+    printf("GRBL: ERROR: Failed write trace file %s.\n", fileName.c_str());
+    return;
+  }
+  lost_ += lost;
+  captures_++;
+  printf("GRBL: INFO: Trace written to %s (%" PRIu64 " records).\n", fileName.c_str(), end - first);
+}
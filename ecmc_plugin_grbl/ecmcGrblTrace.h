@@ -0,0 +1,77 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblTrace.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_TRACE_H_
+#define ECMC_GRBL_TRACE_H_
+
+#include "ecmcGrblDefs.h"
+#include "ecmcGrblTraceFormat.h"
+#include <epicsEvent.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+
+// Rt trace (flight recorder) of the ecmc rt thread, one record per cycle (see ecmcGrblTraceFormat.h).
+// The rt thread writes records to a lock free single producer/single consumer ring buffer
+// (ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS records, no allocation, locks or io). A worker thread drains
+// the ring buffer to file:
+//  - Continuous (preCycles == postCycles == 0): All records are appended to fileName. Records are
+//    dropped (counted as lost) if the writer falls behind.
+//  - Triggered: The ring buffer is overwritten continuously. trigger() captures the window
+//    [trigger - preCycles, trigger + postCycles) to "<fileName>.<n>" (n counting captures).
+//    Triggers while a capture is in progress are ignored.
+class ecmcGrblTrace {
+ public:
+  ecmcGrblTrace(std::string fileName,
+                std::string threadSuffix,
+                int index,
+                double sampleTimeMs,
+                int preCycles,
+                int postCycles);
+  ~ecmcGrblTrace();
+
+  // ecmc rt thread
+  void                    write(const ecmcGrblTraceRecord *record);
+  bool                    trigger();          // Trigger at next written record (triggered mode)
+
+  // Status
+  size_t                  getCaptures();      // Files written (triggered mode)
+  uint64_t                getLost();          // Records lost (writer behind)
+
+  void                    doWorker();         // trace thread
+
+ private:
+  FILE                   *openFile(const std::string &fileName);
+  bool                    writeHeader(FILE *file, uint64_t triggerRecord, uint64_t lostRecords);
+  bool                    writeRecords(FILE *file, uint64_t first, uint64_t end);
+  void                    drain();
+  void                    capture(uint64_t triggerAt);
+
+  std::string             fileName_;
+  int                     index_;
+  double                  sampleTimeMs_;
+  uint64_t                preCycles_;
+  uint64_t                postCycles_;
+  bool                    continuous_;
+  std::vector<ecmcGrblTraceRecord> buffer_;  // ECMC_PLUGIN_GRBL_TRACE_BUFFER_RECORDS (power of 2)
+  std::atomic<uint64_t>   head_;             // Records written (rt thread)
+  std::atomic<uint64_t>   tail_;             // Records drained (continuous mode, trace thread)
+  std::atomic<uint64_t>   triggerAt_;        // Record of trigger, ECMC_PLUGIN_GRBL_TRACE_NO_TRIGGER if none
+  std::atomic<uint64_t>   lost_;
+  std::atomic<size_t>     captures_;
+  FILE                   *file_;             // Continuous mode
+  std::atomic<bool>       stop_;
+  epicsEventId            doneEvent_;
+};
+
+#endif  /* ECMC_GRBL_TRACE_H_ */
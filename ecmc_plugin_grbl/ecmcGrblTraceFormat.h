@@ -0,0 +1,59 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblTraceFormat.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_TRACE_FORMAT_H_
+#define ECMC_GRBL_TRACE_FORMAT_H_
+
+// Binary rt trace file format (see ecmcGrblTrace and tools/ecmcGrblTraceRead.cpp).
+// A file is one ecmcGrblTraceHeader followed by records of header.recordSize bytes, native byte
+// order (the reader checks the magic and version). Kept free of epics and grbl headers so the
+// reader tool can be built standalone.
+
+#include <stdint.h>
+
+#define ECMC_GRBL_TRACE_MAGIC "GRBLTRC"     // Including terminating zero (8 bytes)
+#define ECMC_GRBL_TRACE_VERSION 1           // Increase if the format changes
+#define ECMC_GRBL_TRACE_AXES 3              // X, Y, Z
+
+// ecmcGrblTraceHeader::mode
+#define ECMC_GRBL_TRACE_MODE_CONTINUOUS 0   // All cycles
+#define ECMC_GRBL_TRACE_MODE_TRIGGERED 1    // Window around one trigger
+
+// ecmcGrblTraceRecord::flags
+#define ECMC_GRBL_TRACE_FLAG_ERROR 0x01     // ecmc or plugin error active
+#define ECMC_GRBL_TRACE_FLAG_TRIGGER 0x02   // Trigger cycle
+#define ECMC_GRBL_TRACE_FLAG_EXECUTE 0x04   // Grbl executed (all axes enabled)
+
+typedef struct {
+  char        magic[8];         // ECMC_GRBL_TRACE_MAGIC
+  uint32_t    version;          // ECMC_GRBL_TRACE_VERSION
+  uint32_t    recordSize;       // sizeof(ecmcGrblTraceRecord)
+  uint32_t    mode;             // ECMC_GRBL_TRACE_MODE_*
+  uint32_t    index;            // Plugin object index
+  double      sampleTimeMs;     // ecmc sample time
+  uint64_t    triggerRecord;    // Record index of trigger in file (triggered mode)
+  uint64_t    lostRecords;      // Records lost before or inside this file (buffer overrun)
+} ecmcGrblTraceHeader;
+
+typedef struct {
+  uint64_t    cycle;            // rt cycle counter (gaps if records were lost)
+  int64_t     timeNs;           // CLOCK_REALTIME [ns]
+  double      setpoint[ECMC_GRBL_TRACE_AXES];  // Setpoints to ecmc, sys_position (STEP) or interpolated (CONTINUOUS) [mm]
+  double      actual[ECMC_GRBL_TRACE_AXES];    // ecmc actual positions read in readEcmcStatus() [mm]
+  float       spindleSpeed;     // [rpm]
+  uint32_t    segment;          // Segments loaded since stepper reset (segment index of executing segment)
+  int32_t     line;             // Line number (N) of executing block
+  uint8_t     state;            // grbl sys.state
+  uint8_t     flags;            // ECMC_GRBL_TRACE_FLAG_*
+  uint16_t    reserved;
+} ecmcGrblTraceRecord;
+
+#endif  /* ECMC_GRBL_TRACE_FORMAT_H_ */
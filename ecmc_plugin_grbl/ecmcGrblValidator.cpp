@@ -0,0 +1,326 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblValidator.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+#include "ecmcGrblValidator.h"
+#include "ecmcGrblProgram.h"
+#include "epicsThread.h"
+#include <stdexcept>
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+
+// Validation thread
+void f_worker_validate(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: GRBL: ERROR: Worker validate thread ecmcGrblValidator object NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+  ecmcGrblValidator * validatorObj = (ecmcGrblValidator*)obj;
+  validatorObj->doWorker();
+}
+
+// Parse threads
+void f_worker_parse(void *obj) {
+  if(!obj) {
+    printf("%s/%s:%d: GRBL: ERROR: Worker parse thread argument NULL..\n",
+            __FILE__, __FUNCTION__, __LINE__);
+    return;
+  }
+  ecmcGrblParseWorkerArg * arg = (ecmcGrblParseWorkerArg*)obj;
+  arg->validator->doParseWorker(arg->worker);
+}
+
+ecmcGrblValidator::ecmcGrblValidator(struct grbl_context *grblCtx, std::string threadSuffix) {
+  grblCtx_       = grblCtx;
+  validatorCtx_  = NULL;
+  threadSuffix_  = threadSuffix;
+  program_       = NULL;
+  busy_          = false;
+  lines_         = 0;
+  skipped_       = 0;
+  softLimits_    = 0;
+  parseWorkers_  = 0;
+  parseStop_     = false;
+  parseFirst_    = 0;
+  parseCount_    = 0;
+  parseBuffer_   = NULL;
+
+  if(!(resultMutex_ = epicsMutexCreate())) {
+    throw std::runtime_error("GRBL: ERROR: Failed create mutex for validation.");
+  }
+  if(!(doneEvent_ = epicsEventCreate(epicsEventEmpty))) {
+    throw std::runtime_error("GRBL: ERROR: Failed create event for validation.");
+  }
+  for(int i = 0; i < ECMC_PLUGIN_GRBL_VALIDATE_MAX_WORKERS; i++) {
+    parseArgs_[i].validator = this;
+    parseArgs_[i].worker    = i;
+    parseStartEvent_[i]     = epicsEventCreate(epicsEventEmpty);
+    parseDoneEvent_[i]      = epicsEventCreate(epicsEventEmpty);
+    if(!parseStartEvent_[i] || !parseDoneEvent_[i]) {
+      throw std::runtime_error("GRBL: ERROR: Failed create event for validation.");
+    }
+  }
+}
+
+ecmcGrblValidator::~ecmcGrblValidator() {
+  wait();
+  for(int i = 0; i < ECMC_PLUGIN_GRBL_VALIDATE_MAX_WORKERS; i++) {
+    epicsEventDestroy(parseStartEvent_[i]);
+    epicsEventDestroy(parseDoneEvent_[i]);
+  }
+  epicsEventDestroy(doneEvent_);
+  epicsMutexDestroy(resultMutex_);
+}
+
+int ecmcGrblValidator::start(ecmcGrblProgram *program) {
+  bool idle = false;
+  if(!busy_.compare_exchange_strong(idle, true)) {
+    return EBUSY;
+  }
+
+  program->lock();
+  bool streamed = program->isStreamed();
+  program->unlock();
+  if(streamed) {
+    busy_ = false;
+    return ENOTSUP;
+  }
+
+  program_ = program;
+  epicsMutexLock(resultMutex_);
+  errors_.clear();
+  lines_   = 0;
+  skipped_ = 0;
+  epicsMutexUnlock(resultMutex_);
+
+  std::string threadname = "ecmc.grbl.validate" + threadSuffix_;
+  if(epicsThreadCreate(threadname.c_str(), 0, 32768, f_worker_validate, this) == NULL) {
+    busy_ = false;
+    return EAGAIN;
+  }
+  return 0;
+}
+
+void ecmcGrblValidator::wait() {
+  while(busy_) {
+    epicsEventWaitWithTimeout(doneEvent_, 0.1);
+  }
+}
+
+bool ecmcGrblValidator::busy() {
+  return busy_;
+}
+
+size_t ecmcGrblValidator::getLines() {
+  return lines_;
+}
+
+size_t ecmcGrblValidator::getSkipped() {
+  return skipped_;
+}
+
+size_t ecmcGrblValidator::getErrorCount() {
+  epicsMutexLock(resultMutex_);
+  size_t count = errors_.size();
+  epicsMutexUnlock(resultMutex_);
+  return count;
+}
+
+std::vector<ecmcGrblValidationError> ecmcGrblValidator::getErrors() {
+  epicsMutexLock(resultMutex_);
+  std::vector<ecmcGrblValidationError> errors = errors_;
+  epicsMutexUnlock(resultMutex_);
+  return errors;
+}
+
+void ecmcGrblValidator::addError(size_t row, int code) {
+  epicsMutexLock(resultMutex_);
+  errors_.push_back({(unsigned int)row, code});
+  epicsMutexUnlock(resultMutex_);
+}
+
+// Filter and parse one line (same dispatch as protocol_execute_line()). Any thread.
+void ecmcGrblValidator::parseLine(std::string_view line, validatorLine *parsed) {
+  char filtered[LINE_BUFFER_SIZE];
+  parsed->kind   = ECMC_PLUGIN_GRBL_VALIDATE_LINE_EMPTY;
+  parsed->status = STATUS_OK;
+  if(ecmc_filter_line(filtered, line.data(), line.length())) {
+    parsed->kind   = ECMC_PLUGIN_GRBL_VALIDATE_LINE_ERROR;
+    parsed->status = STATUS_OVERFLOW;
+  } else if(filtered[0] == '$') {
+    parsed->kind   = ECMC_PLUGIN_GRBL_VALIDATE_LINE_SYSTEM;
+  } else if(filtered[0] != '0' && strlen(filtered) > 1) {
+    parsed->status = gc_parse_line(filtered, &parsed->block);
+    parsed->kind   = parsed->status == STATUS_OK ? ECMC_PLUGIN_GRBL_VALIDATE_LINE_PARSED :
+                                                   ECMC_PLUGIN_GRBL_VALIDATE_LINE_ERROR;
+  }
+}
+
+// Parse lines first..first+count-1 into buffer (split over parse workers)
+void ecmcGrblValidator::parseStart(size_t first, size_t count, validatorLine *buffer) {
+  parseFirst_  = first;
+  parseCount_  = count;
+  parseBuffer_ = buffer;
+  if(parseWorkers_ == 0) {
+    for(size_t i = 0; i < count; i++) {
+      parseLine(program_->getLine(first + i), &buffer[i]);
+    }
+    return;
+  }
+  for(int i = 0; i < parseWorkers_; i++) {
+    epicsEventSignal(parseStartEvent_[i]);
+  }
+}
+
+void ecmcGrblValidator::parseWait() {
+  for(int i = 0; i < parseWorkers_; i++) {
+    epicsEventWait(parseDoneEvent_[i]);
+  }
+}
+
+void ecmcGrblValidator::doParseWorker(int worker) {
+  for(;;) {
+    epicsEventWait(parseStartEvent_[worker]);
+    if(parseStop_) {
+      epicsEventSignal(parseDoneEvent_[worker]);
+      return;
+    }
+    // Program is locked by the validation thread (read only access)
+    size_t first = parseCount_ * worker / parseWorkers_;
+    size_t end   = parseCount_ * (worker + 1) / parseWorkers_;
+    for(size_t i = first; i < end; i++) {
+      parseLine(program_->getLine(parseFirst_ + i), &parseBuffer_[i]);
+    }
+    epicsEventSignal(parseDoneEvent_[worker]);
+  }
+}
+
+// Private grbl context in check mode with a copy of the state of the instance
+bool ecmcGrblValidator::initContext() {
+  if(!(validatorCtx_ = grbl_context_create())) {
+    return false;
+  }
+  grbl_context_bind(grblCtx_);
+  grbl_context_lock_state(grblCtx_);  // Consistent with the grbl main thread
+  settings_t     instanceSettings = settings;
+  parser_state_t instanceState    = gc_state;
+  memcpy(validatorCtx_->eeprom_buffer, grblCtx_->eeprom_buffer, EEPROM_MEM_SIZE);  // coordinate systems
+  grbl_context_unlock_state(grblCtx_);
+  grbl_context_bind(validatorCtx_);
+  settings = instanceSettings;
+  gc_state = instanceState;
+
+  // Soft limits are checked after each line instead (limits_soft_check() waits for reset)
+  softLimits_ = bit_istrue(settings.flags, BITFLAG_SOFT_LIMIT_ENABLE);
+  bit_false(settings.flags, BITFLAG_SOFT_LIMIT_ENABLE);
+
+  plan_reset();
+  sys.state = STATE_CHECK_MODE;
+  validatorCtx_->simulation_wait = grbl_context_no_wait;
+  validatorCtx_->simulation_arg  = NULL;
+  return true;
+}
+
+// Error-check parsed lines in order (validation thread, private context bound)
+void ecmcGrblValidator::checkBatch(size_t first, size_t count, validatorLine *buffer) {
+  char discard[TX_BUFFER_SIZE];
+  for(size_t i = 0; i < count; i++) {
+    validatorLine *line = &buffer[i];
+    uint8_t status = STATUS_OK;
+    if(line->kind == ECMC_PLUGIN_GRBL_VALIDATE_LINE_PARSED) {
+      real_t position[N_AXIS];
+      memcpy(position, gc_state.position, sizeof(position));
+      status = gc_execute_parsed_line(&line->block);
+      if(status == STATUS_OK && softLimits_ && memcmp(position, gc_state.position, sizeof(position)) &&
+         system_check_travel_limits(gc_state.position)) {
+        status = STATUS_TRAVEL_EXCEEDED;  // Motion to outside of travel
+      }
+    } else if(line->kind == ECMC_PLUGIN_GRBL_VALIDATE_LINE_ERROR) {
+      status = line->status;
+    } else if(line->kind == ECMC_PLUGIN_GRBL_VALIDATE_LINE_SYSTEM) {
+      skipped_++;
+    }
+    if(status != STATUS_OK) {
+      addError(first + i, status);
+    }
+    // Discard messages (for instance program end)
+    while(ecmc_read_from_grbl_tx_buffer(discard, sizeof(discard)) > 0) {}
+  }
+}
+
+void ecmcGrblValidator::doWorker() {
+  program_->lock();
+
+  // Start parse workers (parse in this thread if none could be started)
+  int cpus = (int)epicsThreadGetCPUs();
+  int workers = std::min(std::max(cpus - 1, 1), ECMC_PLUGIN_GRBL_VALIDATE_MAX_WORKERS);
+  parseStop_    = false;
+  parseWorkers_ = 0;
+  for(int i = 0; i < workers; i++) {
+    std::string threadname = "ecmc.grbl.parse" + threadSuffix_ + "." + std::to_string(i);
+    if(epicsThreadCreate(threadname.c_str(), 0, 32768, f_worker_parse, &parseArgs_[i]) == NULL) {
+      break;
+    }
+    parseWorkers_++;
+  }
+
+  size_t lines = program_->isStreamed() ? 0 : program_->size();
+  if(!initContext()) {
+    printf("%s/%s:%d: GRBL: ERROR: Failed allocate grbl context for validation.\n",
+           __FILE__, __FUNCTION__, __LINE__);
+    addError(0, STATUS_SETTING_READ_FAIL);
+    lines = 0;
+  }
+
+  // Parse one batch ahead while checking current batch
+  size_t batch = ECMC_PLUGIN_GRBL_VALIDATE_BATCH_LINES;
+  buffers_[0].resize(std::min(batch, lines));
+  buffers_[1].resize(std::min(batch, lines));
+  if(lines > 0) {
+    parseStart(0, std::min(batch, lines), buffers_[0].data());
+    parseWait();
+  }
+  int current = 0;
+  for(size_t first = 0; first < lines; first += batch) {
+    size_t count = std::min(batch, lines - first);
+    size_t next  = first + count;
+    if(next < lines) {
+      parseStart(next, std::min(batch, lines - next), buffers_[1 - current].data());
+    }
+    checkBatch(first, count, buffers_[current].data());
+    if(next < lines) {
+      parseWait();
+    }
+    current = 1 - current;
+  }
+
+  // Stop parse workers
+  parseStop_ = true;
+  for(int i = 0; i < parseWorkers_; i++) {
+    epicsEventSignal(parseStartEvent_[i]);
+  }
+  parseWait();
+  parseWorkers_ = 0;
+
+  grbl_context_bind(NULL);
+  grbl_context_delete(validatorCtx_);
+  validatorCtx_ = NULL;
+  buffers_[0].clear();
+  buffers_[0].shrink_to_fit();
+  buffers_[1].clear();
+  buffers_[1].shrink_to_fit();
+  lines_ = lines;
+  program_->unlock();
+  busy_ = false;
+  epicsEventSignal(doneEvent_);
+}
@@ -0,0 +1,112 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblValidator.h
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+#ifndef ECMC_GRBL_VALIDATOR_H_
+#define ECMC_GRBL_VALIDATOR_H_
+
+#include "ecmcGrblDefs.h"
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+extern "C" {
+#include "grbl.h"
+}
+
+class ecmcGrblProgram;
+class ecmcGrblValidator;
+
+// Error found by validation
+typedef struct {
+  unsigned int  row;    // Code row (program line index, same as grbl_get_code_row_num())
+  int           code;   // Grbl status code (error:<code>)
+} ecmcGrblValidationError;
+
+// Argument of parse threads
+typedef struct {
+  ecmcGrblValidator    *validator;
+  int                   worker;
+} ecmcGrblParseWorkerArg;
+
+// Offline program validation.
+// Runs all lines of a program through the g-code parser in check mode ($C) on a private grbl context
+// (copy of the settings, coordinate systems and parser state of the grbl instance), so nothing moves
+// and the instance is not affected. All errors are collected with their code rows.
+// Validation runs in a worker thread in batches of ECMC_PLUGIN_GRBL_VALIDATE_BATCH_LINES lines. The
+// parsing of the lines does not depend on the modal state and is split over parallel parse workers
+// (one batch ahead), the state dependent error-checking is done in order by the validation thread.
+// '$' system commands are skipped (not validated). Soft limits are checked for the end point of each
+// motion if enabled in the grbl settings. Streamed files are not supported.
+class ecmcGrblValidator {
+ public:
+  ecmcGrblValidator(struct grbl_context *grblCtx, std::string threadSuffix);
+  ~ecmcGrblValidator();
+
+  // Start validation of program. Returns 0, EBUSY if a validation is running, ENOTSUP for a streamed
+  // program or errno if the worker could not be started. The program is locked while validating.
+  int                     start(ecmcGrblProgram *program);
+
+  // Wait for validation to finish
+  void                    wait();
+  bool                    busy();
+
+  // Result of last validation
+  size_t                  getLines();          // Lines validated
+  size_t                  getSkipped();        // '$' lines skipped
+  size_t                  getErrorCount();
+  std::vector<ecmcGrblValidationError> getErrors();
+
+  void                    doWorker();                   // validation thread
+  void                    doParseWorker(int worker);    // parse threads
+
+ private:
+  typedef struct {
+    uint8_t               kind;     // ECMC_PLUGIN_GRBL_VALIDATE_LINE_*
+    uint8_t               status;   // Status for ECMC_PLUGIN_GRBL_VALIDATE_LINE_ERROR
+    gc_parsed_line_t      block;
+  } validatorLine;
+
+  static void             parseLine(std::string_view line, validatorLine *parsed);
+  void                    parseStart(size_t first, size_t count, validatorLine *buffer);
+  void                    parseWait();
+  bool                    initContext();
+  void                    checkBatch(size_t first, size_t count, validatorLine *buffer);
+  void                    addError(size_t row, int code);
+
+  struct grbl_context    *grblCtx_;          // Instance (source of settings and state)
+  struct grbl_context    *validatorCtx_;     // Private context (check mode)
+  std::string             threadSuffix_;
+  ecmcGrblProgram        *program_;
+  std::atomic<bool>       busy_;
+  epicsEventId            doneEvent_;
+  epicsMutexId            resultMutex_;
+  std::vector<ecmcGrblValidationError> errors_;
+  size_t                  lines_;
+  size_t                  skipped_;
+  uint8_t                 softLimits_;
+
+  // Parse workers
+  int                     parseWorkers_;
+  ecmcGrblParseWorkerArg  parseArgs_[ECMC_PLUGIN_GRBL_VALIDATE_MAX_WORKERS];
+  epicsEventId            parseStartEvent_[ECMC_PLUGIN_GRBL_VALIDATE_MAX_WORKERS];
+  epicsEventId            parseDoneEvent_[ECMC_PLUGIN_GRBL_VALIDATE_MAX_WORKERS];
+  bool                    parseStop_;
+  size_t                  parseFirst_;
+  size_t                  parseCount_;
+  validatorLine          *parseBuffer_;
+  std::vector<validatorLine> buffers_[2];
+};
+
+#endif  /* ECMC_GRBL_VALIDATOR_H_ */
@@ -19,6 +19,7 @@
 #include "ecmcGrbl.h"
 #include "ecmcGrblDefs.h"
 #include "ecmcGrblWrap.h"
+#include "ecmcPluginClient.h"
 #include <epicsTypes.h>
 #include <epicsTime.h>
 #include <epicsThread.h>
@@ -34,124 +35,195 @@
 #define ECMC_PLUGIN_MAX_PORTNAME_CHARS 64
 #define ECMC_PLUGIN_PORTNAME_PREFIX "PLUGIN.GRBL"
 
-static ecmcGrbl*  grbl = NULL;
+// All grbl objects (index 0 created at plugin load, others by ecmcGrblCreateInstance())
+static std::vector<ecmcGrbl*> grbls;
 static char  portNameBuffer[ECMC_PLUGIN_MAX_PORTNAME_CHARS];
+static int   grblExeSampleTimeMs = 0;
 
-int createGrbl(char* configStr, int exeSampleTimeMs) {
+static ecmcGrbl* getGrbl(int index) {
+  if(index < 0 || index >= (int)grbls.size()) {
+    return NULL;
+  }
+  return grbls[index];
+}
 
-  // create asynport name for new object ()
+static int newGrbl(char* configStr) {
+  int index = (int)grbls.size();
+  // create asynport name for new object (first object without index)
   memset(portNameBuffer, 0, ECMC_PLUGIN_MAX_PORTNAME_CHARS);
-  snprintf (portNameBuffer, ECMC_PLUGIN_MAX_PORTNAME_CHARS,
-            ECMC_PLUGIN_PORTNAME_PREFIX);
+  if(index == 0) {
+    snprintf (portNameBuffer, ECMC_PLUGIN_MAX_PORTNAME_CHARS,
+              ECMC_PLUGIN_PORTNAME_PREFIX);
+  } else {
+    snprintf (portNameBuffer, ECMC_PLUGIN_MAX_PORTNAME_CHARS,
+              ECMC_PLUGIN_PORTNAME_PREFIX "%d", index);
+  }
+  ecmcGrbl* grbl = NULL;
   try {
-    grbl = new ecmcGrbl(configStr, portNameBuffer, exeSampleTimeMs);
+    grbl = new ecmcGrbl(configStr, portNameBuffer, grblExeSampleTimeMs, index);
   }
   catch(std::exception& e) {
     if(grbl) {
       delete grbl;
     }
-    printf("Exception: %s. Plugin will unload.\n",e.what());
+    printf("Exception: %s.\n",e.what());
+    return -1;
+  }
+  grbls.push_back(grbl);
+  return index;
+}
+
+int createGrbl(char* configStr, int exeSampleTimeMs) {
+  grblExeSampleTimeMs = exeSampleTimeMs;
+  if(newGrbl(configStr) < 0) {
+    printf("Plugin will unload.\n");
     return ECMC_PLUGIN_GRBL_GENERAL_ERROR_CODE;
   }
-  
   return 0;
 }
 
+int createGrblInstance(char* configStr) {
+  if(grbls.empty()) {
+    return -1;
+  }
+  return newGrbl(configStr);
+}
+
+int getGrblInstanceCount() {
+  return (int)grbls.size();
+}
+
 int enterRT() {
-  if(grbl){
-    return grbl->enterRT();
+  int errorCode = 0;
+  for(size_t i = 0; i < grbls.size(); i++) {
+    int err = grbls[i]->enterRT();
+    if(err && !errorCode) {
+      errorCode = err;
+    }
   }
-  return 0;
+  return errorCode;
 }
 
 int realtime(int ecmcError) {
-  if(grbl){
-    return grbl->grblRTexecute(ecmcError);
+  int errorCode = 0;
+  for(size_t i = 0; i < grbls.size(); i++) {
+    int err = grbls[i]->grblRTexecute(ecmcError);
+    if(err && !errorCode) {
+      errorCode = err;
+    }
   }
-  return 0;
+  return errorCode;
 }
 
-int setExecute(int exe) {
+int setExecute(int index, int exe) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->setExecute(exe);
   }
   return 0;
 }
 
-int setHalt(int halt) {
+int setHalt(int index, int halt) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->setHalt(halt);
   }
   return 0;
 }
 
-int setResume(int resume) {
+int setResume(int index, int resume) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->setResume(resume);
   }
   return 0;
 }
 
-int getBusy() {
+int getBusy(int index) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->getBusy();
   }
   return 0;
 }
 
-int getParserBusy() {
+int getParserBusy(int index) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->getParserBusy();
   }
   return 0;
 }
 
-int getCodeRowNum() {
+int getCodeRowNum(int index) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->getCodeRowNum();
   }
   return 0;
 }
 
-int setReset(int reset) {
+int setReset(int index, int reset) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->setReset(reset);
   }
   return 0;
 }
 
-int getError() {
+int getError(int index) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->getError();
   }
   return 0;
 }
 
-int resetError() {
+int resetError(int index) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     grbl->resetError();
   }
   return 0;
 }
 
-int setAllAxesEnable(int enable) { 
+int setAllAxesEnable(int index, int enable) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     grbl->setAllAxesEnable(enable);
   }
   return 0;
 }
 
-int getAllAxesEnabled() { 
+int getAllAxesEnabled(int index) {
+  ecmcGrbl* grbl = getGrbl(index);
   if(grbl){
     return grbl->getAllAxesEnabled();
   }
   return 0;
 }
 
+double getAxisFFVelocity(int index, int axis) {
+  ecmcGrbl* grbl = getGrbl(index);
+  if(grbl){
+    return grbl->getAxisFFVelocity(axis);
+  }
+  return 0;
+}
+
+double getAxisFFAcceleration(int index, int axis) {
+  ecmcGrbl* grbl = getGrbl(index);
+  if(grbl){
+    return grbl->getAxisFFAcceleration(axis);
+  }
+  return 0;
+}
+
 void deleteGrbl() {
-  if(grbl) {
-    delete (grbl);
+  for(size_t i = 0; i < grbls.size(); i++) {
+    delete (grbls[i]);
   }
+  grbls.clear();
 }
 
 /** 
@@ -160,12 +232,13 @@ void deleteGrbl() {
 
 void ecmcGrblAddCommandPrintHelp() {
   printf("\n");
-  printf("       Use ecmcGrblAddCommand(<command>)\n");
+  printf("       Use ecmcGrblAddCommand(<command>,<instance>)\n");
   printf("          <command>                      : Grbl command.\n");
+  printf("          <instance>                     : Grbl instance index (default 0).\n");
   printf("\n");
 }
 
-int ecmcGrblAddCommand(const char* command) {
+int ecmcGrblAddCommand(const char* command, int index) {
 
   if(!command) {
     printf("Error: command.\n");
@@ -178,8 +251,9 @@ int ecmcGrblAddCommand(const char* command) {
     return asynSuccess;
   }
 
+  ecmcGrbl* grbl = getGrbl(index);
   if(!grbl) {
-    printf("Plugin not initialized/loaded.\n");
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
     return asynError;
   }
 
@@ -197,11 +271,15 @@ int ecmcGrblAddCommand(const char* command) {
 static const iocshArg initArg0_0 =
 { " Grbl Command", iocshArgString };
 
-static const iocshArg *const initArgs_0[]  = { &initArg0_0};
+static const iocshArg initArg1_0 =
+{ " Instance", iocshArgInt };
+
+static const iocshArg *const initArgs_0[]  = { &initArg0_0,
+                                               &initArg1_0};
 
-static const iocshFuncDef    initFuncDef_0 = { "ecmcGrblAddCommand", 1, initArgs_0 };
+static const iocshFuncDef    initFuncDef_0 = { "ecmcGrblAddCommand", 2, initArgs_0 };
 static void initCallFunc_0(const iocshArgBuf *args) {
-  ecmcGrblAddCommand(args[0].sval);
+  ecmcGrblAddCommand(args[0].sval,args[1].ival);
 }
 
 /** 
@@ -210,15 +288,16 @@ static void initCallFunc_0(const iocshArgBuf *args) {
 
 void ecmcGrblLoadFilePrintHelp() {
   printf("\n");
-  printf("       Use ecmcGrblLoadGCodeFile(<filename>,<append>)\n");
+  printf("       Use ecmcGrblLoadGCodeFile(<filename>,<append>,<instance>)\n");
   printf("          <filename>             : Filename containg g-code.\n");
   printf("          <append>               : 0: reset grbl, clear all current commands in buffer before \n"); 
   printf ("                                     loading file (default).\n");
   printf("                                 : 1: append commands in file last in buffer. (grbl is not reset)\n");
+  printf("          <instance>             : Grbl instance index (default 0).\n");
   printf("\n");
 }
 
-int ecmcGrblLoadFile(const char* filename, int append) {
+int ecmcGrblLoadFile(const char* filename, int append, int index) {
 
   if(!filename) {
     printf("Error: filename.\n");
@@ -231,8 +310,9 @@ int ecmcGrblLoadFile(const char* filename, int append) {
     return asynSuccess;
   }
 
+  ecmcGrbl* grbl = getGrbl(index);
   if(!grbl) {
-    printf("Plugin not initialized/loaded.\n");
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
     return asynError;
   }
 
@@ -252,17 +332,246 @@ static const iocshArg initArg0_1 =
 static const iocshArg initArg1_1 =
 { " Append", iocshArgInt };
 
+static const iocshArg initArg2_1 =
+{ " Instance", iocshArgInt };
+
 static const iocshArg *const initArgs_1[]  = { &initArg0_1,
-                                               &initArg1_1};
+                                               &initArg1_1,
+                                               &initArg2_1};
 
-static const iocshFuncDef    initFuncDef_1 = { "ecmcGrblLoadGCodeFile", 2, initArgs_1 };
+static const iocshFuncDef    initFuncDef_1 = { "ecmcGrblLoadGCodeFile", 3, initArgs_1 };
 static void initCallFunc_1(const iocshArgBuf *args) {
-  ecmcGrblLoadFile(args[0].sval,args[1].ival);
+  ecmcGrblLoadFile(args[0].sval,args[1].ival,args[2].ival);
+}
+
+/** 
+ * EPICS iocsh shell command: ecmcGrblStreamGCodeFile
+*/
+
+void ecmcGrblStreamFilePrintHelp() {
+  printf("\n");
+  printf("       Use ecmcGrblStreamGCodeFile(<filename>,<instance>)\n");
+  printf("          <filename>             : Filename containg g-code.\n");
+  printf("          <instance>             : Grbl instance index (default 0).\n");
+  printf("\n");
+  printf("       Clears all current commands in buffer and streams the file: Execution can start directly,\n");
+  printf("       lines are read in a bounded window ahead of the executing line. Memory use does not\n");
+  printf("       depend on the file size. No commands can be added after a streamed file.\n");
+  printf("\n");
+}
+
+int ecmcGrblStreamFile(const char* filename, int index) {
+
+  if(!filename) {
+    printf("Error: filename.\n");
+    ecmcGrblStreamFilePrintHelp();
+    return asynError;
+  }
+
+  if(strcmp(filename,"-h") == 0 || strcmp(filename,"--help") == 0 ) {
+    ecmcGrblStreamFilePrintHelp();
+    return asynSuccess;
+  }
+
+  ecmcGrbl* grbl = getGrbl(index);
+  if(!grbl) {
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
+    return asynError;
+  }
+
+  try {
+    grbl->streamGCodeFile(filename);
+  }
+  catch(std::exception& e) {
+    printf("Exception: %s. Stream file command failed.\n",e.what());
+    return asynError;
+  }
+  
+  return asynSuccess;
+}
+
+static const iocshArg initArg0_5 =
+{ " Filename", iocshArgString };
+
+static const iocshArg initArg1_5 =
+{ " Instance", iocshArgInt };
+
+static const iocshArg *const initArgs_5[]  = { &initArg0_5,
+                                               &initArg1_5};
+
+static const iocshFuncDef    initFuncDef_5 = { "ecmcGrblStreamGCodeFile", 2, initArgs_5 };
+static void initCallFunc_5(const iocshArgBuf *args) {
+  ecmcGrblStreamFile(args[0].sval,args[1].ival);
+}
+
+/** 
+ * EPICS iocsh shell command: ecmcGrblCompileGCode
+*/
+
+void ecmcGrblCompilePrintHelp() {
+  printf("\n");
+  printf("       Use ecmcGrblCompileGCode(<cachedir>,<instance>)\n");
+  printf("          <cachedir>             : Directory for block cache files.\n");
+  printf("          <instance>             : Grbl instance index (default 0).\n");
+  printf("\n");
+  printf("       Parses all lines of the loaded program once and stores the parsed blocks in a cache\n");
+  printf("       file named by a hash of the program. If the file already exists (same program compiled\n");
+  printf("       before) it is used directly. The parsed blocks are then executed without parsing the\n");
+  printf("       text again. Use after the program is loaded (not supported for streamed files).\n");
+  printf("\n");
+}
+
+int ecmcGrblCompile(const char* cacheDir, int index) {
+
+  if(!cacheDir) {
+    printf("Error: cachedir.\n");
+    ecmcGrblCompilePrintHelp();
+    return asynError;
+  }
+
+  if(strcmp(cacheDir,"-h") == 0 || strcmp(cacheDir,"--help") == 0 ) {
+    ecmcGrblCompilePrintHelp();
+    return asynSuccess;
+  }
+
+  ecmcGrbl* grbl = getGrbl(index);
+  if(!grbl) {
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
+    return asynError;
+  }
+
+  try {
+    grbl->compileGCode(cacheDir);
+  }
+  catch(std::exception& e) {
+    printf("Exception: %s. Compile command failed.\n",e.what());
+    return asynError;
+  }
+  
+  return asynSuccess;
+}
+
+static const iocshArg initArg0_6 =
+{ " Cachedir", iocshArgString };
+
+static const iocshArg initArg1_6 =
+{ " Instance", iocshArgInt };
+
+static const iocshArg *const initArgs_6[]  = { &initArg0_6,
+                                               &initArg1_6};
+
+static const iocshFuncDef    initFuncDef_6 = { "ecmcGrblCompileGCode", 2, initArgs_6 };
+static void initCallFunc_6(const iocshArgBuf *args) {
+  ecmcGrblCompile(args[0].sval,args[1].ival);
+}
+
+/** 
+ * EPICS iocsh shell command: ecmcGrblValidateGCode
+*/
+
+void ecmcGrblValidatePrintHelp() {
+  printf("\n");
+  printf("       Use ecmcGrblValidateGCode(<instance>)\n");
+  printf("          <instance>             : Grbl instance index (default 0).\n");
+  printf("\n");
+  printf("       Checks all lines of the loaded program in grbl check mode ($C) on a private copy of\n");
+  printf("       the grbl state (nothing moves). All errors are printed with code row and grbl error\n");
+  printf("       code. Not supported for streamed files.\n");
+  printf("\n");
+}
+
+int ecmcGrblValidate(int index) {
+
+  ecmcGrbl* grbl = getGrbl(index);
+  if(!grbl) {
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
+    ecmcGrblValidatePrintHelp();
+    return asynError;
+  }
+
+  try {
+    if(grbl->validateGCode(true) > 0) {
+      return asynError;
+    }
+  }
+  catch(std::exception& e) {
+    printf("Exception: %s. Validate command failed.\n",e.what());
+    return asynError;
+  }
+  
+  return asynSuccess;
+}
+
+static const iocshArg initArg0_7 =
+{ " Instance", iocshArgInt };
+
+static const iocshArg *const initArgs_7[]  = { &initArg0_7};
+
+static const iocshFuncDef    initFuncDef_7 = { "ecmcGrblValidateGCode", 1, initArgs_7 };
+static void initCallFunc_7(const iocshArgBuf *args) {
+  ecmcGrblValidate(args[0].ival);
+}
+
+/** 
+ * EPICS iocsh shell command: ecmcGrblSimulateGCode
+*/
+
+void ecmcGrblSimulatePrintHelp() {
+  printf("\n");
+  printf("       Use ecmcGrblSimulateGCode(<dumpfile>,<instance>)\n");
+  printf("          <dumpfile>             : Trajectory file (optional, \"\" for none).\n");
+  printf("          <instance>             : Grbl instance index (default 0).\n");
+  printf("\n");
+  printf("       Runs the loaded program through the grbl planner and stepper on a private copy of the\n");
+  printf("       grbl state (nothing moves) as fast as possible and prints the machining time estimate.\n");
+  printf("       If <dumpfile> is set, position, velocity and code row are written for each ecmc sample:\n");
+  printf("         <time[s]> <x> <y> <z> [mm] <vx> <vy> <vz> [mm/s] <code row>\n");
+  printf("       Stops at the first error or alarm. Not supported for streamed files.\n");
+  printf("\n");
+}
+
+int ecmcGrblSimulate(const char* dumpFile, int index) {
+
+  if(dumpFile && (strcmp(dumpFile,"-h") == 0 || strcmp(dumpFile,"--help") == 0)) {
+    ecmcGrblSimulatePrintHelp();
+    return asynSuccess;
+  }
+
+  ecmcGrbl* grbl = getGrbl(index);
+  if(!grbl) {
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
+    ecmcGrblSimulatePrintHelp();
+    return asynError;
+  }
+
+  try {
+    grbl->simulateGCode(dumpFile ? dumpFile : "", true);
+  }
+  catch(std::exception& e) {
+    printf("Exception: %s. Simulate command failed.\n",e.what());
+    return asynError;
+  }
+  
+  return asynSuccess;
+}
+
+static const iocshArg initArg0_8 =
+{ " Dumpfile", iocshArgString };
+
+static const iocshArg initArg1_8 =
+{ " Instance", iocshArgInt };
+
+static const iocshArg *const initArgs_8[]  = { &initArg0_8,
+                                               &initArg1_8};
+
+static const iocshFuncDef    initFuncDef_8 = { "ecmcGrblSimulateGCode", 2, initArgs_8 };
+static void initCallFunc_8(const iocshArgBuf *args) {
+  ecmcGrblSimulate(args[0].sval,args[1].ival);
 }
 
 /*
 $11 - Junction deviation, mm
-$12 – Arc tolerance, mm
+$12 – Arc tolerance, mm (not used with native arcs, ARC_NATIVE_BLOCKS)
 $30 - Max spindle speed, RPM
 $31 - Min spindle speed, RPM
 $100, $101 and $102 – [X,Y,Z] steps/mm
@@ -275,12 +584,13 @@ $120, $121, $122 – [X,Y,Z] Acceleration, mm/sec^2*/
 
 void ecmcGrblAddConfigPrintHelp() {
   printf("\n");
-  printf("       Use ecmcGrblAddConfig(<command>)\n");
+  printf("       Use ecmcGrblAddConfig(<command>,<instance>)\n");
   printf("          <command>                      : Grbl command.\n");
+  printf("          <instance>                     : Grbl instance index (default 0).\n");
   printf("\n");
   printf("       Supported grbl comamnds:\n");
   printf("          $11 - Junction deviation, mm\n");
-  printf("          $12 – Arc tolerance, mm\n");
+  printf("          $12 – Arc tolerance, mm (not used with native arcs, ARC_NATIVE_BLOCKS)\n");
   printf("          $30 - Max spindle speed, RPM\n");
   printf("          $31 - Min spindle speed, RPM\n");
   printf("          $100, $101 and $102 – [X,Y,Z] steps/mm\n");
@@ -292,7 +602,7 @@ void ecmcGrblAddConfigPrintHelp() {
   printf("\n");
 }
 
-int ecmcGrblAddConfig(const char* command) {
+int ecmcGrblAddConfig(const char* command, int index) {
 
   if(!command) {
     printf("Error: command.\n");
@@ -305,8 +615,9 @@ int ecmcGrblAddConfig(const char* command) {
     return asynSuccess;
   }
 
+  ecmcGrbl* grbl = getGrbl(index);
   if(!grbl) {
-    printf("Plugin not initialized/loaded.\n");
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
     return asynError;
   }
 
@@ -324,11 +635,15 @@ int ecmcGrblAddConfig(const char* command) {
 static const iocshArg initArg0_2 =
 { " Grbl Config", iocshArgString };
 
-static const iocshArg *const initArgs_2[]  = { &initArg0_2};
+static const iocshArg initArg1_2 =
+{ " Instance", iocshArgInt };
+
+static const iocshArg *const initArgs_2[]  = { &initArg0_2,
+                                               &initArg1_2};
 
-static const iocshFuncDef    initFuncDef_2 = { "ecmcGrblAddConfig", 1, initArgs_2 };
+static const iocshFuncDef    initFuncDef_2 = { "ecmcGrblAddConfig", 2, initArgs_2 };
 static void initCallFunc_2(const iocshArgBuf *args) {
-  ecmcGrblAddConfig(args[0].sval);
+  ecmcGrblAddConfig(args[0].sval,args[1].ival);
 }
 
 /** 
@@ -337,15 +652,16 @@ static void initCallFunc_2(const iocshArgBuf *args) {
 
 void ecmcGrblLoadConfigFilePrintHelp() {
   printf("\n");
-  printf("       Use ecmcGrblLoadConfigFile(<filename>,<append>)\n");
+  printf("       Use ecmcGrblLoadConfigFile(<filename>,<append>,<instance>)\n");
   printf("          <filename>             : Filename containg grbl configs.\n");
   printf("          <append>               : 0: clear all current configs in buffer before \n"); 
   printf ("                                     loading file (default).\n");
   printf("                                 : 1: append commands in file last in buffer. (grbl is not reset)\n");
+  printf("          <instance>             : Grbl instance index (default 0).\n");
   printf("\n");
 }
 
-int ecmcGrblLoadConfigFile(const char* filename, int append) {
+int ecmcGrblLoadConfigFile(const char* filename, int append, int index) {
 
   if(!filename) {
     printf("Error: filename.\n");
@@ -358,8 +674,9 @@ int ecmcGrblLoadConfigFile(const char* filename, int append) {
     return asynSuccess;
   }
 
+  ecmcGrbl* grbl = getGrbl(index);
   if(!grbl) {
-    printf("Plugin not initialized/loaded.\n");
+    printf("Plugin not initialized/loaded or invalid instance (%d).\n", index);
     return asynError;
   }
 
@@ -379,12 +696,75 @@ static const iocshArg initArg0_3 =
 static const iocshArg initArg1_3 =
 { " Append", iocshArgInt };
 
+static const iocshArg initArg2_3 =
+{ " Instance", iocshArgInt };
+
 static const iocshArg *const initArgs_3[]  = { &initArg0_3,
-                                               &initArg1_3};
+                                               &initArg1_3,
+                                               &initArg2_3};
 
-static const iocshFuncDef    initFuncDef_3 = { "ecmcGrblLoadConfigFile", 2, initArgs_3 };
+static const iocshFuncDef    initFuncDef_3 = { "ecmcGrblLoadConfigFile", 3, initArgs_3 };
 static void initCallFunc_3(const iocshArgBuf *args) {
-  ecmcGrblLoadConfigFile(args[0].sval,args[1].ival);
+  ecmcGrblLoadConfigFile(args[0].sval,args[1].ival,args[2].ival);
+}
+
+/** 
+ * EPICS iocsh shell command: ecmcGrblCreateInstance
+*/
+
+void ecmcGrblCreateInstancePrintHelp() {
+  printf("\n");
+  printf("       Use ecmcGrblCreateInstance(<configStr>)\n");
+  printf("          <configStr>            : Configuration string (same options as for plugin load).\n");
+  printf("\n");
+  printf("       Creates an additional grbl object with own grbl state, axes and asyn port\n");
+  printf("       (" ECMC_PLUGIN_PORTNAME_PREFIX "<instance>). The plugin must be loaded first (instance 0).\n");
+  printf("       The instance index is printed and used as last argument in the other\n");
+  printf("       ecmcGrbl* commands and in the grbl_*_idx() plc functions.\n");
+  printf("\n");
+}
+
+int ecmcGrblCreateInstance(const char* configStr) {
+
+  if(!configStr) {
+    printf("Error: configStr.\n");
+    ecmcGrblCreateInstancePrintHelp();
+    return asynError;
+  }
+
+  if(strcmp(configStr,"-h") == 0 || strcmp(configStr,"--help") == 0 ) {
+    ecmcGrblCreateInstancePrintHelp();
+    return asynSuccess;
+  }
+
+  if(grbls.empty()) {
+    printf("Plugin not initialized/loaded.\n");
+    return asynError;
+  }
+
+  if (getEcmcEpicsIOCState() == 16) {
+    printf("Error: Instances can only be created during startup.\n");
+    return asynError;
+  }
+
+  int index = createGrblInstance((char*)configStr);
+  if(index < 0) {
+    printf("Error: Create grbl instance failed.\n");
+    return asynError;
+  }
+  printf("GRBL: INFO: Created grbl instance %d (asyn port " ECMC_PLUGIN_PORTNAME_PREFIX "%d).\n",
+         index, index);
+  return asynSuccess;
+}
+
+static const iocshArg initArg0_4 =
+{ " Config string", iocshArgString };
+
+static const iocshArg *const initArgs_4[]  = { &initArg0_4};
+
+static const iocshFuncDef    initFuncDef_4 = { "ecmcGrblCreateInstance", 1, initArgs_4 };
+static void initCallFunc_4(const iocshArgBuf *args) {
+  ecmcGrblCreateInstance(args[0].sval);
 }
 
 ///** 
@@ -395,6 +775,11 @@ void ecmcGrblPluginDriverRegister(void) {
   iocshRegister(&initFuncDef_1,    initCallFunc_1);   // ecmcGrblLoadFile
   iocshRegister(&initFuncDef_2,    initCallFunc_2);   // ecmcGrblAddConfig
   iocshRegister(&initFuncDef_3,    initCallFunc_3);   // ecmcGrblLoadConfigFile
+  iocshRegister(&initFuncDef_4,    initCallFunc_4);   // ecmcGrblCreateInstance
+  iocshRegister(&initFuncDef_5,    initCallFunc_5);   // ecmcGrblStreamGCodeFile
+  iocshRegister(&initFuncDef_6,    initCallFunc_6);   // ecmcGrblCompileGCode
+  iocshRegister(&initFuncDef_7,    initCallFunc_7);   // ecmcGrblValidateGCode
+  iocshRegister(&initFuncDef_8,    initCallFunc_8);   // ecmcGrblSimulateGCode
 }
 
 epicsExportRegistrar(ecmcGrblPluginDriverRegister);
@@ -30,59 +30,83 @@ extern "C" {
  */
 int createGrbl(char *configStr, int exeSampleTimeMs);
 
-/** \brief prepare for RT\n
+/** \brief Create additional grbl object (instance)\n
+ *
+ *  Must be called after createGrbl(). The object gets its own grbl state,
+ *  axes and asyn port (PLUGIN.GRBL<index>).\n
+ *  \param[in] configStr Configuration string.\n
+ *
+ *  \return instance index if success or otherwise -1.\n
+ */
+int createGrblInstance(char *configStr);
+
+/** \brief get number of grbl objects (instances)\n
+  */
+int getGrblInstanceCount();
+
+/** \brief prepare for RT (all instances)\n
   */
 int enterRT();
 
-/** \brief rt loop\n
+/** \brief rt loop (all instances)\n
   */
 int realtime(int ecmcError);
 
+/* All functions below take the grbl instance index as first argument */
+
 /** \brief execute g-code\n
   */
-int setExecute(int exe);
+int setExecute(int index, int exe);
 
 /** \brief halt motion\n
   */
-int setHalt(int halt);
+int setHalt(int index, int halt);
 
 /** \brief resume grbl\n
   */
-int setResume(int resume);
+int setResume(int index, int resume);
 
 /** \brief reset grbl\n
   */
-int setReset(int reset);
+int setReset(int index, int reset);
 
 /** \brief get grbl busy\n
   */
-int getBusy();
+int getBusy(int index);
 
 /** \brief get grbl g-code parser busy\n
   */
-int getParserBusy();
+int getParserBusy(int index);
 
 /** \brief get grbl g-code row number\n
   */
-int getCodeRowNum();
+int getCodeRowNum(int index);
 
 /** \brief get error code\n
   */
-int getError();
+int getError(int index);
 
 /** \brief reset error code\n
   */
-int resetError();
+int resetError(int index);
 
 /** \brief get all configured axes enabled\n
   */
-int getAllAxesEnabled();
+int getAllAxesEnabled(int index);
 
 /** \brief set all enable of all configured axes\n
   */
-int setAllAxesEnable(int enable);
+int setAllAxesEnable(int index, int enable);
+
+/** \brief get velocity feed-forward of grbl axis (0=X, 1=Y, 2=Z) [mm/s]\n
+  */
+double getAxisFFVelocity(int index, int axis);
+
+/** \brief get acceleration feed-forward of grbl axis (0=X, 1=Y, 2=Z) [mm/s^2]\n
+  */
+double getAxisFFAcceleration(int index, int axis);
 
-// Delete object
+// Delete all objects
 void deleteGrbl();
 
 # ifdef __cplusplus
@@ -101,53 +101,111 @@ int grblExitRT(void){
 
 // Plc function for execute grbl code
 double grbl_set_execute(double exe) {
-  return setExecute((int)exe);
+  return setExecute(0, (int)exe);
 }
 
 // Plc function for halt grbl
 double grbl_mc_halt(double halt) {
-  return setHalt((int)halt);
+  return setHalt(0, (int)halt);
 }
 
 // Plc function for resume grbl
 double grbl_mc_resume(double halt) {
-  return setResume((int)halt);
+  return setResume(0, (int)halt);
 }
 
 // Plc function for reset grbl
 //double grbl_mc_reset(double halt) {
-//  return setReset((int)halt);
+//  return setReset(0, (int)halt);
 //}
 
 // Plc function for reset grbl
 double grbl_get_busy() {
-  return getBusy();
+  return getBusy(0);
 }
 
 // Plc function for reset grbl
 double grbl_get_parser_busy() {
-  return getParserBusy();
+  return getParserBusy(0);
 }
 
 // Plc function for reset grbl
 double grbl_get_code_row_num() {
-  return getCodeRowNum();
+  return getCodeRowNum(0);
 }
 
 double grbl_reset_error() {
-  return resetError();
+  return resetError(0);
 }
 
 double grbl_get_error() {
-  return getError();
+  return getError(0);
 }
 
 double grbl_get_all_enabled() {
-  return getAllAxesEnabled();
+  return getAllAxesEnabled(0);
 }
 
 double grbl_set_all_enable(double enable) {
-  return setAllAxesEnable(enable);
+  return setAllAxesEnable(0, enable);
+}
+
+double grbl_get_ff_velo(double axis) {
+  return getAxisFFVelocity(0, (int)axis);
+}
+
+double grbl_get_ff_acc(double axis) {
+  return getAxisFFAcceleration(0, (int)axis);
+}
+
+
+// Plc functions for additional grbl instances (first argument is instance index)
+double grbl_set_execute_idx(double idx, double exe) {
+  return setExecute((int)idx, (int)exe);
+}
+
+double grbl_mc_halt_idx(double idx, double halt) {
+  return setHalt((int)idx, (int)halt);
+}
+
+double grbl_mc_resume_idx(double idx, double resume) {
+  return setResume((int)idx, (int)resume);
+}
+
+double grbl_get_busy_idx(double idx) {
+  return getBusy((int)idx);
+}
+
+double grbl_get_parser_busy_idx(double idx) {
+  return getParserBusy((int)idx);
+}
+
+double grbl_get_code_row_num_idx(double idx) {
+  return getCodeRowNum((int)idx);
+}
+
+double grbl_get_error_idx(double idx) {
+  return getError((int)idx);
+}
+
+double grbl_reset_error_idx(double idx) {
+  return resetError((int)idx);
+}
+
+double grbl_get_all_enabled_idx(double idx) {
+  return getAllAxesEnabled((int)idx);
+}
+
+double grbl_set_all_enable_idx(double idx, double enable) {
+  return setAllAxesEnable((int)idx, (int)enable);
+}
+
+double grbl_get_ff_velo_idx(double idx, double axis) {
+  return getAxisFFVelocity((int)idx, (int)axis);
+}
+
+double grbl_get_ff_acc_idx(double idx, double axis) {
+  return getAxisFFAcceleration((int)idx, (int)axis);
 }
 
 // Register data for plugin so ecmc know what to use
@@ -166,6 +224,9 @@ struct ecmcPluginData pluginDataDef = {
                 "      "ECMC_PLUGIN_SPINDLE_AXIS_ID_OPTION_CMD"<axis id>: Ecmc Axis id for use as grbl spindle axis, default = disabled (=-1).\n"
                 "      "ECMC_PLUGIN_AUTO_ENABLE_AT_START_OPTION_CMD"<1/0>: Auto enable the linked ecmc axes autmatically before start, default = disabled (=0).\n"
                 "      "ECMC_PLUGIN_AUTO_START_OPTION_CMD"<1/0>: Auto start g-code at ecmc start, default = disabled (=0).\n"
+                "      "ECMC_PLUGIN_INTERP_MODE_OPTION_CMD"<STEP/CONTINUOUS>: Setpoints from emulated steps or continuous interpolation of segments, default = STEP.\n"
+                "      "ECMC_PLUGIN_PLANNER_BUFFER_SIZE_OPTION_CMD"<blocks>: Size of grbl planner buffer (look-ahead), default = 16.\n"
+                "      Additional grbl instances (own axes) can be created with iocsh command ecmcGrblCreateInstance().\n"
   ,
   // Plugin version
   .version = ECMC_EXAMPLE_PLUGIN_VERSION,
@@ -300,7 +361,7 @@ struct ecmcPluginData pluginDataDef = {
         // Function name (this is the name you use in ecmc plc-code)
         .funcName = "grbl_get_code_row_num",
         // Function description
-        .funcDesc = "double grbl_get_code_row_num() :  Get g-code row number currently preparing for exe.",
+        .funcDesc = "double grbl_get_code_row_num() :  Get g-code row number currently preparing for exe (oldest row not yet acknowledged by grbl, failing row after error).",
         /**
         * 7 different prototypes allowed (only doubles since reg in plc).
         * Only funcArg${argCount} func shall be assigned the rest set to NULL.
@@ -410,8 +471,331 @@ struct ecmcPluginData pluginDataDef = {
         .funcArg10 = NULL,
         .funcGenericObj = NULL,
       },
+  .funcs[10] =
+      { /*----grbl_get_ff_velo----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_ff_velo",
+        // Function description
+        .funcDesc = "double grbl_get_ff_velo(axis) : Get velocity feed-forward of grbl axis (0=X, 1=Y, 2=Z) [mm/s].",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_get_ff_velo,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[11] =
+      { /*----grbl_get_ff_acc----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_ff_acc",
+        // Function description
+        .funcDesc = "double grbl_get_ff_acc(axis) : Get acceleration feed-forward of grbl axis (0=X, 1=Y, 2=Z) [mm/s^2].",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_get_ff_acc,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+
+  .funcs[12] =
+      { /*----grbl_set_execute_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_set_execute_idx",
+        // Function description
+        .funcDesc = "double grbl_set_execute_idx(<idx>, <exe>) :  Trigg execution of loaded g-code at positive edge of <exe> for grbl instance <idx>",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = grbl_set_execute_idx,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[13] =
+      { /*----grbl_mc_halt_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_mc_halt_idx",
+        // Function description
+        .funcDesc = "double grbl_mc_halt_idx(<idx>, <halt>) :  Halt grbl instance <idx> at positive edge of <halt>",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = grbl_mc_halt_idx,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[14] =
+      { /*----grbl_mc_resume_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_mc_resume_idx",
+        // Function description
+        .funcDesc = "double grbl_mc_resume_idx(<idx>, <resume>) :  Resume grbl instance <idx> at positive edge of <resume>",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = grbl_mc_resume_idx,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[15] =
+      { /*----grbl_get_busy_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_busy_idx",
+        // Function description
+        .funcDesc = "double grbl_get_busy_idx(<idx>) :  Get grbl instance <idx> busy.",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_get_busy_idx,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[16] =
+      { /*----grbl_get_parser_busy_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_parser_busy_idx",
+        // Function description
+        .funcDesc = "double grbl_get_parser_busy_idx(<idx>) :  Get g-code parser busy of grbl instance <idx>.",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_get_parser_busy_idx,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[17] =
+      { /*----grbl_get_code_row_num_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_code_row_num_idx",
+        // Function description
+        .funcDesc = "double grbl_get_code_row_num_idx(<idx>) :  Get current g-code row number of grbl instance <idx>.",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_get_code_row_num_idx,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[18] =
+      { /*----grbl_get_error_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_error_idx",
+        // Function description
+        .funcDesc = "double grbl_get_error_idx(<idx>) :  Get error code of grbl instance <idx>.",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_get_error_idx,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[19] =
+      { /*----grbl_reset_error_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_reset_error_idx",
+        // Function description
+        .funcDesc = "double grbl_reset_error_idx(<idx>) :  Reset error of grbl instance <idx>.",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_reset_error_idx,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[20] =
+      { /*----grbl_get_all_enabled_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_all_enabled_idx",
+        // Function description
+        .funcDesc = "double grbl_get_all_enabled_idx(<idx>) :  Get all configured axes of grbl instance <idx> enabled.",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = grbl_get_all_enabled_idx,
+        .funcArg2 = NULL,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[21] =
+      { /*----grbl_set_all_enable_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_set_all_enable_idx",
+        // Function description
+        .funcDesc = "double grbl_set_all_enable_idx(<idx>, <enable>) : Set enable on all configured axes of grbl instance <idx>.",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = grbl_set_all_enable_idx,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[22] =
+      { /*----grbl_get_ff_velo_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_ff_velo_idx",
+        // Function description
+        .funcDesc = "double grbl_get_ff_velo_idx(<idx>, <axis>) : Get velocity feed-forward of grbl axis (0=X, 1=Y, 2=Z) of grbl instance <idx> [mm/s].",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = grbl_get_ff_velo_idx,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
+  .funcs[23] =
+      { /*----grbl_get_ff_acc_idx----*/
+        // Function name (this is the name you use in ecmc plc-code)
+        .funcName = "grbl_get_ff_acc_idx",
+        // Function description
+        .funcDesc = "double grbl_get_ff_acc_idx(<idx>, <axis>) : Get acceleration feed-forward of grbl axis (0=X, 1=Y, 2=Z) of grbl instance <idx> [mm/s^2].",
+        /**
+        * 7 different prototypes allowed (only doubles since reg in plc).
+        * Only funcArg${argCount} func shall be assigned the rest set to NULL.
+        **/
+        .funcArg0 = NULL,
+        .funcArg1 = NULL,
+        .funcArg2 = grbl_get_ff_acc_idx,
+        .funcArg3 = NULL,
+        .funcArg4 = NULL,
+        .funcArg5 = NULL,
+        .funcArg6 = NULL,
+        .funcArg7 = NULL,
+        .funcArg8 = NULL,
+        .funcArg9 = NULL,
+        .funcArg10 = NULL,
+        .funcGenericObj = NULL,
+      },
 
-  .funcs[10] = {0},  // last element set all to zero..
+  .funcs[24] = {0},  // last element set all to zero..
   // PLC consts
   .consts[0] = {0}, // last element set all to zero..
 };
@@ -61,6 +61,7 @@
 #include "grbl_spindle_control.h"
 #include "grbl_stepper.h"
 #include "grbl_jog.h"  
+#include "grbl_context.h" // Added for ecmc
 
 #define PRINTF_DEBUG(str)                                                     \
   {                                                                           \
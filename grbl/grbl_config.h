@@ -156,7 +156,9 @@
 
 // Allows GRBL to track and report gcode line numbers.  Enabling this means that the planning buffer
 // goes from 16 to 15 to make room for the additional line number data in the plan_block_t struct
-// #define USE_LINE_NUMBERS // Disabled by default. Uncomment to enable.
+// Added for ecmc: Enabled for the executing line number in the realtime status (status.line). The
+// planner buffer is allocated at runtime, so the default size stays 16 (see grbl_planner.h).
+#define USE_LINE_NUMBERS // Disabled by default. Uncomment to enable.
 
 // Upon a successful probe cycle, this option provides immediately feedback of the probe coordinates
 // through an automatically generated message. If disabled, users can still access the last probe
@@ -406,6 +408,14 @@
 // much greater than this. The default setting should capture most, if not all, full arc error situations.
 #define ARC_ANGULAR_TRAVEL_EPSILON 5E-7 // Float (radians)
 
+// Plans G2/G3 arcs as one native circular/helical planner block instead of splitting them into
+// line segments by settings.arc_tolerance ($12). The arc block is planned with its path length
+// and a nominal speed limited by the centripetal acceleration, and the stepper interpolates the
+// position on the circle. This removes the chordal error and reduces the planner load of arc heavy
+// programs by the number of segments per arc. Comment out for the upstream segmented arcs. Added
+// for ecmc
+#define ARC_NATIVE_BLOCKS // Default enabled. Comment to disable.
+
 // Time delay increments performed during a dwell. The default value is set at 50ms, which provides
 // a maximum time delay of roughly 55 minutes, more than enough for most any application. Increasing
 // this delay will increase the maximum dwell time linearly, but also reduces the responsiveness of
@@ -439,6 +449,13 @@
 // before having to come back and refill this buffer, currently at ~50msec of step moves.
 // #define SEGMENT_BUFFER_SIZE 6 // Uncomment to override default in stepper.h.
 
+// Selects the real number type (real_t) used by the motion pipeline. Upstream grbl uses single
+// precision float since the AVR has no double support. On x86_64 double costs almost nothing
+// and removes the accumulated rounding error on long, arc heavy programs and large coordinates.
+// NOTE: Changes the size of the settings and coordinate data stored in eeprom. Stored data is
+// restored to defaults the first time after switching. Added for ecmc
+// #define USE_DOUBLE_PRECISION_REAL // Uncomment to enable. Default disabled.
+
 // Line buffer size from the serial input stream to be executed. Also, governs the size of
 // each of the startup blocks, as they are each stored as a string of this size. Make sure
 // to account for the available EEPROM at the defined memory address in settings.h and for
@@ -459,8 +476,8 @@
 // 115200 baud will take 5 msec to transmit a typical 55 character report. Worst case reports are
 // around 90-100 characters. As long as the serial TX buffer doesn't get continually maxed, Grbl
 // will continue operating efficiently. Size the TX buffer around the size of a worst-case report.
-// #define RX_BUFFER_SIZE 128 // (1-254) Uncomment to override defaults in serial.h
-// #define TX_BUFFER_SIZE 100 // (1-254)
+// #define RX_BUFFER_SIZE 128 // (1-65534, ecmc) Uncomment to override defaults in serial.h
+// #define TX_BUFFER_SIZE 100 // (1-65534, ecmc)
 
 // A simple software debouncing feature for hard limit switches. When enabled, the interrupt 
 // monitoring the hard limit switch pins will enable the Arduino's watchdog timer to re-check 
@@ -0,0 +1,104 @@
+/*
+  grbl_context.c - Per instance grbl state
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Added for ecmc (see grbl_context.h)
+
+#include "grbl.h"
+
+__thread grbl_context_t *grbl_ctx = NULL;
+
+
+grbl_context_t *grbl_context_create()
+{
+  grbl_context_t *ctx = (grbl_context_t*)calloc(1, sizeof(grbl_context_t));
+  if (ctx == NULL) { return(NULL); }
+
+  ctx->planner = plan_create_state();
+  ctx->stepper = st_create_state();
+  ctx->serial = serial_create_state();
+  ctx->protocol_event = epicsEventCreate(epicsEventEmpty);
+  ctx->state_lock = epicsMutexCreate();
+  if (ctx->planner == NULL || ctx->stepper == NULL || ctx->serial == NULL || ctx->protocol_event == NULL ||
+      ctx->state_lock == NULL) {
+    grbl_context_delete(ctx);
+    return(NULL);
+  }
+  return(ctx);
+}
+
+
+void grbl_context_delete(grbl_context_t *ctx)
+{
+  if (ctx == NULL) { return; }
+  plan_delete_state(ctx->planner);
+  st_delete_state(ctx->stepper);
+  serial_delete_state(ctx->serial);
+  if (ctx->protocol_event) { epicsEventDestroy(ctx->protocol_event); }
+  if (ctx->state_lock) { epicsMutexDestroy(ctx->state_lock); }
+  free(ctx);
+}
+
+
+void grbl_context_bind(grbl_context_t *ctx)
+{
+  grbl_ctx = ctx;
+}
+
+
+void grbl_context_no_wait(void *arg, double wait_s)
+{
+  (void)arg;
+  (void)wait_s;
+}
+
+
+void grbl_context_lock_state(grbl_context_t *ctx)
+{
+  epicsMutexLock(ctx->state_lock);
+}
+
+
+void grbl_context_unlock_state(grbl_context_t *ctx)
+{
+  epicsMutexUnlock(ctx->state_lock);
+}
+
+
+void grbl_context_publish_wco()
+{
+  uint32_t seq = __atomic_load_n(&grbl_ctx->wco_seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&grbl_ctx->wco_seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  uint8_t idx;
+  for (idx = 0; idx < N_AXIS; idx++) {
+    grbl_ctx->wco[idx] = gc_state.coord_system[idx] + gc_state.coord_offset[idx];
+    if (idx == TOOL_LENGTH_OFFSET_AXIS) { grbl_ctx->wco[idx] += gc_state.tool_length_offset; }
+  }
+  __atomic_store_n(&grbl_ctx->wco_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+
+void grbl_context_get_wco(grbl_context_t *ctx, real_t *wco)
+{
+  uint32_t seq;
+  do {
+    seq = __atomic_load_n(&ctx->wco_seq, __ATOMIC_ACQUIRE);
+    memcpy(wco, ctx->wco, sizeof(ctx->wco));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) || seq != __atomic_load_n(&ctx->wco_seq, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,127 @@
+/*
+  grbl_context.h - Per instance grbl state
+  Part of Grbl
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Added for ecmc: All state grbl keeps as globals on the AVR is stored in a grbl_context_t, so
+// several independent grbl instances can run in the same process (one per ecmcGrbl object).
+// The grbl core code is unchanged and accesses the state of the context that is bound to the
+// calling thread with grbl_context_bind(). Each thread that calls into grbl (grbl main loop,
+// serial writer, ecmc rt thread, asyn and iocsh threads) must bind the context of the
+// instance before the call. The ecmc rt thread rebinds for each instance it executes.
+// NOTE: Module private state (planner, stepper, serial) is allocated by the modules and only
+// accessible inside the module (see grbl_planner.c, grbl_stepper.c and grbl_serial.c).
+
+#ifndef grbl_context_h
+#define grbl_context_h
+
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+
+#define EEPROM_MEM_SIZE 1024  // Size of simulated eeprom
+
+typedef struct grbl_context {
+  // Realtime system state (main.c)
+  system_t sys;
+  int32_t sys_position[N_AXIS];      // Real-time machine (aka home) position vector in steps.
+  int32_t sys_probe_position[N_AXIS]; // Last probe position in machine coordinates and steps.
+  volatile uint8_t sys_probe_state;   // Probing state value.  Used to coordinate the probing cycle with stepper ISR.
+  volatile uint8_t sys_rt_exec_state;   // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
+  volatile uint8_t sys_rt_exec_alarm;   // Global realtime executor bitflag variable for setting various alarms.
+  volatile uint8_t sys_rt_exec_motion_override; // Global realtime executor bitflag variable for motion-based overrides.
+  volatile uint8_t sys_rt_exec_accessory_override; // Global realtime executor bitflag variable for spindle/coolant overrides.
+  volatile uint8_t sys_rt_exec_sync_position; // Set by ecmc rt thread, g-code position synced by main thread (added for ecmc)
+  #ifdef DEBUG
+    volatile uint8_t sys_rt_exec_debug;
+  #endif
+  int stepper_interrupt_enable;       // Emulated stepper timer interrupt enable
+  int debug_printouts;                // Enables PRINTF_DEBUG()
+
+  settings_t settings;                // Settings (settings.c)
+  parser_state_t gc_state;            // G-code parser state (gcode.c)
+  parser_block_t gc_block;            // G-code block being parsed (gcode.c)
+  char protocol_line[LINE_BUFFER_SIZE]; // Line to be executed (protocol.c)
+  epicsEventId protocol_event;        // Wakes the grbl main thread (protocol.c)
+  volatile uint8_t protocol_waiting;  // Main thread blocked in protocol_wait(), event must be signaled
+  volatile uint8_t protocol_pending;  // Wakeup since the last protocol_wait()
+  epicsMutexId state_lock;            // Held by the grbl main thread while executing a line (protocol.c)
+  uint32_t wco_seq;                   // Seqlock of wco[] (odd while written)
+  real_t wco[N_AXIS];                 // Work coordinate offset published by the grbl main thread (protocol.c)
+  uint8_t probe_invert_mask;          // Probe pin invert mask (probe.c)
+  #ifdef VARIABLE_SPINDLE
+    real_t spindle_pwm_gradient;      // Rpm to PWM conversion (spindle_control.c)
+  #endif
+  char eeprom_buffer[EEPROM_MEM_SIZE]; // Simulated eeprom (eeprom.c)
+
+  // Simulation: If set, protocol_wait() and dwells (delay_sec()) call simulation_wait() instead of
+  // sleeping. The callback advances the simulated time (executes the stepper) by wait_s seconds,
+  // or one sample for wait_s = 0 (see ecmcGrblSimulator).
+  void (*simulation_wait)(void *arg, double wait_s);
+  void *simulation_arg;
+
+  grbl_planner_state_t *planner;      // Module private state
+  grbl_stepper_state_t *stepper;
+  grbl_serial_state_t *serial;
+} grbl_context_t;
+
+// Context of the calling thread
+extern __thread grbl_context_t *grbl_ctx;
+
+// Allocates a new grbl context with module states. Returns NULL if allocation failed.
+grbl_context_t *grbl_context_create();
+
+// Frees a context created by grbl_context_create(). The context must not be bound by any thread.
+void grbl_context_delete(grbl_context_t *ctx);
+
+// Binds ctx to the calling thread. All grbl calls from the thread operate on ctx.
+void grbl_context_bind(grbl_context_t *ctx);
+
+// simulation_wait hook that returns at once. For contexts in check mode (nothing is executed), so
+// waits for the planner (program flow, coordinate data and offset writes) do not block.
+void grbl_context_no_wait(void *arg, double wait_s);
+
+// Locks the settings and parser state of ctx against the grbl main thread, which holds the lock while
+// it executes a line (also while waiting for planner space) and syncs the parser position. For
+// consistent copies of the state from other threads. Recursive.
+void grbl_context_lock_state(grbl_context_t *ctx);
+void grbl_context_unlock_state(grbl_context_t *ctx);
+
+// Work coordinate offset (coordinate system, G92 and tool length offset) of the parser state. Published
+// for the bound context by the grbl main thread after each executed line, so threads that do not hold
+// the state lock (ecmc rt thread) read a consistent copy instead of the parser state being written.
+void grbl_context_publish_wco();
+void grbl_context_get_wco(grbl_context_t *ctx, real_t *wco);
+
+// Access to the state of the bound context with the original grbl global names
+#define sys                            (grbl_ctx->sys)
+#define sys_position                   (grbl_ctx->sys_position)
+#define sys_probe_position             (grbl_ctx->sys_probe_position)
+#define sys_probe_state                (grbl_ctx->sys_probe_state)
+#define sys_rt_exec_state              (grbl_ctx->sys_rt_exec_state)
+#define sys_rt_exec_alarm              (grbl_ctx->sys_rt_exec_alarm)
+#define sys_rt_exec_motion_override    (grbl_ctx->sys_rt_exec_motion_override)
+#define sys_rt_exec_accessory_override (grbl_ctx->sys_rt_exec_accessory_override)
+#define sys_rt_exec_sync_position      (grbl_ctx->sys_rt_exec_sync_position)
+#ifdef DEBUG
+  #define sys_rt_exec_debug            (grbl_ctx->sys_rt_exec_debug)
+#endif
+#define stepperInterruptEnable         (grbl_ctx->stepper_interrupt_enable)
+#define enableDebugPrintouts           (grbl_ctx->debug_printouts)
+#define settings                       (grbl_ctx->settings)
+#define gc_state                       (grbl_ctx->gc_state)
+#define probe_invert_mask              (grbl_ctx->probe_invert_mask)
+
+#endif
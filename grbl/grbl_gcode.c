@@ -32,9 +32,8 @@
 #define AXIS_COMMAND_MOTION_MODE 2
 #define AXIS_COMMAND_TOOL_LENGTH_OFFSET 3 // *Undefined but required
 
-// Declare gc extern struct
-parser_state_t gc_state;
-parser_block_t gc_block;
+// NOTE: gc_state and gc_block are stored in the grbl context (see grbl_context.h). Added for ecmc
+#define gc_block (grbl_ctx->gc_block)
 
 #define FAIL(status) return(status);
 
@@ -72,6 +71,23 @@ uint8_t gc_execute_line(char *line)
      return(STATUS_OK);
    }
 
+  // Added for ecmc: Split in parsing (STEP 1-2) and error-checking/execution (STEP 3-4), so that
+  // parsed lines can be cached and executed without parsing the text again.
+  gc_parsed_line_t parsed;
+  uint8_t status = gc_parse_line(line, &parsed);
+  if (status != STATUS_OK) { return(status); }
+  return(gc_execute_parsed_line(&parsed));
+}
+
+
+// Parses one line of G-Code (STEP 1-2 of the original gc_execute_line()). The parsed modes are
+// not merged with the current g-code state (done in gc_execute_parsed_line()), so the result only
+// depends on the line and the grbl state is not accessed. Can be called from any thread.
+// Added for ecmc
+#undef gc_block
+#define gc_block (parsed->block)
+uint8_t gc_parse_line(char *line, gc_parsed_line_t *parsed)
+{
   /* -------------------------------------------------------------------------------------
      STEP 1: Initialize parser block struct and copy current g-code state modes. The parser
      updates these modes and commands as the block line is parser and will only be used and
@@ -79,12 +95,10 @@ uint8_t gc_execute_line(char *line)
      values struct, word tracking variables, and a non-modal commands tracker for the new
      block. This struct contains all of the necessary information to execute the block. */
 
-  memset(&gc_block, 0, sizeof(parser_block_t)); // Initialize the parser block struct.
-  memcpy(&gc_block.modal,&gc_state.modal,sizeof(gc_modal_t)); // Copy current modes
+  memset(parsed, 0, sizeof(gc_parsed_line_t)); // Initialize the parser block struct.
+  // NOTE: Current modes are copied in gc_execute_parsed_line() (added for ecmc)
 
   uint8_t axis_command = AXIS_COMMAND_NONE;
-  uint8_t axis_0, axis_1, axis_linear;
-  uint8_t coord_select = 0; // Tracks G10 P coordinate selection for execution
 
   // Initialize bitflag tracking variables for axis indices compatible operations.
   uint8_t axis_words = 0; // XYZ tracking
@@ -98,9 +112,8 @@ uint8_t gc_execute_line(char *line)
   // Determine if the line is a jogging motion or a normal g-code block.
   if (line[0] == '$') { // NOTE: `$J=` already parsed when passed to this function.
     // Set G1 and G94 enforced modes to ensure accurate error checks.
+    // NOTE: Modes are enforced in gc_execute_parsed_line() (added for ecmc)
     gc_parser_flags |= GC_PARSER_JOG_MOTION;
-    gc_block.modal.motion = MOTION_MODE_LINEAR;
-    gc_block.modal.feed_rate = FEED_RATE_MODE_UNITS_PER_MIN;
     #ifdef USE_LINE_NUMBERS
       gc_block.values.n = JOG_LINE_NUMBER; // Initialize default line number reported during jog.
     #endif
@@ -115,7 +128,7 @@ uint8_t gc_execute_line(char *line)
   uint8_t word_bit; // Bit-value for assigning tracking variables
   uint8_t char_counter;
   char letter;
-  float value;
+  real_t value;
   uint8_t int_value = 0;
   uint16_t mantissa = 0;
   if (gc_parser_flags & GC_PARSER_JOG_MOTION) { char_counter = 3; } // Start parsing after `$J=`
@@ -352,6 +365,57 @@ uint8_t gc_execute_line(char *line)
   }
   // Parsing complete!
 
+  parsed->axis_command = axis_command;
+  parsed->axis_words = axis_words;
+  parsed->ijk_words = ijk_words;
+  parsed->command_words = command_words;
+  parsed->value_words = value_words;
+  parsed->parser_flags = gc_parser_flags;
+  return(STATUS_OK);
+}
+#undef gc_block
+#define gc_block (grbl_ctx->gc_block)
+
+
+// Error-checks and executes a line parsed by gc_parse_line() (STEP 3-4 of the original
+// gc_execute_line()). Added for ecmc
+uint8_t gc_execute_parsed_line(const gc_parsed_line_t *parsed)
+{
+  uint8_t axis_command = parsed->axis_command;
+  uint8_t axis_0, axis_1, axis_linear;
+  uint8_t coord_select = 0; // Tracks G10 P coordinate selection for execution
+  uint8_t axis_words = parsed->axis_words;
+  uint8_t ijk_words = parsed->ijk_words;
+  uint16_t command_words = parsed->command_words;
+  uint16_t value_words = parsed->value_words;
+  uint8_t gc_parser_flags = parsed->parser_flags;
+
+  // Merge the modes of the parsed line with the current modes (modes not set by the line are kept).
+  const gc_modal_t *modal = &parsed->block.modal;
+  memcpy(&gc_block, &parsed->block, sizeof(parser_block_t));
+  memcpy(&gc_block.modal,&gc_state.modal,sizeof(gc_modal_t)); // Copy current modes
+  if (gc_parser_flags & GC_PARSER_JOG_MOTION) {
+    // Set G1 and G94 enforced modes to ensure accurate error checks.
+    gc_block.modal.motion = MOTION_MODE_LINEAR;
+    gc_block.modal.feed_rate = FEED_RATE_MODE_UNITS_PER_MIN;
+  }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_G1))) { gc_block.modal.motion = modal->motion; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_G2))) { gc_block.modal.plane_select = modal->plane_select; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_G3))) { gc_block.modal.distance = modal->distance; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_G5))) { gc_block.modal.feed_rate = modal->feed_rate; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_G6))) { gc_block.modal.units = modal->units; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_G8))) { gc_block.modal.tool_length = modal->tool_length; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_G12))) { gc_block.modal.coord_select = modal->coord_select; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_M4)) && modal->program_flow) { gc_block.modal.program_flow = modal->program_flow; } // M1 ignored
+  if (bit_istrue(command_words,bit(MODAL_GROUP_M7))) { gc_block.modal.spindle = modal->spindle; }
+  if (bit_istrue(command_words,bit(MODAL_GROUP_M8))) { // M7/M8 add to current coolant, M9 disables both
+    if (modal->coolant) { gc_block.modal.coolant |= modal->coolant; }
+    else { gc_block.modal.coolant = COOLANT_DISABLE; }
+  }
+  #ifdef ENABLE_PARKING_OVERRIDE_CONTROL
+    if (bit_istrue(command_words,bit(MODAL_GROUP_M9))) { gc_block.modal.override = modal->override; }
+  #endif
+
 
   /* -------------------------------------------------------------------------------------
      STEP 3: Error-check all commands and values passed in this block. This step ensures all of
@@ -528,7 +592,7 @@ uint8_t gc_execute_line(char *line)
   // is active. The read pauses the processor temporarily and may cause a rare crash. For
   // future versions on processors with enough memory, all coordinate data should be stored
   // in memory and written to EEPROM only when there is not a cycle active.
-  float block_coord_system[N_AXIS];
+  real_t block_coord_system[N_AXIS];
   memcpy(block_coord_system,gc_state.coord_system,sizeof(gc_state.coord_system));
   if ( bit_istrue(command_words,bit(MODAL_GROUP_G12)) ) { // Check if called in block
     if (gc_block.modal.coord_select > N_COORDINATE_SYSTEM) { FAIL(STATUS_GCODE_UNSUPPORTED_COORD_SYS); } // [Greater than N sys]
@@ -710,7 +774,7 @@ uint8_t gc_execute_line(char *line)
           if (!(axis_words & (bit(axis_0)|bit(axis_1)))) { FAIL(STATUS_GCODE_NO_AXIS_WORDS_IN_PLANE); } // [No axis words in plane]
 
           // Calculate the change in position along each selected axis
-          float x,y;
+          real_t x,y;
           x = gc_block.values.xyz[axis_0]-gc_state.position[axis_0]; // Delta x between current position and target
           y = gc_block.values.xyz[axis_1]-gc_state.position[axis_1]; // Delta y between current position and target
 
@@ -770,7 +834,7 @@ uint8_t gc_execute_line(char *line)
 
             // First, use h_x2_div_d to compute 4*h^2 to check if it is negative or r is smaller
             // than d. If so, the sqrt of a negative number is complex and error out.
-            float h_x2_div_d = 4.0 * gc_block.values.r*gc_block.values.r - x*x - y*y;
+            real_t h_x2_div_d = 4.0 * gc_block.values.r*gc_block.values.r - x*x - y*y;
 
             if (h_x2_div_d < 0) { FAIL(STATUS_GCODE_ARC_RADIUS_ERROR); } // [Arc radius error]
 
@@ -820,13 +884,13 @@ uint8_t gc_execute_line(char *line)
             // Arc radius from center to target
             x -= gc_block.values.ijk[axis_0]; // Delta x between circle center and target
             y -= gc_block.values.ijk[axis_1]; // Delta y between circle center and target
-            float target_r = hypot_f(x,y);
+            real_t target_r = hypot_f(x,y);
 
             // Compute arc radius for mc_arc. Defined from current location to center.
             gc_block.values.r = hypot_f(gc_block.values.ijk[axis_0], gc_block.values.ijk[axis_1]);
 
             // Compute difference between current location and target radii for final error-checks.
-            float delta_r = fabs(target_r-gc_block.values.r);
+            real_t delta_r = fabs(target_r-gc_block.values.r);
             if (delta_r > 0.005) {
               if (delta_r > 0.5) { FAIL(STATUS_GCODE_INVALID_TARGET); } // [Arc definition error] > 0.5mm
               if (delta_r > (0.001*gc_block.values.r)) { FAIL(STATUS_GCODE_INVALID_TARGET); } // [Arc definition error] > 0.005mm AND 0.1% radius
@@ -1022,7 +1086,7 @@ uint8_t gc_execute_line(char *line)
   // [15. Coordinate system selection ]:
   if (gc_state.modal.coord_select != gc_block.modal.coord_select) {
     gc_state.modal.coord_select = gc_block.modal.coord_select;
-    memcpy(gc_state.coord_system,block_coord_system,N_AXIS*sizeof(float));
+    memcpy(gc_state.coord_system,block_coord_system,N_AXIS*sizeof(real_t));
     system_flag_wco_change();
   }
 
@@ -1040,7 +1104,7 @@ uint8_t gc_execute_line(char *line)
       settings_write_coord_data(coord_select,gc_block.values.ijk);
       // Update system coordinate system if currently active.
       if (gc_state.modal.coord_select == coord_select) {
-        memcpy(gc_state.coord_system,gc_block.values.ijk,N_AXIS*sizeof(float));
+        memcpy(gc_state.coord_system,gc_block.values.ijk,N_AXIS*sizeof(real_t));
         system_flag_wco_change();
       }
       break;
@@ -1050,7 +1114,7 @@ uint8_t gc_execute_line(char *line)
       pl_data->condition |= PL_COND_FLAG_RAPID_MOTION; // Set rapid motion condition flag.
       if (axis_command) { mc_line(gc_block.values.xyz, pl_data); }
       mc_line(gc_block.values.ijk, pl_data);
-      memcpy(gc_state.position, gc_block.values.ijk, N_AXIS*sizeof(float));
+      memcpy(gc_state.position, gc_block.values.ijk, N_AXIS*sizeof(real_t));
       break;
     case NON_MODAL_SET_HOME_0:
       settings_write_coord_data(SETTING_INDEX_G28,gc_state.position);
@@ -197,36 +197,36 @@ typedef struct {
 } gc_modal_t;
 
 typedef struct {
-  float f;         // Feed
-  float ijk[3];    // I,J,K Axis arc offsets
+  real_t f;         // Feed
+  real_t ijk[3];    // I,J,K Axis arc offsets
   uint8_t l;       // G10 or canned cycles parameters
   int32_t n;       // Line number
-  float p;         // G10 or dwell parameters
+  real_t p;         // G10 or dwell parameters
   // float q;      // G82 peck drilling
-  float r;         // Arc radius
-  float s;         // Spindle speed
+  real_t r;         // Arc radius
+  real_t s;         // Spindle speed
   uint8_t t;       // Tool selection
-  float xyz[3];    // X,Y,Z Translational axes
+  real_t xyz[3];    // X,Y,Z Translational axes
 } gc_values_t;
 
 
 typedef struct {
   gc_modal_t modal;
 
-  float spindle_speed;          // RPM
-  float feed_rate;              // Millimeters/min
+  real_t spindle_speed;          // RPM
+  real_t feed_rate;              // Millimeters/min
   uint8_t tool;                 // Tracks tool number. NOT USED.
   int32_t line_number;          // Last line number sent
 
-  float position[N_AXIS];       // Where the interpreter considers the tool to be at this point in the code
+  real_t position[N_AXIS];       // Where the interpreter considers the tool to be at this point in the code
 
-  float coord_system[N_AXIS];    // Current work coordinate system (G54+). Stores offset from absolute machine
+  real_t coord_system[N_AXIS];    // Current work coordinate system (G54+). Stores offset from absolute machine
                                  // position in mm. Loaded from EEPROM when called.
-  float coord_offset[N_AXIS];    // Retains the G92 coordinate offset (work coordinates) relative to
+  real_t coord_offset[N_AXIS];    // Retains the G92 coordinate offset (work coordinates) relative to
                                  // machine zero in mm. Non-persistent. Cleared upon reset and boot.
-  float tool_length_offset;      // Tracks tool length offset value when enabled.
+  real_t tool_length_offset;      // Tracks tool length offset value when enabled.
 } parser_state_t;
-extern parser_state_t gc_state;
+// NOTE: gc_state is stored in the grbl context (see grbl_context.h). Added for ecmc
 
 
 typedef struct {
@@ -236,12 +236,30 @@ typedef struct {
 } parser_block_t;
 
 
+// Line parsed by gc_parse_line(). Only the modes set by the line are valid in block.modal
+// (see command_words). Added for ecmc
+typedef struct {
+  parser_block_t block;
+  uint16_t command_words;
+  uint16_t value_words;
+  uint8_t axis_command;
+  uint8_t axis_words;
+  uint8_t ijk_words;
+  uint8_t parser_flags;
+} gc_parsed_line_t;
+
+
 // Initialize the parser
 void gc_init();
 
 // Execute one block of rs275/ngc/g-code
 uint8_t gc_execute_line(char *line);
 
+// Parse one block without accessing the grbl state, and error-check and execute a parsed block.
+// gc_execute_line() = gc_parse_line() + gc_execute_parsed_line(). Added for ecmc
+uint8_t gc_parse_line(char *line, gc_parsed_line_t *parsed);
+uint8_t gc_execute_parsed_line(const gc_parsed_line_t *parsed);
+
 // Set g-code parser position. Input in steps.
 void gc_sync_position();
 
@@ -420,7 +420,7 @@ void limits_go_home(uint8_t cycle_mask)
 // Performs a soft limit check. Called from mc_line() only. Assumes the machine has been homed,
 // the workspace volume is in all negative space, and the system is in normal operation.
 // NOTE: Used by jogging to limit travel within soft-limit volume.
-void limits_soft_check(float *target)
+void limits_soft_check(real_t *target)
 {
   printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
 
@@ -434,6 +434,7 @@ void limits_soft_check(float *target)
       do {
         protocol_execute_realtime();
         if (sys.abort) { return; }
+        protocol_wait(); // added for ecmc
       } while ( sys.state != STATE_IDLE );
     }
     mc_reset(); // Issue system reset and ensure spindle and coolant are shutdown.
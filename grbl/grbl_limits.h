@@ -35,6 +35,6 @@ uint8_t limits_get_state();
 void limits_go_home(uint8_t cycle_mask);
 
 // Check for soft limit violations
-void limits_soft_check(float *target);
+void limits_soft_check(real_t *target);
 
 #endif
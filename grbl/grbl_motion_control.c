@@ -28,7 +28,7 @@
 // segments, must pass through this routine before being passed to the planner. The seperation of
 // mc_line and plan_buffer_line is done primarily to place non-planner-type functions from being
 // in the planner and to let backlash compensation or canned cycle integration simple and direct.
-void mc_line(float *target, plan_line_data_t *pl_data)
+void mc_line(real_t *target, plan_line_data_t *pl_data)
 {
   //PRINTF_DEBUG("");
 
@@ -61,7 +61,10 @@ void mc_line(float *target, plan_line_data_t *pl_data)
   do {
     protocol_execute_realtime(); // Check for any run-time commands
     if (sys.abort) { return; } // Bail, if system abort.
-    if ( plan_check_full_buffer() ) { protocol_auto_cycle_start(); } // Auto-cycle start when buffer is full.
+    if ( plan_check_full_buffer() ) {
+      protocol_auto_cycle_start(); // Auto-cycle start when buffer is full.
+      protocol_wait(); // Wait for the stepper to free space (added for ecmc)
+    }
     else { break; }
   } while (1);
 
@@ -78,6 +81,64 @@ void mc_line(float *target, plan_line_data_t *pl_data)
 }
 
 
+#ifdef ARC_NATIVE_BLOCKS
+// Checks the soft limits of an arc: the target and the points where the arc passes the axis extremes
+// of the circle (multiples of 90 degrees) with the helical position at that point. Added for ecmc
+static void mc_arc_soft_check(real_t *target, real_t *position, plan_arc_t *arc)
+{
+  limits_soft_check(target);
+  if (sys.abort) { return; }
+
+  real_t radius = sqrt(arc->r_axis0*arc->r_axis0 + arc->r_axis1*arc->r_axis1);
+  real_t start_angle = atan2(arc->r_axis1, arc->r_axis0);
+  real_t travel = fabs(arc->angular_travel);
+  real_t extreme[N_AXIS];
+  uint8_t k;
+  for (k=0; k<4; k++) {
+    real_t angle = k*0.5*M_PI;
+    real_t delta = (arc->angular_travel > 0.0) ? (angle - start_angle) : (start_angle - angle);
+    delta = fmod(delta, 2*M_PI);
+    if (delta < 0.0) { delta += 2*M_PI; }
+    if (delta > travel) { continue; } // Extreme not passed
+    memcpy(extreme, target, sizeof(extreme));
+    extreme[arc->axis_0] = position[arc->axis_0] - arc->r_axis0 + radius*cos(angle);
+    extreme[arc->axis_1] = position[arc->axis_1] - arc->r_axis1 + radius*sin(angle);
+    extreme[arc->axis_linear] = position[arc->axis_linear] +
+                                (target[arc->axis_linear] - position[arc->axis_linear])*delta/travel;
+    limits_soft_check(extreme);
+    if (sys.abort) { return; }
+  }
+}
+
+
+// Plans an arc as one native arc block (see plan_buffer_arc()). Same as mc_line() for lines.
+// Added for ecmc
+static void mc_arc_block(real_t *target, plan_line_data_t *pl_data, real_t *position, plan_arc_t *arc)
+{
+  // If enabled, check for soft limit violations.
+  if (bit_istrue(settings.flags,BITFLAG_SOFT_LIMIT_ENABLE)) {
+    if (sys.state != STATE_JOG) { mc_arc_soft_check(target, position, arc); }
+  }
+
+  // If in check gcode mode, prevent motion by blocking planner. Soft limits still work.
+  if (sys.state == STATE_CHECK_MODE) { return; }
+
+  // Remain in this loop until there is room in the buffer.
+  do {
+    protocol_execute_realtime(); // Check for any run-time commands
+    if (sys.abort) { return; } // Bail, if system abort.
+    if ( plan_check_full_buffer() ) {
+      protocol_auto_cycle_start(); // Auto-cycle start when buffer is full.
+      protocol_wait(); // Wait for the stepper to free space
+    }
+    else { break; }
+  } while (1);
+
+  plan_buffer_arc(target, pl_data, arc);
+}
+#endif
+
+
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_X defines circle plane in tool space, axis_linear is
 // the direction of helical travel, radius == circle radius, isclockwise boolean. Used
@@ -85,26 +146,40 @@ void mc_line(float *target, plan_line_data_t *pl_data)
 // The arc is approximated by generating a huge number of tiny, linear segments. The chordal tolerance
 // of each segment is configured in settings.arc_tolerance, which is defined to be the maximum normal
 // distance from segment to the circle when the end points both lie on the circle.
-void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
+// Added for ecmc: With ARC_NATIVE_BLOCKS the arc is planned as one arc block instead, which the
+// stepper interpolates on the circle (no chordal error, settings.arc_tolerance is not used).
+void mc_arc(real_t *target, plan_line_data_t *pl_data, real_t *position, real_t *offset, real_t radius,
   uint8_t axis_0, uint8_t axis_1, uint8_t axis_linear, uint8_t is_clockwise_arc)
 {
   //PRINTF_DEBUG("");
 
-  float center_axis0 = position[axis_0] + offset[axis_0];
-  float center_axis1 = position[axis_1] + offset[axis_1];
-  float r_axis0 = -offset[axis_0];  // Radius vector from center to current location
-  float r_axis1 = -offset[axis_1];
-  float rt_axis0 = target[axis_0] - center_axis0;
-  float rt_axis1 = target[axis_1] - center_axis1;
+  real_t center_axis0 = position[axis_0] + offset[axis_0];
+  real_t center_axis1 = position[axis_1] + offset[axis_1];
+  real_t r_axis0 = -offset[axis_0];  // Radius vector from center to current location
+  real_t r_axis1 = -offset[axis_1];
+  real_t rt_axis0 = target[axis_0] - center_axis0;
+  real_t rt_axis1 = target[axis_1] - center_axis1;
 
   // CCW angle between position and target from circle center. Only one atan2() trig computation required.
-  float angular_travel = atan2(r_axis0*rt_axis1-r_axis1*rt_axis0, r_axis0*rt_axis0+r_axis1*rt_axis1);
+  real_t angular_travel = atan2(r_axis0*rt_axis1-r_axis1*rt_axis0, r_axis0*rt_axis0+r_axis1*rt_axis1);
   if (is_clockwise_arc) { // Correct atan2 output per direction
     if (angular_travel >= -ARC_ANGULAR_TRAVEL_EPSILON) { angular_travel -= 2*M_PI; }
   } else {
     if (angular_travel <= ARC_ANGULAR_TRAVEL_EPSILON) { angular_travel += 2*M_PI; }
   }
 
+  #ifdef ARC_NATIVE_BLOCKS
+    plan_arc_t arc;
+    arc.r_axis0 = r_axis0;
+    arc.r_axis1 = r_axis1;
+    arc.angular_travel = angular_travel;
+    arc.axis_0 = axis_0;
+    arc.axis_1 = axis_1;
+    arc.axis_linear = axis_linear;
+    (void)radius;  // Not segmented, no chordal tolerance
+    mc_arc_block(target, pl_data, position, &arc);
+  #else
+
   // NOTE: Segment end points are on the arc, which can lead to the arc diameter being smaller by up to
   // (2x) settings.arc_tolerance. For 99% of users, this is just fine. If a different arc segment fit
   // is desired, i.e. least-squares, midpoint on arc, just change the mm_per_arc_segment calculation.
@@ -121,8 +196,8 @@ void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *of
       bit_false(pl_data->condition,PL_COND_FLAG_INVERSE_TIME); // Force as feed absolute mode over arc segments.
     }
     
-    float theta_per_segment = angular_travel/segments;
-    float linear_per_segment = (target[axis_linear] - position[axis_linear])/segments;
+    real_t theta_per_segment = angular_travel/segments;
+    real_t linear_per_segment = (target[axis_linear] - position[axis_linear])/segments;
 
     /* Vector rotation by transformation matrix: r is the original vector, r_T is the rotated vector,
        and phi is the angle of rotation. Solution approach by Jens Geisler.
@@ -150,13 +225,13 @@ void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *of
        This is important when there are successive arc motions.
     */
     // Computes: cos_T = 1 - theta_per_segment^2/2, sin_T = theta_per_segment - theta_per_segment^3/6) in ~52usec
-    float cos_T = 2.0 - theta_per_segment*theta_per_segment;
-    float sin_T = theta_per_segment*0.16666667*(cos_T + 4.0);
+    real_t cos_T = 2.0 - theta_per_segment*theta_per_segment;
+    real_t sin_T = theta_per_segment*0.16666667*(cos_T + 4.0);
     cos_T *= 0.5;
 
-    float sin_Ti;
-    float cos_Ti;
-    float r_axisi;
+    real_t sin_Ti;
+    real_t cos_Ti;
+    real_t r_axisi;
     uint16_t i;
     uint8_t count = 0;
 
@@ -191,11 +266,12 @@ void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *of
   }
   // Ensure last segment arrives at target location.
   mc_line(target, pl_data);
+  #endif
 }
 
 
 // Execute dwell in seconds.
-void mc_dwell(float seconds)
+void mc_dwell(real_t seconds)
 {
   //PRINTF_DEBUG("");
 
@@ -260,7 +336,7 @@ void mc_homing_cycle(uint8_t cycle_mask)
 
 // Perform tool length probe cycle. Requires probe switch.
 // NOTE: Upon probe failure, the program will be stopped and placed into ALARM state.
-uint8_t mc_probe_cycle(float *target, plan_line_data_t *pl_data, uint8_t parser_flags)
+uint8_t mc_probe_cycle(real_t *target, plan_line_data_t *pl_data, uint8_t parser_flags)
 {
   printf("%s:%s:%d Not supported yet..\n",__FILE__,__FUNCTION__,__LINE__);
   return 0;
@@ -331,7 +407,7 @@ uint8_t mc_probe_cycle(float *target, plan_line_data_t *pl_data, uint8_t parser_
 // Plans and executes the single special motion case for parking. Independent of main planner buffer.
 // NOTE: Uses the always free planner ring buffer head to store motion parameters for execution.
 #ifdef PARKING_ENABLE
-  void mc_parking_motion(float *parking_target, plan_line_data_t *pl_data)
+  void mc_parking_motion(real_t *parking_target, plan_line_data_t *pl_data)
   {
     //PRINTF_DEBUG("");
 
@@ -348,6 +424,7 @@ uint8_t mc_probe_cycle(float *target, plan_line_data_t *pl_data, uint8_t parser_
       do {
         protocol_exec_rt_system();
         if (sys.abort) { return; }
+        protocol_wait(); // added for ecmc
       } while (sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION);
       st_parking_restore_buffer(); // Restore step segment buffer to normal run state.
     } else {
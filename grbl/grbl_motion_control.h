@@ -36,29 +36,29 @@
 // Execute linear motion in absolute millimeter coordinates. Feed rate given in millimeters/second
 // unless invert_feed_rate is true. Then the feed_rate means that the motion should be completed in
 // (1 minute)/feed_rate time.
-void mc_line(float *target, plan_line_data_t *pl_data);
+void mc_line(real_t *target, plan_line_data_t *pl_data);
 
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_XXX defines circle plane in tool space, axis_linear is
 // the direction of helical travel, radius == circle radius, is_clockwise_arc boolean. Used
 // for vector transformation direction.
-void mc_arc(float *target, plan_line_data_t *pl_data, float *position, float *offset, float radius,
+void mc_arc(real_t *target, plan_line_data_t *pl_data, real_t *position, real_t *offset, real_t radius,
   uint8_t axis_0, uint8_t axis_1, uint8_t axis_linear, uint8_t is_clockwise_arc);
 
 // Dwell for a specific number of seconds
-void mc_dwell(float seconds);
+void mc_dwell(real_t seconds);
 
 // Perform homing cycle to locate machine zero. Requires limit switches.
 void mc_homing_cycle(uint8_t cycle_mask);
 
 // Perform tool length probe cycle. Requires probe switch.
-uint8_t mc_probe_cycle(float *target, plan_line_data_t *pl_data, uint8_t parser_flags);
+uint8_t mc_probe_cycle(real_t *target, plan_line_data_t *pl_data, uint8_t parser_flags);
 
 // Handles updating the override control state.
 void mc_override_ctrl_update(uint8_t override_state);
 
 // Plans and executes the single special motion case for parking. Independent of main planner buffer.
-void mc_parking_motion(float *parking_target, plan_line_data_t *pl_data);
+void mc_parking_motion(real_t *parking_target, plan_line_data_t *pl_data);
 
 // Performs system reset. If in motion state, kills all motion and sets system alarm.
 void mc_reset();
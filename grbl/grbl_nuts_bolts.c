@@ -22,7 +22,13 @@
 #include "grbl.h"
 
 
-#define MAX_INT_DIGITS 8 // Maximum number of digits in int32 (and float)
+#ifdef USE_DOUBLE_PRECISION_REAL
+  #define MAX_INT_DIGITS 17 // Maximum number of digits in int64 (and double). Added for ecmc
+  typedef uint64_t read_int_t;
+#else
+  #define MAX_INT_DIGITS 8 // Maximum number of digits in int32 (and float)
+  typedef uint32_t read_int_t;
+#endif
 
 //added for ecmc
 #include <time.h>
@@ -34,7 +40,7 @@
 // Scientific notation is officially not supported by g-code, and the 'E' character may
 // be a g-code word on some CNC systems. So, 'E' notation will not be recognized.
 // NOTE: Thanks to Radu-Eosif Mihailescu for identifying the issues with using strtod().
-uint8_t read_float(char *line, uint8_t *char_counter, float *float_ptr)
+uint8_t read_float(char *line, uint8_t *char_counter, real_t *float_ptr)
 {
   char *ptr = line + *char_counter;
   unsigned char c;
@@ -52,7 +58,7 @@ uint8_t read_float(char *line, uint8_t *char_counter, float *float_ptr)
   }
 
   // Extract number into fast integer. Track decimal in terms of exponent value.
-  uint32_t intval = 0;
+  read_int_t intval = 0;
   int8_t exp = 0;
   uint8_t ndigit = 0;
   bool isdecimal = false;
@@ -78,8 +84,8 @@ uint8_t read_float(char *line, uint8_t *char_counter, float *float_ptr)
   if (!ndigit) { return(false); };
 
   // Convert integer into floating point.
-  float fval;
-  fval = (float)intval;
+  real_t fval;
+  fval = (real_t)intval;
 
   // Apply decimal. Should perform no more than two floating point multiplications for the
   // expected range of E0 to E-4.
@@ -111,8 +117,12 @@ uint8_t read_float(char *line, uint8_t *char_counter, float *float_ptr)
 
 
 // Non-blocking delay function used for general operation and suspend features.
-void delay_sec(float seconds, uint8_t mode)
+void delay_sec(real_t seconds, uint8_t mode)
 {
+  if (grbl_ctx->simulation_wait) {  // Dwell in simulated time (added for ecmc)
+    grbl_ctx->simulation_wait(grbl_ctx->simulation_arg, seconds);
+    return;
+  }
   struct timespec deadline;
   clock_gettime(CLOCK_MONOTONIC,&deadline);
   deadline.tv_sec+=1*seconds;
@@ -151,29 +161,29 @@ void delay_us(uint32_t us)
 
 
 // Simple hypotenuse computation function.
-float hypot_f(float x, float y) { return(sqrt(x*x + y*y)); }
+real_t hypot_f(real_t x, real_t y) { return(sqrt(x*x + y*y)); }
 
 
-float convert_delta_vector_to_unit_vector(float *vector)
+real_t convert_delta_vector_to_unit_vector(real_t *vector)
 {
   uint8_t idx;
-  float magnitude = 0.0;
+  real_t magnitude = 0.0;
   for (idx=0; idx<N_AXIS; idx++) {
     if (vector[idx] != 0.0) {
       magnitude += vector[idx]*vector[idx];
     }
   }
   magnitude = sqrt(magnitude);
-  float inv_magnitude = 1.0/magnitude;
+  real_t inv_magnitude = 1.0/magnitude;
   for (idx=0; idx<N_AXIS; idx++) { vector[idx] *= inv_magnitude; }
   return(magnitude);
 }
 
 
-float limit_value_by_axis_maximum(float *max_value, float *unit_vec)
+real_t limit_value_by_axis_maximum(real_t *max_value, real_t *unit_vec)
 {
   uint8_t idx;
-  float limit_value = SOME_LARGE_VALUE;
+  real_t limit_value = SOME_LARGE_VALUE;
   for (idx=0; idx<N_AXIS; idx++) {
     if (unit_vec[idx] != 0) {  // Avoid divide by zero.
       limit_value = min_grbl(limit_value,fabs(max_value[idx]/unit_vec[idx]));
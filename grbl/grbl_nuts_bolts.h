@@ -25,6 +25,15 @@
 #define false 0
 #define true 1
 
+// Real number type used in all motion calculations (g-code parser, planner, arcs, stepper prep).
+// Defaults to float as in upstream grbl. Define USE_DOUBLE_PRECISION_REAL (see grbl_config.h)
+// to run the motion pipeline in double. Added for ecmc
+#ifdef USE_DOUBLE_PRECISION_REAL
+  typedef double real_t;
+#else
+  typedef float real_t;
+#endif
+
 #define SOME_LARGE_VALUE 1.0E+38
 
 // Axis array index values. Must start with 0 and be continuous.
@@ -52,11 +61,11 @@
 
 // Useful macros
 #define clear_vector(a) memset(a, 0, sizeof(a))
-#define clear_vector_float(a) memset(a, 0.0, sizeof(float)*N_AXIS)
+#define clear_vector_float(a) memset(a, 0.0, sizeof(real_t)*N_AXIS)
 // #define clear_vector_long(a) memset(a, 0.0, sizeof(long)*N_AXIS)
 #define max_grbl(a,b) (((a) > (b)) ? (a) : (b))
 #define min_grbl(a,b) (((a) < (b)) ? (a) : (b))
-#define isequal_position_vector(a,b) !(memcmp(a, b, sizeof(float)*N_AXIS))
+#define isequal_position_vector(a,b) !(memcmp(a, b, sizeof(real_t)*N_AXIS))
 
 // Bit field and masking macros
 #define bit(n) (1 << n)
@@ -68,10 +77,10 @@
 // Read a floating point value from a string. Line points to the input buffer, char_counter
 // is the indexer pointing to the current character of the line, while float_ptr is
 // a pointer to the result variable. Returns true when it succeeds
-uint8_t read_float(char *line, uint8_t *char_counter, float *float_ptr);
+uint8_t read_float(char *line, uint8_t *char_counter, real_t *float_ptr);
 
 // Non-blocking delay function used for general operation and suspend features.
-void delay_sec(float seconds, uint8_t mode);
+void delay_sec(real_t seconds, uint8_t mode);
 
 // Delays variable-defined milliseconds. Compiler compatibility fix for _delay_ms().
 void delay_ms(uint16_t ms);
@@ -80,9 +89,9 @@ void delay_ms(uint16_t ms);
 void delay_us(uint32_t us);
 
 // Computes hypotenuse, avoiding avr-gcc's bloated version and the extra error checking.
-float hypot_f(float x, float y);
+real_t hypot_f(real_t x, real_t y);
 
-float convert_delta_vector_to_unit_vector(float *vector);
-float limit_value_by_axis_maximum(float *max_value, float *unit_vec);
+real_t convert_delta_vector_to_unit_vector(real_t *vector);
+real_t limit_value_by_axis_maximum(real_t *max_value, real_t *unit_vec);
 
 #endif
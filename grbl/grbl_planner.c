@@ -23,36 +23,90 @@
 #include "grbl.h"
 
 
-static plan_block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
-static uint8_t block_buffer_tail;     // Index of the block to process now
-static uint8_t block_buffer_head;     // Index of the next block to be pushed
-static uint8_t next_buffer_head;      // Index of the next buffer head
-static uint8_t block_buffer_planned;  // Index of the optimally planned block
-
 // Define planner variables
 typedef struct {
   int32_t position[N_AXIS];          // The planner position of the tool in absolute steps. Kept separate
                                      // from g-code position for movements requiring multiple line motions,
                                      // i.e. arcs, canned cycles, and backlash compensation.
-  float previous_unit_vec[N_AXIS];   // Unit vector of previous path line segment
-  float previous_nominal_speed;  // Nominal speed of previous path line segment
+  real_t previous_unit_vec[N_AXIS];   // Unit vector of previous path line segment
+  real_t previous_nominal_speed;  // Nominal speed of previous path line segment
 } planner_t;
-static planner_t pl;
+
+// Planner state of a grbl instance. Added for ecmc: Stored in the grbl context (see grbl_context.h)
+// and accessed with the original names. The block buffer is allocated at startup by
+// plan_init_buffer(), so the planner look-ahead can be configured (BLOCK_BUFFER_SIZE is the
+// default size).
+struct grbl_planner_state {
+  plan_block_t *block_buffer;     // A ring buffer for motion instructions
+  uint16_t block_buffer_size;     // Number of blocks in block_buffer
+  uint16_t block_buffer_tail;     // Index of the block to process now
+  uint16_t block_buffer_head;     // Index of the next block to be pushed
+  uint16_t next_buffer_head;      // Index of the next buffer head
+  uint16_t block_buffer_planned;  // Index of the optimally planned block
+  uint8_t  block_buffer_replan;   // Force full reverse pass at next recalculation
+  planner_t pl;
+};
+
+grbl_planner_state_t *plan_create_state()
+{
+  return((grbl_planner_state_t*)calloc(1, sizeof(grbl_planner_state_t)));
+}
+
+
+void plan_delete_state(grbl_planner_state_t *state)
+{
+  if (state == NULL) { return; }
+  free(state->block_buffer);
+  free(state);
+}
+
+
+#define block_buffer         (grbl_ctx->planner->block_buffer)
+#define block_buffer_size    (grbl_ctx->planner->block_buffer_size)
+#define block_buffer_tail    (grbl_ctx->planner->block_buffer_tail)
+#define block_buffer_head    (grbl_ctx->planner->block_buffer_head)
+#define next_buffer_head     (grbl_ctx->planner->next_buffer_head)
+#define block_buffer_planned (grbl_ctx->planner->block_buffer_planned)
+#define block_buffer_replan  (grbl_ctx->planner->block_buffer_replan)
+#define pl                   (grbl_ctx->planner->pl)
+
+
+// Allocates the block ring buffer with block_count blocks. Must be called before plan_reset() and
+// while the planner is not in use. Returns false if size is invalid or allocation failed.
+// Added for ecmc
+uint8_t plan_init_buffer(uint16_t block_count)
+{
+  if (block_count < BLOCK_BUFFER_SIZE_MIN || block_count > BLOCK_BUFFER_SIZE_MAX) { return(false); }
+  plan_block_t *buffer = (plan_block_t*)calloc(block_count, sizeof(plan_block_t));
+  if (buffer == NULL) { return(false); }
+  free(block_buffer);
+  block_buffer = buffer;
+  block_buffer_size = block_count;
+  plan_reset_buffer();
+  return(true);
+}
+
+
+// Returns the number of blocks in the block ring buffer (one block is always kept empty).
+uint16_t plan_get_block_buffer_size()
+{
+  return(block_buffer_size);
+}
 
 
 // Returns the index of the next block in the ring buffer. Also called by stepper segment buffer.
-uint8_t plan_next_block_index(uint8_t block_index)
+uint16_t plan_next_block_index(uint16_t block_index)
 {
   block_index++;
-  if (block_index == BLOCK_BUFFER_SIZE) { block_index = 0; }
+  if (block_index == block_buffer_size) { block_index = 0; }
   return(block_index);
 }
 
 
 // Returns the index of the previous block in the ring buffer
-static uint8_t plan_prev_block_index(uint8_t block_index)
+static uint16_t plan_prev_block_index(uint16_t block_index)
 {
-  if (block_index == 0) { block_index = BLOCK_BUFFER_SIZE; }
+  if (block_index == 0) { block_index = block_buffer_size; }
   block_index--;
   return(block_index);
 }
@@ -122,11 +176,19 @@ static uint8_t plan_prev_block_index(uint8_t block_index)
   to compute an optimal plan, so select carefully. The Arduino 328p memory is already maxed out, but future
   ARM versions should have enough memory and speed for look-ahead blocks numbering up to a hundred or more.
 
+  Added for ecmc: With deep planner buffers (hundreds or thousands of short blocks), the reverse pass
+  is bounded when a new block has been appended (new_block). In parallel with the new plan, the
+  reverse pass computes the entry speeds of the previous plan, where the previous last block
+  decelerates to a stop. As soon as both plans give the same entry speed for a block, nothing before
+  that block can change, so the reverse pass stops there and the forward pass starts from that block.
+  The passes are then limited to the deceleration distance back from the end of the buffer instead
+  of the whole non-optimal part of the buffer. A full pass is done after a replan (feed hold, override
+  change), since the stored entry speeds then do not represent the previous plan.
 */
-static void planner_recalculate()
+static void planner_recalculate(uint8_t new_block)
 {
   // Initialize block index to the last block in the planner buffer.
-  uint8_t block_index = plan_prev_block_index(block_buffer_head);
+  uint16_t block_index = plan_prev_block_index(block_buffer_head);
 
   // Bail. Can't do anything with one only one plan-able block.
   if (block_index == block_buffer_planned) { return; }
@@ -134,9 +196,13 @@ static void planner_recalculate()
   // Reverse Pass: Coarsely maximize all possible deceleration curves back-planning from the last
   // block in buffer. Cease planning when the last optimal planned or tail pointer is reached.
   // NOTE: Forward pass will later refine and correct the reverse pass to create an optimal plan.
-  float entry_speed_sqr;
+  real_t entry_speed_sqr;
   plan_block_t *next;
   plan_block_t *current = &block_buffer[block_index];
+  uint16_t forward_start_index = block_buffer_planned;
+  uint8_t bounded = new_block && !block_buffer_replan;
+  real_t prev_plan_entry_speed_sqr = 0.0; // Previous plan ended with a stop at the previous last block.
+  block_buffer_replan = false;
 
   // Calculate maximum entry speed for last block in buffer, where the exit speed is always zero.
   current->entry_speed_sqr = min_grbl( current->max_entry_speed_sqr, 2*current->acceleration*current->millimeters);
@@ -149,10 +215,6 @@ static void planner_recalculate()
     while (block_index != block_buffer_planned) {
       next = current;
       current = &block_buffer[block_index];
-      block_index = plan_prev_block_index(block_index);
-
-      // Check if next block is the tail block(=planned block). If so, update current stepper parameters.
-      if (block_index == block_buffer_tail) { st_update_plan_block_parameters(); }
 
       // Compute maximum entry speed decelerating over the current block from its exit speed.
       if (current->entry_speed_sqr != current->max_entry_speed_sqr) {
@@ -163,13 +225,28 @@ static void planner_recalculate()
           current->entry_speed_sqr = current->max_entry_speed_sqr;
         }
       }
+
+      // Bounded reverse pass. Stop when the entry speed is the same as in the previous plan.
+      if (bounded) {
+        prev_plan_entry_speed_sqr = min_grbl(current->max_entry_speed_sqr,
+                                  prev_plan_entry_speed_sqr + 2*current->acceleration*current->millimeters);
+        if (current->entry_speed_sqr == prev_plan_entry_speed_sqr) {
+          forward_start_index = block_index;
+          break;
+        }
+      }
+
+      block_index = plan_prev_block_index(block_index);
+
+      // Check if next block is the tail block(=planned block). If so, update current stepper parameters.
+      if (block_index == block_buffer_tail) { st_update_plan_block_parameters(); }
     }
   }
 
   // Forward Pass: Forward plan the acceleration curve from the planned pointer onward.
   // Also scans for optimal plan breakpoints and appropriately updates the planned pointer.
-  next = &block_buffer[block_buffer_planned]; // Begin at buffer planned pointer
-  block_index = plan_next_block_index(block_buffer_planned);
+  next = &block_buffer[forward_start_index]; // Begin at buffer planned pointer (or bounded reverse pass end)
+  block_index = plan_next_block_index(forward_start_index);
   while (block_index != block_buffer_head) {
     current = next;
     next = &block_buffer[block_index];
@@ -205,17 +282,21 @@ void plan_reset()
 
 void plan_reset_buffer()
 {
+  // Added for ecmc. Allocate default size if not configured.
+  if (block_buffer == NULL) { plan_init_buffer(BLOCK_BUFFER_SIZE); }
+
   block_buffer_tail = 0;
   block_buffer_head = 0; // Empty = tail
   next_buffer_head = 1; // plan_next_block_index(block_buffer_head)
   block_buffer_planned = 0; // = block_buffer_tail;
+  block_buffer_replan = true;
 }
 
 
 void plan_discard_current_block()
 {
   if (block_buffer_head != block_buffer_tail) { // Discard non-empty buffer.
-    uint8_t block_index = plan_next_block_index( block_buffer_tail );
+    uint16_t block_index = plan_next_block_index( block_buffer_tail );
     // Push block_buffer_planned pointer, if encountered.
     if (block_buffer_tail == block_buffer_planned) { block_buffer_planned = block_index; }
     block_buffer_tail = block_index;
@@ -238,9 +319,9 @@ plan_block_t *plan_get_current_block()
 }
 
 
-float plan_get_exec_block_exit_speed_sqr()
+real_t plan_get_exec_block_exit_speed_sqr()
 {
-  uint8_t block_index = plan_next_block_index(block_buffer_tail);
+  uint16_t block_index = plan_next_block_index(block_buffer_tail);
   if (block_index == block_buffer_head) { return( 0.0 ); }
   return( block_buffer[block_index].entry_speed_sqr );
 }
@@ -256,9 +337,9 @@ uint8_t plan_check_full_buffer()
 
 // Computes and returns block nominal speed based on running condition and override values.
 // NOTE: All system motion commands, such as homing/parking, are not subject to overrides.
-float plan_compute_profile_nominal_speed(plan_block_t *block)
+real_t plan_compute_profile_nominal_speed(plan_block_t *block)
 {
-  float nominal_speed = block->programmed_rate;
+  real_t nominal_speed = block->programmed_rate;
   if (block->condition & PL_COND_FLAG_RAPID_MOTION) { nominal_speed *= (0.01*sys.r_override); }
   else {
     if (!(block->condition & PL_COND_FLAG_NO_FEED_OVERRIDE)) { nominal_speed *= (0.01*sys.f_override); }
@@ -271,7 +352,7 @@ float plan_compute_profile_nominal_speed(plan_block_t *block)
 
 // Computes and updates the max entry speed (sqr) of the block, based on the minimum of the junction's
 // previous and current nominal speeds and max junction speed.
-static void plan_compute_profile_parameters(plan_block_t *block, float nominal_speed, float prev_nominal_speed)
+static void plan_compute_profile_parameters(plan_block_t *block, real_t nominal_speed, real_t prev_nominal_speed)
 {
   // Compute the junction maximum entry based on the minimum of the junction speed and neighboring nominal speeds.
   if (nominal_speed > prev_nominal_speed) { block->max_entry_speed_sqr = prev_nominal_speed*prev_nominal_speed; }
@@ -283,10 +364,10 @@ static void plan_compute_profile_parameters(plan_block_t *block, float nominal_s
 // Re-calculates buffered motions profile parameters upon a motion-based override change.
 void plan_update_velocity_profile_parameters()
 {
-  uint8_t block_index = block_buffer_tail;
+  uint16_t block_index = block_buffer_tail;
   plan_block_t *block;
-  float nominal_speed;
-  float prev_nominal_speed = SOME_LARGE_VALUE; // Set high for first block nominal speed calculation.
+  real_t nominal_speed;
+  real_t prev_nominal_speed = SOME_LARGE_VALUE; // Set high for first block nominal speed calculation.
   while (block_index != block_buffer_head) {
     block = &block_buffer[block_index];
     nominal_speed = plan_compute_profile_nominal_speed(block);
@@ -295,9 +376,13 @@ void plan_update_velocity_profile_parameters()
     block_index = plan_next_block_index(block_index);
   }
   pl.previous_nominal_speed = prev_nominal_speed; // Update prev nominal speed for next incoming block.
+  block_buffer_replan = true; // Max entry speeds changed. Next recalculation must be a full pass.
 }
 
 
+static uint8_t plan_buffer_motion(real_t *target, plan_line_data_t *pl_data, plan_arc_t *arc);
+
+
 /* Add a new linear movement to the buffer. target[N_AXIS] is the signed, absolute target position
    in millimeters. Feed rate specifies the speed of the motion. If feed rate is inverted, the feed
    rate is taken to mean "frequency" and would complete the operation in 1/feed_rate minutes.
@@ -312,7 +397,81 @@ void plan_update_velocity_profile_parameters()
    head. It avoids changing the planner state and preserves the buffer to ensure subsequent gcode
    motions are still planned correctly, while the stepper module only points to the block buffer head
    to execute the special system motion. */
-uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
+uint8_t plan_buffer_line(real_t *target, plan_line_data_t *pl_data)
+{
+  return(plan_buffer_motion(target, pl_data, NULL));
+}
+
+
+// Adds a circular/helical arc as one block. See plan_buffer_motion(). Added for ecmc
+uint8_t plan_buffer_arc(real_t *target, plan_line_data_t *pl_data, plan_arc_t *arc)
+{
+  return(plan_buffer_motion(target, pl_data, arc));
+}
+
+
+/* Computes the path data of a native arc block. Added for ecmc. Called with the chord from the
+   planner position to the target in unit_vec[] (mm, from steps) and the chord step data in block.
+   - millimeters is the helical path length.
+   - step_event_count is the number of step events along the path, so that no axis takes more
+     than about one step per event (the stepper interpolates the arc, see st_exec_step_events()).
+   - unit_vec[] and exit_unit_vec[] are set to the path tangents at the start and the end of the
+     arc, which are used for the junction speeds with the neighboring blocks.
+   - The tangent rotates in the arc plane, so the plane axes limit the acceleration and rate with
+     the full plane component of the path. The centripetal and the tangential acceleration are
+     orthogonal and each is limited to a/sqrt(2) of the slowest plane axis, so that their sum
+     stays within a on every axis (v^2/r <= a/sqrt(2) limits the rate).
+   The chordal error of the segmented arcs (settings.arc_tolerance) does not apply. */
+static void plan_compute_arc_parameters(plan_block_t *block, real_t *unit_vec, real_t *exit_unit_vec)
+{
+  plan_arc_t *arc = &block->arc;
+  real_t radius = sqrt(arc->r_axis0*arc->r_axis0 + arc->r_axis1*arc->r_axis1);
+  real_t arc_travel = radius*fabs(arc->angular_travel);
+  real_t linear_travel = unit_vec[arc->axis_linear];
+  block->millimeters = sqrt(arc_travel*arc_travel + linear_travel*linear_travel);
+  if (block->millimeters <= 0.0) { // Degenerated arc. Planned as the chord line.
+    block->is_arc = false;
+    return;
+  }
+
+  uint8_t idx;
+  real_t max_step_per_mm = 0.0;
+  for (idx=0; idx<N_AXIS; idx++) { max_step_per_mm = max_grbl(max_step_per_mm, settings.steps_per_mm[idx]); }
+  block->step_event_count = max_grbl(block->step_event_count, (uint32_t)ceil(block->millimeters*max_step_per_mm));
+
+  // Tangents (derivative of the position by the arc fraction, divided by the path length).
+  real_t inv_millimeters = 1.0/block->millimeters;
+  real_t cos_travel = cos(arc->angular_travel);
+  real_t sin_travel = sin(arc->angular_travel);
+  real_t r_end_axis0 = arc->r_axis0*cos_travel - arc->r_axis1*sin_travel;
+  real_t r_end_axis1 = arc->r_axis0*sin_travel + arc->r_axis1*cos_travel;
+  real_t limit_vec[N_AXIS];
+  for (idx=0; idx<N_AXIS; idx++) { unit_vec[idx] = exit_unit_vec[idx] = limit_vec[idx] = 0.0; }
+  unit_vec[arc->axis_0] = -arc->r_axis1*arc->angular_travel*inv_millimeters;
+  unit_vec[arc->axis_1] = arc->r_axis0*arc->angular_travel*inv_millimeters;
+  exit_unit_vec[arc->axis_0] = -r_end_axis1*arc->angular_travel*inv_millimeters;
+  exit_unit_vec[arc->axis_1] = r_end_axis0*arc->angular_travel*inv_millimeters;
+  unit_vec[arc->axis_linear] = exit_unit_vec[arc->axis_linear] = linear_travel*inv_millimeters;
+
+  limit_vec[arc->axis_0] = limit_vec[arc->axis_1] = arc_travel*inv_millimeters;
+  limit_vec[arc->axis_linear] = fabs(linear_travel)*inv_millimeters;
+  block->acceleration = limit_value_by_axis_maximum(settings.acceleration, limit_vec);
+  block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, limit_vec);
+
+  // Centripetal limit of the path rate and tangential limit of the acceleration, splitting the plane
+  // acceleration between both. The plane speed is the path rate times arc_travel/millimeters.
+  if (arc_travel > 0.0) {
+    real_t plane_acceleration = M_SQRT1_2*min_grbl(settings.acceleration[arc->axis_0], settings.acceleration[arc->axis_1]);
+    real_t centripetal_rate = sqrt(plane_acceleration*radius)*block->millimeters/arc_travel;
+    if (block->rapid_rate > centripetal_rate) { block->rapid_rate = centripetal_rate; }
+    real_t tangential_acceleration = plane_acceleration*block->millimeters/arc_travel;
+    if (block->acceleration > tangential_acceleration) { block->acceleration = tangential_acceleration; }
+  }
+}
+
+
+// Plans a line (arc == NULL) or a native arc block. See plan_buffer_line().
+static uint8_t plan_buffer_motion(real_t *target, plan_line_data_t *pl_data, plan_arc_t *arc)
 {
   // Prepare and initialize new block. Copy relevant pl_data for block execution.
   plan_block_t *block = &block_buffer[block_buffer_head];
@@ -327,7 +486,7 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
 
   // Compute and store initial move distance data.
   int32_t target_steps[N_AXIS], position_steps[N_AXIS];
-  float unit_vec[N_AXIS], delta_mm;
+  real_t unit_vec[N_AXIS], delta_mm;
   uint8_t idx;
 
   // Copy position data based on type of motion being planned.
@@ -376,6 +535,15 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
     // Set direction bits. Bit enabled always means direction is negative.
     if (delta_mm < 0.0 ) { block->direction_bits |= get_direction_pin_mask(idx); }
   }
+  memcpy(block->target_steps, target_steps, sizeof(target_steps)); // Added for ecmc (preview)
+
+  // Added for ecmc. Arc path length, step events and tangents (exit direction of the block).
+  real_t exit_unit_vec[N_AXIS];
+  if (arc != NULL) {
+    block->is_arc = true;
+    block->arc = *arc;
+    plan_compute_arc_parameters(block, unit_vec, exit_unit_vec);
+  }
 
   // Bail if this is a zero-length block. Highly unlikely to occur.
   if (block->step_event_count == 0) { return(PLAN_EMPTY_BLOCK); }
@@ -384,9 +552,12 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
   // down such that no individual axes maximum values are exceeded with respect to the line direction.
   // NOTE: This calculation assumes all axes are orthogonal (Cartesian) and works with ABC-axes,
   // if they are also orthogonal/independent. Operates on the absolute value of the unit vector.
-  block->millimeters = convert_delta_vector_to_unit_vector(unit_vec);
-  block->acceleration = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
-  block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, unit_vec);
+  if (!block->is_arc) {
+    block->millimeters = convert_delta_vector_to_unit_vector(unit_vec);
+    block->acceleration = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
+    block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, unit_vec);
+    memcpy(exit_unit_vec, unit_vec, sizeof(unit_vec));
+  }
 
   // Store programmed rate.
   if (block->condition & PL_COND_FLAG_RAPID_MOTION) { block->programmed_rate = block->rapid_rate; }
@@ -426,8 +597,8 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
     // memory in the event of a feedrate override changing the nominal speeds of blocks, which can
     // change the overall maximum entry speed conditions of all blocks.
 
-    float junction_unit_vec[N_AXIS];
-    float junction_cos_theta = 0.0;
+    real_t junction_unit_vec[N_AXIS];
+    real_t junction_cos_theta = 0.0;
     for (idx=0; idx<N_AXIS; idx++) {
       junction_cos_theta -= pl.previous_unit_vec[idx]*unit_vec[idx];
       junction_unit_vec[idx] = unit_vec[idx]-pl.previous_unit_vec[idx];
@@ -443,8 +614,8 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
         block->max_junction_speed_sqr = SOME_LARGE_VALUE;
       } else {
         convert_delta_vector_to_unit_vector(junction_unit_vec);
-        float junction_acceleration = limit_value_by_axis_maximum(settings.acceleration, junction_unit_vec);
-        float sin_theta_d2 = sqrt(0.5*(1.0-junction_cos_theta)); // Trig half angle identity. Always positive.
+        real_t junction_acceleration = limit_value_by_axis_maximum(settings.acceleration, junction_unit_vec);
+        real_t sin_theta_d2 = sqrt(0.5*(1.0-junction_cos_theta)); // Trig half angle identity. Always positive.
         block->max_junction_speed_sqr = max_grbl( MINIMUM_JUNCTION_SPEED*MINIMUM_JUNCTION_SPEED,
                        (junction_acceleration * settings.junction_deviation * sin_theta_d2)/(1.0-sin_theta_d2) );
       }
@@ -453,20 +624,21 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
 
   // Block system motion from updating this data to ensure next g-code motion is computed correctly.
   if (!(block->condition & PL_COND_FLAG_SYSTEM_MOTION)) {
-    float nominal_speed = plan_compute_profile_nominal_speed(block);
+    real_t nominal_speed = plan_compute_profile_nominal_speed(block);
     plan_compute_profile_parameters(block, nominal_speed, pl.previous_nominal_speed);
     pl.previous_nominal_speed = nominal_speed;
     
     // Update previous path unit_vector and planner position.
-    memcpy(pl.previous_unit_vec, unit_vec, sizeof(unit_vec)); // pl.previous_unit_vec[] = unit_vec[]
+    memcpy(pl.previous_unit_vec, exit_unit_vec, sizeof(exit_unit_vec)); // pl.previous_unit_vec[] = exit_unit_vec[]
     memcpy(pl.position, target_steps, sizeof(target_steps)); // pl.position[] = target_steps[]
 
     // New block is all set. Update buffer head and next buffer head indices.
-    block_buffer_head = next_buffer_head;
+    // Release ordering publishes the block data before the head to plan_get_buffer_indices() (added for ecmc).
+    __atomic_store_n(&block_buffer_head, next_buffer_head, __ATOMIC_RELEASE);
     next_buffer_head = plan_next_block_index(block_buffer_head);
 
     // Finish up by recalculating the plan with the new block.
-    planner_recalculate();
+    planner_recalculate(true);
   }
   return(PLAN_OK);
 }
@@ -495,19 +667,19 @@ void plan_sync_position()
 
 
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available()
+uint16_t plan_get_block_buffer_available()
 {
-  if (block_buffer_head >= block_buffer_tail) { return((BLOCK_BUFFER_SIZE-1)-(block_buffer_head-block_buffer_tail)); }
+  if (block_buffer_head >= block_buffer_tail) { return((block_buffer_size-1)-(block_buffer_head-block_buffer_tail)); }
   return((block_buffer_tail-block_buffer_head-1));
 }
 
 
 // Returns the number of active blocks are in the planner buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count()
+uint16_t plan_get_block_buffer_count()
 {
   if (block_buffer_head >= block_buffer_tail) { return(block_buffer_head-block_buffer_tail); }
-  return(BLOCK_BUFFER_SIZE - (block_buffer_tail-block_buffer_head));
+  return(block_buffer_size - (block_buffer_tail-block_buffer_head));
 }
 
 
@@ -518,5 +690,21 @@ void plan_cycle_reinitialize()
   // Re-plan from a complete stop. Reset planner entry speeds and buffer planned pointer.
   st_update_plan_block_parameters();
   block_buffer_planned = block_buffer_tail;
-  planner_recalculate();
+  planner_recalculate(false);
+}
+
+
+// Indices of the block buffer for the toolpath preview. Added for ecmc
+void plan_get_buffer_indices(uint16_t *tail, uint16_t *head, uint16_t *planned)
+{
+  *tail = __atomic_load_n(&block_buffer_tail, __ATOMIC_RELAXED);
+  *head = __atomic_load_n(&block_buffer_head, __ATOMIC_ACQUIRE);  // Blocks up to head are complete
+  *planned = __atomic_load_n(&block_buffer_planned, __ATOMIC_RELAXED);
+}
+
+
+// Block at index. Added for ecmc
+plan_block_t *plan_get_block(uint16_t block_index)
+{
+  return(&block_buffer[block_index]);
 }
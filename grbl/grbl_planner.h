@@ -24,14 +24,16 @@
 
 
 // The number of linear motions that can be in the plan at any give time
+// Added for ecmc: The buffer is allocated at runtime (see plan_init_buffer()), line numbers do not
+// reduce the default size.
 #ifndef BLOCK_BUFFER_SIZE
-  #ifdef USE_LINE_NUMBERS
-    #define BLOCK_BUFFER_SIZE 15
-  #else
-    #define BLOCK_BUFFER_SIZE 16
-  #endif
+  #define BLOCK_BUFFER_SIZE 16
 #endif
 
+// Limits of runtime configured block buffer size (see plan_init_buffer()). Added for ecmc
+#define BLOCK_BUFFER_SIZE_MIN 3
+#define BLOCK_BUFFER_SIZE_MAX 10000
+
 // Returned status message from planner.
 #define PLAN_OK true
 #define PLAN_EMPTY_BLOCK false
@@ -50,6 +52,17 @@
 #define PL_COND_ACCESSORY_MASK (PL_COND_FLAG_SPINDLE_CW|PL_COND_FLAG_SPINDLE_CCW|PL_COND_FLAG_COOLANT_FLOOD|PL_COND_FLAG_COOLANT_MIST)
 
 
+// Circular/helical arc geometry of a native arc block (see plan_buffer_arc()). Added for ecmc
+typedef struct {
+  real_t r_axis0;         // Radius vector from arc center to start position (mm)
+  real_t r_axis1;
+  real_t angular_travel;  // Signed angular travel in the axis_0/axis_1 plane. CCW positive (rad)
+  uint8_t axis_0;         // Plane axes and helical linear axis
+  uint8_t axis_1;
+  uint8_t axis_linear;
+} plan_arc_t;
+
+
 // This struct stores a linear movement of a g-code block motion with its critical "nominal" values
 // are as specified in the source g-code.
 typedef struct {
@@ -59,37 +72,43 @@ typedef struct {
   uint32_t step_event_count; // The maximum step axis count and number of steps required to complete this block.
   uint8_t direction_bits;    // The direction bit set for this block (refers to *_DIRECTION_BIT in config.h)
 
+  // Native arc block (added for ecmc). steps[] and direction_bits are the chord from start to target
+  // and step_event_count is the number of step events along the arc path (see plan_buffer_arc()).
+  uint8_t is_arc;
+  plan_arc_t arc;
+
   // Block condition data to ensure correct execution depending on states and overrides.
   uint8_t condition;      // Block bitflag variable defining block run conditions. Copied from pl_line_data.
   #ifdef USE_LINE_NUMBERS
     int32_t line_number;  // Block line number for real-time reporting. Copied from pl_line_data.
   #endif
+  int32_t target_steps[N_AXIS]; // Absolute target position in steps (toolpath preview). Added for ecmc
 
   // Fields used by the motion planner to manage acceleration. Some of these values may be updated
   // by the stepper module during execution of special motion cases for replanning purposes.
-  float entry_speed_sqr;     // The current planned entry speed at block junction in (mm/min)^2
-  float max_entry_speed_sqr; // Maximum allowable entry speed based on the minimum of junction limit and
+  real_t entry_speed_sqr;     // The current planned entry speed at block junction in (mm/min)^2
+  real_t max_entry_speed_sqr; // Maximum allowable entry speed based on the minimum of junction limit and
                              //   neighboring nominal speeds with overrides in (mm/min)^2
-  float acceleration;        // Axis-limit adjusted line acceleration in (mm/min^2). Does not change.
-  float millimeters;         // The remaining distance for this block to be executed in (mm).
+  real_t acceleration;        // Axis-limit adjusted line acceleration in (mm/min^2). Does not change.
+  real_t millimeters;         // The remaining distance for this block to be executed in (mm).
                              // NOTE: This value may be altered by stepper algorithm during execution.
 
   // Stored rate limiting data used by planner when changes occur.
-  float max_junction_speed_sqr; // Junction entry speed limit based on direction vectors in (mm/min)^2
-  float rapid_rate;             // Axis-limit adjusted maximum rate for this block direction in (mm/min)
-  float programmed_rate;        // Programmed rate of this block (mm/min).
+  real_t max_junction_speed_sqr; // Junction entry speed limit based on direction vectors in (mm/min)^2
+  real_t rapid_rate;             // Axis-limit adjusted maximum rate for this block direction in (mm/min)
+  real_t programmed_rate;        // Programmed rate of this block (mm/min).
 
   #ifdef VARIABLE_SPINDLE
     // Stored spindle speed data used by spindle overrides and resuming methods.
-    float spindle_speed;    // Block spindle speed. Copied from pl_line_data.
+    real_t spindle_speed;    // Block spindle speed. Copied from pl_line_data.
   #endif
 } plan_block_t;
 
 
 // Planner data prototype. Must be used when passing new motions to the planner.
 typedef struct {
-  float feed_rate;          // Desired feed rate for line motion. Value is ignored, if rapid motion.
-  float spindle_speed;      // Desired spindle speed through line motion.
+  real_t feed_rate;          // Desired feed rate for line motion. Value is ignored, if rapid motion.
+  real_t spindle_speed;      // Desired spindle speed through line motion.
   uint8_t condition;        // Bitflag variable to indicate planner conditions. See defines above.
   #ifdef USE_LINE_NUMBERS
     int32_t line_number;    // Desired line number to report when executing.
@@ -97,6 +116,17 @@ typedef struct {
 } plan_line_data_t;
 
 
+// Planner state of a grbl instance (see grbl_context.h). Added for ecmc
+typedef struct grbl_planner_state grbl_planner_state_t;
+grbl_planner_state_t *plan_create_state();
+void plan_delete_state(grbl_planner_state_t *state);
+
+// Allocate block buffer with block_count blocks (default BLOCK_BUFFER_SIZE). Call before plan_reset().
+uint8_t plan_init_buffer(uint16_t block_count);
+
+// Returns the size of the block buffer
+uint16_t plan_get_block_buffer_size();
+
 // Initialize and reset the motion plan subsystem
 void plan_reset(); // Reset all
 void plan_reset_buffer(); // Reset buffer only.
@@ -104,7 +134,12 @@ void plan_reset_buffer(); // Reset buffer only.
 // Add a new linear movement to the buffer. target[N_AXIS] is the signed, absolute target position
 // in millimeters. Feed rate specifies the speed of the motion. If feed rate is inverted, the feed
 // rate is taken to mean "frequency" and would complete the operation in 1/feed_rate minutes.
-uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data);
+uint8_t plan_buffer_line(real_t *target, plan_line_data_t *pl_data);
+
+// Add a new circular/helical arc from the planner position to target[N_AXIS] (mm) as one block.
+// The arc is planned with its path length, the tangent directions at the junctions and a nominal
+// speed limited by the centripetal acceleration. Added for ecmc
+uint8_t plan_buffer_arc(real_t *target, plan_line_data_t *pl_data, plan_arc_t *arc);
 
 // Called when the current block is no longer needed. Discards the block and makes the memory
 // availible for new blocks.
@@ -117,13 +152,13 @@ plan_block_t *plan_get_system_motion_block();
 plan_block_t *plan_get_current_block();
 
 // Called periodically by step segment buffer. Mostly used internally by planner.
-uint8_t plan_next_block_index(uint8_t block_index);
+uint16_t plan_next_block_index(uint16_t block_index);
 
 // Called by step segment buffer when computing executing block velocity profile.
-float plan_get_exec_block_exit_speed_sqr();
+real_t plan_get_exec_block_exit_speed_sqr();
 
 // Called by main program during planner calculations and step segment buffer during initialization.
-float plan_compute_profile_nominal_speed(plan_block_t *block);
+real_t plan_compute_profile_nominal_speed(plan_block_t *block);
 
 // Re-calculates buffered motions profile parameters upon a motion-based override change.
 void plan_update_velocity_profile_parameters();
@@ -135,16 +170,25 @@ void plan_sync_position();
 void plan_cycle_reinitialize();
 
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available();
+uint16_t plan_get_block_buffer_available();
 
 // Returns the number of active blocks are in the planner buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count();
+uint16_t plan_get_block_buffer_count();
 
 // Returns the status of the block ring buffer. True, if buffer is full.
 uint8_t plan_check_full_buffer();
 
-void plan_get_planner_mpos(float *target);
+void plan_get_planner_mpos(real_t *target);
+
+// Indices of the block buffer for reading blocks outside the grbl threads (toolpath preview).
+// Blocks from tail up to head are valid, blocks from planned up to head can still be replanned.
+// The head is published with release ordering, so the blocks up to head are completely written
+// (only the entry speeds of the blocks that can be replanned still change). Added for ecmc
+void plan_get_buffer_indices(uint16_t *tail, uint16_t *head, uint16_t *planned);
+
+// Block at index (no check of index). Added for ecmc
+plan_block_t *plan_get_block(uint16_t block_index);
 
 
 #endif
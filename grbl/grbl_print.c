@@ -145,7 +145,7 @@ void printInteger(long n)
 // may be set by the user. The integer is then efficiently converted to a string.
 // NOTE: AVR '%' and '/' integer operations are very efficient. Bitshifting speed-up
 // techniques are actually just slightly slower. Found this out the hard way.
-void printFloat(float n, uint8_t decimal_places)
+void printFloat(real_t n, uint8_t decimal_places)
 {
   //printf("%s:%s:%d:%f\n",__FILE__,__FUNCTION__,__LINE__,n);
 
@@ -189,7 +189,7 @@ void printFloat(float n, uint8_t decimal_places)
 // in the config.h.
 //  - CoordValue: Handles all position or coordinate values in inches or mm reporting.
 //  - RateValue: Handles feed rate and current velocity in inches or mm reporting.
-void printFloat_CoordValue(float n) {
+void printFloat_CoordValue(real_t n) {
   if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
     printFloat(n*INCH_PER_MM,N_DECIMAL_COORDVALUE_INCH);
   } else {
@@ -197,7 +197,7 @@ void printFloat_CoordValue(float n) {
   }
 }
 
-void printFloat_RateValue(float n) {
+void printFloat_RateValue(real_t n) {
   if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
     printFloat(n*INCH_PER_MM,N_DECIMAL_RATEVALUE_INCH);
   } else {
@@ -37,13 +37,13 @@ void print_uint8_base10(uint8_t n);
 // Prints an uint8 variable in base 2 with desired number of desired digits.
 void print_uint8_base2_ndigit(uint8_t n, uint8_t digits);
 
-void printFloat(float n, uint8_t decimal_places);
+void printFloat(real_t n, uint8_t decimal_places);
 
 // Floating value printing handlers for special variables types used in Grbl.
 //  - CoordValue: Handles all position or coordinate values in inches or mm reporting.
 //  - RateValue: Handles feed rate and current velocity in inches or mm reporting.
-void printFloat_CoordValue(float n);
-void printFloat_RateValue(float n);
+void printFloat_CoordValue(real_t n);
+void printFloat_RateValue(real_t n);
 
 // Debug tool to print free memory in bytes at the called point. Not used otherwise.
 void printFreeMemory();
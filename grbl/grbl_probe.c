@@ -21,8 +21,8 @@
 #include "grbl.h"
 
 
-// Inverts the probe pin state depending on user settings and probing cycle mode.
-uint8_t probe_invert_mask;
+// NOTE: probe_invert_mask (inverts the probe pin state depending on user settings and probing
+// cycle mode) is stored in the grbl context (see grbl_context.h). Added for ecmc
 
 
 // Probe pin initialization routine.
@@ -71,6 +71,6 @@ void probe_state_monitor()
   if (probe_get_state()) {
     sys_probe_state = PROBE_OFF;
     memcpy(sys_probe_position, sys_position, sizeof(sys_position));
-    bit_true(sys_rt_exec_state, EXEC_MOTION_CANCEL);
+    system_set_exec_state_flag(EXEC_MOTION_CANCEL); // Atomic, called from ecmc rt thread (added for ecmc)
   }
 }
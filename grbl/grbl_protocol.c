@@ -20,6 +20,7 @@
 */
 
 #include "grbl.h"
+#include <epicsEvent.h>
 
 // Define line flags. Includes comment type tracking and line overflow detection.
 #define LINE_FLAG_OVERFLOW bit(0)
@@ -27,9 +28,14 @@
 #define LINE_FLAG_COMMENT_SEMICOLON bit(2)
 
 
-static char line[LINE_BUFFER_SIZE]; // Line to be executed. Zero-terminated.
+#define line (grbl_ctx->protocol_line) // Line to be executed. Zero-terminated. Stored in the grbl context (added for ecmc)
+#define protocol_event (grbl_ctx->protocol_event) // Wakes protocol waits (added for ecmc)
+#define protocol_waiting (grbl_ctx->protocol_waiting)
+#define protocol_pending (grbl_ctx->protocol_pending)
 
 static void protocol_exec_rt_suspend();
+static void protocol_execute_line(char *exec_line, uint8_t overflow);
+static void protocol_execute_parsed_line(const gc_parsed_line_t *parsed);
 
 
 /*
@@ -62,6 +68,7 @@ void protocol_main_loop()
     // All systems go!
     system_execute_startup(line); // Execute startup script.
   }
+  grbl_context_publish_wco(); // Parser state after reset and startup script (added for ecmc)
 
   // ---------------------------------------------------------------------------------
   // Primary loop! Upon a system abort, this exits back to main() to reset the system.
@@ -71,12 +78,29 @@ void protocol_main_loop()
   uint8_t line_flags = 0;
   uint8_t char_counter = 0;
   uint8_t c;
-  delay_ms(1);  // added for ecmc (I think..)
   for (;;) {
 
+    // Execute complete lines from the line queue (added for ecmc). Already filtered (or parsed)
+    // by the client and executed in place, so no per character processing is needed.
+    char *queued_line;
+    uint8_t queued_overflow;
+    gc_parsed_line_t *queued_parsed;
+    while ((queued_line = serial_line_queue_peek(&queued_overflow, &queued_parsed)) != NULL) {
+      protocol_execute_realtime(); // Runtime command check point.
+      if (sys.abort) { return; } // Bail to calling function upon system abort
+      if (queued_parsed) {
+        protocol_execute_parsed_line(queued_parsed);
+      } else {
+        #ifdef REPORT_ECHO_LINE_RECEIVED
+          report_echo_line_received(queued_line);
+        #endif
+        protocol_execute_line(queued_line, queued_overflow);
+      }
+      serial_line_queue_pop();
+    }
+
     // Process one line of incoming serial data, as the data becomes available. Performs an
     // initial filtering by removing spaces and comments and capitalizing all letters.    
-    delay_us(100);  // added for ecmc
     while((c = serial_read()) != SERIAL_NO_DATA) {
 
       if ((c == '\n') || (c == '\r')) { // End of line reached
@@ -89,32 +113,11 @@ void protocol_main_loop()
           report_echo_line_received(line);
         #endif
 
-        // Direct and execute one line of formatted input, and report status of execution.
-        if (line_flags & LINE_FLAG_OVERFLOW) {
-          // Report line overflow error.
-          report_status_message(STATUS_OVERFLOW);
-        } else if (line[0] == 0 || line[0]== '0') {
-          // Empty or comment line. For syncing purposes.
-          report_status_message(STATUS_OK);
-        } else if (line[0] == '$') {
-          // Grbl '$' system command
-          report_status_message(system_execute_line(line));
-        } else if (sys.state & (STATE_ALARM | STATE_JOG)) {
-          // Everything else is gcode. Block if in alarm or jog mode.
-          report_status_message(STATUS_SYSTEM_GC_LOCK);
-        } else {
-          // Parse and execute g-code block.
-          //printf("protocol: Line to gc_execute %s\n",line);
-          if(strlen(line)>1) {
-            
-            report_status_message(gc_execute_line(line));
-          }
-        }
+        protocol_execute_line(line, line_flags & LINE_FLAG_OVERFLOW);
 
         // Reset tracking data for next line.
         line_flags = 0;
         char_counter = 0;
-        delay_us(100);  // added for ecmc
       } else {
 
         if (line_flags) {
@@ -154,11 +157,8 @@ void protocol_main_loop()
             line[char_counter++] = c;
           }
         }
-        delay_us(100);
       }
-      delay_us(100); // added for ecmc
     }
-    delay_us(1000); // added for ecmc
     // If there are no more characters in the serial read buffer to be processed and executed,
     // this indicates that g-code streaming has either filled the planner buffer or has
     // completed. In either case, auto-cycle start, if enabled, any queued moves.
@@ -166,12 +166,68 @@ void protocol_main_loop()
 
     protocol_execute_realtime();  // Runtime command check point.
     if (sys.abort) { return; } // Bail to main() program loop to reset system.
+
+    // Sleep until new input, a realtime flag or a free segment slot (added for ecmc)
+    protocol_wait();
   }
 
   return; /* Never reached */
 }
 
 
+// Directs and executes one line of formatted input, and reports status of execution.
+// Moved out of protocol_main_loop() to be shared by the serial stream and the line queue (added for ecmc).
+static void protocol_execute_line(char *exec_line, uint8_t overflow)
+{
+  if (overflow) {
+    // Report line overflow error.
+    report_status_message(STATUS_OVERFLOW);
+  } else if (exec_line[0] == 0 || exec_line[0]== '0') {
+    // Empty or comment line. For syncing purposes.
+    report_status_message(STATUS_OK);
+  } else if (exec_line[0] == '$') {
+    // Grbl '$' system command
+    epicsMutexLock(grbl_ctx->state_lock);  // added for ecmc, see grbl_context_lock_state()
+    uint8_t status = system_execute_line(exec_line);
+    grbl_context_publish_wco();
+    epicsMutexUnlock(grbl_ctx->state_lock);
+    report_status_message(status);
+  } else if (sys.state & (STATE_ALARM | STATE_JOG)) {
+    // Everything else is gcode. Block if in alarm or jog mode.
+    report_status_message(STATUS_SYSTEM_GC_LOCK);
+  } else if (exec_line[1] == 0) {
+    // Single character line (like the '%' program delimiter) is not executed, but replied like all
+    // other lines since the client matches one reply per line (added for ecmc)
+    report_status_message(STATUS_OK);
+  } else {
+    // Parse and execute g-code block.
+    //printf("protocol: Line to gc_execute %s\n",exec_line);
+    epicsMutexLock(grbl_ctx->state_lock);  // added for ecmc, see grbl_context_lock_state()
+    uint8_t status = gc_execute_line(exec_line);
+    grbl_context_publish_wco();
+    epicsMutexUnlock(grbl_ctx->state_lock);
+    report_status_message(status);
+  }
+}
+
+
+// Executes a g-code block parsed by the client (see ecmc_write_parsed_line()). Same checks and
+// replies as protocol_execute_line() for the text line. Added for ecmc
+static void protocol_execute_parsed_line(const gc_parsed_line_t *parsed)
+{
+  if (sys.state & (STATE_ALARM | STATE_JOG)) {
+    // Block if in alarm or jog mode.
+    report_status_message(STATUS_SYSTEM_GC_LOCK);
+  } else {
+    epicsMutexLock(grbl_ctx->state_lock);  // see grbl_context_lock_state()
+    uint8_t status = gc_execute_parsed_line(parsed);
+    grbl_context_publish_wco();
+    epicsMutexUnlock(grbl_ctx->state_lock);
+    report_status_message(status);
+  }
+}
+
+
 // Block until all buffered steps are executed or in a cycle state. Works with feed hold
 // during a synchronize call, if it should happen. Also, waits for clean cycle end.
 void protocol_buffer_synchronize()
@@ -181,8 +237,46 @@ void protocol_buffer_synchronize()
   do {
     protocol_execute_realtime();   // Check and execute run-time commands
     if (sys.abort) { return; } // Check for system abort
-    delay_us(100);  // added for ecmc
-  } while (plan_get_current_block() || (sys.state == STATE_CYCLE));
+    // Added for ecmc: Restart the cycle if the stepper went idle with blocks or segments still queued
+    // (segment buffer underrun). Otherwise this loop waits forever for the remaining blocks.
+    if (sys.state == STATE_IDLE) { protocol_auto_cycle_start(); }
+    protocol_wait();  // added for ecmc
+  } while (plan_get_current_block() || st_segment_buffer_pending() || (sys.state == STATE_CYCLE));
+}
+
+
+// Wakes up the grbl main thread if it is waiting in protocol_wait(). Called when new input is
+// available, a realtime flag is set or the stepper has consumed a segment (ecmc rt thread, every
+// segment). The event is only signaled if the main thread is blocked in protocol_wait(), otherwise
+// the wakeup costs two atomic operations. Added for ecmc
+void protocol_wakeup()
+{
+  if (protocol_event) {
+    __atomic_store_n(&protocol_pending, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&protocol_waiting, 0, __ATOMIC_SEQ_CST)) { epicsEventSignal(protocol_event); }
+  }
+}
+
+
+// Waits for protocol_wakeup() (replaces the fixed sleeps of the grbl main thread). Returns
+// immediately if woken since the last wait. The timeout is a fallback for state changes that are
+// not signaled. In a simulation context the wait advances the simulated time instead. Added for ecmc
+void protocol_wait()
+{
+  if (grbl_ctx->simulation_wait) {
+    grbl_ctx->simulation_wait(grbl_ctx->simulation_arg, 0.0);  // Advance simulated time one sample
+  } else if (protocol_event) {
+    // Announce the wait before checking for wakeups: Either protocol_wakeup() sees the waiting
+    // flag and signals, or the pending flag is seen here (both sequentially consistent).
+    __atomic_store_n(&protocol_waiting, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&protocol_pending, __ATOMIC_SEQ_CST)) {
+      epicsEventWaitWithTimeout(protocol_event, PROTOCOL_WAIT_TIMEOUT_S);
+    }
+    __atomic_store_n(&protocol_waiting, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&protocol_pending, 0, __ATOMIC_SEQ_CST); // Caller checks the state again
+  } else {
+    delay_us(100);
+  }
 }
 
 
@@ -194,7 +288,8 @@ void protocol_buffer_synchronize()
 // execute calls a buffer sync, or the planner buffer is full and ready to go.
 void protocol_auto_cycle_start()
 {
-  if (plan_get_current_block() != NULL) { // Check if there are any blocks in the buffer.
+  // Check if there are any blocks or segments left by an underrun in the buffers (added for ecmc).
+  if ((plan_get_current_block() != NULL) || st_segment_buffer_pending()) {
     system_set_exec_state_flag(EXEC_CYCLE_START); // If so, execute them!
   }
 }
@@ -241,11 +336,18 @@ void protocol_exec_rt_system()
         // the user and a GUI time to do what is needed before resetting, like killing the
         // incoming stream. The same could be said about soft limits. While the position is not
         // lost, continued streaming could cause a serious crash if by chance it gets executed.
+        protocol_wait();  // added for ecmc
       } while (bit_isfalse(sys_rt_exec_state,EXEC_RESET));
     }
     system_clear_exec_alarm(); // Clear alarm
   }
-  delay_us(10); // added for ecmc
+  // Position synced from ecmc by the rt thread (added for ecmc)
+  if (__atomic_exchange_n(&sys_rt_exec_sync_position, 0, __ATOMIC_SEQ_CST)) {
+    epicsMutexLock(grbl_ctx->state_lock);
+    gc_sync_position();
+    epicsMutexUnlock(grbl_ctx->state_lock);
+  }
+
   rt_exec = sys_rt_exec_state; // Copy volatile sys_rt_exec_state.
   if (rt_exec) {
 
@@ -360,8 +462,9 @@ void protocol_exec_rt_system()
             sys.spindle_stop_ovr |= SPINDLE_STOP_OVR_RESTORE_CYCLE; // Set to restore in suspend routine and cycle start after.
           } else {
             // Start cycle only if queued motions exist in planner buffer and the motion is not canceled.
+            // Also for segments left by an underrun after the last block was prepped (added for ecmc).
             sys.step_control = STEP_CONTROL_NORMAL_OP; // Restore step control to normal operation
-            if (plan_get_current_block() && bit_isfalse(sys.suspend,SUSPEND_MOTION_CANCEL)) {
+            if ((plan_get_current_block() || st_segment_buffer_pending()) && bit_isfalse(sys.suspend,SUSPEND_MOTION_CANCEL)) {
               sys.suspend = SUSPEND_DISABLE; // Break suspend state.
               sys.state = STATE_CYCLE;
               st_prep_buffer(); // Initialize step segment buffer before beginning cycle.
@@ -519,9 +622,9 @@ static void protocol_exec_rt_suspend()
 {
   #ifdef PARKING_ENABLE
     // Declare and initialize parking local variables
-    float restore_target[N_AXIS];
-    float parking_target[N_AXIS];
-    float retract_waypoint = PARKING_PULLOUT_INCREMENT;
+    real_t restore_target[N_AXIS];
+    real_t parking_target[N_AXIS];
+    real_t retract_waypoint = PARKING_PULLOUT_INCREMENT;
     plan_line_data_t plan_data;
     plan_line_data_t *pl_data = &plan_data;
     memset(pl_data,0,sizeof(plan_line_data_t));
@@ -534,7 +637,7 @@ static void protocol_exec_rt_suspend()
   plan_block_t *block = plan_get_current_block();
   uint8_t restore_condition;
   #ifdef VARIABLE_SPINDLE
-    float restore_spindle_speed;
+    real_t restore_spindle_speed;
     if (block == NULL) {
       restore_condition = (gc_state.modal.spindle | gc_state.modal.coolant);
       restore_spindle_speed = gc_state.spindle_speed;
@@ -555,7 +658,6 @@ static void protocol_exec_rt_suspend()
   while (sys.suspend) {
 
     if (sys.abort) { return; }
-    delay_us(100);  // added for ecmc
     // Block until initial hold is complete and the machine has stopped motion.
     if (sys.suspend & SUSPEND_HOLD_COMPLETE) {
 
@@ -645,7 +747,7 @@ static void protocol_exec_rt_suspend()
             st_go_idle(); // Disable steppers
             while (!(sys.abort)) { 
               protocol_exec_rt_system();
-              delay_us(100); // added for ecmc
+              protocol_wait(); // added for ecmc
             } // Do nothing until reset.
             return; // Abort received. Return to re-initialize.
           }    
@@ -770,8 +872,7 @@ static void protocol_exec_rt_suspend()
 
       }
     }
-    delay_us(100);  // added for ecmc
+    protocol_wait();  // added for ecmc
     protocol_exec_rt_system();
   }
-  delay_us(100); // added for ecmc
 }
@@ -43,6 +43,11 @@ void protocol_exec_rt_system();
 // Executes the auto cycle feature, if enabled.
 void protocol_auto_cycle_start();
 
+// Wakes up and waits for events in the grbl main thread instead of fixed sleeps. Added for ecmc
+#define PROTOCOL_WAIT_TIMEOUT_S 0.01  // Fallback timeout of protocol_wait() [s]
+void protocol_wakeup();
+void protocol_wait();
+
 // Block until all buffered steps are executed
 void protocol_buffer_synchronize();
 
@@ -20,48 +20,91 @@
 */
 
 #include "grbl.h"
-#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <stdatomic.h>
 
 #define RX_RING_BUFFER (RX_BUFFER_SIZE+1)
 #define TX_RING_BUFFER (TX_BUFFER_SIZE+1)
 
-uint8_t serial_rx_buffer[RX_RING_BUFFER];
-uint16_t serial_rx_buffer_head = 0;
-volatile uint8_t serial_rx_buffer_tail = 0;
-
-uint8_t serial_tx_buffer[TX_RING_BUFFER];
-uint16_t serial_tx_buffer_head = 0;
-volatile uint16_t serial_tx_buffer_tail = 0;
-
-epicsMutexId serialRxBufferMutex = NULL;
-epicsMutexId serialTxBufferMutex = NULL;
+#define SERIAL_CACHE_LINE_SIZE 64
+
+// Line queue entry. Added for ecmc
+typedef struct {
+  uint8_t overflow;                // Line longer than LINE_BUFFER_SIZE-1 after filtering
+  uint8_t parsed_valid;            // Entry is a parsed block (parsed), data is empty
+  char data[LINE_BUFFER_SIZE];     // Filtered line. Zero-terminated.
+  gc_parsed_line_t parsed;         // Block parsed by the client (see ecmc_write_parsed_line())
+} serial_line_t;
+
+// Serial state of a grbl instance. Added for ecmc: Stored in the grbl context (see grbl_context.h)
+// and accessed with the original names.
+// The rx and tx buffers are lock-free single producer single consumer rings (added for ecmc):
+// rx is written by the client and read by protocol_main_loop(), tx is written by the grbl main
+// thread and read by the client. Each index is only written by one side.
+struct grbl_serial_state {
+  uint8_t serial_rx_buffer[RX_RING_BUFFER];
+  _Alignas(SERIAL_CACHE_LINE_SIZE) atomic_uint_fast16_t serial_rx_buffer_head;  // Written by client only
+  _Alignas(SERIAL_CACHE_LINE_SIZE) atomic_uint_fast16_t serial_rx_buffer_tail;  // Written by grbl only
+
+  uint8_t serial_tx_buffer[TX_RING_BUFFER];
+  _Alignas(SERIAL_CACHE_LINE_SIZE) atomic_uint_fast16_t serial_tx_buffer_head;  // Written by grbl only
+  _Alignas(SERIAL_CACHE_LINE_SIZE) atomic_uint_fast16_t serial_tx_buffer_tail;  // Written by client only
+  atomic_uint_fast8_t serial_tx_waiting;  // serial_write() waits for space in the tx buffer
+
+  epicsEventId serialTxDataEvent;  // Signalled when a line is complete in the tx buffer (added for ecmc)
+  epicsEventId serialTxSpaceEvent; // Signalled when the client made space in a full tx buffer
+
+  // Line queue (added for ecmc): Lock-free single producer (client) single consumer
+  // (protocol_main_loop()) ring of complete lines. Bypasses the byte wise rx buffer.
+  serial_line_t line_queue[LINE_QUEUE_SIZE];
+  _Alignas(SERIAL_CACHE_LINE_SIZE) atomic_uint_fast8_t line_queue_tail;  // Written by consumer only
+  _Alignas(SERIAL_CACHE_LINE_SIZE) atomic_uint_fast8_t line_queue_head;  // Written by producer only
+};
+
+grbl_serial_state_t *serial_create_state()
+{
+  void *state = NULL;
+  if (posix_memalign(&state, SERIAL_CACHE_LINE_SIZE, sizeof(grbl_serial_state_t))) { return(NULL); }
+  memset(state, 0, sizeof(grbl_serial_state_t));
+  ((grbl_serial_state_t*)state)->serialTxDataEvent = epicsEventCreate(epicsEventEmpty);
+  ((grbl_serial_state_t*)state)->serialTxSpaceEvent = epicsEventCreate(epicsEventEmpty);
+  if (((grbl_serial_state_t*)state)->serialTxDataEvent == NULL ||
+      ((grbl_serial_state_t*)state)->serialTxSpaceEvent == NULL) {
+    serial_delete_state((grbl_serial_state_t*)state);
+    return(NULL);
+  }
+  return((grbl_serial_state_t*)state);
+}
 
-#define MUTEX_LOCK(mutex)              \
-  {                                    \
-    if (mutex) {                       \
-      epicsMutexLock(mutex);           \
-    }                                  \
-  }                                    \
+void serial_delete_state(grbl_serial_state_t *state)
+{
+  if (state == NULL) { return; }
+  if (state->serialTxDataEvent) { epicsEventDestroy(state->serialTxDataEvent); }
+  if (state->serialTxSpaceEvent) { epicsEventDestroy(state->serialTxSpaceEvent); }
+  free(state);
+}
 
-#define MUTEX_UNLOCK(mutex)            \
-  {                                    \
-    if (mutex) {                       \
-      epicsMutexUnlock(mutex);         \
-    }                                  \
-  }                                    \
+#define serial_rx_buffer      (grbl_ctx->serial->serial_rx_buffer)
+#define serial_rx_buffer_head (grbl_ctx->serial->serial_rx_buffer_head)
+#define serial_rx_buffer_tail (grbl_ctx->serial->serial_rx_buffer_tail)
+#define serial_tx_buffer      (grbl_ctx->serial->serial_tx_buffer)
+#define serial_tx_buffer_head (grbl_ctx->serial->serial_tx_buffer_head)
+#define serial_tx_buffer_tail (grbl_ctx->serial->serial_tx_buffer_tail)
+#define serial_tx_waiting     (grbl_ctx->serial->serial_tx_waiting)
+#define serialTxDataEvent     (grbl_ctx->serial->serialTxDataEvent)
+#define serialTxSpaceEvent    (grbl_ctx->serial->serialTxSpaceEvent)
+#define line_queue            (grbl_ctx->serial->line_queue)
+#define line_queue_tail       (grbl_ctx->serial->line_queue_tail)
+#define line_queue_head       (grbl_ctx->serial->line_queue_head)
 
 // Returns the number of bytes available in the RX serial buffer.
 uint16_t serial_get_rx_buffer_available()
 {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
-  MUTEX_LOCK(serialRxBufferMutex);
-  uint16_t rtail = serial_rx_buffer_tail; // Copy to limit multiple calls to volatile
-  if (serial_rx_buffer_head >= rtail) { 
-    MUTEX_UNLOCK(serialRxBufferMutex);
-    return(RX_BUFFER_SIZE - (serial_rx_buffer_head-rtail)); 
-  }
-  MUTEX_UNLOCK(serialRxBufferMutex);
-  return((rtail-serial_rx_buffer_head-1));
+  uint16_t rhead = atomic_load_explicit(&serial_rx_buffer_head, memory_order_acquire);
+  uint16_t rtail = atomic_load_explicit(&serial_rx_buffer_tail, memory_order_acquire);
+  if (rhead >= rtail) { return(RX_BUFFER_SIZE - (rhead-rtail)); }
+  return((rtail-rhead-1));
 }
 
 
@@ -70,17 +113,10 @@ uint16_t serial_get_rx_buffer_available()
 uint16_t serial_get_rx_buffer_count()
 {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);  
-
-  MUTEX_LOCK(serialRxBufferMutex);
-
-  uint16_t rtail = serial_rx_buffer_tail; // Copy to limit multiple calls to volatile
-  if (serial_rx_buffer_head >= rtail) { 
-    MUTEX_UNLOCK(serialRxBufferMutex);
-    return(serial_rx_buffer_head-rtail); 
-  }
-
-  MUTEX_UNLOCK(serialRxBufferMutex);
-  return (RX_BUFFER_SIZE - (rtail-serial_rx_buffer_head));
+  uint16_t rhead = atomic_load_explicit(&serial_rx_buffer_head, memory_order_acquire);
+  uint16_t rtail = atomic_load_explicit(&serial_rx_buffer_tail, memory_order_acquire);
+  if (rhead >= rtail) { return(rhead-rtail); }
+  return (RX_RING_BUFFER - (rtail-rhead));
 }
 
 
@@ -89,17 +125,10 @@ uint16_t serial_get_rx_buffer_count()
 uint16_t serial_get_tx_buffer_count()
 {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
-
-  MUTEX_LOCK(serialTxBufferMutex);
-  
-  uint16_t ttail = serial_tx_buffer_tail; // Copy to limit multiple calls to volatile
-  if (serial_tx_buffer_head >= ttail) {
-    MUTEX_UNLOCK(serialTxBufferMutex);
-    return(serial_tx_buffer_head-ttail); 
-  }
-  
-  MUTEX_UNLOCK(serialTxBufferMutex);
-  return (TX_RING_BUFFER - (ttail-serial_tx_buffer_head));
+  uint16_t thead = atomic_load_explicit(&serial_tx_buffer_head, memory_order_acquire);
+  uint16_t ttail = atomic_load_explicit(&serial_tx_buffer_tail, memory_order_acquire);
+  if (thead >= ttail) { return(thead-ttail); }
+  return (TX_RING_BUFFER - (ttail-thead));
 }
 
 
@@ -107,18 +136,6 @@ void serial_init()
 {
   printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
   memset(&serial_rx_buffer[0],0,RX_RING_BUFFER);
-  // Create some mutexes to ensure safe communication
-  if(!(serialRxBufferMutex = epicsMutexCreate())) {
-    printf("%s:%s:%d: Failed create serialRxBufferMutex\n",__FILE__,__FUNCTION__,__LINE__); 
-    return;
-  }
-  //MUTEX_UNLOCK(serialRxBufferMutex);
-
-  if(!(serialTxBufferMutex = epicsMutexCreate())) {
-    printf("%s:%s:%d: Failed create serialTxBufferMutex\n",__FILE__,__FUNCTION__,__LINE__); 
-    return;
-  }
-  //MUTEX_UNLOCK(serialTxBufferMutex);
 
   // Set baud rate
   //#if BAUD_RATE < 57600
@@ -142,81 +159,109 @@ void serial_init()
 void serial_write(uint8_t data) {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
 
-  MUTEX_LOCK(serialTxBufferMutex);
-
   // Calculate next head
-  uint16_t next_head = serial_tx_buffer_head + 1;
+  uint16_t head = atomic_load_explicit(&serial_tx_buffer_head, memory_order_relaxed);
+  uint16_t next_head = head + 1;
   if (next_head == TX_RING_BUFFER) { next_head = 0; }
 
   // Wait until there is space in the buffer
-  while (next_head == serial_tx_buffer_tail) {
+  while (next_head == atomic_load(&serial_tx_buffer_tail)) {
     // TODO: Restructure st_prep_buffer() calls to be executed here during a long print.
-    if (sys_rt_exec_state & EXEC_RESET) {
-      MUTEX_UNLOCK(serialTxBufferMutex);
-      return; 
-    } // Only check for abort to avoid an endless loop.
+    if (sys_rt_exec_state & EXEC_RESET) { return; } // Only check for abort to avoid an endless loop.
+    // Added for ecmc: Sleep until the client has read data instead of spinning.
+    epicsEventSignal(serialTxDataEvent);
+    atomic_store(&serial_tx_waiting, true);
+    if (next_head == atomic_load(&serial_tx_buffer_tail)) {
+      epicsEventWaitWithTimeout(serialTxSpaceEvent, SERIAL_TX_WAIT_TIMEOUT_S);
+    }
+    atomic_store(&serial_tx_waiting, false);
   }
 
   // Store data and advance head
-  serial_tx_buffer[serial_tx_buffer_head] = data;
-  serial_tx_buffer_head = next_head;
+  serial_tx_buffer[head] = data;
+  atomic_store_explicit(&serial_tx_buffer_head, next_head, memory_order_release);
 
-  MUTEX_UNLOCK(serialTxBufferMutex);
+  // Wake up reader when a reply line is complete (added for ecmc)
+  if (data == '\n') { epicsEventSignal(serialTxDataEvent); }
 
   // Enable Data Register Empty Interrupt to make sure tx-streaming is running
   //UCSR0B |=  (1 << UDRIE0);
 }
 
 
+// Advances the TX buffer tail and wakes up serial_write() if waiting for space. Added for ecmc
+static void serial_tx_buffer_release(uint16_t tail)
+{
+  atomic_store(&serial_tx_buffer_tail, tail);
+  if (atomic_load(&serial_tx_waiting)) { epicsEventSignal(serialTxSpaceEvent); }
+}
+
+
 // Data Register Empty Interrupt handler
 char ecmc_get_char_from_grbl_tx_buffer()
 //ISR(SERIAL_UDRE)
 {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
 
-  MUTEX_LOCK(serialTxBufferMutex);
+  uint16_t tail = atomic_load_explicit(&serial_tx_buffer_tail, memory_order_relaxed);
+  if (tail == atomic_load_explicit(&serial_tx_buffer_head, memory_order_acquire)) { return 0; }
 
-  uint16_t tail = serial_tx_buffer_tail; // Temporary serial_tx_buffer_tail (to optimize for volatile)
-  char tempChar=0;
   // Send a byte from the buffer
-  
   //UDR0 = serial_tx_buffer[tail];
-  tempChar =serial_tx_buffer[tail];
+  char tempChar = serial_tx_buffer[tail];
   // Update tail position
   tail++;
   if (tail == TX_RING_BUFFER) { tail = 0; }
 
-  serial_tx_buffer_tail = tail;
-
-  MUTEX_UNLOCK(serialTxBufferMutex);
+  serial_tx_buffer_release(tail);
 
   // Turn off Data Register Empty Interrupt to stop tx-streaming if this concludes the transfer
   //if (tail == serial_tx_buffer_head) { UCSR0B &= ~(1 << UDRIE0); }
   return tempChar;
 }
 
+// Reads up to max_count bytes from the TX serial buffer to data. Returns the number of bytes read.
+// Added for ecmc: Bulk version of ecmc_get_char_from_grbl_tx_buffer().
+uint16_t ecmc_read_from_grbl_tx_buffer(char *data, uint16_t max_count)
+{
+  uint16_t tail = atomic_load_explicit(&serial_tx_buffer_tail, memory_order_relaxed);
+  uint16_t head = atomic_load_explicit(&serial_tx_buffer_head, memory_order_acquire);
+  uint16_t count = 0;
+  while (tail != head && count < max_count) {
+    data[count++] = serial_tx_buffer[tail];
+    tail++;
+    if (tail == TX_RING_BUFFER) { tail = 0; }
+  }
+  if (count > 0) { serial_tx_buffer_release(tail); }
+  return(count);
+}
+
+
+// Waits until the TX serial buffer contains data or timeout. Returns true if data is available.
+// Added for ecmc: Replaces polling of serial_get_tx_buffer_count() in the client.
+uint8_t ecmc_wait_for_grbl_tx_data(double timeout_s)
+{
+  if (serial_get_tx_buffer_count() > 0) { return(true); }
+  epicsEventWaitWithTimeout(serialTxDataEvent, timeout_s);
+  return(serial_get_tx_buffer_count() > 0);
+}
+
+
 // Fetches the first byte in the serial read buffer. Called by main program.
 uint8_t serial_read()
 {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
-
-  MUTEX_LOCK(serialRxBufferMutex);
-  uint16_t tail = serial_rx_buffer_tail; // Temporary serial_rx_buffer_tail (to optimize for volatile)
-  if (serial_rx_buffer_head == tail) {
-    MUTEX_UNLOCK(serialRxBufferMutex);
-    //printf("tail %u, head %u, available %u\n",serial_rx_buffer_tail,serial_rx_buffer_head,serial_get_rx_buffer_available());
+  uint16_t tail = atomic_load_explicit(&serial_rx_buffer_tail, memory_order_relaxed);
+  if (atomic_load_explicit(&serial_rx_buffer_head, memory_order_acquire) == tail) {
     return SERIAL_NO_DATA;
   } else {
     uint8_t data = serial_rx_buffer[tail];
-    serial_rx_buffer[tail]=0;
 
     tail++;
     if (tail == RX_RING_BUFFER) { 
       tail = 0; 
     }
-    //printf("tail %u, head %u, available %u\n",serial_rx_buffer_tail,serial_rx_buffer_head,serial_get_rx_buffer_available());
-    serial_rx_buffer_tail = tail;
-    MUTEX_UNLOCK(serialRxBufferMutex);
+    atomic_store_explicit(&serial_rx_buffer_tail, tail, memory_order_release);
     return data;
   }
 }
@@ -269,21 +314,21 @@ void ecmc_add_char_to_buffer(char data)
         }
         // Throw away any unfound extended-ASCII character by not passing it to the serial buffer.
       } else { // Write character to buffer
-        next_head = serial_rx_buffer_head + 1;
+        uint16_t head = atomic_load_explicit(&serial_rx_buffer_head, memory_order_relaxed);
+        next_head = head + 1;
         if (next_head == RX_RING_BUFFER) { next_head = 0; }
 
         // Write data to buffer unless it is full.
-        //if (next_head != serial_rx_buffer_tail) {
-          serial_rx_buffer[serial_rx_buffer_head] = data;
-          serial_rx_buffer_head = next_head;
-        //}        
+        if (next_head != atomic_load_explicit(&serial_rx_buffer_tail, memory_order_acquire)) {
+          serial_rx_buffer[head] = data;
+          atomic_store_explicit(&serial_rx_buffer_head, next_head, memory_order_release);
+        }
       }
   }
 }
 
 // write direct to serial buffer
 void ecmc_write_command_serial(char* line) {
-  MUTEX_LOCK(serialRxBufferMutex);
   unsigned int i=0;
   for(i=0; i<strlen(line);i++) {
     ecmc_add_char_to_buffer(line[i]);    
@@ -302,7 +347,7 @@ void ecmc_write_command_serial(char* line) {
 //    }
 //  }
 //  printf("\n");
-  MUTEX_UNLOCK(serialRxBufferMutex);
+  protocol_wakeup(); // added for ecmc
   //if(enableDebugPrintouts) {
   //  printf("Added: %s\n", line);
   //}
@@ -311,5 +356,124 @@ void ecmc_write_command_serial(char* line) {
 
 void serial_reset_read_buffer()
 {
-  serial_rx_buffer_tail = serial_rx_buffer_head;
+  atomic_store_explicit(&serial_rx_buffer_tail, atomic_load_explicit(&serial_rx_buffer_head, memory_order_acquire),
+                        memory_order_release);
+  // Drop queued lines (consumer side, producer may still be writing)
+  atomic_store_explicit(&line_queue_tail, atomic_load_explicit(&line_queue_head, memory_order_acquire),
+                        memory_order_release);
+}
+
+
+// Returns the number of free entries in the line queue. Added for ecmc
+uint8_t serial_get_line_queue_available()
+{
+  uint8_t head = atomic_load_explicit(&line_queue_head, memory_order_relaxed);
+  uint8_t tail = atomic_load_explicit(&line_queue_tail, memory_order_acquire);
+  if (head >= tail) { return(LINE_QUEUE_SIZE-1 - (head-tail)); }
+  return(tail-head-1);
+}
+
+
+// Filters one line like the serial stream in protocol_main_loop(): Spaces, control characters,
+// comments and block delete are removed and letters are capitalized. A line end terminates the
+// line. At most length chars are read (data does not need to be zero-terminated). dest must hold
+// LINE_BUFFER_SIZE chars and is zero-terminated. Returns true if the filtered line is longer than
+// LINE_BUFFER_SIZE-1 (overflow). Added for ecmc
+uint8_t ecmc_filter_line(char *dest, const char *data, size_t length)
+{
+  uint8_t comment = false;
+  uint8_t char_counter = 0;
+  uint8_t overflow = false;
+  for (; length > 0 && *data != 0 && *data != '\n' && *data != '\r'; data++, length--) {
+    char c = *data;
+    if (comment) {
+      if (c == ')' && comment == '(') { comment = false; }  // End of '()' comment
+    } else if (c <= ' ' || c == '/') {
+      // Throw away whitespace, control characters and block delete
+    } else if (c == '(' || c == ';') {
+      comment = c;
+    } else if (char_counter >= (LINE_BUFFER_SIZE-1)) {
+      overflow = true;
+      break;
+    } else if (c >= 'a' && c <= 'z') {
+      dest[char_counter++] = c-'a'+'A';
+    } else {
+      dest[char_counter++] = c;
+    }
+  }
+  dest[char_counter] = 0;
+  return(overflow);
+}
+
+
+// Returns the entry to write next in the line queue, or NULL if the queue is full. Added for ecmc
+static serial_line_t *serial_line_queue_head_entry(uint8_t *next_head)
+{
+  uint8_t head = atomic_load_explicit(&line_queue_head, memory_order_relaxed);
+  *next_head = head + 1;
+  if (*next_head == LINE_QUEUE_SIZE) { *next_head = 0; }
+  if (*next_head == atomic_load_explicit(&line_queue_tail, memory_order_acquire)) { return(NULL); }
+  return(&line_queue[head]);
+}
+
+
+// Writes one complete line to the line queue. Called by the client (producer) only.
+// The line is filtered with ecmc_filter_line(). Realtime command characters are not supported
+// (use the system_set_exec_*() functions).
+// Returns false if the queue is full. Added for ecmc
+uint8_t ecmc_write_command_line(const char *data, size_t length)
+{
+  uint8_t next_head;
+  serial_line_t *entry = serial_line_queue_head_entry(&next_head);
+  if (entry == NULL) { return(false); }
+
+  entry->parsed_valid = false;
+  entry->overflow = ecmc_filter_line(entry->data, data, length);
+  atomic_store_explicit(&line_queue_head, next_head, memory_order_release);
+  protocol_wakeup();
+  return(true);
+}
+
+
+// Writes one g-code block parsed with gc_parse_line() to the line queue. The block is executed
+// with gc_execute_parsed_line() (same replies as for the text line). Called by the client
+// (producer) only. Returns false if the queue is full. Added for ecmc
+uint8_t ecmc_write_parsed_line(const gc_parsed_line_t *parsed)
+{
+  uint8_t next_head;
+  serial_line_t *entry = serial_line_queue_head_entry(&next_head);
+  if (entry == NULL) { return(false); }
+
+  entry->parsed_valid = true;
+  entry->overflow = false;
+  entry->data[0] = 0;
+  memcpy(&entry->parsed, parsed, sizeof(gc_parsed_line_t));
+  atomic_store_explicit(&line_queue_head, next_head, memory_order_release);
+  protocol_wakeup();
+  return(true);
+}
+
+
+// Returns the oldest line in the line queue, or NULL if empty. The line stays valid (and is executed
+// in place) until serial_line_queue_pop(). parsed is set to the parsed block if the entry was
+// written with ecmc_write_parsed_line(), else NULL. Called by protocol_main_loop() (consumer) only.
+// Added for ecmc
+char *serial_line_queue_peek(uint8_t *overflow, gc_parsed_line_t **parsed)
+{
+  uint8_t tail = atomic_load_explicit(&line_queue_tail, memory_order_relaxed);
+  if (tail == atomic_load_explicit(&line_queue_head, memory_order_acquire)) { return(NULL); }
+  *overflow = line_queue[tail].overflow;
+  *parsed = line_queue[tail].parsed_valid ? &line_queue[tail].parsed : NULL;
+  return(line_queue[tail].data);
+}
+
+
+// Releases the line returned by serial_line_queue_peek(). Added for ecmc
+void serial_line_queue_pop()
+{
+  uint8_t tail = atomic_load_explicit(&line_queue_tail, memory_order_relaxed);
+  if (tail == atomic_load_explicit(&line_queue_head, memory_order_acquire)) { return; }
+  tail++;
+  if (tail == LINE_QUEUE_SIZE) { tail = 0; }
+  atomic_store_explicit(&line_queue_tail, tail, memory_order_release);
 }
@@ -22,10 +22,10 @@
 #ifndef serial_h
 #define serial_h
 
-#define RX_BUFFER_SIZE 100
-
+// Added for ecmc: The buffers are lock-free rings in memory (not limited by AVR ram), sizes up to
+// 65534 bytes can be set at compile time (for instance USR_CFLAGS += -DRX_BUFFER_SIZE=1024).
 #ifndef RX_BUFFER_SIZE
-  #define RX_BUFFER_SIZE 128
+  #define RX_BUFFER_SIZE 100
 #endif
 #ifndef TX_BUFFER_SIZE
   #ifdef USE_LINE_NUMBERS
@@ -34,13 +34,42 @@
     #define TX_BUFFER_SIZE 104
   #endif
 #endif
+#if RX_BUFFER_SIZE > 65534 || TX_BUFFER_SIZE > 65534
+  #error "RX_BUFFER_SIZE and TX_BUFFER_SIZE must be less than 65535"
+#endif
+
+// Fallback timeout for serial_write() waiting for space in a full tx buffer. Added for ecmc
+#define SERIAL_TX_WAIT_TIMEOUT_S 0.01
 
 #define SERIAL_NO_DATA 0xff
 
+// Number of entries in the line queue (one entry is always kept empty). Added for ecmc
+#ifndef LINE_QUEUE_SIZE
+  #define LINE_QUEUE_SIZE 16
+#endif
+
+// Serial state of a grbl instance (see grbl_context.h). Added for ecmc
+typedef struct grbl_serial_state grbl_serial_state_t;
+grbl_serial_state_t *serial_create_state();
+void serial_delete_state(grbl_serial_state_t *state);
+
 
 void ecmc_write_command_serial(char* line);
 char ecmc_get_char_from_grbl_tx_buffer();
 
+// Bulk read of the TX buffer and signalled wait for TX data. Added for ecmc
+uint16_t ecmc_read_from_grbl_tx_buffer(char *data, uint16_t max_count);
+uint8_t ecmc_wait_for_grbl_tx_data(double timeout_s);
+
+// Line queue: Complete lines written by the client directly to protocol_main_loop(), bypassing the
+// byte wise rx buffer (see grbl_serial.c). Added for ecmc
+uint8_t ecmc_filter_line(char *dest, const char *data, size_t length);
+uint8_t ecmc_write_command_line(const char *data, size_t length);
+uint8_t ecmc_write_parsed_line(const gc_parsed_line_t *parsed);
+uint8_t serial_get_line_queue_available();
+char *serial_line_queue_peek(uint8_t *overflow, gc_parsed_line_t **parsed);
+void serial_line_queue_pop();
+
 void serial_init();
 
 // Writes one byte to the TX serial buffer. Called by main program.
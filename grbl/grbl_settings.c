@@ -21,8 +21,6 @@
 
 #include "grbl.h"
 
-settings_t settings;
-
 const settings_t defaults = {\
     .pulse_microseconds = DEFAULT_STEP_PULSE_MICROSECONDS,
     .stepper_idle_lock_time = DEFAULT_STEPPER_IDLE_LOCK_TIME,
@@ -81,13 +79,13 @@ void settings_store_build_info(char *line)
 
 
 // Method to store coord data parameters into EEPROM
-void settings_write_coord_data(uint8_t coord_select, float *coord_data)
+void settings_write_coord_data(uint8_t coord_select, real_t *coord_data)
 {
   #ifdef FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE
     protocol_buffer_synchronize();
   #endif
-  uint32_t addr = coord_select*(sizeof(float)*N_AXIS+1) + EEPROM_ADDR_PARAMETERS;
-  memcpy_to_eeprom_with_checksum(addr,(char*)coord_data, sizeof(float)*N_AXIS);
+  uint32_t addr = coord_select*(sizeof(real_t)*N_AXIS+1) + EEPROM_ADDR_PARAMETERS;
+  memcpy_to_eeprom_with_checksum(addr,(char*)coord_data, sizeof(real_t)*N_AXIS);
 }
 
 
@@ -109,7 +107,7 @@ void settings_restore(uint8_t restore_flag) {
 
   if (restore_flag & SETTINGS_RESTORE_PARAMETERS) {
     uint8_t idx;
-    float coord_data[N_AXIS];
+    real_t coord_data[N_AXIS];
     memset(&coord_data, 0, sizeof(coord_data));
     for (idx=0; idx <= SETTING_INDEX_NCOORD; idx++) { settings_write_coord_data(idx, coord_data); }
   }
@@ -161,10 +159,10 @@ uint8_t settings_read_build_info(char *line)
 
 
 // Read selected coordinate data from EEPROM. Updates pointed coord_data value.
-uint8_t settings_read_coord_data(uint8_t coord_select, float *coord_data)
+uint8_t settings_read_coord_data(uint8_t coord_select, real_t *coord_data)
 {
-  uint32_t addr = coord_select*(sizeof(float)*N_AXIS+1) + EEPROM_ADDR_PARAMETERS;
-  if (!(memcpy_from_eeprom_with_checksum((char*)coord_data, addr, sizeof(float)*N_AXIS))) {
+  uint32_t addr = coord_select*(sizeof(real_t)*N_AXIS+1) + EEPROM_ADDR_PARAMETERS;
+  if (!(memcpy_from_eeprom_with_checksum((char*)coord_data, addr, sizeof(real_t)*N_AXIS))) {
     // Reset with default zero vector
     clear_vector_float(coord_data);
     settings_write_coord_data(coord_select,coord_data);
@@ -191,7 +189,7 @@ uint8_t read_global_settings() {
 
 
 // A helper method to set settings from command line
-uint8_t settings_store_global_setting(uint8_t parameter, float value) {
+uint8_t settings_store_global_setting(uint8_t parameter, real_t value) {
   if (value < 0.0) { return(STATUS_NEGATIVE_VALUE); }
   if (parameter >= AXIS_SETTINGS_START_VAL) {
     // Store axis configuration. Axis numbering sequence set by AXIS_SETTING defines.
@@ -256,7 +254,7 @@ uint8_t settings_store_global_setting(uint8_t parameter, float value) {
         break;
       case 10: settings.status_report_mask = int_value; break;
       case 11: settings.junction_deviation = value; break;
-      case 12: settings.arc_tolerance = value; break;
+      case 12: settings.arc_tolerance = value; break; // Not used with ARC_NATIVE_BLOCKS (ecmc)
       case 13:
         if (int_value) { settings.flags |= BITFLAG_REPORT_INCHES; }
         else { settings.flags &= ~BITFLAG_REPORT_INCHES; }
@@ -86,10 +86,10 @@
 // Global persistent settings (Stored from byte EEPROM_ADDR_GLOBAL onwards)
 typedef struct {
   // Axis settings
-  float steps_per_mm[N_AXIS];
-  float max_rate[N_AXIS];
-  float acceleration[N_AXIS];
-  float max_travel[N_AXIS];
+  real_t steps_per_mm[N_AXIS];
+  real_t max_rate[N_AXIS];
+  real_t acceleration[N_AXIS];
+  real_t max_travel[N_AXIS];
 
   // Remaining Grbl settings
   uint8_t pulse_microseconds;
@@ -97,21 +97,21 @@ typedef struct {
   uint8_t dir_invert_mask;
   uint8_t stepper_idle_lock_time; // If max value 255, steppers do not disable.
   uint8_t status_report_mask; // Mask to indicate desired report data.
-  float junction_deviation;
-  float arc_tolerance;
+  real_t junction_deviation;
+  real_t arc_tolerance;
 
-  float rpm_max;
-  float rpm_min;
+  real_t rpm_max;
+  real_t rpm_min;
 
   uint8_t flags;  // Contains default boolean settings
 
   uint8_t homing_dir_mask;
-  float homing_feed_rate;
-  float homing_seek_rate;
+  real_t homing_feed_rate;
+  real_t homing_seek_rate;
   uint16_t homing_debounce_delay;
-  float homing_pulloff;
+  real_t homing_pulloff;
 } settings_t;
-extern settings_t settings;
+// NOTE: settings is stored in the grbl context (see grbl_context.h). Added for ecmc
 
 // Initialize the configuration subsystem (load settings from EEPROM)
 void settings_init();
@@ -120,7 +120,7 @@ void settings_init();
 void settings_restore(uint8_t restore_flag);
 
 // A helper method to set new settings from command line
-uint8_t settings_store_global_setting(uint8_t parameter, float value);
+uint8_t settings_store_global_setting(uint8_t parameter, real_t value);
 
 // Stores the protocol line variable as a startup line in EEPROM
 void settings_store_startup_line(uint8_t n, char *line);
@@ -135,10 +135,10 @@ void settings_store_build_info(char *line);
 uint8_t settings_read_build_info(char *line);
 
 // Writes selected coordinate data to EEPROM
-void settings_write_coord_data(uint8_t coord_select, float *coord_data);
+void settings_write_coord_data(uint8_t coord_select, real_t *coord_data);
 
 // Reads selected coordinate data from EEPROM
-uint8_t settings_read_coord_data(uint8_t coord_select, float *coord_data);
+uint8_t settings_read_coord_data(uint8_t coord_select, real_t *coord_data);
 
 // Returns the step pin mask according to Grbl's internal axis numbering
 uint8_t get_step_pin_mask(uint8_t i);
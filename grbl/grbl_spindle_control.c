@@ -22,7 +22,8 @@
 #include "grbl.h"
 
 #ifdef VARIABLE_SPINDLE
-  static float pwm_gradient; // Precalulated value to speed up rpm to PWM conversions.
+  // Precalulated value to speed up rpm to PWM conversions. Stored in the grbl context (added for ecmc)
+  #define pwm_gradient (grbl_ctx->spindle_pwm_gradient)
 #endif
 
 
@@ -207,7 +208,7 @@ void spindle_stop()
 //  #else 
 //  
 //    // Called by spindle_set_state() and step segment generator. Keep routine small and efficient.
-    uint8_t spindle_compute_pwm_value(float rpm) // 328p PWM register is 8-bit.
+    uint8_t spindle_compute_pwm_value(real_t rpm) // 328p PWM register is 8-bit.
     {
       uint8_t pwm_value;
       rpm *= (0.010*sys.spindle_speed_ovr); // Scale by spindle speed override value.
@@ -241,7 +242,7 @@ void spindle_stop()
 // Called by g-code parser spindle_sync(), parking retract and restore, g-code program end,
 // sleep, and spindle stop override.
 #ifdef VARIABLE_SPINDLE
-  void spindle_set_state(uint8_t state, float rpm)
+  void spindle_set_state(uint8_t state, real_t rpm)
 #else
   void _spindle_set_state(uint8_t state)
 #endif
@@ -293,7 +294,7 @@ void spindle_stop()
 // G-code parser entry-point for setting spindle state. Forces a planner buffer sync and bails 
 // if an abort or check-mode is active.
 #ifdef VARIABLE_SPINDLE
-  void spindle_sync(uint8_t state, float rpm)
+  void spindle_sync(uint8_t state, real_t rpm)
   {
     //printf("%s:%s:%d Not supported yet..\n",__FILE__,__FUNCTION__,__LINE__);
     if (sys.state == STATE_CHECK_MODE) { return; }
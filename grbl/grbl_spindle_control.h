@@ -42,17 +42,17 @@ uint8_t spindle_get_state();
 #ifdef VARIABLE_SPINDLE
 
   // Called by g-code parser when setting spindle state and requires a buffer sync.
-  void spindle_sync(uint8_t state, float rpm);
+  void spindle_sync(uint8_t state, real_t rpm);
 
   // Sets spindle running state with direction, enable, and spindle PWM.
-  void spindle_set_state(uint8_t state, float rpm); 
+  void spindle_set_state(uint8_t state, real_t rpm); 
   
   // Sets spindle PWM quickly for stepper ISR. Also called by spindle_set_state().
   // NOTE: 328p PWM register is 8-bit.
   void spindle_set_speed(uint8_t pwm_value);
   
   // Computes 328p-specific PWM register value for the given RPM for quick updating.
-  uint8_t spindle_compute_pwm_value(float rpm);
+  uint8_t spindle_compute_pwm_value(real_t rpm);
   
 #else
   
@@ -20,6 +20,7 @@
 */
 
 #include "grbl.h"
+#include <stdatomic.h>
 #include <pthread.h>
 #include <unistd.h>
 
@@ -57,6 +58,14 @@
   #endif
 #endif
 
+// Bit-shift of the Bresenham data in st_block_t relative to the planner block step counts.
+// Added for ecmc (used to track continuous block progress).
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+  #define ST_BLOCK_STEP_SHIFT MAX_AMASS_LEVEL
+#else
+  #define ST_BLOCK_STEP_SHIFT 1
+#endif
+
 
 // Stores the planner block Bresenham algorithm execution data for the segments in the segment
 // buffer. Normally, this buffer is partially in-use, but, for the worst case scenario, it will
@@ -74,8 +83,22 @@ typedef struct {
   #ifdef VARIABLE_SPINDLE
     uint8_t is_pwm_rate_adjusted; // Tracks motions that require constant laser power/rate
   #endif
+  real_t axis_steps_per_mm[N_AXIS]; // Added for ecmc. Signed axis steps per mm of block path (feed-forward).
+
+  // Added for ecmc. Native arc block (see plan_arc_t). The axis positions are interpolated on the
+  // arc from the block fraction instead of the Bresenham line (see st_arc_offset()).
+  uint8_t is_arc;
+  uint8_t arc_axis[2];               // Plane axes
+  double arc_r[2];                   // Radius vector from center to start position (mm)
+  double arc_step_per_mm[2];         // Steps per mm of the plane axes
+  double arc_angular_travel;         // Signed angular travel (rad)
+  double arc_end_correction[2];      // Block target minus arc end of the plane axes (steps)
+  double arc_inv_millimeters;        // Inverse path length (1/mm)
+
+  #ifdef USE_LINE_NUMBERS
+    int32_t line_number;             // Added for ecmc. Line number of planner block (trace).
+  #endif
 } st_block_t;
-static st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE-1];
 
 // Primary stepper segment ring buffer. Contains small, short line segments for the stepper
 // algorithm to execute, which are "checked-out" incrementally from the first block in the
@@ -94,8 +117,9 @@ typedef struct {
   #ifdef VARIABLE_SPINDLE
     uint8_t spindle_pwm;
   #endif
+  real_t speed;               // Added for ecmc. Average path speed of segment (mm/min)
+  real_t acceleration;        // Added for ecmc. Average path acceleration of segment (mm/min^2)
 } segment_t;
-static segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
 
 // Stepper ISR data struct. Contains the running data for the main stepper ISR.
 typedef struct {
@@ -123,29 +147,18 @@ typedef struct {
   uint8_t exec_block_index; // Tracks the current st_block index. Change indicates new block.
   st_block_t *exec_block;   // Pointer to the block data for the segment being executed
   segment_t *exec_segment;  // Pointer to the segment being executed
-} stepper_t;
-static stepper_t st;
-
-// Step segment ring buffer indices
-static volatile uint8_t segment_buffer_tail;
-static uint8_t segment_buffer_head;
-static uint8_t segment_next_head;
 
-// Step and direction port invert masks.
-static uint8_t step_port_invert_mask;
-static uint8_t dir_port_invert_mask;
-#ifdef ENABLE_DUAL_AXIS
-  static uint8_t step_port_invert_mask_dual;
-  static uint8_t dir_port_invert_mask_dual;
-#endif
+  // Added for ecmc (continuous interpolation)
+  uint64_t block_progress;  // Executed part of block in st_block_t step_event_count units.
+  double event_fraction;    // Executed fraction of the next step event of the segment.
+  int32_t block_start_position[N_AXIS]; // sys_position at start of executing block.
 
-// Used to avoid ISR nesting of the "Stepper Driver Interrupt". Should never occur though.
-static volatile uint8_t busy;
+  // Added for ecmc (feed-forward of executing segment)
+  double ff_velocity[N_AXIS];      // Axis velocity (steps/s)
+  double ff_acceleration[N_AXIS];  // Axis acceleration (steps/s^2)
 
-// Pointers for the step segment being prepped from the planner buffer. Accessed only by the
-// main program. Pointers may be planning segments or planner blocks ahead of what being executed.
-static plan_block_t *pl_block;     // Pointer to the planner block being prepped
-static st_block_t *st_prep_block;  // Pointer to the stepper block data being prepped
+  uint32_t segment_count;   // Segments loaded since reset. Added for ecmc (trace)
+} stepper_t;
 
 // Segment preparation data struct. Contains all the necessary information to compute new segments
 // based on the current executing planner block.
@@ -153,33 +166,116 @@ typedef struct {
   uint8_t st_block_index;  // Index of stepper common data block being prepped
   uint8_t recalculate_flag;
 
-  float dt_remainder;
-  float steps_remaining;
-  float step_per_mm;
-  float req_mm_increment;
+  real_t dt_remainder;
+  real_t steps_remaining;
+  real_t step_per_mm;
+  real_t req_mm_increment;
 
   #ifdef PARKING_ENABLE
     uint8_t last_st_block_index;
-    float last_steps_remaining;
-    float last_step_per_mm;
-    float last_dt_remainder;
+    real_t last_steps_remaining;
+    real_t last_step_per_mm;
+    real_t last_dt_remainder;
   #endif
 
   uint8_t ramp_type;      // Current segment ramp state
-  float mm_complete;      // End of velocity profile from end of current planner block in (mm).
+  real_t mm_complete;      // End of velocity profile from end of current planner block in (mm).
                           // NOTE: This value must coincide with a step(no mantissa) when converted.
-  float current_speed;    // Current speed at the end of the segment buffer (mm/min)
-  float maximum_speed;    // Maximum speed of executing block. Not always nominal speed. (mm/min)
-  float exit_speed;       // Exit speed of executing block (mm/min)
-  float accelerate_until; // Acceleration ramp end measured from end of block (mm)
-  float decelerate_after; // Deceleration ramp start measured from end of block (mm)
+  real_t current_speed;    // Current speed at the end of the segment buffer (mm/min)
+  real_t maximum_speed;    // Maximum speed of executing block. Not always nominal speed. (mm/min)
+  real_t exit_speed;       // Exit speed of executing block (mm/min)
+  real_t accelerate_until; // Acceleration ramp end measured from end of block (mm)
+  real_t decelerate_after; // Deceleration ramp start measured from end of block (mm)
 
   #ifdef VARIABLE_SPINDLE
-    float inv_rate;    // Used by PWM laser mode to speed up segment calculations.
+    real_t inv_rate;    // Used by PWM laser mode to speed up segment calculations.
     uint8_t current_spindle_pwm; 
   #endif
 } st_prep_t;
-static st_prep_t prep;
+
+
+// Stepper state of a grbl instance. Added for ecmc: Stored in the grbl context (see
+// grbl_context.h) and accessed with the original names.
+#define ST_CACHE_LINE_SIZE 64
+struct grbl_stepper_state {
+  st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE-1];
+  segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
+  stepper_t st;
+
+  // Continuous (not step quantized) machine position in steps. Added for ecmc.
+  double st_continuous_position[N_AXIS];
+
+  // Step segment ring buffer indices. Added for ecmc: The segment buffer is a lock-free single
+  // producer (st_prep_buffer(), grbl main thread) single consumer (stepper ISR, ecmc rt thread)
+  // ring. The producer publishes segment_buffer_head with release ordering after the segment data
+  // is written and the consumer releases segment_buffer_tail after the segment is consumed. The
+  // indices are kept on separate cache lines to avoid false sharing between the two threads.
+  _Alignas(ST_CACHE_LINE_SIZE) atomic_uint_fast8_t segment_buffer_tail;  // Written by consumer only
+  _Alignas(ST_CACHE_LINE_SIZE) atomic_uint_fast8_t segment_buffer_head;  // Written by producer only
+  uint8_t segment_next_head;                                              // Producer only
+  atomic_bool segment_prep_pending;  // Producer has more motion to prep (underrun detection)
+
+  // Segment buffer water marks and underruns (see st_get_segment_buffer_stats()). Added for ecmc
+  _Alignas(ST_CACHE_LINE_SIZE) atomic_uint segment_buffer_high_water; // Updated by producer
+  _Alignas(ST_CACHE_LINE_SIZE) atomic_uint segment_buffer_low_water;  // Updated by consumer
+  atomic_uint segment_buffer_underruns;                                // Updated by consumer
+
+  // Step and direction port invert masks.
+  uint8_t step_port_invert_mask;
+  uint8_t dir_port_invert_mask;
+  #ifdef ENABLE_DUAL_AXIS
+    uint8_t step_port_invert_mask_dual;
+    uint8_t dir_port_invert_mask_dual;
+  #endif
+
+  // Used to avoid ISR nesting of the "Stepper Driver Interrupt". Should never occur though.
+  volatile uint8_t busy;
+
+  // Pointers for the step segment being prepped from the planner buffer. Accessed only by the
+  // main program. Pointers may be planning segments or planner blocks ahead of what being executed.
+  plan_block_t *pl_block;     // Pointer to the planner block being prepped
+  st_block_t *st_prep_block;  // Pointer to the stepper block data being prepped
+
+  st_prep_t prep;
+};
+
+#define st_block_buffer            (grbl_ctx->stepper->st_block_buffer)
+#define segment_buffer             (grbl_ctx->stepper->segment_buffer)
+#define st                         (grbl_ctx->stepper->st)
+#define st_continuous_position     (grbl_ctx->stepper->st_continuous_position)
+#define segment_buffer_tail        (grbl_ctx->stepper->segment_buffer_tail)
+#define segment_buffer_head        (grbl_ctx->stepper->segment_buffer_head)
+#define segment_next_head          (grbl_ctx->stepper->segment_next_head)
+#define segment_prep_pending       (grbl_ctx->stepper->segment_prep_pending)
+#define segment_buffer_high_water  (grbl_ctx->stepper->segment_buffer_high_water)
+#define segment_buffer_low_water   (grbl_ctx->stepper->segment_buffer_low_water)
+#define segment_buffer_underruns   (grbl_ctx->stepper->segment_buffer_underruns)
+#define step_port_invert_mask      (grbl_ctx->stepper->step_port_invert_mask)
+#define dir_port_invert_mask       (grbl_ctx->stepper->dir_port_invert_mask)
+#ifdef ENABLE_DUAL_AXIS
+  #define step_port_invert_mask_dual (grbl_ctx->stepper->step_port_invert_mask_dual)
+  #define dir_port_invert_mask_dual  (grbl_ctx->stepper->dir_port_invert_mask_dual)
+#endif
+#define busy                       (grbl_ctx->stepper->busy)
+#define pl_block                   (grbl_ctx->stepper->pl_block)
+#define st_prep_block              (grbl_ctx->stepper->st_prep_block)
+#define prep                       (grbl_ctx->stepper->prep)
+
+
+grbl_stepper_state_t *st_create_state()
+{
+  // Cache line aligned for the segment buffer indices
+  void *state = NULL;
+  if (posix_memalign(&state, ST_CACHE_LINE_SIZE, sizeof(grbl_stepper_state_t))) { return(NULL); }
+  memset(state, 0, sizeof(grbl_stepper_state_t));
+  return((grbl_stepper_state_t*)state);
+}
+
+
+void st_delete_state(grbl_stepper_state_t *state)
+{
+  free(state);
+}
 
 
 /*    BLOCK VELOCITY PROFILE DEFINITION
@@ -265,6 +361,10 @@ void st_go_idle()
   //TCCR1B = (TCCR1B & ~((1<<CS12) | (1<<CS11))) | (1<<CS10); // Reset clock to no prescaling.
   busy = false;
 
+  // Added for ecmc. No feed-forward when idle.
+  memset(st.ff_velocity, 0, sizeof(st.ff_velocity));
+  memset(st.ff_acceleration, 0, sizeof(st.ff_acceleration));
+
   // Set stepper driver idle state, disabled or enabled, depending on settings and circumstances.
   bool pin_state = false; // Keep enabled.
   if (((settings.stepper_idle_lock_time != 0xff) || sys_rt_exec_alarm || sys.state == STATE_SLEEP) && sys.state != STATE_HOMING) {
@@ -330,185 +430,493 @@ void st_go_idle()
 // int8 variables and update position counters only when a segment completes. This can get complicated
 // with probing and homing cycles that require true real-time positions.
 
-// call from plugin execute
-// returns exe_time_rate_ms (need to downsample to ecmc rate)
-double ecmc_grbl_main_rt_thread()
-{ 
-  //PRINTF_DEBUG("");
+// Discards the executed segment by advancing the segment buffer tail. The release ordering
+// hands the segment slot back to the producer only after the segment data has been consumed.
+static void st_discard_segment()
+{
+  uint8_t tail = atomic_load_explicit(&segment_buffer_tail, memory_order_relaxed);
+  if ( ++tail == SEGMENT_BUFFER_SIZE) { tail = 0; }
+  atomic_store_explicit(&segment_buffer_tail, tail, memory_order_release);
+  protocol_wakeup(); // Slot free for st_prep_buffer() in the grbl main thread (added for ecmc)
+}
 
-  if (busy || !stepperInterruptEnable) { return -1.0; } // The busy-flag is used to avoid reentering this interrupt
 
-  // Set the direction pins a couple of nanoseconds before we step the steppers
-  //DIRECTION_PORT = (DIRECTION_PORT & ~DIRECTION_MASK) | (st.dir_outbits & DIRECTION_MASK);
-  //#ifdef ENABLE_DUAL_AXIS
-  //  DIRECTION_PORT_DUAL = (DIRECTION_PORT_DUAL & ~DIRECTION_MASK_DUAL) | (st.dir_outbits_dual & DIRECTION_MASK_DUAL);
-  //#endif
-//
-  //// Then pulse the stepping pins
-  //#ifdef STEP_PULSE_DELAY
-  //  st.step_bits = (STEP_PORT & ~STEP_MASK) | st.step_outbits; // Store out_bits to prevent overwriting.
-  //  #ifdef ENABLE_DUAL_AXIS
-  //    st.step_bits_dual = (STEP_PORT_DUAL & ~STEP_MASK_DUAL) | st.step_outbits_dual;
-  //  #endif
-  //#else  // Normal operation
-  //  STEP_PORT = (STEP_PORT & ~STEP_MASK) | st.step_outbits;
-  //  #ifdef ENABLE_DUAL_AXIS
-  //    STEP_PORT_DUAL = (STEP_PORT_DUAL & ~STEP_MASK_DUAL) | st.step_outbits_dual;
-  //  #endif
-  //#endif
+// Returns the block progress (in st_block_t step_event_count units) of one step event of the
+// executing segment. A full block always corresponds to step_event_count.
+static uint32_t st_block_progress_per_event()
+{
+  #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    return(1UL << (ST_BLOCK_STEP_SHIFT - st.exec_segment->amass_level));
+  #else
+    return(1UL << ST_BLOCK_STEP_SHIFT);
+  #endif
+}
 
-  // Enable step pulse reset timer so that The Stepper Port Reset Interrupt can reset the signal after
-  // exactly settings.pulse_microseconds microseconds, independent of the main Timer1 prescaler.
-  //TCNT0 = st.step_pulse_time; // Reload Timer0 counter
-  //TCCR0B = (1<<CS01); // Begin Timer0. Full speed, 1/8 prescaler
 
-  busy = true;
-  //sei(); // Re-enable interrupts to allow Stepper Port Reset Interrupt to fire on-time.
-         // NOTE: The remaining code in this ISR will finish before returning to main program.
+// Returns the executed fraction of the executing block (0..1) from the block progress. Added for ecmc
+static double st_block_fraction()
+{
+  double progress = (double)st.block_progress;
+  if (st.exec_segment != NULL) { progress += st.event_fraction*st_block_progress_per_event(); }
+  double block_fraction = progress/(double)st.exec_block->step_event_count;
+  if (block_fraction > 1.0) { block_fraction = 1.0; }
+  return(block_fraction);
+}
 
-  // If there is no step segment, attempt to pop one from the stepper buffer
-  if (st.exec_segment == NULL) {
-    // Anything in the buffer? If so, load and initialize next step segment.
-    if (segment_buffer_head != segment_buffer_tail) {
-
-      // Initialize new step segment and load number of steps to execute
-      st.exec_segment = &segment_buffer[segment_buffer_tail];
-      //printf("New segment!!!\n");
-      //printf("n_step %d, spindle_pwm %d, cycles_per_tick %lf, %lf\n", st.exec_segment->n_step, 
-      //                                                                st.exec_segment->spindle_pwm,(double)st.exec_segment->cycles_per_tick/((double)F_CPU)*1000,
-      //                                                                st.exec_segment->ecmc_interrupt_time_ms);
-      
-      //#ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-      //  // With AMASS is disabled, set timer prescaler for segments with slow step frequencies (< 250Hz).
-      //  TCCR1B = (TCCR1B & ~(0x07<<CS10)) | (st.exec_segment->prescaler<<CS10);
-      //#endif
-
-      // Initialize step segment timing per step and load number of steps to execute.
-      //OCR1A = st.exec_segment->cycles_per_tick;
-      st.step_count = st.exec_segment->n_step; // NOTE: Can sometimes be zero when moving slow.
-      // If the new segment starts a new planner block, initialize stepper variables and counters.
-      // NOTE: When the segment data index changes, this indicates a new planner block.
-      if ( st.exec_block_index != st.exec_segment->st_block_index ) {
-        st.exec_block_index = st.exec_segment->st_block_index;
-        st.exec_block = &st_block_buffer[st.exec_block_index];
-
-        // Initialize Bresenham line and distance counters
-        st.counter_x = st.counter_y = st.counter_z = (st.exec_block->step_event_count >> 1);
-      }
 
-      //printf("X steps %d, sys_position %d, step_event_count %d\n", st.steps[X_AXIS],sys_position[X_AXIS],st.exec_block->step_event_count);
-      //printf("Y steps %d, sys_position %d, step_event_count %d\n", st.steps[Y_AXIS],sys_position[Y_AXIS],st.exec_block->step_event_count);
-      //printf("Z steps %d, sys_position %d, step_event_count %d\n", st.steps[Z_AXIS],sys_position[Z_AXIS],st.exec_block->step_event_count);
+// Returns the axis offsets (steps) from the start of an arc block at the block fraction u. The plane
+// axes follow the arc, with the difference between the arc end and the step quantized target
+// distributed linearly, so that the offsets are exactly the block steps at u = 1. The other axes
+// (helical linear axis) move linearly. Added for ecmc
+static void st_arc_offset(st_block_t *block, double u, double *offset)
+{
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    offset[idx] = (double)(block->steps[idx] >> ST_BLOCK_STEP_SHIFT)*u;
+    if (block->direction_bits & get_direction_pin_mask(idx)) { offset[idx] = -offset[idx]; }
+  }
+  double phi = u*block->arc_angular_travel;
+  double cos_phi = cos(phi);
+  double sin_phi = sin(phi);
+  offset[block->arc_axis[0]] = block->arc_step_per_mm[0]*
+    (block->arc_r[0]*cos_phi - block->arc_r[1]*sin_phi - block->arc_r[0]) + u*block->arc_end_correction[0];
+  offset[block->arc_axis[1]] = block->arc_step_per_mm[1]*
+    (block->arc_r[0]*sin_phi + block->arc_r[1]*cos_phi - block->arc_r[1]) + u*block->arc_end_correction[1];
+}
 
 
-      st.dir_outbits = st.exec_block->direction_bits ^ dir_port_invert_mask;
-      #ifdef ENABLE_DUAL_AXIS
-        st.dir_outbits_dual = st.exec_block->direction_bits_dual ^ dir_port_invert_mask_dual;
-      #endif
+// Sets the axis feed-forward of the executing arc block from the path tangent and the centripetal
+// acceleration at the block fraction u. Added for ecmc
+static void st_arc_feed_forward(double u)
+{
+  st_block_t *block = st.exec_block;
+  double speed = st.exec_segment->speed/60.0;               // mm/s
+  double acceleration = st.exec_segment->acceleration/3600.0; // mm/s^2
+  double k = block->arc_inv_millimeters;
+  double theta = block->arc_angular_travel;
+  double cos_phi = cos(u*theta);
+  double sin_phi = sin(u*theta);
+
+  // First and second derivative of the position by u (steps)
+  double d[N_AXIS], dd[N_AXIS];
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    d[idx] = (double)(block->steps[idx] >> ST_BLOCK_STEP_SHIFT);
+    if (block->direction_bits & get_direction_pin_mask(idx)) { d[idx] = -d[idx]; }
+    dd[idx] = 0.0;
+  }
+  d[block->arc_axis[0]] = block->arc_step_per_mm[0]*theta*(-block->arc_r[0]*sin_phi - block->arc_r[1]*cos_phi) +
+                          block->arc_end_correction[0];
+  d[block->arc_axis[1]] = block->arc_step_per_mm[1]*theta*(block->arc_r[0]*cos_phi - block->arc_r[1]*sin_phi) +
+                          block->arc_end_correction[1];
+  dd[block->arc_axis[0]] = block->arc_step_per_mm[0]*theta*theta*(-block->arc_r[0]*cos_phi + block->arc_r[1]*sin_phi);
+  dd[block->arc_axis[1]] = block->arc_step_per_mm[1]*theta*theta*(-block->arc_r[0]*sin_phi - block->arc_r[1]*cos_phi);
 
-      #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-        // With AMASS enabled, adjust Bresenham axis increment counters according to AMASS level.
-        st.steps[X_AXIS] = st.exec_block->steps[X_AXIS] >> st.exec_segment->amass_level;
-        st.steps[Y_AXIS] = st.exec_block->steps[Y_AXIS] >> st.exec_segment->amass_level;
-        st.steps[Z_AXIS] = st.exec_block->steps[Z_AXIS] >> st.exec_segment->amass_level;
-      #endif
+  for (idx=0; idx<N_AXIS; idx++) {
+    st.ff_velocity[idx] = speed*k*d[idx];
+    st.ff_acceleration[idx] = acceleration*k*d[idx] + speed*speed*k*k*dd[idx];
+  }
+}
 
-      #ifdef VARIABLE_SPINDLE
-        // Set real-time spindle output as segment is loaded, just prior to the first step.        
-        //spindle_set_speed(st.exec_segment->spindle_pwm);
-      #endif
 
-    } else {
-      // Segment buffer empty. Shutdown.
-      //printf("Segment buffer empty!!!!!!!!!!!!!!!!!!!!!");
-      st_go_idle();
-      #ifdef VARIABLE_SPINDLE
-        // Ensure pwm is set properly upon completion of rate-controlled motion.
-        if (st.exec_block->is_pwm_rate_adjusted) {
-          //spindle_set_speed(SPINDLE_PWM_OFF_VALUE);         
-        }
-      #endif
-      system_set_exec_state_flag(EXEC_CYCLE_STOP); // Flag main program for cycle end
-      return -1.0; // Nothing to do but exit.
+// Loads the next step segment from the segment buffer into the stepper ISR data. Returns false
+// and shuts down the stepper subsystem if the segment buffer is empty.
+static uint8_t st_load_segment()
+{
+  uint8_t tail = atomic_load_explicit(&segment_buffer_tail, memory_order_relaxed);
+  uint8_t head = atomic_load_explicit(&segment_buffer_head, memory_order_acquire);
+
+  // Anything in the buffer? If so, load and initialize next step segment.
+  if (head != tail) {
+
+    // Track lowest buffer fill level seen when popping a segment
+    unsigned int fill = (head >= tail) ? (head - tail) : (SEGMENT_BUFFER_SIZE - tail + head);
+    if (fill < atomic_load_explicit(&segment_buffer_low_water, memory_order_relaxed)) {
+      atomic_store_explicit(&segment_buffer_low_water, fill, memory_order_relaxed);
+    }
+
+    // Initialize new step segment and load number of steps to execute
+    st.exec_segment = &segment_buffer[tail];
+    st.segment_count++; // Added for ecmc
+
+    // Initialize step segment timing per step and load number of steps to execute.
+    st.step_count = st.exec_segment->n_step; // NOTE: Can sometimes be zero when moving slow.
+    // If the new segment starts a new planner block, initialize stepper variables and counters.
+    // NOTE: When the segment data index changes, this indicates a new planner block.
+    if ( st.exec_block_index != st.exec_segment->st_block_index ) {
+      st.exec_block_index = st.exec_segment->st_block_index;
+      st.exec_block = &st_block_buffer[st.exec_block_index];
+
+      // Initialize Bresenham line and distance counters
+      st.counter_x = st.counter_y = st.counter_z = (st.exec_block->step_event_count >> 1);
+
+      // Initialize continuous block progress
+      st.block_progress = 0;
+      memcpy(st.block_start_position, sys_position, sizeof(sys_position));
+    }
+    st.event_fraction = 0.0;
+
+    // Axis feed-forward from segment path speed/acceleration and block direction (unit vector)
+    if (st.exec_block->is_arc) { st_arc_feed_forward(st_block_fraction()); }
+    else {
+      uint8_t idx;
+      for (idx=0; idx<N_AXIS; idx++) {
+        st.ff_velocity[idx] = st.exec_segment->speed*st.exec_block->axis_steps_per_mm[idx]/60.0;
+        st.ff_acceleration[idx] = st.exec_segment->acceleration*st.exec_block->axis_steps_per_mm[idx]/3600.0;
+      }
     }
+
+    st.dir_outbits = st.exec_block->direction_bits ^ dir_port_invert_mask;
+    #ifdef ENABLE_DUAL_AXIS
+      st.dir_outbits_dual = st.exec_block->direction_bits_dual ^ dir_port_invert_mask_dual;
+    #endif
+
+    #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+      // With AMASS enabled, adjust Bresenham axis increment counters according to AMASS level.
+      st.steps[X_AXIS] = st.exec_block->steps[X_AXIS] >> st.exec_segment->amass_level;
+      st.steps[Y_AXIS] = st.exec_block->steps[Y_AXIS] >> st.exec_segment->amass_level;
+      st.steps[Z_AXIS] = st.exec_block->steps[Z_AXIS] >> st.exec_segment->amass_level;
+    #endif
+
+    #ifdef VARIABLE_SPINDLE
+      // Set real-time spindle output as segment is loaded, just prior to the first step.
+      //spindle_set_speed(st.exec_segment->spindle_pwm);
+    #endif
+    return(true);
   }
 
-  //printf("EXE\n");
-  // Check probing state.
-  if (sys_probe_state == PROBE_ACTIVE) { probe_state_monitor(); }
+  // Segment buffer empty. Count as underrun if the main program still had motion to prep.
+  if (atomic_load_explicit(&segment_prep_pending, memory_order_acquire)) {
+    atomic_fetch_add_explicit(&segment_buffer_underruns, 1, memory_order_relaxed);
+  }
 
-  // Reset step out bits.
-  st.step_outbits = 0;
-  #ifdef ENABLE_DUAL_AXIS
-    st.step_outbits_dual = 0;
+  // Segment buffer empty. Shutdown.
+  st_go_idle();
+  #ifdef VARIABLE_SPINDLE
+    // Ensure pwm is set properly upon completion of rate-controlled motion.
+    if (st.exec_block->is_pwm_rate_adjusted) {
+      //spindle_set_speed(SPINDLE_PWM_OFF_VALUE);
+    }
   #endif
+  system_set_exec_state_flag(EXEC_CYCLE_STOP); // Flag main program for cycle end
+  return(false);
+}
+
+
+// Advances one Bresenham axis counter by n_events step events and returns the number of steps
+// the axis takes. Equivalent to n_events iterations of the per-event tracer:
+//   counter += steps; if (counter > step_event_count) { counter -= step_event_count; step; }
+// Since steps <= step_event_count and the counter never exceeds step_event_count between events,
+// at most one step is taken per event and the result can be computed with one division.
+// NOTE: *last_event_step is set if the last of the n_events produced a step (step_outbits).
+static uint32_t st_bresenham_advance(uint32_t *counter, uint32_t steps, uint32_t step_event_count,
+                                     uint16_t n_events, uint8_t *last_event_step)
+{
+  uint64_t acc = (uint64_t)(*counter) + (uint64_t)steps*n_events;
+  uint32_t n_steps = 0;
+  if (acc > step_event_count) { n_steps = (acc-1)/step_event_count; }
+  *counter = acc - (uint64_t)n_steps*step_event_count;
+  // The last event stepped exactly when the remaining counter is not larger than the increment.
+  *last_event_step = (n_steps > 0) && (*counter <= steps);
+  return(n_steps);
+}
+
+
+// Executes n_events step events of the loaded segment by the Bresenham line algorithm. The
+// counters and sys_position are advanced arithmetically, so the cost does not depend on n_events.
+static void st_exec_bresenham_events(uint16_t n_events)
+{
+  uint32_t n_steps;
+  uint8_t last_event_step;
 
   // Execute step displacement profile by Bresenham line algorithm
   #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_x += st.steps[X_AXIS];
+    n_steps = st_bresenham_advance(&st.counter_x, st.steps[X_AXIS], st.exec_block->step_event_count, n_events, &last_event_step);
   #else
-    st.counter_x += st.exec_block->steps[X_AXIS];
+    n_steps = st_bresenham_advance(&st.counter_x, st.exec_block->steps[X_AXIS], st.exec_block->step_event_count, n_events, &last_event_step);
   #endif
-  if (st.counter_x > st.exec_block->step_event_count) {
+  if (last_event_step) {
     st.step_outbits |= (1<<X_STEP_BIT);
     #if defined(ENABLE_DUAL_AXIS) && (DUAL_AXIS_SELECT == X_AXIS)
       st.step_outbits_dual = (1<<DUAL_STEP_BIT);
     #endif
-    st.counter_x -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<X_DIRECTION_BIT)) { sys_position[X_AXIS]--; }
-    else { sys_position[X_AXIS]++; }
   }
+  if (st.exec_block->direction_bits & (1<<X_DIRECTION_BIT)) { sys_position[X_AXIS] -= n_steps; }
+  else { sys_position[X_AXIS] += n_steps; }
+
   #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_y += st.steps[Y_AXIS];
+    n_steps = st_bresenham_advance(&st.counter_y, st.steps[Y_AXIS], st.exec_block->step_event_count, n_events, &last_event_step);
   #else
-    st.counter_y += st.exec_block->steps[Y_AXIS];
+    n_steps = st_bresenham_advance(&st.counter_y, st.exec_block->steps[Y_AXIS], st.exec_block->step_event_count, n_events, &last_event_step);
   #endif
-  if (st.counter_y > st.exec_block->step_event_count) {
+  if (last_event_step) {
     st.step_outbits |= (1<<Y_STEP_BIT);
     #if defined(ENABLE_DUAL_AXIS) && (DUAL_AXIS_SELECT == Y_AXIS)
       st.step_outbits_dual = (1<<DUAL_STEP_BIT);
     #endif
-    st.counter_y -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<Y_DIRECTION_BIT)) { sys_position[Y_AXIS]--; }
-    else { sys_position[Y_AXIS]++; }
   }
+  if (st.exec_block->direction_bits & (1<<Y_DIRECTION_BIT)) { sys_position[Y_AXIS] -= n_steps; }
+  else { sys_position[Y_AXIS] += n_steps; }
+
   #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_z += st.steps[Z_AXIS];
+    n_steps = st_bresenham_advance(&st.counter_z, st.steps[Z_AXIS], st.exec_block->step_event_count, n_events, &last_event_step);
   #else
-    st.counter_z += st.exec_block->steps[Z_AXIS];
+    n_steps = st_bresenham_advance(&st.counter_z, st.exec_block->steps[Z_AXIS], st.exec_block->step_event_count, n_events, &last_event_step);
   #endif
-  if (st.counter_z > st.exec_block->step_event_count) {
-    st.step_outbits |= (1<<Z_STEP_BIT);
-    st.counter_z -= st.exec_block->step_event_count;
-    if (st.exec_block->direction_bits & (1<<Z_DIRECTION_BIT)) { sys_position[Z_AXIS]--; }
-    else { sys_position[Z_AXIS]++; }
+  if (last_event_step) { st.step_outbits |= (1<<Z_STEP_BIT); }
+  if (st.exec_block->direction_bits & (1<<Z_DIRECTION_BIT)) { sys_position[Z_AXIS] -= n_steps; }
+  else { sys_position[Z_AXIS] += n_steps; }
+}
+
+
+// Moves sys_position to the arc position at the executed step events (rounded to steps). Steps
+// are output for the axes that moved. Added for ecmc
+static void st_exec_arc_events()
+{
+  double offset[N_AXIS];
+  double u = (double)st.block_progress/(double)st.exec_block->step_event_count;
+  st_arc_offset(st.exec_block, u, offset);
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) {
+    int32_t position = st.block_start_position[idx] + (int32_t)lround(offset[idx]);
+    if (position != sys_position[idx]) {
+      st.step_outbits |= get_step_pin_mask(idx);
+      sys_position[idx] = position;
+    }
   }
+  st_arc_feed_forward(u);
+}
+
+
+// Executes n_events step events of the loaded segment.
+// NOTE: n_events must be >0 and <= st.step_count.
+static void st_exec_step_events(uint16_t n_events)
+{
+  // Reset step out bits.
+  st.step_outbits = 0;
+  #ifdef ENABLE_DUAL_AXIS
+    st.step_outbits_dual = 0;
+  #endif
+
+  st.block_progress += (uint64_t)n_events*st_block_progress_per_event();
+  if (st.exec_block->is_arc) { st_exec_arc_events(); } // Added for ecmc
+  else { st_exec_bresenham_events(n_events); }
 
   // During a homing cycle, lock out and prevent desired axes from moving.
-  if (sys.state == STATE_HOMING) { 
+  if (sys.state == STATE_HOMING) {
     st.step_outbits &= sys.homing_axis_lock;
     #ifdef ENABLE_DUAL_AXIS
       st.step_outbits_dual &= sys.homing_axis_lock_dual;
     #endif
   }
 
-  st.step_count--; // Decrement step events count
+  st.step_count -= n_events; // Decrement step events count
   if (st.step_count == 0) {
     // Segment is complete. Discard current segment and advance segment indexing.
     st.exec_segment = NULL;
-    if ( ++segment_buffer_tail == SEGMENT_BUFFER_SIZE) { segment_buffer_tail = 0; }
+    st_discard_segment();
   }
 
   st.step_outbits ^= step_port_invert_mask;  // Apply step port invert mask
   #ifdef ENABLE_DUAL_AXIS
     st.step_outbits_dual ^= step_port_invert_mask_dual;
   #endif
+}
+
+
+// Executes step events of the current segment until budget_ms of ISR tick time is consumed or
+// the segment completes. At least one step event is executed. Returns the ISR tick time of the
+// segment in ms, or -1.0 if the segment completed or nothing could be executed (same as
+// ecmc_grbl_main_rt_thread()). The number of executed step events is returned in n_events.
+static double st_exec_segment_ticks(double budget_ms, uint16_t *n_events)
+{
+  *n_events = 0;
+
+  if (busy || !stepperInterruptEnable) { return -1.0; } // The busy-flag is used to avoid reentering this interrupt
+
+  busy = true;
+
+  // If there is no step segment, attempt to pop one from the stepper buffer
+  if (st.exec_segment == NULL) {
+    if (!st_load_segment()) {
+      return -1.0; // Nothing to do but exit.
+    }
+  }
+
+  double tick_time_ms = st.exec_segment->ecmc_interrupt_time_ms;
+
+  // Number of events the per-event loop would execute before the time budget is reached.
+  uint16_t n = st.step_count;
+  if (sys_probe_state == PROBE_ACTIVE) {
+    // Probing requires the probe pin to be checked each step event.
+    probe_state_monitor();
+    n = 1;
+  } else if (tick_time_ms > 0 && budget_ms > tick_time_ms) {
+    double n_budget = ceil(budget_ms/tick_time_ms);
+    if (n_budget < (double)n) { n = (uint16_t)n_budget; }
+  } else if (tick_time_ms > 0) {
+    n = 1;
+  }
+  if (n == 0) { n = 1; }
+
+  st_exec_step_events(n);
+  *n_events = n;
+
   busy = false;
 
   if(!st.exec_segment) {
     return -1.0;
   }
-  return st.exec_segment->ecmc_interrupt_time_ms;
+  return tick_time_ms;
+}
+
+
+// call from plugin execute
+// returns exe_time_rate_ms (need to downsample to ecmc rate)
+// Executes one step event (one emulated stepper ISR tick).
+double ecmc_grbl_main_rt_thread()
+{
+  uint16_t n_events;
+  return st_exec_segment_ticks(0.0, &n_events);
+}
+
+
+// call from plugin execute
+// Executes all step events that fit in one ecmc sample (sample_time_ms). Gives the same
+// segment, Bresenham and sys_position result as calling ecmc_grbl_main_rt_thread() in a loop
+// while accumulating the returned tick time in time_to_next_ms, but runs in O(segments)
+// instead of O(steps). time_to_next_ms is the carried tick time between ecmc cycles.
+// NOTE: The tick time of a segment is accumulated by multiplication instead of repeated
+// additions, which can differ from the per-event loop in the last bits of time_to_next_ms.
+// Returns the number of executed step events.
+uint32_t ecmc_grbl_main_rt_execute(double *time_to_next_ms, double sample_time_ms)
+{
+  uint32_t step_events = 0;
+  uint16_t n_events = 0;
+  double tick_time_ms = 0.0;
+
+  while (*time_to_next_ms < sample_time_ms && tick_time_ms >= 0) {
+    tick_time_ms = st_exec_segment_ticks(sample_time_ms - *time_to_next_ms, &n_events);
+    step_events += n_events;
+    if (tick_time_ms > 0) {
+      *time_to_next_ms += n_events*tick_time_ms;
+    } else {
+      *time_to_next_ms = 0;  // reset since no more steps..
+    }
+  }
+  if (tick_time_ms >= 0) {
+    *time_to_next_ms -= sample_time_ms;
+  }
+  return step_events;
+}
+
+
+// Updates the continuous machine position from the progress of the executing block. The
+// position is interpolated linearly between the block start position and the block target
+// (on the arc for arc blocks), so it is not quantized to steps. At the end of a block it equals
+// sys_position.
+static void st_update_continuous_position()
+{
+  if (st.exec_block == NULL) { return; }
+
+  double block_fraction = st_block_fraction();
+
+  uint8_t idx;
+  if (st.exec_block->is_arc) {
+    double offset[N_AXIS];
+    st_arc_offset(st.exec_block, block_fraction, offset);
+    for (idx=0; idx<N_AXIS; idx++) {
+      st_continuous_position[idx] = (double)st.block_start_position[idx] + offset[idx];
+    }
+    if (st.exec_segment != NULL) { st_arc_feed_forward(block_fraction); }
+    return;
+  }
+  for (idx=0; idx<N_AXIS; idx++) {
+    double axis_steps = (double)(st.exec_block->steps[idx] >> ST_BLOCK_STEP_SHIFT)*block_fraction;
+    if (st.exec_block->direction_bits & get_direction_pin_mask(idx)) { axis_steps = -axis_steps; }
+    st_continuous_position[idx] = (double)st.block_start_position[idx] + axis_steps;
+  }
+}
+
+
+// call from plugin execute (continuous interpolation mode)
+// Advances the executing segments by sample_time_ms of motion time without step emulation.
+// Each segment is executed at its constant rate, so the velocity profile computed by
+// st_prep_buffer() is sampled directly at the ecmc sample time. Whole step events are still
+// applied to sys_position (Bresenham), while the continuous position is interpolated.
+// Returns number of executed step events.
+uint32_t ecmc_grbl_main_rt_execute_continuous(double sample_time_ms)
+{
+  double budget_ms = sample_time_ms;
+  uint32_t step_events = 0;
+
+  if (busy || !stepperInterruptEnable) { return 0; } // The busy-flag is used to avoid reentering this interrupt
+
+  busy = true;
+
+  while (budget_ms > 0) {
+    // If there is no step segment, attempt to pop one from the stepper buffer
+    if (st.exec_segment == NULL) {
+      if (!st_load_segment()) {
+        return step_events; // Nothing to do but exit.
+      }
+    }
+
+    // Check probing state.
+    if (sys_probe_state == PROBE_ACTIVE) { probe_state_monitor(); }
+
+    double tick_time_ms = st.exec_segment->ecmc_interrupt_time_ms;
+    double events_remaining = (double)st.step_count - st.event_fraction;
+    double events = events_remaining;
+    if (tick_time_ms > 0) { events = budget_ms/tick_time_ms; }
+
+    if (st.step_count == 0) {
+      // Segment without steps. Discard current segment and advance segment indexing.
+      st.exec_segment = NULL;
+      st_discard_segment();
+    } else if (events >= events_remaining) {
+      // Complete the segment and continue with the next one in this sample.
+      if (tick_time_ms > 0) { budget_ms -= events_remaining*tick_time_ms; }
+      step_events += st.step_count;
+      st_exec_step_events(st.step_count);
+    } else {
+      // Sample ends within the segment.
+      double events_total = st.event_fraction + events;
+      uint16_t n_events = (uint16_t)events_total;
+      if (n_events > 0) { st_exec_step_events(n_events); }
+      step_events += n_events;
+      st.event_fraction = events_total - n_events;
+      budget_ms = 0;
+    }
+    st_update_continuous_position();
+  }
+
+  busy = false;
+  return step_events;
+}
+
+
+// Returns the continuous (not step quantized) machine position in steps.
+void st_get_continuous_position(double *position)
+{
+  memcpy(position, st_continuous_position, sizeof(st_continuous_position));
+}
+
+
+// Returns axis velocity (steps/s) and acceleration (steps/s^2) of the executing segment.
+// Computed from the segment path speed and acceleration and the block direction. Added for ecmc
+void st_get_feed_forward(double *velocity, double *acceleration)
+{
+  memcpy(velocity, st.ff_velocity, sizeof(st.ff_velocity));
+  memcpy(acceleration, st.ff_acceleration, sizeof(st.ff_acceleration));
+}
+
+
+// Syncs the continuous machine position to sys_position. Call when sys_position is set.
+void st_sync_continuous_position()
+{
+  uint8_t idx;
+  for (idx=0; idx<N_AXIS; idx++) { st_continuous_position[idx] = (double)sys_position[idx]; }
 }
 
 
@@ -583,13 +991,15 @@ void st_reset()
   memset(&st, 0, sizeof(stepper_t));
   st.exec_segment = NULL;
   pl_block = NULL;  // Planner block pointer used by segment buffer
-  segment_buffer_tail = 0;
-  segment_buffer_head = 0; // empty = tail
+  atomic_store_explicit(&segment_buffer_tail, 0, memory_order_relaxed);
+  atomic_store_explicit(&segment_buffer_head, 0, memory_order_release); // empty = tail
   segment_next_head = 1;
+  atomic_store_explicit(&segment_prep_pending, false, memory_order_release);
   busy = false;
 
   st_generate_step_dir_invert_masks();
   st.dir_outbits = dir_port_invert_mask; // Initialize direction bits to default.
+  st_sync_continuous_position();
 
   // Initialize step and direction port pins.
   //STEP_PORT = (STEP_PORT & ~STEP_MASK) | step_port_invert_mask;
@@ -608,6 +1018,9 @@ void stepper_init()
 {
   //PRINTF_DEBUG("");
 
+  // Added for ecmc
+  st_reset_segment_buffer_stats();
+
   // Configure step and direction interface pins
 //  STEP_DDR |= STEP_MASK;
 //  STEPPERS_DISABLE_DDR |= 1<<STEPPERS_DISABLE_BIT;
@@ -699,6 +1112,36 @@ static uint8_t st_next_block_index(uint8_t block_index)
 #endif
 
 
+// Copies the arc geometry of the loaded planner block to the prepped stepper block. The end
+// correction is the difference between the step quantized block target and the arc end, which is
+// distributed over the arc by st_arc_offset(). Added for ecmc
+static void st_prep_arc_block()
+{
+  plan_arc_t *arc = &pl_block->arc;
+  st_prep_block->arc_axis[0] = arc->axis_0;
+  st_prep_block->arc_axis[1] = arc->axis_1;
+  st_prep_block->arc_r[0] = arc->r_axis0;
+  st_prep_block->arc_r[1] = arc->r_axis1;
+  st_prep_block->arc_step_per_mm[0] = settings.steps_per_mm[arc->axis_0];
+  st_prep_block->arc_step_per_mm[1] = settings.steps_per_mm[arc->axis_1];
+  st_prep_block->arc_angular_travel = arc->angular_travel;
+  st_prep_block->arc_inv_millimeters = 1.0/pl_block->millimeters;
+
+  double cos_travel = cos(st_prep_block->arc_angular_travel);
+  double sin_travel = sin(st_prep_block->arc_angular_travel);
+  double arc_end[2];
+  arc_end[0] = st_prep_block->arc_step_per_mm[0]*(arc->r_axis0*cos_travel - arc->r_axis1*sin_travel - arc->r_axis0);
+  arc_end[1] = st_prep_block->arc_step_per_mm[1]*(arc->r_axis0*sin_travel + arc->r_axis1*cos_travel - arc->r_axis1);
+  uint8_t i;
+  for (i=0; i<2; i++) {
+    uint8_t idx = st_prep_block->arc_axis[i];
+    double block_steps = (double)pl_block->steps[idx];
+    if (pl_block->direction_bits & get_direction_pin_mask(idx)) { block_steps = -block_steps; }
+    st_prep_block->arc_end_correction[i] = block_steps - arc_end[i];
+  }
+}
+
+
 /* Prepares step segment buffer. Continuously called from main program.
 
    The segment buffer is an intermediary buffer interface between the execution of steps
@@ -712,14 +1155,15 @@ static uint8_t st_next_block_index(uint8_t block_index)
    Currently, the segment buffer conservatively holds roughly up to 40-50 msec of steps.
    NOTE: Computation units are in steps, millimeters, and minutes.
 */
-void st_prep_buffer()
+static void st_prep_segments()
 {
   //PRINTF_DEBUG("");
 
   // Block step prep buffer, while in a suspend state and there is no suspend motion to execute.
   if (bit_istrue(sys.step_control,STEP_CONTROL_END_MOTION)) { return; }
 
-  while (segment_buffer_tail != segment_next_head) { // Check if we need to fill the buffer.
+  // Check if we need to fill the buffer.
+  while (atomic_load_explicit(&segment_buffer_tail, memory_order_acquire) != segment_next_head) {
     // Determine if we need to load a new planner block or if the block needs to be recomputed.
     if (pl_block == NULL) {
 
@@ -770,8 +1214,24 @@ void st_prep_buffer()
         #endif
 
         // Initialize segment buffer data for generating the segments.
-        prep.steps_remaining = (float)pl_block->step_event_count;
+        prep.steps_remaining = (real_t)pl_block->step_event_count;
         prep.step_per_mm = prep.steps_remaining/pl_block->millimeters;
+
+        // Added for ecmc. Axis steps per mm of path, signed by direction (feed-forward).
+        for (idx=0; idx<N_AXIS; idx++) {
+          st_prep_block->axis_steps_per_mm[idx] = prep.step_per_mm*(real_t)pl_block->steps[idx]/(real_t)pl_block->step_event_count;
+          if (pl_block->direction_bits & get_direction_pin_mask(idx)) {
+            st_prep_block->axis_steps_per_mm[idx] = -st_prep_block->axis_steps_per_mm[idx];
+          }
+        }
+
+        // Added for ecmc. Arc geometry for the stepper interpolation (see st_arc_offset()).
+        st_prep_block->is_arc = pl_block->is_arc;
+        if (pl_block->is_arc) { st_prep_arc_block(); }
+        #ifdef USE_LINE_NUMBERS
+          st_prep_block->line_number = pl_block->line_number; // Added for ecmc
+        #endif
+
         prep.req_mm_increment = REQ_MM_INCREMENT_SCALAR/prep.step_per_mm;
         prep.dt_remainder = 0.0; // Reset for new segment block
 
@@ -805,14 +1265,14 @@ void st_prep_buffer()
 			 hold, override the planner velocities and decelerate to the target exit speed.
 			*/
 			prep.mm_complete = 0.0; // Default velocity profile complete at 0.0mm from end of block.
-			float inv_2_accel = 0.5/pl_block->acceleration;
+			real_t inv_2_accel = 0.5/pl_block->acceleration;
       //printf("pl_block->acceleration=%f\n",pl_block->acceleration);
 			if (sys.step_control & STEP_CONTROL_EXECUTE_HOLD) { // [Forced Deceleration to Zero Velocity]
 				// Compute velocity profile parameters for a feed hold in-progress. This profile overrides
 				// the planner block profile, enforcing a deceleration to zero speed.
 				prep.ramp_type = RAMP_DECEL;
 				// Compute decelerate distance relative to end of block.
-				float decel_dist = pl_block->millimeters - inv_2_accel*pl_block->entry_speed_sqr;
+				real_t decel_dist = pl_block->millimeters - inv_2_accel*pl_block->entry_speed_sqr;
 				if (decel_dist < 0.0) {
 					// Deceleration through entire planner block. End of feed hold is not in this block.
 					prep.exit_speed = sqrt(pl_block->entry_speed_sqr-2*pl_block->acceleration*pl_block->millimeters);
@@ -825,8 +1285,8 @@ void st_prep_buffer()
 				prep.ramp_type = RAMP_ACCEL; // Initialize as acceleration ramp.
 				prep.accelerate_until = pl_block->millimeters;
 
-				float exit_speed_sqr;
-				float nominal_speed;
+				real_t exit_speed_sqr;
+				real_t nominal_speed;
         if (sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION) {
           prep.exit_speed = exit_speed_sqr = 0.0; // Enforce stop at end of system motion.
         } else {
@@ -835,8 +1295,8 @@ void st_prep_buffer()
         }
 
         nominal_speed = plan_compute_profile_nominal_speed(pl_block);
-				float nominal_speed_sqr = nominal_speed*nominal_speed;
-				float intersect_distance =
+				real_t nominal_speed_sqr = nominal_speed*nominal_speed;
+				real_t intersect_distance =
 								0.5*(pl_block->millimeters+inv_2_accel*(pl_block->entry_speed_sqr-exit_speed_sqr));
 
         if (pl_block->entry_speed_sqr > nominal_speed_sqr) { // Only occurs during override reductions.
@@ -896,7 +1356,7 @@ void st_prep_buffer()
     }
     
     // Initialize new segment
-    segment_t *prep_segment = &segment_buffer[segment_buffer_head];
+    segment_t *prep_segment = &segment_buffer[atomic_load_explicit(&segment_buffer_head, memory_order_relaxed)];
 
     // Set new segment to point to the current segment data block.
     prep_segment->st_block_index = prep.st_block_index;
@@ -915,13 +1375,14 @@ void st_prep_buffer()
       the end of planner block (typical) or mid-block at the end of a forced deceleration,
       such as from a feed hold.
     */
-    float dt_max = DT_SEGMENT; // Maximum segment time
-    float dt = 0.0; // Initialize segment time
-    float time_var = dt_max; // Time worker variable
-    float mm_var; // mm-Distance worker variable
-    float speed_var; // Speed worker variable
-    float mm_remaining = pl_block->millimeters; // New segment distance from end of block.
-    float minimum_mm = mm_remaining-prep.req_mm_increment; // Guarantee at least one step.
+    real_t dt_max = DT_SEGMENT; // Maximum segment time
+    real_t dt = 0.0; // Initialize segment time
+    real_t time_var = dt_max; // Time worker variable
+    real_t mm_var; // mm-Distance worker variable
+    real_t speed_var; // Speed worker variable
+    real_t mm_remaining = pl_block->millimeters; // New segment distance from end of block.
+    real_t segment_start_speed = prep.current_speed; // Added for ecmc (feed-forward)
+    real_t minimum_mm = mm_remaining-prep.req_mm_increment; // Guarantee at least one step.
     if (minimum_mm < 0.0) { minimum_mm = 0.0; }
 
     do {
@@ -1000,6 +1461,11 @@ void st_prep_buffer()
 
     } while (mm_remaining > prep.mm_complete); // **Complete** Exit loop. Profile complete.
 
+    // Added for ecmc. Average path speed and acceleration of segment (feed-forward)
+    prep_segment->speed = 0.5*(segment_start_speed + prep.current_speed);
+    if (dt > 0.0) { prep_segment->acceleration = (prep.current_speed - segment_start_speed)/dt; }
+    else { prep_segment->acceleration = 0.0; }
+
     #ifdef VARIABLE_SPINDLE
       /* -----------------------------------------------------------------------------------
         Compute spindle speed PWM output for step segment
@@ -1007,7 +1473,7 @@ void st_prep_buffer()
       
       if (st_prep_block->is_pwm_rate_adjusted || (sys.step_control & STEP_CONTROL_UPDATE_SPINDLE_PWM)) {
         if (pl_block->condition & (PL_COND_FLAG_SPINDLE_CW | PL_COND_FLAG_SPINDLE_CCW)) {
-          float rpm = pl_block->spindle_speed;
+          real_t rpm = pl_block->spindle_speed;
           // NOTE: Feed and rapid overrides are independent of PWM value and do not alter laser power/rate.        
           if (st_prep_block->is_pwm_rate_adjusted) { rpm *= (prep.current_speed * prep.inv_rate); }
           // If current_speed is zero, then may need to be rpm_min*(100/MAX_SPINDLE_SPEED_OVERRIDE)
@@ -1033,9 +1499,9 @@ void st_prep_buffer()
        Fortunately, this scenario is highly unlikely and unrealistic in CNC machines
        supported by Grbl (i.e. exceeding 10 meters axis travel at 200 step/mm).
     */
-    float step_dist_remaining = prep.step_per_mm*mm_remaining; // Convert mm_remaining to steps
-    float n_steps_remaining = ceil(step_dist_remaining); // Round-up current steps remaining
-    float last_n_steps_remaining = ceil(prep.steps_remaining); // Round-up last steps remaining
+    real_t step_dist_remaining = prep.step_per_mm*mm_remaining; // Convert mm_remaining to steps
+    real_t n_steps_remaining = ceil(step_dist_remaining); // Round-up current steps remaining
+    real_t last_n_steps_remaining = ceil(prep.steps_remaining); // Round-up last steps remaining
     prep_segment->n_step = last_n_steps_remaining-n_steps_remaining; // Compute number of steps to execute.
 
     // Bail if we are at the end of a feed hold and don't have a step to execute.
@@ -1060,7 +1526,7 @@ void st_prep_buffer()
     // typically very small and do not adversely effect performance, but ensures that Grbl
     // outputs the exact acceleration and velocity profiles as computed by the planner.
     dt += prep.dt_remainder; // Apply previous segment partial step execute time
-    float inv_rate = dt/(last_n_steps_remaining - step_dist_remaining); // Compute adjusted step rate inverse
+    real_t inv_rate = dt/(last_n_steps_remaining - step_dist_remaining); // Compute adjusted step rate inverse
 
     // Compute CPU cycles per step for the prepped segment.
     uint32_t cycles = ceil( (TICKS_PER_MICROSECOND*1000000*60)*inv_rate ); // (cycles/step)
@@ -1104,9 +1570,18 @@ void st_prep_buffer()
     #endif
     // Added for ecmc
     // Segment complete! Increment segment buffer indices, so stepper ISR can immediately execute it.
-    segment_buffer_head = segment_next_head;
+    // Release ordering publishes the segment (and stepper block) data before the new head.
+    atomic_store_explicit(&segment_buffer_head, segment_next_head, memory_order_release);
     if ( ++segment_next_head == SEGMENT_BUFFER_SIZE ) { segment_next_head = 0; }
 
+    // Track highest buffer fill level
+    uint8_t tail = atomic_load_explicit(&segment_buffer_tail, memory_order_relaxed);
+    uint8_t head = atomic_load_explicit(&segment_buffer_head, memory_order_relaxed);
+    unsigned int fill = (head >= tail) ? (head - tail) : (SEGMENT_BUFFER_SIZE - tail + head);
+    if (fill > atomic_load_explicit(&segment_buffer_high_water, memory_order_relaxed)) {
+      atomic_store_explicit(&segment_buffer_high_water, fill, memory_order_relaxed);
+    }
+
     // Update the appropriate planner and segment data.
     pl_block->millimeters = mm_remaining;
     prep.steps_remaining = n_steps_remaining;
@@ -1138,11 +1613,68 @@ void st_prep_buffer()
 }
 
 
+void st_prep_buffer()
+{
+  st_prep_segments();
+
+  // Tell the stepper ISR if more motion is pending, so an empty segment buffer can be told
+  // apart from a normal end of motion (underrun detection). Added for ecmc
+  bool pending = bit_isfalse(sys.step_control,STEP_CONTROL_END_MOTION) &&
+                 ((pl_block != NULL) || (plan_get_current_block() != NULL));
+  atomic_store_explicit(&segment_prep_pending, pending, memory_order_release);
+}
+
+
+// Returns segment buffer high/low water marks and underruns since last reset. Added for ecmc
+void st_get_segment_buffer_stats(st_segment_buffer_stats_t *stats)
+{
+  stats->high_water = atomic_load_explicit(&segment_buffer_high_water, memory_order_relaxed);
+  stats->low_water = atomic_load_explicit(&segment_buffer_low_water, memory_order_relaxed);
+  stats->underruns = atomic_load_explicit(&segment_buffer_underruns, memory_order_relaxed);
+}
+
+
+// Returns number of segments loaded since reset. Added for ecmc
+uint32_t st_get_segment_count()
+{
+  return(st.segment_count);
+}
+
+
+// Returns true if the segment buffer holds segments not yet loaded by the stepper. After an underrun
+// the main program may prep the last segments of a block (and discard the block) after the stepper
+// went idle, so the cycle is restarted for these also without planner blocks. Added for ecmc
+uint8_t st_segment_buffer_pending()
+{
+  return(atomic_load_explicit(&segment_buffer_head, memory_order_acquire) !=
+         atomic_load_explicit(&segment_buffer_tail, memory_order_acquire));
+}
+
+
+// Returns line number of the executing block (0 if none). Added for ecmc
+int32_t st_get_line_number()
+{
+  #ifdef USE_LINE_NUMBERS
+    if (st.exec_segment != NULL && st.exec_block != NULL) { return(st.exec_block->line_number); }
+  #endif
+  return(0);
+}
+
+
+// Resets segment buffer water marks and underrun counter. Added for ecmc
+void st_reset_segment_buffer_stats()
+{
+  atomic_store_explicit(&segment_buffer_high_water, 0, memory_order_relaxed);
+  atomic_store_explicit(&segment_buffer_low_water, SEGMENT_BUFFER_SIZE, memory_order_relaxed);
+  atomic_store_explicit(&segment_buffer_underruns, 0, memory_order_relaxed);
+}
+
+
 // Called by realtime status reporting to fetch the current speed being executed. This value
 // however is not exactly the current speed, but the speed computed in the last step segment
 // in the segment buffer. It will always be behind by up to the number of segment blocks (-1)
 // divided by the ACCELERATION TICKS PER SECOND in seconds.
-float st_get_realtime_rate()
+real_t st_get_realtime_rate()
 {
   //PRINTF_DEBUG("");
 
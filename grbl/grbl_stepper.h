@@ -26,6 +26,18 @@
   #define SEGMENT_BUFFER_SIZE 32
 #endif
 
+// Segment buffer statistics. Added for ecmc
+typedef struct {
+  uint32_t high_water;  // Highest number of segments in buffer
+  uint32_t low_water;   // Lowest number of segments in buffer when a segment was loaded
+  uint32_t underruns;   // Segment buffer ran empty while motion was still pending
+} st_segment_buffer_stats_t;
+
+// Stepper state of a grbl instance (see grbl_context.h). Added for ecmc
+typedef struct grbl_stepper_state grbl_stepper_state_t;
+grbl_stepper_state_t *st_create_state();
+void st_delete_state(grbl_stepper_state_t *state);
+
 // Initialize and setup the stepper motor subsystem
 void stepper_init();
 
@@ -54,10 +66,41 @@ void st_prep_buffer();
 void st_update_plan_block_parameters();
 
 // Called by realtime status reporting if realtime rate reporting is enabled in config.h.
-float st_get_realtime_rate();
+real_t st_get_realtime_rate();
 
 // main execution
 double ecmc_grbl_main_rt_thread();
 
+// Executes all step events within one ecmc sample. Returns number of executed step events.
+uint32_t ecmc_grbl_main_rt_execute(double *time_to_next_ms, double sample_time_ms);
+
+// Executes one ecmc sample of motion time without step emulation (continuous interpolation).
+// Returns number of executed step events.
+uint32_t ecmc_grbl_main_rt_execute_continuous(double sample_time_ms);
+
+// Returns the continuous (not step quantized) machine position in steps.
+void st_get_continuous_position(double *position);
+
+// Returns axis feed-forward velocity (steps/s) and acceleration (steps/s^2) of executing segment.
+void st_get_feed_forward(double *velocity, double *acceleration);
+
+// Syncs the continuous machine position to sys_position.
+void st_sync_continuous_position();
+
+// Returns segment buffer high/low water marks and underruns since last reset.
+void st_get_segment_buffer_stats(st_segment_buffer_stats_t *stats);
+
+// Resets segment buffer water marks and underrun counter.
+void st_reset_segment_buffer_stats();
+
+// Returns number of segments loaded since reset (executing segment, trace). Added for ecmc
+uint32_t st_get_segment_count();
+
+// Returns true if the segment buffer holds segments not yet loaded by the stepper. Added for ecmc
+uint8_t st_segment_buffer_pending();
+
+// Returns line number (N) of the executing block, 0 if none. Added for ecmc
+int32_t st_get_line_number();
+
 
 #endif
@@ -135,7 +135,7 @@ uint8_t system_execute_line(char *line)
 
   uint8_t char_counter = 1;
   uint8_t helper_var = 0; // Helper variable
-  float parameter, value;  
+  real_t parameter, value;  
   switch( line[char_counter] ) {
     case 0 : report_grbl_help(); break;
     case 'J' : // Jogging
@@ -300,14 +300,14 @@ void system_flag_wco_change()
 // Returns machine position of axis 'idx'. Must be sent a 'step' array.
 // NOTE: If motor steps and machine position are not in the same coordinate frame, this function
 //   serves as a central place to compute the transformation.
-float system_convert_axis_steps_to_mpos(int32_t *steps, uint8_t idx)
+real_t system_convert_axis_steps_to_mpos(int32_t *steps, uint8_t idx)
 {
-  float pos;
+  real_t pos;
   #ifdef COREXY
     if (idx==X_AXIS) {
-      pos = (float)system_convert_corexy_to_x_axis_steps(steps) / settings.steps_per_mm[idx];
+      pos = (real_t)system_convert_corexy_to_x_axis_steps(steps) / settings.steps_per_mm[idx];
     } else if (idx==Y_AXIS) {
-      pos = (float)system_convert_corexy_to_y_axis_steps(steps) / settings.steps_per_mm[idx];
+      pos = (real_t)system_convert_corexy_to_y_axis_steps(steps) / settings.steps_per_mm[idx];
     } else {
       pos = steps[idx]/settings.steps_per_mm[idx];
     }
@@ -318,7 +318,7 @@ float system_convert_axis_steps_to_mpos(int32_t *steps, uint8_t idx)
 }
 
 
-void system_convert_array_steps_to_mpos(float *position, int32_t *steps)
+void system_convert_array_steps_to_mpos(real_t *position, int32_t *steps)
 {
   uint8_t idx;
   for (idx=0; idx<N_AXIS; idx++) {
@@ -342,7 +342,7 @@ void system_convert_array_steps_to_mpos(float *position, int32_t *steps)
 
 
 // Checks and reports if target array exceeds machine travel limits.
-uint8_t system_check_travel_limits(float *target)
+uint8_t system_check_travel_limits(real_t *target)
 {
   uint8_t idx;
   for (idx=0; idx<N_AXIS; idx++) {
@@ -370,8 +370,9 @@ void system_set_exec_state_flag(uint8_t mask) {
 
   //uint8_t sreg = SREG;
   //cli();
-  sys_rt_exec_state |= (mask);
+  __atomic_fetch_or(&sys_rt_exec_state, mask, __ATOMIC_SEQ_CST); // Set from several threads (ecmc)
   //SREG = sreg;
+  protocol_wakeup(); // added for ecmc
 }
 
 void system_clear_exec_state_flag(uint8_t mask) {
@@ -379,7 +380,7 @@ void system_clear_exec_state_flag(uint8_t mask) {
 
   //uint8_t sreg = SREG;
   //cli();
-  sys_rt_exec_state &= ~(mask);
+  __atomic_fetch_and(&sys_rt_exec_state, (uint8_t)~(mask), __ATOMIC_SEQ_CST); // ecmc
   //SREG = sreg;
 }
 
@@ -389,6 +390,7 @@ void system_set_exec_alarm(uint8_t code) {
   //cli();
   sys_rt_exec_alarm = code;
   //SREG = sreg;
+  protocol_wakeup(); // added for ecmc
 }
 
 void system_clear_exec_alarm() {
@@ -403,16 +405,26 @@ void system_set_exec_motion_override_flag(uint8_t mask) {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
   //uint8_t sreg = SREG;
   //cli();
-  sys_rt_exec_motion_override |= (mask);
+  __atomic_fetch_or(&sys_rt_exec_motion_override, mask, __ATOMIC_SEQ_CST); // ecmc
   //SREG = sreg;
+  protocol_wakeup(); // added for ecmc
 }
 
 void system_set_exec_accessory_override_flag(uint8_t mask) {
   //printf("%s:%s:%d:\n",__FILE__,__FUNCTION__,__LINE__);
   //uint8_t sreg = SREG;
   //cli();
-  sys_rt_exec_accessory_override |= (mask);
+  __atomic_fetch_or(&sys_rt_exec_accessory_override, mask, __ATOMIC_SEQ_CST); // ecmc
   //SREG = sreg;
+  protocol_wakeup(); // added for ecmc
+}
+
+// Request gc_sync_position() from the grbl main thread (added for ecmc). The ecmc rt thread syncs
+// stepper and planner, the g-code parser state is only touched by the main thread.
+void system_set_exec_sync_position() {
+  if (!__atomic_exchange_n(&sys_rt_exec_sync_position, 1, __ATOMIC_SEQ_CST)) {
+    protocol_wakeup(); // Only at new request
+  }
 }
 
 void system_clear_exec_motion_overrides() {
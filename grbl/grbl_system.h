@@ -145,27 +145,15 @@ typedef struct {
     uint8_t override_ctrl;     // Tracks override control states.
   #endif
   #ifdef VARIABLE_SPINDLE
-    float spindle_speed;
+    real_t spindle_speed;
   #endif
 } system_t;
-extern system_t sys;
-
-// NOTE: These position variables may need to be declared as volatiles, if problems arise.
-extern int enableDebugPrintouts;
-extern int stepperInterruptEnable;
-
-extern int32_t sys_position[N_AXIS];      // Real-time machine (aka home) position vector in steps.
-extern int32_t sys_probe_position[N_AXIS]; // Last probe position in machine coordinates and steps.
-
-extern volatile uint8_t sys_probe_state;   // Probing state value.  Used to coordinate the probing cycle with stepper ISR.
-extern volatile uint8_t sys_rt_exec_state;   // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
-extern volatile uint8_t sys_rt_exec_alarm;   // Global realtime executor bitflag variable for setting various alarms.
-extern volatile uint8_t sys_rt_exec_motion_override; // Global realtime executor bitflag variable for motion-based overrides.
-extern volatile uint8_t sys_rt_exec_accessory_override; // Global realtime executor bitflag variable for spindle/coolant overrides.
+// NOTE: The realtime system state (sys, sys_position, sys_probe_position, sys_probe_state,
+// sys_rt_exec_xxx, stepperInterruptEnable and enableDebugPrintouts) is stored in the grbl context
+// (see grbl_context.h). Added for ecmc
 
 #ifdef DEBUG
   #define EXEC_DEBUG_REPORT  bit(0)
-  extern volatile uint8_t sys_rt_exec_debug;
 #endif
 
 // Initialize the serial protocol
@@ -187,10 +175,10 @@ void system_execute_startup(char *line);
 void system_flag_wco_change();
 
 // Returns machine position of axis 'idx'. Must be sent a 'step' array.
-float system_convert_axis_steps_to_mpos(int32_t *steps, uint8_t idx);
+real_t system_convert_axis_steps_to_mpos(int32_t *steps, uint8_t idx);
 
 // Updates a machine 'position' array based on the 'step' array sent.
-void system_convert_array_steps_to_mpos(float *position, int32_t *steps);
+void system_convert_array_steps_to_mpos(real_t *position, int32_t *steps);
 
 // CoreXY calculation only. Returns x or y-axis "steps" based on CoreXY motor steps.
 #ifdef COREXY
@@ -199,7 +187,7 @@ void system_convert_array_steps_to_mpos(float *position, int32_t *steps);
 #endif
 
 // Checks and reports if target array exceeds machine travel limits.
-uint8_t system_check_travel_limits(float *target);
+uint8_t system_check_travel_limits(real_t *target);
 
 // Special handlers for setting and clearing Grbl's real-time execution flags.
 void system_set_exec_state_flag(uint8_t mask);
@@ -210,6 +198,7 @@ void system_set_exec_motion_override_flag(uint8_t mask);
 void system_set_exec_accessory_override_flag(uint8_t mask);
 void system_clear_exec_motion_overrides();
 void system_clear_exec_accessory_overrides();
+void system_set_exec_sync_position(); // added for ecmc
 
 
 #endif
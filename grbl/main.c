@@ -22,22 +22,14 @@
 #include "grbl.h"
 
 
-// Declare system global variable structure
-system_t sys;
-int32_t sys_position[N_AXIS];      // Real-time machine (aka home) position vector in steps.
-int32_t sys_probe_position[N_AXIS]; // Last probe position in machine coordinates and steps.
-volatile uint8_t sys_probe_state;   // Probing state value.  Used to coordinate the probing cycle with stepper ISR.
-volatile uint8_t sys_rt_exec_state;   // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
-volatile uint8_t sys_rt_exec_alarm;   // Global realtime executor bitflag variable for setting various alarms.
-volatile uint8_t sys_rt_exec_motion_override; // Global realtime executor bitflag variable for motion-based overrides.
-volatile uint8_t sys_rt_exec_accessory_override; // Global realtime executor bitflag variable for spindle/coolant overrides.
-#ifdef DEBUG
-  volatile uint8_t sys_rt_exec_debug;
-#endif
+// NOTE: System variables are stored in the grbl context (see grbl_context.h). Added for ecmc
 
 
 int main(void)
 {
+  // Allocate and bind the grbl state. Added for ecmc
+  grbl_context_bind(grbl_context_create());
+
   // Initialize system upon power-up.
   serial_init();   // Setup serial baud rate and interrupts
   settings_init(); // Load Grbl settings from EEPROM
@@ -0,0 +1,150 @@
+/*************************************************************************\
+* Copyright (c) 2019 European Spallation Source ERIC
+* ecmc is distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*
+*  ecmcGrblTraceRead.cpp
+*
+*  Created on: oct 17, 2026
+*      Author: anderssandstrom
+*
+\*************************************************************************/
+
+// Reader of rt trace files (see ecmcGrblTraceFormat.h and README.md).
+// Prints the header as comments followed by one text line per record (same layout as the
+// simulation dump, easy to plot with gnuplot or numpy.loadtxt()):
+//   <time[s]> <cycle> <set x y z> <act x y z> [mm] <spindle[rpm]> <segment> <line> <state> <flags>
+// where time is relative to the trigger record (triggered) or the first record (continuous).
+// With -s only a summary is printed (records, cycle gaps, max difference between setpoint and
+// actual position per axis and the line numbers executed).
+
+#include "ecmcGrblTraceFormat.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(const char *name) {
+  printf("Usage: %s [-s] <trace file>\n"
+         "  -s  Summary only\n", name);
+}
+
+static bool readHeader(FILE *file, ecmcGrblTraceHeader *header) {
+  if(fread(header, sizeof(ecmcGrblTraceHeader), 1, file) != 1) {
+    fprintf(stderr, "ERROR: File too short for header.\n");
+    return false;
+  }
+  if(memcmp(header->magic, ECMC_GRBL_TRACE_MAGIC, sizeof(ECMC_GRBL_TRACE_MAGIC))) {
+    fprintf(stderr, "ERROR: Not a grbl trace file.\n");
+    return false;
+  }
+  if(header->version != ECMC_GRBL_TRACE_VERSION || header->recordSize != sizeof(ecmcGrblTraceRecord)) {
+    fprintf(stderr, "ERROR: Unsupported trace version %u (record size %u), reader version %d.\n",
+            header->version, header->recordSize, ECMC_GRBL_TRACE_VERSION);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool summary = false;
+  int opt;
+  while((opt = getopt(argc, argv, "sh")) != -1) {
+    switch(opt) {
+      case 's':
+        summary = true;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if(optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *file = fopen(argv[optind], "rb");
+  if(!file) {
+    perror(argv[optind]);
+    return 1;
+  }
+  ecmcGrblTraceHeader header;
+  if(!readHeader(file, &header)) {
+    fclose(file);
+    return 1;
+  }
+
+  bool triggered = header.mode == ECMC_GRBL_TRACE_MODE_TRIGGERED;
+  printf("# file %s\n", argv[optind]);
+  printf("# mode %s, object %u, sample time %gms\n", triggered ? "triggered" : "continuous",
+         header.index, header.sampleTimeMs);
+  if(triggered) {
+    printf("# trigger record %" PRIu64 "\n", header.triggerRecord);
+  }
+  printf("# lost records %" PRIu64 "\n", header.lostRecords);
+  if(!summary) {
+    printf("# time[s] cycle set.x set.y set.z act.x act.y act.z [mm] spindle[rpm] segment line state flags\n");
+  }
+
+  ecmcGrblTraceRecord record;
+  uint64_t records  = 0;
+  uint64_t gaps     = 0;
+  uint64_t lastCycle = 0;
+  int64_t  timeZeroNs = 0;
+  double   maxDiff[ECMC_GRBL_TRACE_AXES] = {0};
+  int32_t  firstLine = 0;
+  int32_t  lastLine  = 0;
+  uint64_t errors    = 0;
+
+  // Time zero at trigger record (triggered) or first record
+  long start = ftell(file);
+  uint64_t zeroRecord = triggered ? header.triggerRecord : 0;
+  if(fseek(file, start + zeroRecord * sizeof(record), SEEK_SET) == 0 &&
+     fread(&record, sizeof(record), 1, file) == 1) {
+    timeZeroNs = record.timeNs;
+  }
+  fseek(file, start, SEEK_SET);
+
+  while(fread(&record, sizeof(record), 1, file) == 1) {
+    if(records > 0 && record.cycle != lastCycle + 1) {
+      gaps++;
+    }
+    lastCycle = record.cycle;
+    for(int i = 0; i < ECMC_GRBL_TRACE_AXES; i++) {
+      double diff = fabs(record.setpoint[i] - record.actual[i]);
+      if(diff > maxDiff[i]) {
+        maxDiff[i] = diff;
+      }
+    }
+    if(record.line != 0) {
+      if(firstLine == 0) {
+        firstLine = record.line;
+      }
+      lastLine = record.line;
+    }
+    if(record.flags & ECMC_GRBL_TRACE_FLAG_ERROR) {
+      errors++;
+    }
+    records++;
+    if(summary) {
+      continue;
+    }
+    printf("%.6f %" PRIu64 " %.6f %.6f %.6f %.6f %.6f %.6f %.1f %u %d %u 0x%02x\n",
+           (record.timeNs - timeZeroNs) * 1E-9, record.cycle,
+           record.setpoint[0], record.setpoint[1], record.setpoint[2],
+           record.actual[0], record.actual[1], record.actual[2],
+           record.spindleSpeed, record.segment, record.line, record.state, record.flags);
+  }
+  fclose(file);
+
+  if(summary) {
+    printf("records %" PRIu64 " (%.3fs)\n", records, records * header.sampleTimeMs * 1E-3);
+    printf("cycle gaps %" PRIu64 "\n", gaps);
+    printf("error records %" PRIu64 "\n", errors);
+    printf("max |set - act| x %.6f y %.6f z %.6f [mm]\n", maxDiff[0], maxDiff[1], maxDiff[2]);
+    printf("lines N%d..N%d\n", firstLine, lastLine);
+  }
+  return 0;
+}